@@ -72,7 +72,7 @@ static void gui_cardwnd_set_cfg(gui_wnd_t* p_me, char* cfg, void* data)
       glx_color_t color;
       player_t* p_player = (player_t*)data;
       gui_widget_t* p_wgt;
-      card_t* p_card = core_get()->current_contract_card;
+      const card_t* p_card = (const card_t*)core_get()->current_contract_card;
       REQUIRE(p_card != NULL);
       p_wgt = p_me->find_widget(p_me, "card_image");
       REQUIRE(p_wgt != NULL);
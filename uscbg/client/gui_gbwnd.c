@@ -274,7 +274,7 @@ static void gui_board_set_cfg(gui_widget_t* p_me, char* cfg, void* data)
       int i;
       for (i=0;i<5;i++)
       {
-         card_t* p_card = core_get()->board_planning_cards[i];
+         const card_t* p_card = core_get()->board_planning_cards[i];
          if (p_board->planning_cards_img[i] != NULL)
          {
             glx_free_image(p_board->planning_cards_img[i]);
@@ -287,7 +287,7 @@ static void gui_board_set_cfg(gui_widget_t* p_me, char* cfg, void* data)
       }
       for (i=0;i<8;i++)
       {
-         card_t* p_card = core_get()->board_contract_cards[i];
+         const card_t* p_card = core_get()->board_contract_cards[i];
          if (p_board->contract_cards_img[i] != NULL)
          {
             glx_free_image(p_board->contract_cards_img[i]);
@@ -624,7 +624,7 @@ static void gui_board_handle_mouse(gui_widget_t* p_me, gfw_evt_t* p_evt)
             gui_board_draw_cards);
          if (id > 0)
          {
-            card_t* p_card = NULL;
+            const card_t* p_card = NULL;
             if (id <= 5)
             {
                p_card = core_get()->board_planning_cards[id-1];
@@ -144,7 +144,6 @@ static void gui_pbwnd_set_cfg(gui_wnd_t* p_me, char* cfg, void* data)
    if (strcmp(cfg, "update") == 0) {
       player_t* p_player = (player_t*)data;
       gui_widget_t* p_wgt;
-      card_t* p_card = SLNK_NEXT(card_t, &p_player->cards_head);
       int i;
       /* Add card(s) */
       for (i=0;i<6;i++)
@@ -153,11 +152,11 @@ static void gui_pbwnd_set_cfg(gui_wnd_t* p_me, char* cfg, void* data)
          sprintf(wgt_name, "card_%d", i + 1);
          p_wgt = p_me->find_widget(p_me, wgt_name);
          REQUIRE(p_wgt != NULL);
-         if (p_card != NULL)
+         if (i < p_player->cards.n)
          {
-            p_wgt->set_cfg(p_wgt, "image", p_card->img_path);
+            p_wgt->set_cfg(p_wgt, "image",
+               p_player->cards.p_cards[i]->img_path);
             p_wgt->visible = TRUE;
-            p_card = SLNK_NEXT(card_t, p_card);
          }
          else
          {
@@ -159,6 +159,7 @@ void main_hsm_stop(void)
 
    msg.evt = HSM_EVT_STOP;
    HSM_EVT(&main_hsm, &msg);
+   HSM_PROF_DUMP(&main_hsm);
 }
 
 /*-----------------------------------------------------------------------------
@@ -181,8 +182,8 @@ STATIC void main_hsm_ctor(main_hsm_t* p_me)
       &p_me->super.top);
    HSM_STATE_CTOR(&p_me->newgame, "newgame", main_newgame_hnd,
       &p_me->super.top);
-   HSM_STATE_CTOR(&p_me->lobby, "lobby", main_lobby_hnd, &p_me->game);
    HSM_STATE_CTOR(&p_me->game, "game", main_game_hnd, &p_me->super.top);
+   HSM_STATE_CTOR(&p_me->lobby, "lobby", main_lobby_hnd, &p_me->game);
    HSM_STATE_CTOR(&p_me->waitnet, "waitnet", main_waitnet_hnd, &p_me->game);
    HSM_STATE_CTOR(&p_me->select_color, "select_color",
       main_select_color_hnd, &p_me->game);
@@ -727,7 +728,7 @@ STATIC hsm_msg_t const* main_select_board_card_hnd(main_hsm_t* p_hsm,
    case HSM_EVT_ENTRY:
    {
       info_update("Select board card");
-      core_board_cards_mark();
+      core_board_cards_mark(core_get());
       p_msg = HSM_MSG_PROCESSED;
       break;
    }
@@ -742,7 +743,7 @@ STATIC hsm_msg_t const* main_select_board_card_hnd(main_hsm_t* p_hsm,
       //p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_EXIT:
-      core_board_cards_clear();
+      core_board_cards_clear(core_get());
       p_msg = HSM_MSG_PROCESSED;
       break;
    default:
@@ -763,7 +764,7 @@ STATIC hsm_msg_t const* main_select_player_card_hnd(main_hsm_t* p_hsm,
       info_update("Select player card");
       p_hsm->p_gpb->set_cfg(p_hsm->p_gpb, "update", core_get()->active_player);
       p_hsm->p_gpb->visible = TRUE;
-      //core_board_cards_mark();
+      //core_board_cards_mark(core_get());
       p_msg = HSM_MSG_PROCESSED;
       break;
    }
@@ -778,7 +779,7 @@ STATIC hsm_msg_t const* main_select_player_card_hnd(main_hsm_t* p_hsm,
       //p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_EXIT:
-      //core_board_cards_clear();
+      //core_board_cards_clear(core_get());
       p_hsm->p_gpb->visible = FALSE;
       p_msg = HSM_MSG_PROCESSED;
       break;
@@ -840,7 +841,7 @@ STATIC hsm_msg_t const* main_select_board_lot_hnd(main_hsm_t* p_hsm,
    case HSM_EVT_ENTRY:
    {
       info_update("Select board lot");
-      core_board_lots_mark();
+      core_board_lots_mark(core_get());
       p_msg = HSM_MSG_PROCESSED;
       break;
    }
@@ -852,7 +853,7 @@ STATIC hsm_msg_t const* main_select_board_lot_hnd(main_hsm_t* p_hsm,
       break;
    }
    case HSM_EVT_EXIT:
-      core_board_lots_clear();
+      core_board_lots_clear(core_get());
       p_msg = HSM_MSG_PROCESSED;
       break;
    default:
@@ -951,15 +952,10 @@ static void main_hsm_gui_event(gui_widget_t* p_wgt, char* event)
    } else if (strstr(p_wgt->name, "card") != NULL) {
       hsm_msg_t msg;
       player_t* p_player = core_get()->active_player;
-      card_t* p_card = SLNK_NEXT(card_t, &p_player->cards_head);
       int n = p_wgt->name[5] - 0x31;
       TRC_DBG(main_hsm, "Card %d clicked on player board.", n);
-      while (n--)
-      {
-         p_card = SLNK_NEXT(card_t, p_card);
-      }
-      REQUIRE(p_card != NULL);
-      core_get()->card_selection = p_card->id;
+      REQUIRE(n < p_player->cards.n);
+      core_get()->card_selection = p_player->cards.p_cards[n]->id;
       msg.evt = HSM_EVT_CARD;
       HSM_EVT(&main_hsm, &msg);
    }
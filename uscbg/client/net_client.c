@@ -11,11 +11,11 @@ Copyright (c) 2013, All Rights Reserved.
 #include "sys_assert.h"
 #include "slnk.h"
 #include "trc.h"
-#include "pbuf.h"
 #include "net.h"
 #include "net_us.h"
 #include "net_client.h"
 #include "core.h"
+#include "core_sync.h"
 #include "main_hsm.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -64,7 +64,7 @@ void net_client_start(char* name, char* ip, int port)
    strncpy(net_cfg.addr, ip, 15);
    p_player->id = 0;
    strncpy(p_player->name, name, MAX_CLIENT_NAME_LEN);
-   core_add_player(p_player);
+   core_add_player(core_get(), p_player);
    net_start(&net_cfg);
 }
 
@@ -80,7 +80,7 @@ static void net_client_evt_cb_fn(int evt, int sock, void* data, int len)
    }
    else if (evt == NET_EVT_DISCONNECTED)
    { /* Disconnected from server */
-
+      net_release(sock);
    }
    else if (evt == NET_EVT_RX)
    {
@@ -104,66 +104,75 @@ static void net_client_parse_command(int sock, void* data, int len)
    {
       case NET_CMD_SERVER_PLAYER_INFO:
       {
-         int id;
+         net_us_server_player_info_t msg;
          player_t* p_player;
-         pbuf_unpack(&p_data[2], "w", &id);
-         if (id == 0)
+         if (net_us_dec_server_player_info(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
+         }
+         if (msg.id == 0)
          { /* This player is always first in the list */
             p_player = SLNK_NEXT(player_t, &core_get()->players_head);
          }
          else
          {
-            p_player = core_find_player(id);
+            p_player = core_find_player(core_get(), msg.id);
          }
          if (p_player == NULL)
          { /* New player */
             p_player = (player_t*)calloc(1, sizeof(player_t));
             REQUIRE(p_player != NULL);
-            core_add_player(p_player);
+            core_add_player(core_get(), p_player);
          }
-         pbuf_unpack(&p_data[2], "wsdw", &id, MAX_CLIENT_NAME_LEN,
-            p_player->name, &p_player->id);
+         memcpy(p_player->name, msg.name, MAX_CLIENT_NAME_LEN);
+         p_player->id = msg.player_id;
          main_hsm_evt(HSM_EVT_NET_UPDATE_PLAYERS);
          break;
       }
       case NET_CMD_SERVER_PLAYER_REMOVE:
       {
-         int id;
+         net_us_server_player_remove_t msg;
          player_t* p_player;
-         pbuf_unpack(&p_data[2], "w", &id);
-         p_player = core_find_player(id);
+         if (net_us_dec_server_player_remove(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
+         }
+         p_player = core_find_player(core_get(), msg.id);
          REQUIRE(p_player != NULL);
-         core_rm_player(p_player);
+         core_rm_player(core_get(), p_player);
          main_hsm_evt(HSM_EVT_NET_UPDATE_PLAYERS);
          break;
       }
       case NET_CMD_SERVER_PLAYER_UPDATE:
       { /* Used for any other player updates during the game */
+         net_us_server_player_update_t msg;
          player_t* p_player;
-         card_t* p_card = SLNK_NEXT(card_t, &p_player->cards_head);
-         int id;
-         int pos = 2;
          int i;
-         pos += pbuf_unpack(&p_data[2], "w", &id);
-         p_player = core_find_player(id);
-         REQUIRE(p_player != NULL);
-         pos += pbuf_unpack(&p_data[pos], "bbbwww", &p_player->color,
-            &p_player->ap, &p_player->politicians, &p_player->vocations,
-            &p_player->wealth, &p_player->prestige);
-         /* Cards */
-         while ((p_card = cards_draw(&p_player->cards_head, -1)) != NULL)
+         if (net_us_dec_server_player_update(p_data, len, &msg) < 0)
          {
-            SLNK_ADD(&core_get()->planning_deck_head, p_card);
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
          }
+         p_player = core_find_player(core_get(), msg.id);
+         REQUIRE(p_player != NULL);
+         p_player->color = msg.color;
+         p_player->ap = msg.ap;
+         p_player->politicians = msg.politicians;
+         p_player->vocations = msg.vocations;
+         p_player->wealth = msg.wealth;
+         p_player->prestige = msg.prestige;
+         /* Cards, looked up in the card catalog */
+         p_player->cards.n = 0;
          for (i=0;i<6;i++)
          {
-            uint8_t id;
-            pos += pbuf_unpack(&p_data[pos], "b", &id);
+            uint8_t id = msg.cards[i];
             if (id > 0)
             {
-               card_t* p_card = cards_draw(&core_get()->planning_deck_head, id);
+               const card_t* p_card = cards_get(CARD_DECK_PLANNING, id);
                REQUIRE(p_card != NULL);
-               SLNK_ADD(&p_player->cards_head, p_card);
+               cards_hand_add(&p_player->cards, p_card);
             }
          }
          core_dbg_dump_player_data(p_player);
@@ -172,23 +181,28 @@ static void net_client_parse_command(int sock, void* data, int len)
       }
       case NET_CMD_SERVER_BOARD_CARDS_UPDATE:
       {
-         int pos = 2;
+         net_us_server_board_cards_update_t msg;
          uint8_t id;
          int i;
+         if (net_us_dec_server_board_cards_update(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
+         }
          for (i=0;i<5;i++)
          {
-            card_t* p_card;
-            pos += pbuf_unpack(&p_data[pos], "b", &id);
-            p_card = cards_find(&core_get()->planning_deck_head, id);
+            const card_t* p_card;
+            id = msg.planning[i];
+            p_card = cards_get(CARD_DECK_PLANNING, id);
             core_get()->board_planning_cards[i] = p_card;
             TRC_DBG(net_client, "Planning card id %d", id);
          }
          for (i=0;i<8;i++)
          {
-            card_t* p_card;
-            pos += pbuf_unpack(&p_data[pos], "b", &id);
+            const card_t* p_card;
+            id = msg.contract[i];
             /* Todo: Add type check for town/city/metropolis */
-            p_card = cards_find(&core_get()->town_deck_head, id);
+            p_card = cards_get(CARD_DECK_TOWN, id);
             core_get()->board_contract_cards[i] = p_card;
             TRC_DBG(net_client, "Contract card id %d", id);
          }
@@ -202,7 +216,13 @@ static void net_client_parse_command(int sock, void* data, int len)
       }
       case NET_CMD_SERVER_SELECT_COLOR:
       {
-         pbuf_unpack(&p_data[2], "b", &core_get()->available_colors);
+         net_us_server_select_color_t msg;
+         if (net_us_dec_server_select_color(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
+         }
+         core_get()->available_colors = msg.available_colors;
          main_hsm_evt(HSM_EVT_NET_SELECT_COLOR);
          break;
       }
@@ -213,21 +233,26 @@ static void net_client_parse_command(int sock, void* data, int len)
       }
       case NET_CMD_SERVER_BLOCK_UPDATE:
       {
+         net_us_server_block_update_t msg;
          block_t* p_blk;
-         uint8_t id;
-         int pos = 2;
          int i;
-         pos += pbuf_unpack(&p_data[pos], "b", &id);
-         REQUIRE(id < MAX_BOARD_BLOCKS);
-         p_blk = &core_get()->board_blocks[id];
-         pos += pbuf_unpack(&p_data[pos], "bw",
-            &p_blk->n_buildings, &p_blk->value);
+         if (net_us_dec_server_block_update(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
+         }
+         REQUIRE(msg.id < MAX_BOARD_BLOCKS);
+         p_blk = &core_get()->board_blocks[msg.id];
+         p_blk->n_buildings = msg.n_buildings;
+         p_blk->value = msg.value;
          for (i=0;i<4;i++)
          {
-            pos += pbuf_unpack(&p_data[pos], "bbbb",
-               &p_blk->buildings[i].zone, &p_blk->buildings[i].size,
-               &p_blk->buildings[i].owner, &p_blk->buildings[i].block_pos);
+            p_blk->buildings[i].zone = msg.buildings[4*i];
+            p_blk->buildings[i].size = msg.buildings[4*i+1];
+            p_blk->buildings[i].owner = msg.buildings[4*i+2];
+            p_blk->buildings[i].block_pos = msg.buildings[4*i+3];
          }
+         core_board_block_update(core_get(), msg.id);
          TRC_DBG(net_client, "Block: id %d, n_buildings %d, value %d",
             p_blk->id, p_blk->n_buildings, p_blk->value);
          }
@@ -249,10 +274,14 @@ static void net_client_parse_command(int sock, void* data, int len)
          break;
       case NET_CMD_SERVER_ACTIVE_PLAYER:
       {
-         int id;
+         net_us_server_active_player_t msg;
          player_t* p_player;
-         pbuf_unpack(&p_data[2], "w", &id);
-         p_player = core_find_player(id);
+         if (net_us_dec_server_active_player(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
+         }
+         p_player = core_find_player(core_get(), msg.id);
          REQUIRE(p_player != NULL);
          core_get()->active_player = p_player;
          main_hsm_evt(HSM_EVT_NET_UPDATE_ACTIVE_PLAYER);
@@ -261,21 +290,54 @@ static void net_client_parse_command(int sock, void* data, int len)
       case NET_CMD_SERVER_PHASE_UPDATE:
       {
          core_t* p_core = core_get();
-         pbuf_unpack(&p_data[2], "bb", &p_core->current_round,
-            &p_core->state);
+         net_us_server_phase_update_t msg;
+         if (net_us_dec_server_phase_update(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
+         }
+         p_core->current_round = msg.current_round;
+         p_core->state = msg.state;
          main_hsm_evt(HSM_EVT_NET_UPDATE_PHASE);
          break;
       }
+      case NET_CMD_SERVER_STATE_SYNC:
+      {
+         uint8_t changed;
+         if (core_sync_decode(core_get(), p_data, len, &changed) < 0)
+         {
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
+         }
+         if (changed & CORE_DIRTY_PLAYERS)
+         {
+            main_hsm_evt(HSM_EVT_NET_UPDATE_PLAYERS);
+         }
+         if (changed & CORE_DIRTY_BOARD_CARDS)
+         {
+            main_hsm_evt(HSM_EVT_NET_UPDATE_BOARD_CARDS);
+         }
+         if (changed & CORE_DIRTY_PHASE)
+         {
+            main_hsm_evt(HSM_EVT_NET_UPDATE_PHASE);
+         }
+         if (changed & CORE_DIRTY_ACTIVE_PLAYER)
+         {
+            main_hsm_evt(HSM_EVT_NET_UPDATE_ACTIVE_PLAYER);
+         }
+         break;
+      }
       case NET_CMD_SERVER_LOG_ENTRY:
       {
-         int id;
-         char* log_entry;
+         net_us_server_log_entry_t msg;
          core_t* p_core = core_get();
-         int pos = 2;
-         pos += pbuf_unpack(&p_data[2], "w", &id);
-         log_entry = (char*)&p_data[pos];
-         p_core->log_entry.p_player = core_find_player(id);
-         snprintf(p_core->log_entry.text, MAX_CORE_LOG_ENTRY, "%s",log_entry);
+         if (net_us_dec_server_log_entry(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_client, "Error: Malformed command %d", cmd);
+            break;
+         }
+         p_core->log_entry.p_player = core_find_player(p_core, msg.id);
+         snprintf(p_core->log_entry.text, MAX_CORE_LOG_ENTRY, "%s", msg.text);
          main_hsm_evt(HSM_EVT_NET_UPDATE_LOG);
          break;
       }
@@ -290,73 +352,98 @@ static void net_client_parse_command(int sock, void* data, int len)
 void net_client_send_cmd(net_us_cmd_t cmd, uint32_t data)
 {
    uint8_t packet[MAX_PACKET_SZ];
-   int len = 2;
+   int len = -1;
    TRC_DBG(net_client, "Sending command %s (%d) ",
       net_us_cmd_to_str(cmd), cmd);
-   packet[0] = cmd >> 8;
-   packet[1] = cmd & 0xff;
    switch (cmd)
    {
       case NET_CMD_CLIENT_PLAYER_NAME:
       {
-         player_t* p_player = core_find_player(0);
+         player_t* p_player = core_find_player(core_get(), 0);
+         net_us_client_player_name_t msg;
          REQUIRE(p_player != NULL);
-         memcpy((char*)&packet[2], p_player->name, MAX_CLIENT_NAME_LEN);
-         len += MAX_CLIENT_NAME_LEN;
+         memcpy(msg.name, p_player->name, MAX_CLIENT_NAME_LEN);
+         len = net_us_enc_client_player_name(packet, MAX_PACKET_SZ, &msg);
          break;
       }
       case NET_CMD_CLIENT_START_GAME:
+         len = net_us_enc_client_start_game(packet, MAX_PACKET_SZ, NULL);
          break;
       case NET_CMD_CLIENT_LOAD_GAME:
+         len = net_us_enc_client_load_game(packet, MAX_PACKET_SZ, NULL);
          break;
       case NET_CMD_CLIENT_SELECT_COLOR:
       {
-         uint8_t color = (uint8_t)data;
-         core_get()->color_selection = color;
-         TRC_DBG(net_client, "Color selected %d", color);
-         len += pbuf_pack(&packet[2], "b", color);
+         net_us_client_select_color_t msg;
+         msg.color = (uint8_t)data;
+         core_get()->color_selection = msg.color;
+         TRC_DBG(net_client, "Color selected %d", msg.color);
+         len = net_us_enc_client_select_color(packet, MAX_PACKET_SZ, &msg);
          break;
       }
       case NET_CMD_CLIENT_SELECT_ACTION:
       {
-         uint8_t action = (uint8_t)data;
-         len += pbuf_pack(&packet[2], "b", action);
+         net_us_client_select_action_t msg;
+         msg.action = (uint8_t)data;
+         len = net_us_enc_client_select_action(packet, MAX_PACKET_SZ, &msg);
          break;
       }
       case NET_CMD_CLIENT_SELECT_BUILDING_ROTATION:
       {
-         uint8_t rotation = (uint8_t)data;
-         len += pbuf_pack(&packet[2], "b", rotation);
+         net_us_client_select_building_rotation_t msg;
+         msg.rotation = (uint8_t)data;
+         len = net_us_enc_client_select_building_rotation(packet,
+            MAX_PACKET_SZ, &msg);
          break;
       }
       case NET_CMD_CLIENT_SELECT_BOARD_LOT:
       {
-         len += pbuf_pack(&packet[2], "b", core_get()->board_lot_selection);
+         net_us_client_select_board_lot_t msg;
+         msg.lot = core_get()->board_lot_selection;
+         len = net_us_enc_client_select_board_lot(packet, MAX_PACKET_SZ,
+            &msg);
          break;
       }
       case NET_CMD_CLIENT_SELECT_BOARD_CARD:
+      {
+         net_us_client_select_board_card_t msg;
+         msg.card = core_get()->card_selection;
+         len = net_us_enc_client_select_board_card(packet, MAX_PACKET_SZ,
+            &msg);
+         break;
+      }
       case NET_CMD_CLIENT_SELECT_PLAYER_CARD:
       {
-         len += pbuf_pack(&packet[2], "b", core_get()->card_selection);
+         net_us_client_select_player_card_t msg;
+         msg.card = core_get()->card_selection;
+         len = net_us_enc_client_select_player_card(packet, MAX_PACKET_SZ,
+            &msg);
          break;
       }
       case NET_CMD_CLIENT_SELECT_CARD_CHOICE:
       {
          //core_get()->card_choice = (uint8_t)data;
-         //len += pbuf_pack(&packet[2], "b", core_get()->card_choice);
+         len = net_us_enc_client_select_card_choice(packet, MAX_PACKET_SZ,
+            NULL);
          break;
       }
       case NET_CMD_CLIENT_PASS:
+         len = net_us_enc_client_pass(packet, MAX_PACKET_SZ, NULL);
          break;
       case NET_CMD_CLIENT_DONE:
+         len = net_us_enc_client_done(packet, MAX_PACKET_SZ, NULL);
          break;
       case NET_CMD_CLIENT_BACK:
+         len = net_us_enc_client_back(packet, MAX_PACKET_SZ, NULL);
          break;
       default:
          TRC_ERR(net_client, "Error: Unknown command %d", cmd);
          return;
    }
-   net_write_packet(server_sock, packet, len);
+   if (len > 0)
+   {
+      net_write_packet(server_sock, packet, len);
+   }
 }
 
 /* END OF FILE ***************************************************************/
@@ -124,7 +124,8 @@ int main(int argc, char* argv[])
 
    net_init();
    net_client_init();
-   core_init(NULL, NULL);
+   core_init();
+   core_ctor(core_get(), NULL, NULL);
 
    hsm_init();
    main_hsm_init();
@@ -0,0 +1,215 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file bitboard.c
+\brief Lot bitboards implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <string.h>
+#include "bitboard.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define BB_NIBBLE_LSB (0x1111111111111111ull)
+#define BB_LAST_WORD_MASK (0xffffull) /* Lots 128-143 */
+#define BB_BLOCK_LOTS (4)                          /* One block left/right */
+#define BB_ROW_LOTS (BB_COLUMNS * BB_BLOCK_LOTS)   /* One row up/down */
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static void bb_shl(bitboard_t* p_res, const bitboard_t* p_bb, int n);
+static void bb_shr(bitboard_t* p_res, const bitboard_t* p_bb, int n);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+bitboard_t bb_rows[BB_ROWS];
+bitboard_t bb_columns[BB_COLUMNS];
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void bb_init(void)
+{
+   int block;
+   memset(bb_rows, 0, sizeof(bb_rows));
+   memset(bb_columns, 0, sizeof(bb_columns));
+   for (block=0;block<BB_BLOCKS;block++)
+   {
+      BB_SET_BLOCK(&bb_rows[block / BB_COLUMNS], block, 0xf);
+      BB_SET_BLOCK(&bb_columns[block % BB_COLUMNS], block, 0xf);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void bb_clear(bitboard_t* p_bb)
+{
+   memset(p_bb, 0, sizeof(bitboard_t));
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void bb_and(bitboard_t* p_res, const bitboard_t* p_a, const bitboard_t* p_b)
+{
+   int i;
+   for (i=0;i<BB_WORDS;i++)
+   {
+      p_res->w[i] = p_a->w[i] & p_b->w[i];
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void bb_or(bitboard_t* p_res, const bitboard_t* p_a, const bitboard_t* p_b)
+{
+   int i;
+   for (i=0;i<BB_WORDS;i++)
+   {
+      p_res->w[i] = p_a->w[i] | p_b->w[i];
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void bb_andnot(bitboard_t* p_res, const bitboard_t* p_a,
+   const bitboard_t* p_b)
+{
+   int i;
+   for (i=0;i<BB_WORDS;i++)
+   {
+      p_res->w[i] = p_a->w[i] & ~p_b->w[i];
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t bb_empty(const bitboard_t* p_bb)
+{
+   return (p_bb->w[0] | p_bb->w[1] | p_bb->w[2]) == 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int bb_count(const bitboard_t* p_bb)
+{
+   return __builtin_popcountll(p_bb->w[0]) +
+      __builtin_popcountll(p_bb->w[1]) + __builtin_popcountll(p_bb->w[2]);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int bb_next(const bitboard_t* p_bb, int lot)
+{
+   int i = lot >> 6;
+   uint64_t w;
+
+   if ((lot < 0) || (lot >= BB_LOTS))
+   {
+      return -1;
+   }
+   w = p_bb->w[i] & (~0ull << (lot & 63));
+   while (w == 0)
+   {
+      if (++i == BB_WORDS)
+      {
+         return -1;
+      }
+      w = p_bb->w[i];
+   }
+   return (i << 6) + __builtin_ctzll(w);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void bb_blocks(bitboard_t* p_res, const bitboard_t* p_bb)
+{
+   int i;
+   for (i=0;i<BB_WORDS;i++)
+   { /* Fold each nibble into its lowest bit, then spread it back */
+      uint64_t w = p_bb->w[i];
+      w |= w >> 1;
+      w |= w >> 2;
+      p_res->w[i] = (w & BB_NIBBLE_LSB) * 0xf;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void bb_neighbours(bitboard_t* p_res, const bitboard_t* p_bb)
+{
+   bitboard_t blocks;
+   bitboard_t tmp;
+
+   bb_blocks(&blocks, p_bb);
+   /* Right and left, without wrapping to the next/previous row */
+   bb_shl(p_res, &blocks, BB_BLOCK_LOTS);
+   bb_andnot(p_res, p_res, &bb_columns[0]);
+   bb_shr(&tmp, &blocks, BB_BLOCK_LOTS);
+   bb_andnot(&tmp, &tmp, &bb_columns[BB_COLUMNS - 1]);
+   bb_or(p_res, p_res, &tmp);
+   /* Down and up */
+   bb_shl(&tmp, &blocks, BB_ROW_LOTS);
+   bb_or(p_res, p_res, &tmp);
+   bb_shr(&tmp, &blocks, BB_ROW_LOTS);
+   bb_or(p_res, p_res, &tmp);
+   bb_andnot(p_res, p_res, &blocks);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void bb_lines(bitboard_t* p_res, uint8_t rows, uint8_t columns)
+{
+   int i;
+   bb_clear(p_res);
+   for (i=0;i<BB_ROWS;i++)
+   {
+      if (rows & (1u << i))
+      {
+         bb_or(p_res, p_res, &bb_rows[i]);
+      }
+   }
+   for (i=0;i<BB_COLUMNS;i++)
+   {
+      if (columns & (1u << i))
+      {
+         bb_or(p_res, p_res, &bb_columns[i]);
+      }
+   }
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Shift towards higher lots (0 < n < 64). Lots past the board are dropped.
+-----------------------------------------------------------------------------*/
+static void bb_shl(bitboard_t* p_res, const bitboard_t* p_bb, int n)
+{
+   uint64_t w0 = p_bb->w[0];
+   uint64_t w1 = p_bb->w[1];
+   uint64_t w2 = p_bb->w[2];
+   REQUIRE((n > 0) && (n < 64));
+   p_res->w[2] = ((w2 << n) | (w1 >> (64 - n))) & BB_LAST_WORD_MASK;
+   p_res->w[1] = (w1 << n) | (w0 >> (64 - n));
+   p_res->w[0] = w0 << n;
+}
+
+/*-----------------------------------------------------------------------------
+Shift towards lower lots (0 < n < 64).
+-----------------------------------------------------------------------------*/
+static void bb_shr(bitboard_t* p_res, const bitboard_t* p_bb, int n)
+{
+   uint64_t w0 = p_bb->w[0];
+   uint64_t w1 = p_bb->w[1];
+   uint64_t w2 = p_bb->w[2];
+   REQUIRE((n > 0) && (n < 64));
+   p_res->w[0] = (w0 >> n) | (w1 << (64 - n));
+   p_res->w[1] = (w1 >> n) | (w2 << (64 - n));
+   p_res->w[2] = w2 >> n;
+}
+
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,145 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file bitboard.h
+\brief Lot bitboards.
+
+One bit per board lot, lot = block * 4 + position in block. The board is 6x6
+blocks (block = row * 6 + column) and a block is 2x2 lots:
+   |0|1|
+   |2|3|
+A block is a nibble that never crosses a word, so a row of blocks is 24
+consecutive bits. */
+/*---------------------------------------------------------------------------*/
+#ifndef BITBOARD_H
+#define BITBOARD_H
+/* INCLUDE FILES *************************************************************/
+
+/* EXPORTED DEFINES **********************************************************/
+#define BB_LOTS (144)
+#define BB_BLOCKS (36)
+#define BB_ROWS (6)
+#define BB_COLUMNS (6)
+#define BB_WORDS (3)
+
+#define BB_SET(p_bb, lot) \
+   ((p_bb)->w[(lot) >> 6] |= 1ull << ((lot) & 63))
+#define BB_CLR(p_bb, lot) \
+   ((p_bb)->w[(lot) >> 6] &= ~(1ull << ((lot) & 63)))
+#define BB_TEST(p_bb, lot) \
+   (((p_bb)->w[(lot) >> 6] >> ((lot) & 63)) & 1)
+/* Lots of a block as a nibble (bits 0-3 = block positions) */
+#define BB_BLOCK(p_bb, block) \
+   ((uint8_t)(((p_bb)->w[(block) >> 4] >> (((block) & 15) * 4)) & 0xf))
+#define BB_SET_BLOCK(p_bb, block, lots) \
+   ((p_bb)->w[(block) >> 4] |= (uint64_t)((lots) & 0xf) << (((block) & 15) * 4))
+#define BB_CLR_BLOCK(p_bb, block) \
+   ((p_bb)->w[(block) >> 4] &= ~(0xfull << (((block) & 15) * 4)))
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef struct
+{
+   uint64_t w[BB_WORDS];
+} bitboard_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+extern bitboard_t bb_rows[BB_ROWS];       /*!< All lots of a block row */
+extern bitboard_t bb_columns[BB_COLUMNS]; /*!< All lots of a block column */
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize the row and column masks. */
+/*---------------------------------------------------------------------------*/
+void bb_init(void);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Clear all lots. */
+/*---------------------------------------------------------------------------*/
+void bb_clear(
+   bitboard_t* p_bb
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief p_res = p_a & p_b (p_res may be an operand). */
+/*---------------------------------------------------------------------------*/
+void bb_and(
+   bitboard_t* p_res,
+   const bitboard_t* p_a,
+   const bitboard_t* p_b
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief p_res = p_a | p_b (p_res may be an operand). */
+/*---------------------------------------------------------------------------*/
+void bb_or(
+   bitboard_t* p_res,
+   const bitboard_t* p_a,
+   const bitboard_t* p_b
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief p_res = p_a & ~p_b (p_res may be an operand). */
+/*---------------------------------------------------------------------------*/
+void bb_andnot(
+   bitboard_t* p_res,
+   const bitboard_t* p_a,
+   const bitboard_t* p_b
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Check for no lots. */
+/*---------------------------------------------------------------------------*/
+bool_t bb_empty(
+   const bitboard_t* p_bb
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Count lots.
+\return Number of set lots */
+/*---------------------------------------------------------------------------*/
+int bb_count(
+   const bitboard_t* p_bb
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Iterate lots: for (lot = bb_next(p, 0); lot >= 0;
+lot = bb_next(p, lot + 1)).
+\return First set lot >= lot or -1 */
+/*---------------------------------------------------------------------------*/
+int bb_next(
+   const bitboard_t* p_bb,
+   int lot              /*!< Start lot */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Fill every block that has a set lot (all four lots set). */
+/*---------------------------------------------------------------------------*/
+void bb_blocks(
+   bitboard_t* p_res,
+   const bitboard_t* p_bb
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Blocks orthogonally adjacent to the blocks that have a set lot
+(all four lots set, the blocks themselves not included). */
+/*---------------------------------------------------------------------------*/
+void bb_neighbours(
+   bitboard_t* p_res,
+   const bitboard_t* p_bb
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief All lots of the rows and columns in two masks (bit n = row or
+column n, as in prestige_wealth_marker_t). */
+/*---------------------------------------------------------------------------*/
+void bb_lines(
+   bitboard_t* p_res,
+   uint8_t rows,
+   uint8_t columns
+   );
+
+#endif /* #ifndef BITBOARD_H */
+/* END OF FILE ***************************************************************/
@@ -10,10 +10,8 @@ Copyright (c) 2013, All Rights Reserved.
 #include "sys_def.h"
 #include "sys_assert.h"
 #include <stdio.h>
-#include <malloc.h>
 #include <string.h>
 #include <stdlib.h>
-#include "slnk.h"
 #include "net_us.h"
 #include "core.h"
 #include "trc.h"
@@ -25,6 +23,7 @@ Copyright (c) 2013, All Rights Reserved.
 #define Z_COM (1u << ZONE_COM)
 #define Z_IND (1u << ZONE_IND)
 #define Z_RES (1u << ZONE_RES)
+#define CARDS_ALIGNED __attribute__((aligned(64))) /* Cache line */
 
 /* LOCAL DATATYPES ***********************************************************/
 typedef struct
@@ -58,8 +57,9 @@ typedef struct
 } card_event_res_t;
 
 /* LOCAL FUNCTION PROTOTYPES *************************************************/
-static void cards_create_planning_deck(slnk_t* p_deck);
-static void cards_create_contract_deck(slnk_t* p_deck, card_deck_t deck);
+static void cards_create_planning(card_planning_t* p_cards);
+static void cards_create_contracts(card_contract_t* p_cards, card_deck_t deck,
+   const card_contract_res_t* p_res);
 //static card_action_fn_t card_aquatic;
 //static card_mark_fn_t card_aquatic_mark;
 
@@ -168,6 +168,12 @@ static const card_contract_res_t cards_town_contracts_res[] = {
    {NULL, NULL, 0, 0, 0, 0, 0, NULL}
 };
 
+/* Card catalog of all games, built by cards_init() and read only after */
+static card_planning_t cards_planning[CARDS_MAX_DECK] CARDS_ALIGNED;
+static card_contract_t cards_town[CARDS_MAX_DECK] CARDS_ALIGNED;
+static card_t* cards_by_id[CARD_DECK_LAST][CARDS_MAX_DECK + 1] CARDS_ALIGNED;
+static uint8_t cards_n[CARD_DECK_LAST]; /* Cards per deck */
+
 /* GLOBAL CONSTANTS / VARIABLES **********************************************/
 extern const uint8_t bonus_vp_tbl[];
 
@@ -176,127 +182,148 @@ extern const uint8_t bonus_vp_tbl[];
 -----------------------------------------------------------------------------*/
 void cards_init(void)
 {
+   memset(cards_by_id, 0, sizeof(cards_by_id));
+   memset(cards_n, 0, sizeof(cards_n));
+   cards_create_planning(cards_planning);
+   cards_create_contracts(cards_town, CARD_DECK_TOWN,
+      cards_town_contracts_res);
 }
 
-void cards_create_deck(slnk_t* p_deck, card_deck_t deck)
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+const card_t* cards_get(card_deck_t deck, int id)
 {
-   if (deck == CARD_DECK_PLANNING)
+   if ((deck >= CARD_DECK_LAST) || (id < 0) || (id > CARDS_MAX_DECK))
    {
-      cards_create_planning_deck(p_deck);
+      return NULL;
    }
-   else
+   return cards_by_id[deck][id];
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void cards_create_deck(card_pile_t* p_pile, card_deck_t deck)
+{
+   int i;
+
+   cards_pile_init(p_pile, deck);
+   for (i=0;i<cards_n[deck];i++)
    {
-      cards_create_contract_deck(p_deck, deck);
+      p_pile->ids[i] = i + 1;
    }
+   p_pile->n = cards_n[deck];
 }
 
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void cards_pile_init(card_pile_t* p_pile, card_deck_t deck)
+{
+   REQUIRE(deck < CARD_DECK_LAST);
+   p_pile->n = 0;
+   p_pile->deck = deck;
+}
 
 /*-----------------------------------------------------------------------------
+Fisher-Yates in place.
 -----------------------------------------------------------------------------*/
-void cards_free_deck(slnk_t* p_deck)
+void cards_shuffle_deck(card_pile_t* p_pile, core_rng_t* p_rng)
 {
-   card_t* p_card = SLNK_NEXT(card_t, p_deck);
-   while(p_card != NULL)
+   int i;
+
+   for (i=p_pile->n-1;i>0;i--)
    {
-      card_t* p_tmp = p_card;
-      p_card = SLNK_NEXT(card_t, p_card);
-      SLNK_REMOVE(p_deck, p_tmp);
-      free(p_tmp);
+      int r = core_rng_below(p_rng, i + 1);
+      uint8_t id = p_pile->ids[i];
+      p_pile->ids[i] = p_pile->ids[r];
+      p_pile->ids[r] = id;
    }
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void cards_shuffle_deck(slnk_t* p_deck)
+const card_t* cards_pile_draw(card_pile_t* p_pile)
 {
-   slnk_t deck_tmp;
-   int n_cards = 0;
-   card_t* p_card = SLNK_NEXT(card_t, p_deck);
-   SLNK_INIT(&deck_tmp);
-   /* Count cards in deck */
-   while(p_card != NULL)
+   if (p_pile->n == 0)
    {
-      n_cards++;
-      p_card = SLNK_NEXT(card_t, p_card);
-   }
-   if (n_cards > 1)
-   {
-      int i, r, n;
-      int number = n_cards;
-      for (i=--number; i>0; i--)
-      {
-         n = 0;
-         r = (int)(((double)rand()/(double)RAND_MAX)*i);
-         p_card = SLNK_NEXT(card_t, p_deck);
-         while(p_card != NULL)
-         {
-            if (n == r)
-               break;
-            n++;
-            p_card = SLNK_NEXT(card_t, p_card);
-         }
-         REQUIRE(n == r);
-         SLNK_REMOVE(p_deck, p_card);
-         SLNK_ADD(&deck_tmp, p_card);
-      }
-      *p_deck = deck_tmp;
-      p_card = cards_draw(p_deck, -1);
-      REQUIRE(p_card != NULL);
-      SLNK_REMOVE(p_deck, p_card);
-      SLNK_ADD(p_deck, p_card);
+      return NULL;
    }
+   p_pile->n--;
+   return cards_by_id[p_pile->deck][p_pile->ids[p_pile->n]];
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void cards_merge_decks(slnk_t* p_dst_deck, slnk_t* p_src_deck)
+const card_t* cards_pile_top(const card_pile_t* p_pile)
 {
-   card_t* p_card = SLNK_NEXT(card_t, p_src_deck);
-   while(p_card != NULL)
+   if (p_pile->n == 0)
    {
-      card_t* p_tmp = p_card;
-      p_card = SLNK_NEXT(card_t, p_card);
-      SLNK_REMOVE(p_src_deck, p_tmp);
-      SLNK_ADD(p_dst_deck, p_tmp);
+      return NULL;
    }
+   return cards_by_id[p_pile->deck][p_pile->ids[p_pile->n - 1]];
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-card_t* cards_draw(slnk_t* p_deck, int id)
+void cards_pile_put(card_pile_t* p_pile, const card_t* p_card)
 {
-   card_t* p_card = SLNK_NEXT(card_t, p_deck);
-   while(p_card != NULL)
-   {
-      if ((id == -1) || (p_card->id == id))
-      {
-         SLNK_REMOVE(p_deck, p_card);
-         break;
-      }
-      p_card = SLNK_NEXT(card_t, p_card);
-   }
+   REQUIRE((p_card != NULL) && (p_card->deck == p_pile->deck) &&
+      (p_pile->n < CARDS_MAX_DECK));
+   p_pile->ids[p_pile->n++] = p_card->id;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void cards_hand_add(card_hand_t* p_hand, const card_t* p_card)
+{
+   cards_hand_insert(p_hand, p_hand->n, p_card);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void cards_hand_insert(card_hand_t* p_hand, int pos,
+   const card_t* p_card)
+{
+   REQUIRE((p_card != NULL) && (p_hand->n < CARDS_MAX_HAND));
+   REQUIRE((pos >= 0) && (pos <= p_hand->n));
+   memmove(&p_hand->p_cards[pos + 1], &p_hand->p_cards[pos],
+      (p_hand->n - pos) * sizeof(const card_t*));
+   p_hand->p_cards[pos] = p_card;
+   p_hand->n++;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+const card_t* cards_hand_remove(card_hand_t* p_hand, int pos)
+{
+   const card_t* p_card;
+
+   REQUIRE((pos >= 0) && (pos < p_hand->n));
+   p_card = p_hand->p_cards[pos];
+   p_hand->n--;
+   memmove(&p_hand->p_cards[pos], &p_hand->p_cards[pos + 1],
+      (p_hand->n - pos) * sizeof(const card_t*));
    return p_card;
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-card_t* cards_find(slnk_t* p_deck, int id)
+int cards_hand_find(const card_hand_t* p_hand, card_deck_t deck, int id)
 {
-   card_t* p_card = SLNK_NEXT(card_t, p_deck);
-   while(p_card != NULL)
+   int i;
+
+   for (i=0;i<p_hand->n;i++)
    {
-      if (p_card->id == id)
+      if ((p_hand->p_cards[i]->id == id) && (p_hand->p_cards[i]->deck == deck))
       {
-         break;
+         return i;
       }
-      p_card = SLNK_NEXT(card_t, p_card);
    }
-   return p_card;
+   return -1;
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-card_action_t cards_use(card_t* p_card, card_evt_t evt)
+card_action_t cards_use(const card_t* p_card, card_evt_t evt)
 {
    card_action_t action = CARD_ACTION_DONE;
    REQUIRE(p_card != NULL);
@@ -332,7 +359,7 @@ card_action_t cards_use(card_t* p_card, card_evt_t evt)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void cards_mark(card_t* p_card, card_mark_t mark)
+void cards_mark(const card_t* p_card, card_mark_t mark)
 {
    REQUIRE(p_card != NULL);
 #if 0
@@ -350,7 +377,7 @@ void cards_mark(card_t* p_card, card_mark_t mark)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-char* cards_get_image_path(card_t* p_card)
+char* cards_get_image_path(const card_t* p_card)
 {
    //return cards_res[p_card->id].path;
    return NULL;
@@ -359,12 +386,9 @@ char* cards_get_image_path(card_t* p_card)
 /* LOCAL FUNCTIONS ***********************************************************/
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-/*-----------------------------------------------------------------------------
------------------------------------------------------------------------------*/
-static void cards_create_planning_deck(slnk_t* p_deck)
+static void cards_create_planning(card_planning_t* p_cards)
 {
    const card_build_permit_res_t* p_res = &cards_build_permit_res[0];
-   card_planning_t* p_card;
    int id = 1;
    int i;
 
@@ -372,9 +396,9 @@ static void cards_create_planning_deck(slnk_t* p_deck)
    {
       for (i=0;i<p_res->n;i++)
       {
-         p_card = (card_planning_t*)malloc(sizeof(card_planning_t));
-         REQUIRE(p_card != NULL);
-         SLNK_INIT(p_card);
+         card_planning_t* p_card = &p_cards[id - 1];
+         REQUIRE(id <= CARDS_MAX_DECK);
+         memset(p_card, 0, sizeof(card_planning_t));
          p_card->card.id = id;
          p_card->card.deck = CARD_DECK_PLANNING;
          p_card->card.img_path = p_res->img_path;
@@ -383,41 +407,26 @@ static void cards_create_planning_deck(slnk_t* p_deck)
          p_card->n_permits = p_res->n_permits;
          p_card->payout = p_res->payout;
          p_card->election = p_res->election;
-         SLNK_ADD(p_deck, p_card);
+         cards_by_id[CARD_DECK_PLANNING][id] = &p_card->card;
          id++;
       }
       p_res++;
    }
+   cards_n[CARD_DECK_PLANNING] = id - 1;
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-static void cards_create_contract_deck(slnk_t* p_deck, card_deck_t deck)
+static void cards_create_contracts(card_contract_t* p_cards, card_deck_t deck,
+   const card_contract_res_t* p_res)
 {
-   const card_contract_res_t* p_res;
-   card_contract_t* p_card;
    int id = 1;
 
-   switch (deck)
-   {
-   case CARD_DECK_TOWN:
-      p_res = cards_town_contracts_res;
-      break;
-   case CARD_DECK_CITY:
-      //p_res = cards_city_contracts_res;
-      break;
-   case CARD_DECK_METROPOLIS:
-      //p_res = cards_metropolis_contracts_res;
-      break;
-   default:
-      ASSERT(TRUE);
-      break;
-   }
    while (p_res->img_path != NULL)
    {
-      p_card = (card_contract_t*)malloc(sizeof(card_contract_t));
-      REQUIRE(p_card != NULL);
-      SLNK_INIT(p_card);
+      card_contract_t* p_card = &p_cards[id - 1];
+      REQUIRE(id <= CARDS_MAX_DECK);
+      memset(p_card, 0, sizeof(card_contract_t));
       p_card->card.id = id;
       p_card->card.deck = deck;
       p_card->card.img_path = p_res->img_path;
@@ -428,10 +437,11 @@ static void cards_create_contract_deck(slnk_t* p_deck, card_deck_t deck)
       p_card->payout = p_res->payout;
       p_card->vocation = p_res->vocation;
       p_card->vocation_value = p_res->vocation_value;
-      SLNK_ADD(p_deck, p_card);
+      cards_by_id[deck][id] = &p_card->card;
       id++;
       p_res++;
    }
+   cards_n[deck] = id - 1;
 }
 
 #if 0
@@ -4,13 +4,20 @@ Copyright (c) 2013, All Rights Reserved.
 
 /*---------------------------------------------------------------------------*/
 /*! \file cards.h
-\brief The cards interface. */
+\brief The cards interface.
+All cards are in one catalog built by cards_init() and shared by all games,
+a card_t is never changed after that. A game only keeps where its cards are:
+decks and discard piles (card_pile_t, card ids drawn from the top), the
+board slots and the hands of the players (card_hand_t). */
 /*---------------------------------------------------------------------------*/
 #ifndef CARDS_H
 #define CARDS_H
 /* INCLUDE FILES *************************************************************/
+#include "core_rng.h"
 
 /* EXPORTED DEFINES **********************************************************/
+#define CARDS_MAX_DECK (64) /*!< Cards in a deck, ids are 1 to n */
+#define CARDS_MAX_HAND (16) /*!< Cards in a hand */
 
 /* EXPORTED DATA TYPES *******************************************************/
 typedef enum
@@ -69,7 +76,6 @@ typedef void card_mark_fn_t(card_mark_t mark);
 
 typedef struct
 {
-   slnk_t slnk;
    int id;
    card_deck_t deck;
    char* img_path;
@@ -102,104 +108,144 @@ typedef struct
    bool_t event;
 } card_contract_t;
 
+typedef struct
+{
+   uint8_t ids[CARDS_MAX_DECK];     /*!< Bottom first, top is ids[n-1] */
+   uint8_t n;                       /*!< Cards in pile */
+   uint8_t deck;                    /*!< card_deck_t of all cards */
+} card_pile_t;                      /*!< Deck or discard pile */
+
+typedef struct
+{
+   const card_t* p_cards[CARDS_MAX_HAND]; /*!< In the order taken */
+   int n;                                 /*!< Cards in hand */
+} card_hand_t;
+
 /* GLOBAL VARIABLES **********************************************************/
 
 /* INTERFACE FUNCTIONS *******************************************************/
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Initialize. */
+/*! \brief Initialize, build the card catalog (before any game). */
 /*---------------------------------------------------------------------------*/
 void cards_init(void);
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Create new card deck. */
+/*! \brief Get a card of the catalog.
+\return Card or NULL (e.g. id 0) */
 /*---------------------------------------------------------------------------*/
-void cards_create_deck(
-   slnk_t* p_deck,        /*!< List head of deck */
-   card_deck_t deck       /*!< Deck to create */
+const card_t* cards_get(
+   card_deck_t deck,       /*!< Deck */
+   int id                  /*!< Id of card */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Prepare card deck (shuffle and setup). */
+/*! \brief Create new card deck, the cards in id order (id 1 at the
+bottom). */
 /*---------------------------------------------------------------------------*/
-void cards_prepare_deck(
-   slnk_t* p_deck,        /*!< List head of deck */
+void cards_create_deck(
+   card_pile_t* p_pile,   /*!< Pile */
    card_deck_t deck       /*!< Deck to create */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Free card deck. */
+/*! \brief Make an empty pile (e.g. a discard pile) of a deck. */
 /*---------------------------------------------------------------------------*/
-void cards_free_deck(
-   slnk_t* p_deck        /*!< List head of deck */
+void cards_pile_init(
+   card_pile_t* p_pile,   /*!< Pile */
+   card_deck_t deck       /*!< Deck of the cards put on the pile */
    );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Shuffle cards in deck. */
 /*---------------------------------------------------------------------------*/
 void cards_shuffle_deck(
-   slnk_t* p_deck        /*!< List head of deck */
+   card_pile_t* p_pile,  /*!< Deck */
+   core_rng_t* p_rng     /*!< Random numbers of the game */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Merge cards in decks. */
+/*! \brief Draw the top card of a pile.
+\return Card or NULL if the pile is empty */
 /*---------------------------------------------------------------------------*/
-void cards_merge_decks(
-   slnk_t* p_dst_deck,   /*!< List head of destination deck */
-   slnk_t* p_src_deck    /*!< List head of source deck */
+const card_t* cards_pile_draw(
+   card_pile_t* p_pile   /*!< Pile */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Draw any (-1) or specified card from deck. */
+/*! \brief Top card of a pile (not drawn).
+\return Card or NULL if the pile is empty */
 /*---------------------------------------------------------------------------*/
-card_t* cards_draw(
-   slnk_t* p_deck,       /*!< List head of deck */
-   int id                /*!< Id of card or -1 for any */
+const card_t* cards_pile_top(
+   const card_pile_t* p_pile  /*!< Pile */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Find card in deck by id. */
+/*! \brief Put a card on top of a pile. */
 /*---------------------------------------------------------------------------*/
-card_t* cards_find(
-   slnk_t* p_deck,       /*!< List head of deck */
-   int id                /*!< Id of card */
+void cards_pile_put(
+   card_pile_t* p_pile,  /*!< Pile */
+   const card_t* p_card  /*!< Card */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Use card. */
+/*! \brief Add a card to a hand (last). */
 /*---------------------------------------------------------------------------*/
-card_action_t cards_use(
-   card_t* p_card,       /*!< Card */
-   card_evt_t evt        /*!< Event */
+void cards_hand_add(
+   card_hand_t* p_hand,  /*!< Hand */
+   const card_t* p_card  /*!< Card */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Count cards in deck. */
+/*! \brief Insert a card in a hand before position pos (n = last). */
 /*---------------------------------------------------------------------------*/
-int cards_count(
-   slnk_t* p_deck        /*!< List head of deck */
+void cards_hand_insert(
+   card_hand_t* p_hand,  /*!< Hand */
+   int pos,              /*!< Position */
+   const card_t* p_card  /*!< Card */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Handle mark for different card actions. */
+/*! \brief Remove the card at a position from a hand, the order of the other
+cards is kept.
+\return Card */
 /*---------------------------------------------------------------------------*/
-void cards_mark(
-   card_t* p_card,       /*!< Card */
-   card_mark_t mark      /*!< What to mark */
+const card_t* cards_hand_remove(
+   card_hand_t* p_hand,  /*!< Hand */
+   int pos               /*!< Position */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Get card name. */
+/*! \brief Find a card in a hand.
+\return Position or -1 if not in hand */
 /*---------------------------------------------------------------------------*/
-char* cards_get_name(
-   card_t* p_card        /*!< Card */
+int cards_hand_find(
+   const card_hand_t* p_hand, /*!< Hand */
+   card_deck_t deck,          /*!< Deck of card */
+   int id                     /*!< Id of card */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Use card. */
+/*---------------------------------------------------------------------------*/
+card_action_t cards_use(
+   const card_t* p_card, /*!< Card */
+   card_evt_t evt        /*!< Event */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Handle mark for different card actions. */
+/*---------------------------------------------------------------------------*/
+void cards_mark(
+   const card_t* p_card, /*!< Card */
+   card_mark_t mark      /*!< What to mark */
    );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Get card image path. */
 /*---------------------------------------------------------------------------*/
 char* cards_get_image_path(
-   card_t* p_card        /*!< Card */
+   const card_t* p_card  /*!< Card */
    );
 
 #endif /* #ifndef CARDS_H */
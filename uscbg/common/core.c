@@ -3,7 +3,7 @@ Copyright (c) 2013, All Rights Reserved.
 ******************************************************************************/
 
 /*---------------------------------------------------------------------------*/
-/*! \file core.c
+/*! \file p_core->c
 \brief The Core game logic implementation for Urban Sprawl. */
 /*---------------------------------------------------------------------------*/
 /* INCLUDE FILES *************************************************************/
@@ -14,12 +14,13 @@ Copyright (c) 2013, All Rights Reserved.
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
-#include <time.h>
 #include "net_us.h"
 #include "slnk.h"
 #include "trc.h"
 #include "pbuf.h"
 #include "core.h"
+#include "core_sync.h"
+#include "core_hash.h"
 
 /* CONSTANTS / MACROS ********************************************************/
 #define MAX_PATH_LENGTH (255)
@@ -35,10 +36,10 @@ typedef struct
 
 /* LOCAL FUNCTION PROTOTYPES *************************************************/
 //static int core_lots_setup(int n, int x, int y, int c);
-static void core_prepare_players(void);
+static void core_prepare_players(core_t* p_core);
 //static int core_compare_ascending(const void* a, const void* b);
 static int core_compare_descending(const void* a, const void* b);
-static int core_calc_block_value(int block);
+static void core_board_lots_view(core_t* p_core);
 
 /* MODULE CONSTANTS / VARIABLES **********************************************/
 SYS_ASSERT_FILE;
@@ -80,77 +81,180 @@ const uint8_t contract_cards_ap_cost[8] = {
    1, 2, 3, 4, 5, 6, 5, 4
 };
 
-static core_t core;
+static core_t core; /*!< Default instance (client) */
+/* Blocks (bit n = block n) on the rows/columns of a marker, by its 6 bits */
+static uint64_t core_marker_rows[64];
+static uint64_t core_marker_columns[64];
 
 /* GLOBAL CONSTANTS / VARIABLES **********************************************/
+bitboard_t core_startup_lots;
 
 /* GLOBAL FUNCTIONS **********************************************************/
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_init(core_net_send_fn_t* p_fn_send, core_net_broadcast_fn_t* p_fn_bc)
+void core_init(void)
 {
    int i;
-   memset(&core, 0, sizeof(core_t));
-   SLNK_INIT(&core.players_head);
    TRC_REG(core, TRC_ERROR | TRC_DEBUG);
-   core.net_send = p_fn_send;
-   core.net_broadcast = p_fn_bc;
-   core.current_round = 1;
+   bb_init();
+   bb_clear(&core_startup_lots);
+   for (i=0;i<MAX_STARTUP_BUILDINGS;i++)
+   {
+      BB_SET_BLOCK(&core_startup_lots, startup_buildings[i].block,
+         startup_buildings[i].mark);
+   }
+   for (i=0;i<64;i++)
+   {
+      int block;
+      core_marker_rows[i] = 0;
+      core_marker_columns[i] = 0;
+      for (block=0;block<MAX_BOARD_BLOCKS;block++)
+      {
+         if (i & (1u << (block/6)))
+         {
+            core_marker_rows[i] |= 1ull << block;
+         }
+         if (i & (1u << (block%6)))
+         {
+            core_marker_columns[i] |= 1ull << block;
+         }
+      }
+   }
    cards_init();
+   core_sync_init();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_ctor(core_t* p_core, core_net_send_fn_t* p_fn_send,
+   core_net_broadcast_fn_t* p_fn_bc)
+{
+   int i;
+   REQUIRE(p_core != NULL);
+   memset(p_core, 0, sizeof(core_t));
+   SLNK_INIT(&p_core->players_head);
+   p_core->net_send = p_fn_send;
+   p_core->net_broadcast = p_fn_bc;
+   core_seed(p_core, 0);
+   p_core->current_round = 1;
    for (i=0;i<PLAYER_COLOR_LAST;i++)
    {
-      core.available_colors |= 1u << i;
+      p_core->available_colors |= 1u << i;
    }
    for (i=0;i<MAX_BOARD_BLOCKS;i++)
    {
-      core.board_blocks[i].id = i;
+      p_core->board_blocks[i].id = i;
    }
-   core.prestige_markers[0].rows = BIT(2)|BIT(3); /* Prestige 1 on row 2 and 3 */
-   core.prestige_markers[1].rows = BIT(4)|BIT(5); /* Prestige 2 on row 4 and 5 */
-   core.prestige_markers[2].rows = BIT(0)|BIT(1); /* Prestige 3 on row 0 and 1 */
-   core.wealth_markers[0].columns = BIT(0); /* Wealth 1 on column 0 */
-   core.wealth_markers[1].columns = BIT(5); /* Wealth 2 on column 5 */
-   core.wealth_markers[2].columns = BIT(4); /* Wealth 3 on column 4 */
-   core.wealth_markers[3].columns = BIT(1); /* Wealth 4 on column 1 */
-   core.wealth_markers[4].columns = BIT(2); /* Wealth 5 on column 2 */
-   core.wealth_markers[5].columns = BIT(3); /* Wealth 6 on column 3 */
-   core.board_vocations = 0x7fffff;
-   core.startup_buildings = MAX_STARTUP_BUILDINGS;
-   cards_create_deck(&core.planning_deck_head, CARD_DECK_PLANNING);
-   cards_create_deck(&core.town_deck_head, CARD_DECK_TOWN);
+   core_set_marker(p_core, FALSE, 0, BIT(2)|BIT(3), 0); /* Prestige 1 on row 2 and 3 */
+   core_set_marker(p_core, FALSE, 1, BIT(4)|BIT(5), 0); /* Prestige 2 on row 4 and 5 */
+   core_set_marker(p_core, FALSE, 2, BIT(0)|BIT(1), 0); /* Prestige 3 on row 0 and 1 */
+   core_set_marker(p_core, TRUE, 0, 0, BIT(0)); /* Wealth 1 on column 0 */
+   core_set_marker(p_core, TRUE, 1, 0, BIT(5)); /* Wealth 2 on column 5 */
+   core_set_marker(p_core, TRUE, 2, 0, BIT(4)); /* Wealth 3 on column 4 */
+   core_set_marker(p_core, TRUE, 3, 0, BIT(1)); /* Wealth 4 on column 1 */
+   core_set_marker(p_core, TRUE, 4, 0, BIT(2)); /* Wealth 5 on column 2 */
+   core_set_marker(p_core, TRUE, 5, 0, BIT(3)); /* Wealth 6 on column 3 */
+   p_core->board_vocations = 0x7fffff;
+   p_core->startup_buildings = MAX_STARTUP_BUILDINGS;
+   cards_create_deck(&p_core->planning_deck, CARD_DECK_PLANNING);
+   cards_pile_init(&p_core->planning_discard, CARD_DECK_PLANNING);
+   cards_create_deck(&p_core->town_deck, CARD_DECK_TOWN);
+   cards_pile_init(&p_core->town_discard, CARD_DECK_TOWN);
+   cards_pile_init(&p_core->city_deck, CARD_DECK_CITY);
+   cards_pile_init(&p_core->city_discard, CARD_DECK_CITY);
+   cards_pile_init(&p_core->metropolis_deck, CARD_DECK_METROPOLIS);
+   cards_pile_init(&p_core->metropolis_discard, CARD_DECK_METROPOLIS);
    /* Test */
 #if 0
    /* Wealth 7 on columns 0 and 1 */
-   core.wealth_markers[6].columns = BIT(0)|BIT(1);
+   core_set_marker(p_core, TRUE, 6, 0, BIT(0)|BIT(1));
    /* Prestige 4 on row 0 */
-   core.prestige_markers[3].rows = BIT(0);
-   core.board_blocks[0].buildings[0].block_pos = 0x1;
-   core.board_blocks[0].buildings[0].size = 1;
-   core.board_blocks[0].buildings[0].zone = ZONE_CIV;
-   core.board_blocks[0].buildings[0].owner = PLAYER_COLOR_BLACK;
-   core.board_blocks[0].n_buildings = 1;
-   core.board_blocks[4].buildings[0].block_pos = 0x1;
-   core.board_blocks[4].buildings[0].size = 1;
-   core.board_blocks[4].buildings[0].zone = ZONE_COM;
-   core.board_blocks[4].buildings[0].owner = PLAYER_COLOR_GREEN;
-   core.board_blocks[4].n_buildings = 1;
-   core.board_blocks[18].buildings[0].block_pos = 0x1;
-   core.board_blocks[18].buildings[0].size = 1;
-   core.board_blocks[18].buildings[0].zone = ZONE_IND;
-   core.board_blocks[18].buildings[0].owner = PLAYER_COLOR_LAST;
-   core.board_blocks[18].n_buildings = 1;
-   core.board_blocks[34].buildings[0].block_pos = 0x1;
-   core.board_blocks[34].buildings[0].size = 1;
-   core.board_blocks[34].buildings[0].zone = ZONE_RES;
-   core.board_blocks[34].buildings[0].owner = PLAYER_COLOR_LAST;
-   core.board_blocks[34].n_buildings = 1;
+   core_set_marker(p_core, FALSE, 3, BIT(0), 0);
+   p_core->board_blocks[0].buildings[0].block_pos = 0x1;
+   p_core->board_blocks[0].buildings[0].size = 1;
+   p_core->board_blocks[0].buildings[0].zone = ZONE_CIV;
+   p_core->board_blocks[0].buildings[0].owner = PLAYER_COLOR_BLACK;
+   p_core->board_blocks[0].n_buildings = 1;
+   p_core->board_blocks[4].buildings[0].block_pos = 0x1;
+   p_core->board_blocks[4].buildings[0].size = 1;
+   p_core->board_blocks[4].buildings[0].zone = ZONE_COM;
+   p_core->board_blocks[4].buildings[0].owner = PLAYER_COLOR_GREEN;
+   p_core->board_blocks[4].n_buildings = 1;
+   p_core->board_blocks[18].buildings[0].block_pos = 0x1;
+   p_core->board_blocks[18].buildings[0].size = 1;
+   p_core->board_blocks[18].buildings[0].zone = ZONE_IND;
+   p_core->board_blocks[18].buildings[0].owner = PLAYER_COLOR_LAST;
+   p_core->board_blocks[18].n_buildings = 1;
+   p_core->board_blocks[34].buildings[0].block_pos = 0x1;
+   p_core->board_blocks[34].buildings[0].size = 1;
+   p_core->board_blocks[34].buildings[0].zone = ZONE_RES;
+   p_core->board_blocks[34].buildings[0].owner = PLAYER_COLOR_LAST;
+   p_core->board_blocks[34].n_buildings = 1;
 #endif
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_free(void)
+void core_free(core_t* p_core)
+{
+   player_t* p_player;
+
+   while ((p_player = SLNK_NEXT(player_t, &p_core->players_head)) != NULL)
+   { /* The cards are in the shared catalog, nothing to free */
+      core_rm_player(p_core, p_player);
+   }
+   memset(p_core->board_planning_cards, 0,
+      sizeof(p_core->board_planning_cards));
+   memset(p_core->board_contract_cards, 0,
+      sizeof(p_core->board_contract_cards));
+   p_core->planning_deck.n = 0;
+   p_core->planning_discard.n = 0;
+   p_core->town_deck.n = 0;
+   p_core->town_discard.n = 0;
+   p_core->city_deck.n = 0;
+   p_core->city_discard.n = 0;
+   p_core->metropolis_deck.n = 0;
+   p_core->metropolis_discard.n = 0;
+   p_core->hash = 0;
+}
+
+/*-----------------------------------------------------------------------------
+The cards are shared, only the players are copied. The active player is
+mapped by position in the player list.
+-----------------------------------------------------------------------------*/
+void core_copy(core_t* p_dst, const core_t* p_src)
+{
+   player_t* p_player = SLNK_NEXT(player_t, &p_src->players_head);
+   slnk_t* p_last = &p_dst->players_head;
+
+   REQUIRE((p_dst != NULL) && (p_src != NULL) && (p_dst != p_src));
+   memcpy(p_dst, p_src, sizeof(core_t));
+   p_dst->net_send = NULL;
+   p_dst->net_broadcast = NULL;
+   p_dst->log_entry.p_player = NULL;
+   p_dst->active_player = NULL;
+   SLNK_INIT(&p_dst->players_head);
+   while (p_player != NULL)
+   {
+      player_t* p_copy = (player_t*)malloc(sizeof(player_t));
+      REQUIRE(p_copy != NULL);
+      memcpy(p_copy, p_player, sizeof(player_t));
+      SLNK_INSERT(p_last, p_copy);
+      p_last = &p_copy->slnk;
+      if (p_src->active_player == p_player)
+      {
+         p_dst->active_player = p_copy;
+      }
+      p_player = SLNK_NEXT(player_t, p_player);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_seed(core_t* p_core, uint64_t seed)
 {
+   p_core->seed = seed;
+   core_rng_seed(&p_core->rng, seed);
 }
 
 /*-----------------------------------------------------------------------------
@@ -162,47 +266,44 @@ core_t* core_get(void)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-bool_t core_newgame(bool_t load)
+bool_t core_newgame(core_t* p_core, bool_t load)
 {
    bool_t ret = FALSE;
    int i;
 
    if (load)
    {
-      core.state = CORE_STATE_SETUP;
-      srand((unsigned)time( NULL ));
-      //cards_shuffle_deck(&core.cards_head);
-      //if (core_loadgame("save.dat"))
+      p_core->state = CORE_STATE_SETUP;
+      //if (core_loadgame(p_core, "save.dat"))
       {
          /* Start player left most on initiative track */
-         //core.initiative = 0;
-         //core.current_action = CORE_AD_INITIATIVE_AP;
-         //core.active_player = core_find_player_by_animal(core.ad.initiative[0]);
+         //p_core->initiative = 0;
+         //p_core->current_action = CORE_AD_INITIATIVE_AP;
+         //p_core->active_player = core_find_player_by_animal(p_core, p_core->ad.initiative[0]);
          ret = TRUE;
       }
    }
    else
    {
-      core.state = CORE_STATE_SETUP;
-      core_net_broadcast(NET_CMD_SERVER_PHASE_UPDATE, NULL);
-      srand((unsigned)time( NULL ));
-      //cards_create_deck(&core.cards_head);
-      //cards_shuffle_deck(&core.cards_head);
-      core_prepare_players();
+      p_core->state = CORE_STATE_SETUP;
+      core_dirty(p_core, CORE_DIRTY_PHASE);
+      cards_shuffle_deck(&p_core->planning_deck, &p_core->rng);
+      cards_shuffle_deck(&p_core->town_deck, &p_core->rng);
+      core_prepare_players(p_core);
       for (i=0;i<5;i++)
       {
-         core.board_planning_cards[i] = cards_draw(&core.planning_deck_head,
-                                                   -1);
+         core_board_card_set(p_core, i,
+            cards_pile_draw(&p_core->planning_deck));
       }
       for (i=0;i<6;i++)
       {
-         core.board_contract_cards[i] = cards_draw(&core.town_deck_head,
-                                                   -1);
+         core_board_card_set(p_core, 5 + i,
+            cards_pile_draw(&p_core->town_deck));
       }
-      core_net_broadcast(NET_CMD_SERVER_BOARD_CARDS_UPDATE, NULL);
+      core_dirty(p_core, CORE_DIRTY_BOARD_CARDS);
       /* Start player left most on initiative track */
-      //core.current_action = CORE_AD_INITIATIVE_AP;
-      //core.active_player = core_find_player_by_animal(core.ad.initiative[0]);
+      //p_core->current_action = CORE_AD_INITIATIVE_AP;
+      //p_core->active_player = core_find_player_by_animal(p_core, p_core->ad.initiative[0]);
       ret = TRUE;
    }
    return ret;
@@ -210,184 +311,191 @@ bool_t core_newgame(bool_t load)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_select_color(void)
+void core_select_color(core_t* p_core)
 {
-   player_t* p_player = core.active_player;
+   player_t* p_player = p_core->active_player;
    int color = 0;
-   REQUIRE(core.color_selection <= 6);
-   srand((unsigned)time( NULL ));
-   if (core.color_selection == 6)
-   {
+   REQUIRE(p_core->color_selection <= 6);
+   if (p_core->color_selection == 6)
+   { /* Random one of the available colors */
       int i;
-      int r = rand()%6;
+      int r = core_rng_below(&p_core->rng,
+         __builtin_popcount(p_core->available_colors));
       TRC_DBG(core, "Random number %d", r);
       for (i=0;i<PLAYER_COLOR_LAST;i++)
       {
-         if ((core.available_colors & (1u << i)) && (r == 0))
-         {
-            color = i;
-            break;
-         }
-         if (r > 0)
+         if (p_core->available_colors & (1u << i))
          {
+            if (r == 0)
+            {
+               color = i;
+               break;
+            }
             r--;
          }
       }
-      TRC_DBG(core, "Random color %d", i);
+      TRC_DBG(core, "Random color %d", color);
    }
    else
    {
-      color = core.color_selection;
+      color = p_core->color_selection;
    }
    p_player->color = color;
-   core.available_colors &= ~(1u << color);
-   TRC_DBG(core, "Available colors 0x%x", core.available_colors);
-   core_net_broadcast(NET_CMD_SERVER_PLAYER_UPDATE, core.active_player);
-   //core_log(p_player, "selected %s", animal_str[animal]);
+   p_core->available_colors &= ~(1u << color);
+   TRC_DBG(core, "Available colors 0x%x", p_core->available_colors);
+   core_dirty_player(p_core, p_player, PLAYER_DIRTY_COLOR);
+   //core_log(p_core, p_player, "selected %s", animal_str[animal]);
 }
 
 #if 0
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-core_state_t core_next_action(void)
+core_state_t core_next_action(core_t* p_core)
 {
    core_state_t next_state = CORE_STATE_ACTIONS;
    {
       /* Auto save game */
-      core_savegame("save.dat");
+      core_savegame(p_core, "save.dat");
    }
-   if (core.current_action == CORE_AD_AP_LAST)
+   if (p_core->current_action == CORE_AD_AP_LAST)
    {
-      if ((core_find_player_by_animal(ANIMAL_MAMAL) != NULL) &&
-          (core.state != CORE_STATE_EXTINCTION))
+      if ((core_find_player_by_animal(p_core, ANIMAL_MAMAL) != NULL) &&
+          (p_core->state != CORE_STATE_EXTINCTION))
       {
-         core.active_player = core_find_player_by_animal(ANIMAL_MAMAL);
+         p_core->active_player = core_find_player_by_animal(p_core, ANIMAL_MAMAL);
          next_state = CORE_STATE_EXTINCTION;
-         core.state = next_state;
+         p_core->state = next_state;
       }
-      else if (core.last_round)
+      else if (p_core->last_round)
       {
          next_state = CORE_STATE_GAME_END;
-         core.state = next_state;
+         p_core->state = next_state;
       }
       else
       {
          next_state = CORE_STATE_RESET;
-         core.state = next_state;
+         p_core->state = next_state;
       }
    }
-   core_net_broadcast(NET_CMD_SERVER_PHASE_UPDATE, NULL);
+   core_net_broadcast(p_core, NET_CMD_SERVER_PHASE_UPDATE, NULL);
    return next_state;
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_action_done(void)
+void core_action_done(core_t* p_core)
 {
-   uint8_t animal = core.ad.apbox[core.current_action];
-   player_t* p_player = core_find_player_by_animal(animal);
+   uint8_t animal = p_core->ad.apbox[p_core->current_action];
+   player_t* p_player = core_find_player_by_animal(p_core, animal);
    /* Remove action pawn from action display and give back to player */
-   if ((core.current_action != CORE_AD_REGRESSION_AP_REPTILE) &&
-       (core.current_action != CORE_AD_SPECIATION_AP_INSECT) &&
-       (core.current_action != CORE_AD_COMPETITION_AP_ARACHNID))
+   if ((p_core->current_action != CORE_AD_REGRESSION_AP_REPTILE) &&
+       (p_core->current_action != CORE_AD_SPECIATION_AP_INSECT) &&
+       (p_core->current_action != CORE_AD_COMPETITION_AP_ARACHNID))
    {
-      if (core.ad.apbox[core.current_action] != ANIMAL_LAST)
+      if (p_core->ad.apbox[p_core->current_action] != ANIMAL_LAST)
       {
          p_player->used_ap--;
-         core.ad.apbox[core.current_action] = ANIMAL_LAST;
+         p_core->ad.apbox[p_core->current_action] = ANIMAL_LAST;
       }
    }
    /* Handle regression and wasteland mandatory parts */
-   if (core.current_action == CORE_AD_REGRESSION_AP_REPTILE)
+   if (p_core->current_action == CORE_AD_REGRESSION_AP_REPTILE)
    {
-      core_action_regression_mandatory();
+      core_action_regression_mandatory(p_core);
    }
-   else if (core.current_action == CORE_AD_WASTELAND_AP)
+   else if (p_core->current_action == CORE_AD_WASTELAND_AP)
    {
-      core_action_wasteland_mandatory();
+      core_action_wasteland_mandatory(p_core);
    }
-   core_update_earth_dominance();
-   core.current_action++;
-   core.element_box_selection = CORE_AD_ELEMENT_LAST;
-   core.board_tile_selection = MAX_BOARD_TILES;
-   core.board_element_selection = MAX_BOARD_ELEMENTS;
-   core.wanderlust_tile_selection = 3;
-   core.speciation_element = ELEMENT_NONE;
-   core.speciation_tiles[0] = MAX_BOARD_TILES;
-   core.speciation_tiles[1] = MAX_BOARD_TILES;
-   core.speciation_tiles[2] = MAX_BOARD_TILES;
-   core.speciation_species[0] = 0;
-   core.speciation_species[1] = 0;
-   core.speciation_species[2] = 0;
-   core.competition_terrain[0] = TERRAIN_NONE;
-   core.competition_terrain[1] = TERRAIN_NONE;
-   core.competition_terrain[2] = TERRAIN_NONE;
-   core.migration_points = 1;
-   core.migration_tile = MAX_BOARD_TILES;
-   core_net_broadcast(NET_CMD_SERVER_PLAYER_UPDATE, core.active_player);
-   core_net_broadcast(NET_CMD_SERVER_ACTION_DISPLAY_UPDATE, NULL);
+   core_update_earth_dominance(p_core);
+   p_core->current_action++;
+   p_core->element_box_selection = CORE_AD_ELEMENT_LAST;
+   p_core->board_tile_selection = MAX_BOARD_TILES;
+   p_core->board_element_selection = MAX_BOARD_ELEMENTS;
+   p_core->wanderlust_tile_selection = 3;
+   p_core->speciation_element = ELEMENT_NONE;
+   p_core->speciation_tiles[0] = MAX_BOARD_TILES;
+   p_core->speciation_tiles[1] = MAX_BOARD_TILES;
+   p_core->speciation_tiles[2] = MAX_BOARD_TILES;
+   p_core->speciation_species[0] = 0;
+   p_core->speciation_species[1] = 0;
+   p_core->speciation_species[2] = 0;
+   p_core->competition_terrain[0] = TERRAIN_NONE;
+   p_core->competition_terrain[1] = TERRAIN_NONE;
+   p_core->competition_terrain[2] = TERRAIN_NONE;
+   p_core->migration_points = 1;
+   p_core->migration_tile = MAX_BOARD_TILES;
+   core_net_broadcast(p_core, NET_CMD_SERVER_PLAYER_UPDATE,
+      p_core->active_player);
+   core_net_broadcast(p_core, NET_CMD_SERVER_ACTION_DISPLAY_UPDATE, NULL);
 }
 #endif
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_invest(void)
+void core_invest(core_t* p_core)
 {
-   player_t* p_player = core.active_player;
-   card_planning_t* p_card = (card_planning_t*)cards_draw(
-      &core.active_player->cards_head, core.card_selection);
+   player_t* p_player = p_core->active_player;
+   int pos = cards_hand_find(&p_player->cards, CARD_DECK_PLANNING,
+      p_core->card_selection);
+   const card_planning_t* p_card;
 
-   REQUIRE(p_card != NULL);
+   REQUIRE(pos >= 0);
+   p_card = (const card_planning_t*)cards_hand_remove(&p_player->cards,
+      pos);
+   p_core->hash ^= core_hash_card(CORE_HASH_HAND, p_player->id,
+      &p_card->card);
    /* Discard selected planning card for wealth */
    p_player->wealth += p_card->payout;
-   SLNK_ADD(&core.planning_discard_head, p_card);
-   core_net_broadcast(NET_CMD_SERVER_PLAYER_UPDATE, core.active_player);
-   core_log(p_player, "recieved %d wealth", p_card->payout);
+   cards_pile_put(&p_core->planning_discard, &p_card->card);
+   core_dirty_player(p_core, p_player,
+      PLAYER_DIRTY_WEALTH | PLAYER_DIRTY_CARDS);
+   core_log(p_core, p_player, "recieved %d wealth", p_card->payout);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_action_take_card(void)
+void core_action_take_card(core_t* p_core)
 {
-   player_t* p_player = core.active_player;
-   card_t* p_card = NULL;
+   player_t* p_player = p_core->active_player;
+   const card_t* p_card = NULL;
    int ap = 0;
    int i;
    /* Add selected card to player card list (if planning card) or favor
       (if contract card). */
-   REQUIRE(core.card_selection < 13);
-   if (core.card_selection < 5)
+   REQUIRE(p_core->card_selection < 13);
+   if (p_core->card_selection < 5)
    {
-      p_card = core.board_planning_cards[core.card_selection];
-      core.board_planning_cards[core.card_selection] = NULL;
-      ap = core.card_selection + 1;
+      p_card = p_core->board_planning_cards[p_core->card_selection];
+      ap = p_core->card_selection + 1;
    }
    else
    {
-      p_card = core.board_contract_cards[core.card_selection - 5];
-      core.board_contract_cards[core.card_selection - 5] = NULL;
-      ap = contract_cards_ap_cost[core.card_selection - 5];
+      p_card = p_core->board_contract_cards[p_core->card_selection - 5];
+      ap = contract_cards_ap_cost[p_core->card_selection - 5];
    }
    REQUIRE(p_card != NULL);
-   SLNK_ADD(&p_player->cards_head, p_card);
+   core_board_card_set(p_core, p_core->card_selection, NULL);
+   cards_hand_add(&p_player->cards, p_card);
+   p_core->hash ^= core_hash_card(CORE_HASH_HAND, p_player->id, p_card);
    p_player->ap -= ap;
-   core_net_broadcast(NET_CMD_SERVER_BOARD_CARDS_UPDATE, NULL);
-   core_net_broadcast(NET_CMD_SERVER_PLAYER_UPDATE, core.active_player);
-   core_log(p_player, "took card %d for %d ap(s)", p_card->id, ap);
+   core_dirty(p_core, CORE_DIRTY_BOARD_CARDS);
+   core_dirty_player(p_core, p_player, PLAYER_DIRTY_AP | PLAYER_DIRTY_CARDS);
+   core_log(p_core, p_player, "took card %d for %d ap(s)", p_card->id, ap);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_action_build(void)
+void core_action_build(core_t* p_core)
 { /* Build contract card using selected planning cards on selected lot(s) */
-   player_t* p_player = core.active_player;
+   player_t* p_player = p_core->active_player;
    zone_t zone;
    int size;
-   int lot = core.board_lot_selection;
+   int lot = p_core->board_lot_selection;
    int cost = 0;
-   block_t* p_blk = &core.board_blocks[lot/4];
+   block_t* p_blk = &p_core->board_blocks[lot/4];
    int i;
-   if (core.state == CORE_STATE_SETUP)
+   if (p_core->state == CORE_STATE_SETUP)
    { /* Only lot selected in this state. Set size and type here. */
       int block = lot/4;
       size = 1;
@@ -409,66 +517,67 @@ void core_action_build(void)
       p_blk->buildings[p_blk->n_buildings].block_pos = 1u << (lot%4);
    }
    p_blk->n_buildings++;
-   core_net_broadcast(NET_CMD_SERVER_BLOCK_UPDATE, p_blk);
-   cost = core_calc_block_value(lot/4);
+   core_board_block_update(p_core, lot/4);
+   core_dirty_block(p_core, p_blk, BLOCK_DIRTY_BUILDINGS);
+   cost = p_blk->value;
    TRC_DBG(core, "building cost=%d", cost);
    p_player->wealth -= cost;
-   core_net_broadcast(NET_CMD_SERVER_PLAYER_UPDATE, p_player);
-   core_log(p_player, "payed %d wealth for building", cost);
-   //core_log(p_player, "built %s", p_card->name);
+   core_dirty_player(p_core, p_player, PLAYER_DIRTY_WEALTH);
+   core_log(p_core, p_player, "payed %d wealth for building", cost);
+   //core_log(p_core, p_player, "built %s", p_card->name);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_prepare_new_round(void)
+void core_prepare_new_round(core_t* p_core)
 {
-   //core.current_round++;
+   //p_core->current_round++;
    /* Next player */
-   core.active_player = SLNK_NEXT(player_t, core.active_player);
-   if (core.active_player == NULL)
+   p_core->active_player = SLNK_NEXT(player_t, p_core->active_player);
+   if (p_core->active_player == NULL)
    {
-      core.active_player = SLNK_NEXT(player_t, &core.players_head);
+      p_core->active_player = SLNK_NEXT(player_t, &p_core->players_head);
    }
-   core.active_player = SLNK_NEXT(player_t, &core.players_head);
-   core.state = CORE_STATE_INVESTMENTS;
-   core_net_broadcast(NET_CMD_SERVER_PHASE_UPDATE, NULL);
+   p_core->active_player = SLNK_NEXT(player_t, &p_core->players_head);
+   p_core->state = CORE_STATE_INVESTMENTS;
+   core_dirty(p_core, CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER);
    /* Auto save game */
-   //core_savegame("save.dat");
+   //core_savegame(p_core, "save.dat");
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_use_card(void)
+void core_use_card(core_t* p_core)
 {
-   player_t* p_player = core.active_player;
-   //card_t* p_card = cards_draw(&p_player->cards_head, core.card_selection);
+   player_t* p_player = p_core->active_player;
+   //card_t* p_card = cards_draw(&p_player->cards_head, p_core->card_selection);
    //REQUIRE(p_card != NULL);
    //cards_use(p_card);
-   //SLNK_ADD(&core.cards_discard_head, p_card);
-   core_net_broadcast(NET_CMD_SERVER_PLAYER_UPDATE, p_player);
-   core.card_selection = 0;
+   //SLNK_ADD(&p_core->cards_discard_head, p_card);
+   core_dirty_player(p_core, p_player, PLAYER_DIRTY_CARDS);
+   p_core->card_selection = 0;
 }
 
 #if 0
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_calculate_final_vp(void)
+void core_calculate_final_vp(core_t* p_core)
 { /* Score all tiles one final time and determine winner */
    player_t* winner = 0;
    int most_vp = 0;
    int i;
    for (i=0;i<MAX_BOARD_TILES;i++)
    {
-      tile_t* p_tile = &core.board_tiles[i];
+      tile_t* p_tile = &p_core->board_tiles[i];
       if (p_tile->terrain > TERRAIN_NONE)
       {
-         core_domination_vp(p_tile);
+         core_domination_vp(p_core, p_tile);
       }
    }
    /* Find winner */
    for (i=ANIMAL_INSECT;i>=0;i--)
    {
-      player_t* p_player = core_find_player_by_animal(i);
+      player_t* p_player = core_find_player_by_animal(p_core, i);
       if (p_player)
       {
          if (p_player->vp >= most_vp)
@@ -478,7 +587,7 @@ void core_calculate_final_vp(void)
          }
       }
    }
-   core_log(winner, "is the winner with %d vp", winner->vp);
+   core_log(p_core, winner, "is the winner with %d vp", winner->vp);
 }
 #endif
 
@@ -491,7 +600,7 @@ lot_t* core_find_lot(int x, int y)
    int i;
    for (i=0;i<MAX_BOARD_BLOCKS;i++)
    {
-      p_tile = &core.board_blocks[i];
+      p_tile = &p_core->board_blocks[i];
    }
    return p_tile;
 }
@@ -500,7 +609,7 @@ lot_t* core_find_lot(int x, int y)
 #if 0
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-bool_t core_savegame(char* name)
+bool_t core_savegame(core_t* p_core, char* name)
 { /* Only at end of round at the moment */
    bool_t res = FALSE;
    FILE* fp;
@@ -519,7 +628,7 @@ bool_t core_savegame(char* name)
    /* Save player data */
    for (i=0;i<ANIMAL_LAST;i++)
    {
-      player_t* p_player = core_find_player_by_animal(i);
+      player_t* p_player = core_find_player_by_animal(p_core, i);
       if (p_player)
       {
          len = pbuf_pack(buf, "sdbbbbwsd", MAX_NAME_LENGTH, p_player->name,
@@ -537,7 +646,7 @@ bool_t core_savegame(char* name)
    /* Save board tiles */
    for (i=0;i<MAX_BOARD_TILES;i++)
    {
-      tile_t* p_tile = &core.board_tiles[i];
+      tile_t* p_tile = &p_core->board_tiles[i];
       len = pbuf_pack(buf, "bbsdb", p_tile->terrain, p_tile->tundra,
          6, p_tile->species, p_tile->dominance);
       fwrite(buf, 1, len, fp);
@@ -546,21 +655,21 @@ bool_t core_savegame(char* name)
    len = 0;
    for (i=0;i<MAX_BOARD_ELEMENTS;i++)
    {
-      element_t* p_element = &core.board_elements[i];
+      element_t* p_element = &p_core->board_elements[i];
       len += pbuf_pack(&buf[len], "b", p_element->element);
    }
    TRC_DBG(core, "board element total save size = %d", len);
    fwrite(buf, 1, len, fp);
    /* Save action display */
-   len = pbuf_pack(buf, "sdsdsd", 6, core.ad.initiative, CORE_AD_AP_LAST,
-      core.ad.apbox, CORE_AD_ELEMENT_LAST, core.ad.element);
+   len = pbuf_pack(buf, "sdsdsd", 6, p_core->ad.initiative, CORE_AD_AP_LAST,
+      p_core->ad.apbox, CORE_AD_ELEMENT_LAST, p_core->ad.element);
    TRC_DBG(core, "action display total save size = %d", len);
    fwrite(buf, 1, len, fp);
    /* Save board cards */
    len = 0;
    for (i=0;i<5;i++)
    {
-      card_t* p_card = core.board_cards[i];
+      card_t* p_card = p_core->board_cards[i];
       if (p_card)
       {
          len += pbuf_pack(&buf[len], "b", (uint8_t)p_card->id);
@@ -576,7 +685,7 @@ bool_t core_savegame(char* name)
    /* Save used cards */
    memset(buf, 0, 512);
    {
-      card_t* p_card = SLNK_NEXT(card_t, &core.cards_discard_head);
+      card_t* p_card = SLNK_NEXT(card_t, &p_core->cards_discard_head);
       while(p_card != NULL)
       {
          buf[p_card->id/8] |= (1u << (p_card->id%8));
@@ -587,19 +696,19 @@ bool_t core_savegame(char* name)
       fwrite(buf, 1, 4, fp);
    }
    /* Save element bag */
-   len = pbuf_pack(buf, "sd", 6, core.element_bag);
+   len = pbuf_pack(buf, "sd", 6, p_core->element_bag);
    fwrite(buf, 1, len, fp);
    /* Save wanderlust tiles state */
-   len = pbuf_pack(buf, "sdsdsd", 3, core.wanderlust_tiles, 3,
-      core.wanderlust_tiles_left, 7, core.wanderlust_tile_bag);
+   len = pbuf_pack(buf, "sdsdsd", 3, p_core->wanderlust_tiles, 3,
+      p_core->wanderlust_tiles_left, 7, p_core->wanderlust_tile_bag);
    TRC_DBG(core, "wanderlust tiles total save size = %d", len);
    fwrite(buf, 1, len, fp);
    /* Save current round, state and action*/
-   len = pbuf_pack(buf, "bbb", core.current_round, core.state,
-      core.current_action);
+   len = pbuf_pack(buf, "bbb", p_core->current_round, p_core->state,
+      p_core->current_action);
    fwrite(buf, 1, len, fp);
    fclose(fp);
-   core_log(NULL, "Game saved!");
+   core_log(p_core, NULL, "Game saved!");
    res = TRUE;
 done:
    return res;
@@ -607,7 +716,7 @@ done:
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-bool_t core_loadgame(char* name)
+bool_t core_loadgame(core_t* p_core, char* name)
 {
    bool_t res = FALSE;
    FILE* fp;
@@ -641,7 +750,7 @@ bool_t core_loadgame(char* name)
       if (player.name[0] != 0)
       {
          player_t* p_player;
-         p_player = core_find_player_by_name(player.name);
+         p_player = core_find_player_by_name(p_core, player.name);
          if (p_player)
          {
             TRC_DBG(core, "loadgame: Found matching player name %s",
@@ -653,7 +762,7 @@ bool_t core_loadgame(char* name)
             p_player->gene_pool_max = player.gene_pool_max;
             p_player->vp = player.vp;
             memcpy(p_player->elements, player.elements, 6);
-            core_net_broadcast(NET_CMD_SERVER_PLAYER_UPDATE, p_player);
+            core_net_broadcast(p_core, NET_CMD_SERVER_PLAYER_UPDATE, p_player);
          }
          else
          {
@@ -667,24 +776,24 @@ bool_t core_loadgame(char* name)
    /* Load board tiles */
    for (i=0;i<MAX_BOARD_TILES;i++)
    {
-      tile_t* p_tile = &core.board_tiles[i];
+      tile_t* p_tile = &p_core->board_tiles[i];
       pos += pbuf_unpack(&buf[pos], "bbsdb", &p_tile->terrain, &p_tile->tundra,
          6, p_tile->species, &p_tile->dominance);
-      core_net_broadcast(NET_CMD_SERVER_TILE_UPDATE, p_tile);
+      core_net_broadcast(p_core, NET_CMD_SERVER_TILE_UPDATE, p_tile);
    }
    REQUIRE(pos <= len);
    /* Load board elements */
    for (i=0;i<MAX_BOARD_ELEMENTS;i++)
    {
-      element_t* p_element = &core.board_elements[i];
+      element_t* p_element = &p_core->board_elements[i];
       pos += pbuf_unpack(&buf[pos], "b", &p_element->element);
-      core_net_broadcast(NET_CMD_SERVER_ELEMENT_UPDATE, p_element);
+      core_net_broadcast(p_core, NET_CMD_SERVER_ELEMENT_UPDATE, p_element);
    }
    REQUIRE(pos <= len);
    /* Load action display */
-   pos += pbuf_unpack(&buf[pos], "sdsdsd", 6, core.ad.initiative,
-      CORE_AD_AP_LAST, core.ad.apbox, CORE_AD_ELEMENT_LAST, core.ad.element);
-   core_net_broadcast(NET_CMD_SERVER_ACTION_DISPLAY_UPDATE, NULL);
+   pos += pbuf_unpack(&buf[pos], "sdsdsd", 6, p_core->ad.initiative,
+      CORE_AD_AP_LAST, p_core->ad.apbox, CORE_AD_ELEMENT_LAST, p_core->ad.element);
+   core_net_broadcast(p_core, NET_CMD_SERVER_ACTION_DISPLAY_UPDATE, NULL);
    /* Load board cards */
    for (i=0;i<5;i++)
    {
@@ -692,14 +801,14 @@ bool_t core_loadgame(char* name)
       pos += pbuf_unpack(&buf[pos], "b", &id);
       if (id > 0)
       {
-         core.board_cards[i] = cards_draw(&core.cards_head, id);
+         p_core->board_cards[i] = cards_draw(&p_core->cards_head, id);
       }
       else
       {
-         core.board_cards[i] = NULL;
+         p_core->board_cards[i] = NULL;
       }
    }
-   core_net_broadcast(NET_CMD_SERVER_BOARD_CARDS_UPDATE, NULL);
+   core_net_broadcast(p_core, NET_CMD_SERVER_BOARD_CARDS_UPDATE, NULL);
    REQUIRE(pos <= len);
    /* Load used cards */
    {
@@ -711,26 +820,26 @@ bool_t core_loadgame(char* name)
          int bit = i%8;
          if (used_cards[offs] & (1u << bit))
          { /* Remove card from draw deck and put in discard pile */
-            card_t* p_card = cards_draw(&core.cards_head, i);
+            card_t* p_card = cards_draw(&p_core->cards_head, i);
             REQUIRE(p_card != NULL);
-            SLNK_ADD(&core.cards_discard_head, p_card);
+            SLNK_ADD(&p_core->cards_discard_head, p_card);
             TRC_DBG(core, "loadgame: Card %d moved to discard pile", i);
          }
       }
    }
    REQUIRE(pos <= len);
    /* Load element bag */
-   pos += pbuf_unpack(&buf[pos], "sd", 6, core.element_bag);
+   pos += pbuf_unpack(&buf[pos], "sd", 6, p_core->element_bag);
    REQUIRE(pos <= len);
    /* Load wanderlust tiles state */
-   pos += pbuf_unpack(&buf[pos], "sdsdsd", 3, core.wanderlust_tiles, 3,
-      core.wanderlust_tiles_left, 7, core.wanderlust_tile_bag);
-   core_net_broadcast(NET_CMD_SERVER_WANDERLUST_UPDATE, NULL);
+   pos += pbuf_unpack(&buf[pos], "sdsdsd", 3, p_core->wanderlust_tiles, 3,
+      p_core->wanderlust_tiles_left, 7, p_core->wanderlust_tile_bag);
+   core_net_broadcast(p_core, NET_CMD_SERVER_WANDERLUST_UPDATE, NULL);
    REQUIRE(pos <= len);
    /* Load current round, state and action*/
-   pos += pbuf_unpack(&buf[pos], "bbb", &core.current_round, &core.state,
-      &core.current_action);
-   core_log(NULL, "Game loaded!");
+   pos += pbuf_unpack(&buf[pos], "bbb", &p_core->current_round, &p_core->state,
+      &p_core->current_action);
+   core_log(p_core, NULL, "Game loaded!");
    res = TRUE;
 done:
    if (buf)
@@ -743,29 +852,38 @@ done:
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_add_player(player_t* p_player)
+void core_add_player(core_t* p_core, player_t* p_player)
 {
    p_player->color = PLAYER_COLOR_LAST; /* No color selected yet */
    p_player->ap = 6;
-   //TRC_DBG(core, "Player %d got color %d", core.n_players, p_player->color);
-   core.n_players++;
-   SLNK_ADD(&core.players_head, p_player);
+   //TRC_DBG(core, "Player %d got color %d", p_core->n_players, p_player->color);
+   p_core->n_players++;
+   SLNK_ADD(&p_core->players_head, p_player);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_rm_player(player_t* p_player)
+void core_rm_player(core_t* p_core, player_t* p_player)
 {
-   SLNK_REMOVE(&core.players_head, p_player);
-   core.n_players--;
+   if (p_core->active_player == p_player)
+   { /* The next player is active, none if it was the last one */
+      core_next_player(p_core);
+      if (p_core->active_player == p_player)
+      {
+         p_core->active_player = NULL;
+      }
+      core_dirty(p_core, CORE_DIRTY_ACTIVE_PLAYER);
+   }
+   SLNK_REMOVE(&p_core->players_head, p_player);
+   p_core->n_players--;
    free(p_player);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-player_t* core_find_player(int id)
+player_t* core_find_player(core_t* p_core, int id)
 {
-   player_t* p_player = SLNK_NEXT(player_t, &core.players_head);
+   player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
    while(p_player != NULL)
    {
       if (p_player->id == id)
@@ -779,9 +897,9 @@ player_t* core_find_player(int id)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-player_t* core_find_player_by_name(char* name)
+player_t* core_find_player_by_name(core_t* p_core, char* name)
 {
-   player_t* p_player = SLNK_NEXT(player_t, &core.players_head);
+   player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
    while(p_player != NULL)
    {
       if (strncmp(p_player->name, name, MAX_NAME_LENGTH) == 0)
@@ -795,9 +913,9 @@ player_t* core_find_player_by_name(char* name)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-player_t* core_find_player_by_color(int color)
+player_t* core_find_player_by_color(core_t* p_core, int color)
 {
-   player_t* p_player = SLNK_NEXT(player_t, &core.players_head);
+   player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
    while(p_player != NULL)
    {
       if (p_player->color == color)
@@ -811,34 +929,29 @@ player_t* core_find_player_by_color(int color)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_board_lots_mark(void)
+void core_board_lots_mark(core_t* p_core)
 {
-   int i;
-   switch (core.state)
+   switch (p_core->state)
    {
    case CORE_STATE_SETUP:
    { /* Mark free startup buildings. */
-      for (i=0;i<MAX_STARTUP_BUILDINGS;i++)
-      {
-         block_t* p_blk = &core.board_blocks[startup_buildings[i].block];
-         if (p_blk->n_buildings == 0)
-         {
-            p_blk->lots_marked = startup_buildings[i].mark;
-         }
-      }
+      bitboard_t lots;
+      bb_blocks(&lots, &p_core->lots_built);
+      bb_andnot(&lots, &core_startup_lots, &lots);
+      bb_or(&p_core->lots_marked, &p_core->lots_marked, &lots);
       break;
    }
 #if 0
    case CORE_STATE_ACTION_SPECIATION:
    { /* Mark valid tiles around selected element. */
-      if (core.active_player->gene_pool > 0)
+      if (p_core->active_player->gene_pool > 0)
       {
          for (i=0;i<3;i++)
          {
-            if ((core.speciation_tiles[i] < MAX_BOARD_TILES) &&
-                (core.speciation_species[i] > 0))
+            if ((p_core->speciation_tiles[i] < MAX_BOARD_TILES) &&
+                (p_core->speciation_species[i] > 0))
             {
-               tile_t* p_tile = &core.board_tiles[core.speciation_tiles[i]];
+               tile_t* p_tile = &p_core->board_tiles[p_core->speciation_tiles[i]];
                p_tile->marked = TRUE;
             }
          }
@@ -849,36 +962,152 @@ void core_board_lots_mark(void)
    default:
       break;
    }
+   core_board_lots_view(p_core);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_board_lots_clear(void)
+void core_board_lots_clear(core_t* p_core)
 {
+   bb_clear(&p_core->lots_marked);
+   core_board_lots_view(p_core);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_board_block_update(core_t* p_core, int block)
+{
+   block_t* p_blk;
    int i;
-   for (i=0;i<MAX_BOARD_BLOCKS;i++)
+   REQUIRE((block >= 0) && (block < MAX_BOARD_BLOCKS));
+   p_blk = &p_core->board_blocks[block];
+   p_core->hash ^= core_hash_block(p_core, block);
+   for (i=0;i<ZONE_LAST;i++)
+   {
+      BB_CLR_BLOCK(&p_core->lots_zone[i], block);
+   }
+   for (i=0;i<=PLAYER_COLOR_LAST;i++)
    {
-      core.board_blocks[i].lots_marked = 0;
+      BB_CLR_BLOCK(&p_core->lots_owner[i], block);
+   }
+   BB_CLR_BLOCK(&p_core->lots_built, block);
+   for (i=0;(i<p_blk->n_buildings) && (i<4);i++)
+   {
+      building_t* p_bld = &p_blk->buildings[i];
+      if ((p_bld->zone >= ZONE_LAST) || (p_bld->owner > PLAYER_COLOR_LAST))
+      { /* Garbage from the net, keep it out of the bitboards */
+         continue;
+      }
+      BB_SET_BLOCK(&p_core->lots_zone[p_bld->zone], block, p_bld->block_pos);
+      BB_SET_BLOCK(&p_core->lots_owner[p_bld->owner], block, p_bld->block_pos);
+      BB_SET_BLOCK(&p_core->lots_built, block, p_bld->block_pos);
    }
+   p_core->hash ^= core_hash_block(p_core, block);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_board_cards_mark(void)
+void core_board_card_set(core_t* p_core, int slot, const card_t* p_card)
 {
-   player_t* p_player = core.active_player;
+   const card_t** pp_slot;
+   REQUIRE((slot >= 0) && (slot < MAX_BOARD_CARDS));
+   pp_slot = (slot < 5) ? &p_core->board_planning_cards[slot] :
+      &p_core->board_contract_cards[slot - 5];
+   p_core->hash ^= core_hash_card(CORE_HASH_BOARD_CARD, slot, *pp_slot) ^
+      core_hash_card(CORE_HASH_BOARD_CARD, slot, p_card);
+   *pp_slot = p_card;
+}
+
+/*-----------------------------------------------------------------------------
+Only the blocks on the old or the new rows and columns of the marker change,
+they are found with the block masks of the rows and columns. The hash only
+changes by the keys of the rows and columns moved.
+-----------------------------------------------------------------------------*/
+void core_set_marker(core_t* p_core, bool_t wealth, int marker, uint8_t rows,
+   uint8_t columns)
+{ /* Marker n adds n+1 to every block on its rows and again on its columns */
+   prestige_wealth_marker_t* p_mrk;
+   uint64_t rows_old;
+   uint64_t columns_old;
+   uint64_t rows_new;
+   uint64_t columns_new;
+   uint64_t blocks;
+   if (wealth)
+   {
+      REQUIRE((marker >= 0) && (marker < 12));
+      p_mrk = &p_core->wealth_markers[marker];
+   }
+   else
+   {
+      REQUIRE((marker >= 0) && (marker < 6));
+      p_mrk = &p_core->prestige_markers[marker];
+   }
+   rows_old = core_marker_rows[p_mrk->rows & 63];
+   columns_old = core_marker_columns[p_mrk->columns & 63];
+   rows_new = core_marker_rows[rows & 63];
+   columns_new = core_marker_columns[columns & 63];
+   blocks = (rows_old ^ rows_new) | (columns_old ^ columns_new);
+   while (blocks != 0)
+   {
+      int i = __builtin_ctzll(blocks);
+      int hits = (int)((rows_new >> i) & 1) + (int)((columns_new >> i) & 1) -
+         (int)((rows_old >> i) & 1) - (int)((columns_old >> i) & 1);
+      blocks &= blocks - 1;
+      if (hits != 0)
+      {
+         p_core->board_blocks[i].value += hits * (marker + 1);
+         core_dirty_block(p_core, &p_core->board_blocks[i], BLOCK_DIRTY_VALUE);
+      }
+   }
+   /* The marker key is the xor of its row and column keys */
+   p_core->hash ^= core_hash_marker(wealth, marker, p_mrk->rows ^ rows,
+      p_mrk->columns ^ columns);
+   p_mrk->rows = rows;
+   p_mrk->columns = columns;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int core_board_lots_count(core_t* p_core, zone_t zone, uint8_t owner)
+{
+   bitboard_t lots;
+   REQUIRE(zone < ZONE_LAST);
+   REQUIRE(owner <= PLAYER_COLOR_LAST);
+   bb_and(&lots, &p_core->lots_zone[zone], &p_core->lots_owner[owner]);
+   return bb_count(&lots);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t core_board_block_adjacent(core_t* p_core, int block, zone_t zone)
+{
+   bitboard_t lots;
+   REQUIRE((block >= 0) && (block < MAX_BOARD_BLOCKS));
+   REQUIRE(zone < ZONE_LAST);
+   bb_clear(&lots);
+   BB_SET_BLOCK(&lots, block, 0xf);
+   bb_neighbours(&lots, &lots);
+   bb_and(&lots, &lots, &p_core->lots_zone[zone]);
+   return !bb_empty(&lots);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_board_cards_mark(core_t* p_core)
+{
+   player_t* p_player = p_core->active_player;
    int i;
 
-   switch (core.state)
+   switch (p_core->state)
    {
    case CORE_STATE_ACTION_TAKE_CARD:
    { /* Mark all planning cards with ap cost <= player ap */
       for (i=0;i<5;i++)
       {
          if ((p_player->ap >= (i + 1)) &&
-             (core.board_planning_cards[i] != NULL))
+             (p_core->board_planning_cards[i] != NULL))
          {
-            core.board_cards_marked[i] = TRUE;
+            p_core->board_cards_marked[i] = TRUE;
          }
       }
       break;
@@ -888,9 +1117,9 @@ void core_board_cards_mark(void)
       for (i=0;i<8;i++)
       {
          if ((p_player->ap >= contract_cards_ap_cost[i]) &&
-             (core.board_contract_cards[i] != NULL))
+             (p_core->board_contract_cards[i] != NULL))
          {
-            core.board_cards_marked[5+i] = TRUE;
+            p_core->board_cards_marked[5+i] = TRUE;
          }
       }
       break;
@@ -902,12 +1131,12 @@ void core_board_cards_mark(void)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_board_cards_clear(void)
+void core_board_cards_clear(core_t* p_core)
 {
    int i;
    for (i=0;i<MAX_BOARD_CARDS;i++)
    {
-      core.board_cards_marked[i] = FALSE;
+      p_core->board_cards_marked[i] = FALSE;
    }
 }
 
@@ -921,21 +1150,21 @@ vocation_t core_vocbit2voc(uint32_t vocation_bit)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-player_t* core_get_next_player(void)
+player_t* core_get_next_player(core_t* p_core)
 {
-   player_t* p_player = SLNK_NEXT(player_t, core.active_player);
+   player_t* p_player = SLNK_NEXT(player_t, p_core->active_player);
    if (p_player == NULL)
    {
-      p_player = SLNK_NEXT(player_t, &core.players_head);
+      p_player = SLNK_NEXT(player_t, &p_core->players_head);
    }
    return p_player;
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_next_player(void)
+void core_next_player(core_t* p_core)
 {
-   core.active_player = core_get_next_player();
+   p_core->active_player = core_get_next_player(p_core);
 }
 
 /*-----------------------------------------------------------------------------
@@ -954,57 +1183,88 @@ void core_dbg_dump_player_data(player_t* p_player)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_log(player_t* p_player, const char* p_fmt, ...)
+void core_log(core_t* p_core, player_t* p_player, const char* p_fmt, ...)
 {
    va_list ap;
-   core.log_entry.p_player = p_player;
+   p_core->log_entry.p_player = p_player;
    va_start(ap, p_fmt);
-   vsnprintf(core.log_entry.text, MAX_CORE_LOG_ENTRY-1, p_fmt, ap);
+   vsnprintf(p_core->log_entry.text, MAX_CORE_LOG_ENTRY-1, p_fmt, ap);
    va_end(ap);
-   core_net_broadcast(NET_CMD_SERVER_LOG_ENTRY, NULL);
+   core_net_broadcast(p_core, NET_CMD_SERVER_LOG_ENTRY, NULL);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_net_send(int sock, int cmd, void* data)
+void core_dirty(core_t* p_core, uint8_t fields)
 {
-   core.net_send(sock, cmd, data);
+   p_core->dirty |= fields;
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void core_net_broadcast(int cmd, void* data)
+void core_dirty_player(core_t* p_core, player_t* p_player, uint8_t fields)
 {
-   core.net_broadcast(cmd, data);
+   p_player->dirty |= fields;
+   p_core->dirty |= CORE_DIRTY_PLAYERS;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_dirty_block(core_t* p_core, block_t* p_blk, uint8_t fields)
+{
+   p_blk->dirty |= fields;
+   p_core->dirty |= CORE_DIRTY_BLOCKS;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_net_send(core_t* p_core, int sock, int cmd, void* data)
+{
+   if (p_core->net_send)
+   {
+      p_core->net_send(p_core, sock, cmd, data);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_net_broadcast(core_t* p_core, int cmd, void* data)
+{
+   if (p_core->net_broadcast)
+   {
+      p_core->net_broadcast(p_core, cmd, data);
+   }
 }
 
 /* LOCAL FUNCTIONS ***********************************************************/
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-static void core_prepare_players(void)
+static void core_prepare_players(core_t* p_core)
 {
-   player_t* p_player = SLNK_NEXT(player_t, &core.players_head);
+   player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
    int n = 0;
    while(p_player != NULL)
    {
       int i;
       p_player->ap = 6;
-      if (core.n_players == 2) p_player->wealth = 39;
-      if (core.n_players == 3) p_player->wealth = 27;
-      if (core.n_players == 4) p_player->wealth = 21;
+      if (p_core->n_players == 2) p_player->wealth = 39;
+      if (p_core->n_players == 3) p_player->wealth = 27;
+      if (p_core->n_players == 4) p_player->wealth = 21;
       p_player->prestige = 0;
       /* Draw initial planning cards */
       for (i=0;i<n+1;i++)
       {
-         card_t* p_card = cards_draw(&core.planning_deck_head, -1);
-         SLNK_ADD(&p_player->cards_head, p_card);
+         const card_t* p_card = cards_pile_draw(&p_core->planning_deck);
+         cards_hand_add(&p_player->cards, p_card);
+         p_core->hash ^= core_hash_card(CORE_HASH_HAND, p_player->id,
+            p_card);
       }
       /* Test */
       p_player->vocations = 0xA5;
       p_player->politicians = (1u << POLITICIAN_MAYOR) |
          (1u << POLITICIAN_POLICE_CHIEF);
       core_dbg_dump_player_data(p_player);
-      core_net_broadcast(NET_CMD_SERVER_PLAYER_UPDATE, p_player);
+      core_dirty_player(p_core, p_player, PLAYER_DIRTY_ALL);
       n++;
       p_player = SLNK_NEXT(player_t, p_player);
    }
@@ -1036,7 +1296,7 @@ static bool_t core_find_tiles_adjacent_with_species(tile_t* p_tile,
    int i;
    for (i=0;i<6;i++)
    {
-      tile_t* p_tile_tmp = core_find_tile(p_tile->x + tile_dir[i].x,
+      tile_t* p_tile_tmp = core_find_tile(p_core, p_tile->x + tile_dir[i].x,
          p_tile->y + tile_dir[i].y);
       if (p_tile_tmp)
       {
@@ -1065,7 +1325,7 @@ static int core_count_adjacent_tiles(tile_t* p_tile)
    int i;
    for (i=0;i<6;i++)
    {
-      tile_t* p_tile_tmp = core_find_tile(p_tile->x + tile_dir[i].x,
+      tile_t* p_tile_tmp = core_find_tile(p_core, p_tile->x + tile_dir[i].x,
          p_tile->y + tile_dir[i].y);
       if (p_tile_tmp)
       {
@@ -1080,35 +1340,15 @@ static int core_count_adjacent_tiles(tile_t* p_tile)
 #endif
 
 /*-----------------------------------------------------------------------------
+Derive the per block lots_marked nibbles from the marked lots bitboard.
 -----------------------------------------------------------------------------*/
-static int core_calc_block_value(int block)
+static void core_board_lots_view(core_t* p_core)
 {
    int i;
-   int cost = 0;
-   for (i=0;i<6;i++)
-   {
-      if (core.prestige_markers[i].columns & (1u << (block%6)))
-      {
-         cost += i + 1;
-      }
-      if (core.prestige_markers[i].rows & (1u << (block/6)))
-      {
-         cost += i + 1;
-      }
-   }
-   for (i=0;i<12;i++)
+   for (i=0;i<MAX_BOARD_BLOCKS;i++)
    {
-      if (core.wealth_markers[i].columns & (1u << (block%6)))
-      {
-         cost += i + 1;
-      }
-      if (core.wealth_markers[i].rows & (1u << (block/6)))
-      {
-         cost += i + 1;
-      }
+      p_core->board_blocks[i].lots_marked = BB_BLOCK(&p_core->lots_marked, i);
    }
-   return cost;
 }
 
-
 /* END OF FILE ***************************************************************/
@@ -10,6 +10,7 @@ Copyright (c) 2013, All Rights Reserved.
 #define CORE_H
 /* INCLUDE FILES *************************************************************/
 #include "cards.h"
+#include "bitboard.h"
 
 /* EXPORTED DEFINES **********************************************************/
 #define MAX_NAME_LENGTH (40)
@@ -20,9 +21,29 @@ Copyright (c) 2013, All Rights Reserved.
 #define MAX_BOARD_LOTS (36*4)
 #define MAX_BOARD_CARDS (13)
 
+/* Changed state not yet sent to the clients (see core_sync.h) */
+#define CORE_DIRTY_PHASE (BIT(0))          /* current_round, state */
+#define CORE_DIRTY_ACTIVE_PLAYER (BIT(1))
+#define CORE_DIRTY_BOARD_CARDS (BIT(2))
+#define CORE_DIRTY_PLAYERS (BIT(6))        /* Some player_t dirty */
+#define CORE_DIRTY_BLOCKS (BIT(7))         /* Some block_t dirty */
+#define PLAYER_DIRTY_COLOR (BIT(0))
+#define PLAYER_DIRTY_AP (BIT(1))
+#define PLAYER_DIRTY_POLITICIANS (BIT(2))
+#define PLAYER_DIRTY_VOCATIONS (BIT(3))
+#define PLAYER_DIRTY_WEALTH (BIT(4))
+#define PLAYER_DIRTY_PRESTIGE (BIT(5))
+#define PLAYER_DIRTY_CARDS (BIT(6))
+#define PLAYER_DIRTY_ALL (0x7f)
+#define BLOCK_DIRTY_BUILDINGS (BIT(0))     /* n_buildings, buildings */
+#define BLOCK_DIRTY_VALUE (BIT(1))
+#define BLOCK_DIRTY_ALL (0x03)
+
 /* EXPORTED DATA TYPES *******************************************************/
-typedef void core_net_send_fn_t(int sock, int cmd, void* data);
-typedef void core_net_broadcast_fn_t(int cmd, void* data);
+typedef struct core core_t;  /*!< Forward core declaration */
+
+typedef void core_net_send_fn_t(core_t* p_core, int sock, int cmd, void* data);
+typedef void core_net_broadcast_fn_t(core_t* p_core, int cmd, void* data);
 
 typedef struct
 {
@@ -111,8 +132,9 @@ typedef struct
    uint8_t id;
    building_t buildings[4];
    uint8_t n_buildings;
-   uint32_t value;
+   uint32_t value; /* Building cost, kept up to date by core_set_marker() */
    uint8_t lots_marked; /* Bits 0-3 */
+   uint8_t dirty; /* BLOCK_DIRTY_* */
 } block_t;
 
 typedef struct
@@ -129,14 +151,16 @@ typedef struct
    int id;
    char name[MAX_NAME_LENGTH];
    uint8_t color;
-   slnk_t cards_head;
-   slnk_t favor_head;
+   card_hand_t cards;
+   card_hand_t favors;
    uint8_t ap;
    uint8_t politicians;
    uint32_t vocations; /* Bits 0-23 */
    uint32_t wealth;
    uint32_t prestige;
    bool_t passed;
+   uint8_t timeouts; /* Turns in a row out of time (server) */
+   uint8_t dirty; /* PLAYER_DIRTY_* */
 } player_t;
 
 typedef struct
@@ -145,37 +169,52 @@ typedef struct
    char text[MAX_CORE_LOG_ENTRY];
 } core_log_entry_t;
 
-typedef struct
+/*---------------------------------------------------------------------------*/
+/*! \brief Game state.
+One instance per game. The client uses the default instance (core_get()). */
+/*---------------------------------------------------------------------------*/
+struct core
 {
    bool_t is_server;
+   int game_id;               /*!< Game id (server only) */
    slnk_t players_head;
    int n_players;
-   slnk_t planning_deck_head;
-   slnk_t planning_discard_head;
-   slnk_t town_deck_head;
-   slnk_t town_discard_head;
-   slnk_t city_deck_head;
-   slnk_t city_discard_head;
-   slnk_t metropolis_deck_head;
-   slnk_t metropolis_discard_head;
-   card_t* board_planning_cards[5];
-   card_t* board_contract_cards[8];
+   card_pile_t planning_deck;
+   card_pile_t planning_discard;
+   card_pile_t town_deck;
+   card_pile_t town_discard;
+   card_pile_t city_deck;
+   card_pile_t city_discard;
+   card_pile_t metropolis_deck;
+   card_pile_t metropolis_discard;
+   const card_t* board_planning_cards[5];
+   const card_t* board_contract_cards[8];
    bool_t board_cards_marked[MAX_BOARD_CARDS];
    uint8_t state;
    uint32_t board_vocations;
-   block_t board_blocks[MAX_BOARD_BLOCKS];
+   block_t board_blocks[MAX_BOARD_BLOCKS]; /*!< Per block view of the lots */
+   bitboard_t lots_zone[ZONE_LAST];       /*!< Built lots per zone */
+   bitboard_t lots_owner[PLAYER_COLOR_LAST + 1]; /*!< Built lots per owner
+                                                      (last = no owner) */
+   bitboard_t lots_built;                 /*!< All built lots */
+   bitboard_t lots_marked;                /*!< Valid lots (lots_marked view) */
    uint8_t board_election_track[5];
    prestige_wealth_marker_t prestige_markers[6];
    prestige_wealth_marker_t wealth_markers[12];
    player_t* active_player;
    uint8_t current_round;
    uint8_t available_colors;
-   card_contract_t* current_contract_card;
-   card_planning_t* current_planning_cards[5];
+   const card_contract_t* current_contract_card;
+   const card_planning_t* current_planning_cards[5];
    bool_t last_round;
    int startup_buildings;
    core_net_send_fn_t* net_send;
    core_net_broadcast_fn_t* net_broadcast;
+   uint32_t version;          /*!< State version, one per sent delta */
+   uint64_t hash;             /*!< Zobrist hash, see core_hash.h */
+   uint64_t seed;             /*!< Seed of rng, see core_seed() */
+   core_rng_t rng;            /*!< All chance in the game, see core_rng.h */
+   uint8_t dirty;             /*!< CORE_DIRTY_* */
 /* Temporary storage for net events etc */
    uint8_t board_pos_x;
    uint8_t board_pos_y;
@@ -185,86 +224,134 @@ typedef struct
    uint8_t card_selection;
    uint8_t rotation_selection;
    uint8_t board_lot_selection;
-} core_t;
+};
 
 /* GLOBAL VARIABLES **********************************************************/
+extern const uint8_t contract_cards_ap_cost[8]; /*!< Of board_contract_cards */
+extern bitboard_t core_startup_lots;   /*!< Lots of the startup buildings */
 
 /* INTERFACE FUNCTIONS *******************************************************/
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Initialize. */
 /*---------------------------------------------------------------------------*/
-void core_init(
-   core_net_send_fn_t* p_fn_send,
-   core_net_broadcast_fn_t* p_fn_bc
+void core_init(void);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Construct a game instance. */
+/*---------------------------------------------------------------------------*/
+void core_ctor(
+   core_t* p_core,                     /*!< Game instance */
+   core_net_send_fn_t* p_fn_send,      /*!< Send function (NULL = none) */
+   core_net_broadcast_fn_t* p_fn_bc    /*!< Broadcast function (NULL = none) */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Get a pointer to the core_t struct. */
+/*! \brief Seed the random numbers of a game instance (before colors are
+selected). A game replays the same from the same seed and moves. */
+/*---------------------------------------------------------------------------*/
+void core_seed(
+   core_t* p_core,      /*!< Game instance */
+   uint64_t seed        /*!< Seed */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Get a pointer to the default core_t instance. */
 /*---------------------------------------------------------------------------*/
 core_t* core_get(void);
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Free resources. */
+/*! \brief Free resources (remaining players) of a game instance. */
+/*---------------------------------------------------------------------------*/
+void core_free(
+   core_t* p_core       /*!< Game instance */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Copy a game instance with its own players (e.g. for a search
+thread). The copy has no net functions, free it with core_free(). */
 /*---------------------------------------------------------------------------*/
-void core_free(void);
+void core_copy(
+   core_t* p_dst,       /*!< Copy */
+   const core_t* p_src  /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Initialize new game. */
 /*---------------------------------------------------------------------------*/
 bool_t core_newgame(
+   core_t* p_core,      /*!< Game instance */
    bool_t load          /*!< New game/Load game */
    );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Select color for active player. */
 /*---------------------------------------------------------------------------*/
-void core_select_color(void);
+void core_select_color(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Invest (discard planning card(s) for wealth). */
 /*---------------------------------------------------------------------------*/
-void core_invest(void);
+void core_invest(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Prepare next action, round or game end. */
 /*---------------------------------------------------------------------------*/
-core_state_t core_next_action(void);
+core_state_t core_next_action(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Handle action done. */
 /*---------------------------------------------------------------------------*/
-void core_action_done(void);
+void core_action_done(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Handle adaptation action. */
 /*---------------------------------------------------------------------------*/
-void core_action_take_card(void);
+void core_action_take_card(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Handle regression action (active player). */
 /*---------------------------------------------------------------------------*/
-void core_action_build(void);
+void core_action_build(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Prepare new round. */
 /*---------------------------------------------------------------------------*/
-void core_prepare_new_round(void);
+void core_prepare_new_round(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Use selected card. */
 /*---------------------------------------------------------------------------*/
-void core_use_card(void);
+void core_use_card(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Calculate final vp. */
 /*---------------------------------------------------------------------------*/
-void core_calculate_final_vp(void);
+void core_calculate_final_vp(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Find block based on coordinates. */
 /*---------------------------------------------------------------------------*/
 block_t* core_find_block(
+   core_t* p_core,      /*!< Game instance */
    int x,               /*!< x coordinate */
    int y                /*!< y coordinate */
    );
@@ -273,6 +360,7 @@ block_t* core_find_block(
 /*! \brief Save game. */
 /*---------------------------------------------------------------------------*/
 bool_t core_savegame(
+   core_t* p_core,      /*!< Game instance */
    char* name           /*!< Name of save game. */
    );
 
@@ -280,6 +368,7 @@ bool_t core_savegame(
 /*! \brief Load a saved game. */
 /*---------------------------------------------------------------------------*/
 bool_t core_loadgame(
+   core_t* p_core,      /*!< Game instance */
    char* name           /*!< Name of saved game. */
    );
 
@@ -287,13 +376,16 @@ bool_t core_loadgame(
 /*! \brief Add new player. */
 /*---------------------------------------------------------------------------*/
 void core_add_player(
+   core_t* p_core,      /*!< Game instance */
    player_t* p_player   /*!< Player */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Remove player. */
+/*! \brief Remove player. The next player becomes active if the player was
+active. */
 /*---------------------------------------------------------------------------*/
 void core_rm_player(
+   core_t* p_core,      /*!< Game instance */
    player_t* p_player   /*!< Player */
    );
 
@@ -301,6 +393,7 @@ void core_rm_player(
 /*! \brief Find player. */
 /*---------------------------------------------------------------------------*/
 player_t* core_find_player(
+   core_t* p_core,      /*!< Game instance */
    int id               /*!< Player id (0 = this player) */
    );
 
@@ -308,6 +401,7 @@ player_t* core_find_player(
 /*! \brief Find player by name. */
 /*---------------------------------------------------------------------------*/
 player_t* core_find_player_by_name(
+   core_t* p_core,      /*!< Game instance */
    char* name           /*!< Name */
    );
 
@@ -315,38 +409,99 @@ player_t* core_find_player_by_name(
 /*! \brief Find player by animal. */
 /*---------------------------------------------------------------------------*/
 player_t* core_find_player_by_color(
+   core_t* p_core,      /*!< Game instance */
    int color            /*!< Color */
    );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Get next player. */
 /*---------------------------------------------------------------------------*/
-player_t* core_get_next_player(void);
+player_t* core_get_next_player(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Set next player as active player. */
 /*---------------------------------------------------------------------------*/
-void core_next_player(void);
+void core_next_player(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Mark valid lots on game board. */
 /*---------------------------------------------------------------------------*/
-void core_board_lots_mark(void);
+void core_board_lots_mark(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Clear marked lots on game board. */
 /*---------------------------------------------------------------------------*/
-void core_board_lots_clear(void);
+void core_board_lots_clear(
+   core_t* p_core       /*!< Game instance */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Update the lot bitboards of a block from its buildings.
+Call after board_blocks[block].buildings changed (e.g. on the client). */
+/*---------------------------------------------------------------------------*/
+void core_board_block_update(
+   core_t* p_core,      /*!< Game instance */
+   int block            /*!< Block */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Put a card in a board slot (0-4 planning, 5-12 contract). */
+/*---------------------------------------------------------------------------*/
+void core_board_card_set(
+   core_t* p_core,      /*!< Game instance */
+   int slot,            /*!< Slot */
+   const card_t* p_card /*!< Card (NULL = empty) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Move a prestige or wealth marker and update the block values. */
+/*---------------------------------------------------------------------------*/
+void core_set_marker(
+   core_t* p_core,      /*!< Game instance */
+   bool_t wealth,       /*!< Wealth marker/Prestige marker */
+   int marker,          /*!< Marker (value - 1) */
+   uint8_t rows,        /*!< New rows (bit n = row n) */
+   uint8_t columns      /*!< New columns (bit n = column n) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Count built lots of a zone and owner.
+\return Number of lots */
+/*---------------------------------------------------------------------------*/
+int core_board_lots_count(
+   core_t* p_core,      /*!< Game instance */
+   zone_t zone,         /*!< Zone */
+   uint8_t owner        /*!< Player color (PLAYER_COLOR_LAST = no owner) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Check for a building of a zone next to a block (not diagonal). */
+/*---------------------------------------------------------------------------*/
+bool_t core_board_block_adjacent(
+   core_t* p_core,      /*!< Game instance */
+   int block,           /*!< Block */
+   zone_t zone          /*!< Zone */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Mark valid cards on game board. */
 /*---------------------------------------------------------------------------*/
-void core_board_cards_mark(void);
+void core_board_cards_mark(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Clear marked cards. */
 /*---------------------------------------------------------------------------*/
-void core_board_cards_clear(void);
+void core_board_cards_clear(
+   core_t* p_core       /*!< Game instance */
+   );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Convert vocation bit to vocation. */
@@ -366,15 +521,43 @@ void core_dbg_dump_player_data(
 /*! \brief Add log entry. */
 /*---------------------------------------------------------------------------*/
 void core_log(
+   core_t* p_core,      /*!< Game instance */
    player_t* p_player,  /*!< Player */
    const char* p_fmt,   /*!< Pointer to a format string */
    ...                  /*!< Variable argument list */
    );
 
+/*---------------------------------------------------------------------------*/
+/*! \brief Mark game state as changed. */
+/*---------------------------------------------------------------------------*/
+void core_dirty(
+   core_t* p_core,      /*!< Game instance */
+   uint8_t fields       /*!< CORE_DIRTY_* */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Mark player state as changed. */
+/*---------------------------------------------------------------------------*/
+void core_dirty_player(
+   core_t* p_core,      /*!< Game instance */
+   player_t* p_player,  /*!< Player */
+   uint8_t fields       /*!< PLAYER_DIRTY_* */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Mark block state as changed. */
+/*---------------------------------------------------------------------------*/
+void core_dirty_block(
+   core_t* p_core,      /*!< Game instance */
+   block_t* p_blk,      /*!< Block */
+   uint8_t fields       /*!< BLOCK_DIRTY_* */
+   );
+
 /*---------------------------------------------------------------------------*/
 /*! \brief Send net command. */
 /*---------------------------------------------------------------------------*/
 void core_net_send(
+   core_t* p_core,      /*!< Game instance */
    int sock,
    int cmd,
    void* data
@@ -384,6 +567,7 @@ void core_net_send(
 /*! \brief Broadcast net command. */
 /*---------------------------------------------------------------------------*/
 void core_net_broadcast(
+   core_t* p_core,      /*!< Game instance */
    int cmd,
    void* data
    );
@@ -0,0 +1,557 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_ai.c
+\brief Computer player implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "slnk.h"
+#include "core.h"
+#include "core_move.h"
+#include "core_hash.h"
+#include "core_tt.h"
+#include "core_ai.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define CORE_AI_MAX_PLAYERS (8)
+#define CORE_AI_UCT_C (0.7f)  /* Exploration constant, rewards are 0-1 */
+#define CORE_AI_TT_SIZE (1 << 16) /* Entries of the table of a search */
+#define CORE_AI_TT_UNIT (840) /* Reward unit in the table, a reward shared by
+                                 up to 8 players is a whole number of units */
+
+/* LOCAL DATATYPES ***********************************************************/
+typedef struct
+{
+   move_t move;               /*!< Move into this node */
+   int8_t player;             /*!< Player making the move (-1 root) */
+   uint16_t n_children;
+   int32_t first_child;       /*!< -1 = not expanded */
+   uint32_t visits;
+   float reward;              /*!< Sum of the rewards of player */
+   uint64_t key;              /*!< Table key (0 = move not played yet) */
+} core_ai_node_t;
+
+typedef struct
+{
+   pthread_t thread_id;
+   const core_t* p_root;      /*!< Searched game (read only) */
+   const core_ai_cfg_t* p_cfg;
+   core_tt_t* p_tt;           /*!< Table shared by the threads */
+   struct timespec deadline;
+   unsigned int seed;
+   core_t core;               /*!< Own copy of the game */
+   core_undo_stack_t undo;
+   player_t* players[CORE_AI_MAX_PLAYERS]; /*!< Players of the copy */
+   int n_players;
+   core_ai_node_t* p_nodes;
+   int n_nodes;
+   int iterations;
+} core_ai_thread_t;           /*!< Search thread */
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static void* core_ai_thread(void* arg);
+static void core_ai_iterate(core_ai_thread_t* p_t);
+static bool_t core_ai_expand(core_ai_thread_t* p_t, int node);
+static int core_ai_select(core_ai_thread_t* p_t, int node);
+static void core_ai_play(core_ai_thread_t* p_t, const move_t* p_move);
+static uint64_t core_ai_key(core_ai_thread_t* p_t, int player);
+static void core_ai_tt_add(core_ai_thread_t* p_t, uint64_t key, float reward);
+static uint32_t core_ai_tt_stats(core_ai_thread_t* p_t,
+   const core_ai_node_t* p_node, float* p_reward);
+static void core_ai_reward(core_ai_thread_t* p_t, float* p_reward);
+static int core_ai_player(core_ai_thread_t* p_t);
+static bool_t core_ai_timeout(const struct timespec* p_deadline);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int core_ai_gen_moves(const core_t* p_core, move_t* p_moves, int max)
+{
+   int n = core_gen_moves(p_core, p_moves, max);
+   int i;
+   int j = 0;
+
+   for (i=0;i<n;i++)
+   {
+      if ((p_moves[i].type != MOVE_ACTION) || (p_moves[i].arg == 0))
+      {
+         p_moves[j++] = p_moves[i];
+      }
+   }
+   return j;
+}
+
+/*-----------------------------------------------------------------------------
+The undo restores both phase and player.
+-----------------------------------------------------------------------------*/
+void core_ai_next(core_t* p_core, uint8_t state, const move_t* p_move)
+{
+   switch (state)
+   {
+   case CORE_STATE_SETUP:
+      p_core->startup_buildings--;
+      core_next_player(p_core);
+      if (p_core->startup_buildings <= 0)
+      {
+         p_core->state = CORE_STATE_INVESTMENTS;
+      }
+      break;
+   case CORE_STATE_INVESTMENTS:
+      if (p_move->type == MOVE_DONE)
+      {
+         p_core->state = CORE_STATE_ACTIONS;
+      }
+      break;
+   case CORE_STATE_ACTIONS:
+      if (p_move->type == MOVE_ACTION)
+      {
+         p_core->state = CORE_STATE_ACTION_TAKE_CARD;
+      }
+      else
+      { /* End of turn */
+         core_next_player(p_core);
+         p_core->state = CORE_STATE_INVESTMENTS;
+      }
+      break;
+   case CORE_STATE_ACTION_TAKE_CARD:
+      p_core->state = CORE_STATE_ACTIONS;
+      break;
+   case CORE_STATE_ACTION_END_OF_TURN:
+      core_next_player(p_core);
+      p_core->state = CORE_STATE_INVESTMENTS;
+      break;
+   default:
+      break;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Thread 0 runs on the calling thread. All trees have the same root children
+(same position), so the root visits are added up by child index. The threads
+share one transposition table for the search, the statistics of a position
+reached by other move orders or by other threads are used for the selection.
+-----------------------------------------------------------------------------*/
+bool_t core_ai_search(const core_t* p_core, const core_ai_cfg_t* p_cfg,
+   move_t* p_move, core_ai_stats_t* p_stats)
+{
+   move_t moves[CORE_MAX_MOVES];
+   uint32_t visits[CORE_MAX_MOVES];
+   float reward[CORE_MAX_MOVES];
+   core_ai_thread_t* p_threads;
+   core_tt_t tt;
+   struct timespec deadline;
+   int n_threads = p_cfg->n_threads;
+   int iterations = 0;
+   int best = 0;
+   int n;
+   int i;
+   int j;
+
+   REQUIRE((p_cfg->budget_ms > 0) || (p_cfg->max_iterations > 0));
+   n = core_ai_gen_moves(p_core, moves, CORE_MAX_MOVES);
+   if (p_stats != NULL)
+   {
+      memset(p_stats, 0, sizeof(core_ai_stats_t));
+      p_stats->n_moves = n;
+   }
+   if (n == 0)
+   {
+      return FALSE;
+   }
+   if ((n == 1) || (p_core->state == CORE_STATE_NONE))
+   { /* Nothing to search */
+      *p_move = moves[0];
+      return TRUE;
+   }
+   if (n_threads <= 0)
+   {
+#ifdef _SC_NPROCESSORS_ONLN
+      n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+      if (n_threads <= 0)
+      {
+         n_threads = 1;
+      }
+   }
+   n_threads = MIN(n_threads, CORE_AI_MAX_THREADS);
+   clock_gettime(CLOCK_MONOTONIC, &deadline);
+   deadline.tv_sec += p_cfg->budget_ms / 1000;
+   deadline.tv_nsec += (p_cfg->budget_ms % 1000) * 1000000L;
+   if (deadline.tv_nsec >= 1000000000L)
+   {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+   }
+   p_threads = (core_ai_thread_t*)calloc(n_threads, sizeof(core_ai_thread_t));
+   REQUIRE(p_threads != NULL);
+   core_tt_init(&tt, CORE_AI_TT_SIZE);
+   for (i=0;i<n_threads;i++)
+   {
+      core_ai_thread_t* p_t = &p_threads[i];
+      p_t->p_root = p_core;
+      p_t->p_cfg = p_cfg;
+      p_t->p_tt = &tt;
+      p_t->deadline = deadline;
+      p_t->seed = p_cfg->seed + i;
+      p_t->p_nodes = (core_ai_node_t*)malloc(
+         CORE_AI_MAX_NODES * sizeof(core_ai_node_t));
+      REQUIRE(p_t->p_nodes != NULL);
+      if (i > 0)
+      {
+         pthread_create(&p_t->thread_id, NULL, core_ai_thread, p_t);
+      }
+   }
+   core_ai_thread(&p_threads[0]);
+   memset(visits, 0, sizeof(visits));
+   memset(reward, 0, sizeof(reward));
+   for (i=0;i<n_threads;i++)
+   {
+      core_ai_thread_t* p_t = &p_threads[i];
+      core_ai_node_t* p_root = &p_t->p_nodes[0];
+      if (i > 0)
+      {
+         pthread_join(p_t->thread_id, NULL);
+      }
+      REQUIRE(p_root->n_children == n);
+      for (j=0;j<n;j++)
+      {
+         core_ai_node_t* p_child = &p_t->p_nodes[p_root->first_child + j];
+         visits[j] += p_child->visits;
+         reward[j] += p_child->reward;
+      }
+      iterations += p_t->iterations;
+      free(p_t->p_nodes);
+   }
+   free(p_threads);
+   core_tt_free(&tt);
+   for (j=1;j<n;j++)
+   { /* Most visits, then best mean reward */
+      if ((visits[j] > visits[best]) ||
+          ((visits[j] == visits[best]) &&
+           (reward[j] > reward[best])))
+      {
+         best = j;
+      }
+   }
+   *p_move = moves[best];
+   if (p_stats != NULL)
+   {
+      p_stats->iterations = iterations;
+      p_stats->visits = visits[best];
+      p_stats->value = (visits[best] > 0) ? reward[best] / visits[best] : 0;
+   }
+   return TRUE;
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Search on an own copy of the game until the budget is used.
+-----------------------------------------------------------------------------*/
+static void* core_ai_thread(void* arg)
+{
+   core_ai_thread_t* p_t = (core_ai_thread_t*)arg;
+   const core_ai_cfg_t* p_cfg = p_t->p_cfg;
+   player_t* p_player;
+
+   core_copy(&p_t->core, p_t->p_root);
+   core_undo_clear(&p_t->undo);
+   p_player = SLNK_NEXT(player_t, &p_t->core.players_head);
+   while (p_player != NULL)
+   {
+      REQUIRE(p_t->n_players < CORE_AI_MAX_PLAYERS);
+      p_t->players[p_t->n_players++] = p_player;
+      p_player = SLNK_NEXT(player_t, p_player);
+   }
+   memset(&p_t->p_nodes[0], 0, sizeof(core_ai_node_t));
+   p_t->p_nodes[0].player = -1;
+   p_t->p_nodes[0].first_child = -1;
+   p_t->n_nodes = 1;
+   core_ai_expand(p_t, 0);
+   while (((p_cfg->max_iterations <= 0) ||
+           (p_t->iterations < p_cfg->max_iterations)) &&
+          ((p_cfg->budget_ms <= 0) || !core_ai_timeout(&p_t->deadline)))
+   {
+      core_ai_iterate(p_t);
+      p_t->iterations++;
+   }
+   core_free(&p_t->core);
+   return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+One playout: select down the tree, add a node, play random moves to the end,
+update the path and take all moves back.
+-----------------------------------------------------------------------------*/
+static void core_ai_iterate(core_ai_thread_t* p_t)
+{
+   core_t* p_core = &p_t->core;
+   move_t moves[CORE_MAX_MOVES];
+   float reward[CORE_AI_MAX_PLAYERS];
+   int path[CORE_MAX_UNDO + 1];
+   int n_path = 0;
+   int node = 0;
+   int i;
+
+   path[n_path++] = node;
+   while (p_t->undo.n < CORE_MAX_UNDO)
+   {
+      if ((p_t->p_nodes[node].first_child < 0) && !core_ai_expand(p_t, node))
+      { /* No room for more nodes */
+         break;
+      }
+      if (p_t->p_nodes[node].n_children == 0)
+      { /* Game over */
+         break;
+      }
+      node = core_ai_select(p_t, node);
+      core_ai_play(p_t, &p_t->p_nodes[node].move);
+      if (p_t->p_nodes[node].key == 0)
+      {
+         p_t->p_nodes[node].key = core_ai_key(p_t,
+            p_t->p_nodes[node].player);
+      }
+      path[n_path++] = node;
+      if (p_t->p_nodes[node].visits == 0)
+      { /* New node, play out from here */
+         break;
+      }
+   }
+   while ((p_t->undo.n < CORE_MAX_UNDO) && !core_game_over(p_core))
+   {
+      int n = core_ai_gen_moves(p_core, moves, CORE_MAX_MOVES);
+      if (n == 0)
+      {
+         break;
+      }
+      core_ai_play(p_t, &moves[rand_r(&p_t->seed) % n]);
+   }
+   core_ai_reward(p_t, reward);
+   for (i=0;i<n_path;i++)
+   {
+      core_ai_node_t* p_node = &p_t->p_nodes[path[i]];
+      p_node->visits++;
+      if (p_node->player >= 0)
+      {
+         p_node->reward += reward[(int)p_node->player];
+         core_ai_tt_add(p_t, p_node->key, reward[(int)p_node->player]);
+      }
+   }
+   while (core_undo_move(p_core, &p_t->undo))
+   {
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Add the children of a node (no children when the game is over).
+\return FALSE if the node pool is full
+-----------------------------------------------------------------------------*/
+static bool_t core_ai_expand(core_ai_thread_t* p_t, int node)
+{
+   core_ai_node_t* p_node = &p_t->p_nodes[node];
+   move_t moves[CORE_MAX_MOVES];
+   int player;
+   int n = 0;
+   int i;
+
+   if (!core_game_over(&p_t->core))
+   {
+      n = core_ai_gen_moves(&p_t->core, moves, CORE_MAX_MOVES);
+   }
+   if (p_t->n_nodes + n > CORE_AI_MAX_NODES)
+   {
+      return FALSE;
+   }
+   player = core_ai_player(p_t);
+   p_node->first_child = p_t->n_nodes;
+   p_node->n_children = n;
+   for (i=0;i<n;i++)
+   {
+      core_ai_node_t* p_child = &p_t->p_nodes[p_t->n_nodes++];
+      p_child->move = moves[i];
+      p_child->player = player;
+      p_child->n_children = 0;
+      p_child->first_child = -1;
+      p_child->visits = 0;
+      p_child->reward = 0;
+      p_child->key = 0;
+   }
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+UCT, unvisited children first. The children are rated with the table
+statistics, they include the visits of this tree.
+\return Selected child
+-----------------------------------------------------------------------------*/
+static int core_ai_select(core_ai_thread_t* p_t, int node)
+{
+   core_ai_node_t* p_node = &p_t->p_nodes[node];
+   uint32_t visits[CORE_MAX_MOVES];
+   float reward[CORE_MAX_MOVES];
+   uint32_t n_visits = 0;
+   float log_n;
+   float best_uct = -1;
+   int best = p_node->first_child;
+   int i;
+
+   for (i=0;i<p_node->n_children;i++)
+   {
+      core_ai_node_t* p_child = &p_t->p_nodes[p_node->first_child + i];
+      if (p_child->visits == 0)
+      {
+         return p_node->first_child + i;
+      }
+      visits[i] = core_ai_tt_stats(p_t, p_child, &reward[i]);
+      n_visits += visits[i];
+   }
+   log_n = logf((float)n_visits + 1);
+   for (i=0;i<p_node->n_children;i++)
+   {
+      float uct = reward[i] / visits[i] +
+         CORE_AI_UCT_C * sqrtf(log_n / visits[i]);
+      if (uct > best_uct)
+      {
+         best_uct = uct;
+         best = p_node->first_child + i;
+      }
+   }
+   return best;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void core_ai_play(core_ai_thread_t* p_t, const move_t* p_move)
+{
+   uint8_t state = p_t->core.state;
+
+   core_apply_move(&p_t->core, p_move, &p_t->undo);
+   core_ai_next(&p_t->core, state, p_move);
+}
+
+/*-----------------------------------------------------------------------------
+Table key of the position after a move of player (index). The mover is part of
+the key, the statistics are rewards of the mover.
+\return Key
+-----------------------------------------------------------------------------*/
+static uint64_t core_ai_key(core_ai_thread_t* p_t, int player)
+{
+   return core_hash(&p_t->core) ^
+      core_hash_key(CORE_HASH_ACTIVE_PLAYER, (uint32_t)player, 1);
+}
+
+/*-----------------------------------------------------------------------------
+Add a playout to the table statistics of a position: visits in the high, the
+reward sum (CORE_AI_TT_UNIT) in the low 32 bits. Threads updating the same
+entry at once may lose a playout, the statistics are only a guide.
+-----------------------------------------------------------------------------*/
+static void core_ai_tt_add(core_ai_thread_t* p_t, uint64_t key, float reward)
+{
+   uint64_t data = 0;
+
+   core_tt_probe(p_t->p_tt, key, &data);
+   data += ((uint64_t)1 << 32) +
+      (uint64_t)(reward * CORE_AI_TT_UNIT + 0.5f);
+   core_tt_store(p_t->p_tt, key, data);
+}
+
+/*-----------------------------------------------------------------------------
+Statistics of a visited node, those of the table if it has more visits (the
+entry may have been replaced by another position).
+\return Visits
+-----------------------------------------------------------------------------*/
+static uint32_t core_ai_tt_stats(core_ai_thread_t* p_t,
+   const core_ai_node_t* p_node, float* p_reward)
+{
+   uint64_t data;
+
+   if (core_tt_probe(p_t->p_tt, p_node->key, &data) &&
+       ((uint32_t)(data >> 32) > p_node->visits))
+   {
+      *p_reward = (float)(uint32_t)data / CORE_AI_TT_UNIT;
+      return (uint32_t)(data >> 32);
+   }
+   *p_reward = p_node->reward;
+   return p_node->visits;
+}
+
+/*-----------------------------------------------------------------------------
+1 for the player with most prestige, then wealth (shared on a tie).
+-----------------------------------------------------------------------------*/
+static void core_ai_reward(core_ai_thread_t* p_t, float* p_reward)
+{
+   player_t* p_best = p_t->players[0];
+   int n_best = 0;
+   int i;
+
+   for (i=1;i<p_t->n_players;i++)
+   {
+      player_t* p_player = p_t->players[i];
+      if ((p_player->prestige > p_best->prestige) ||
+          ((p_player->prestige == p_best->prestige) &&
+           (p_player->wealth > p_best->wealth)))
+      {
+         p_best = p_player;
+      }
+   }
+   for (i=0;i<p_t->n_players;i++)
+   {
+      player_t* p_player = p_t->players[i];
+      p_reward[i] = 0;
+      if ((p_player->prestige == p_best->prestige) &&
+          (p_player->wealth == p_best->wealth))
+      {
+         p_reward[i] = 1;
+         n_best++;
+      }
+   }
+   for (i=0;i<p_t->n_players;i++)
+   {
+      p_reward[i] /= n_best;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+\return Index of the active player
+-----------------------------------------------------------------------------*/
+static int core_ai_player(core_ai_thread_t* p_t)
+{
+   int i;
+
+   for (i=0;i<p_t->n_players;i++)
+   {
+      if (p_t->players[i] == p_t->core.active_player)
+      {
+         return i;
+      }
+   }
+   return -1;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static bool_t core_ai_timeout(const struct timespec* p_deadline)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (now.tv_sec > p_deadline->tv_sec) ||
+      ((now.tv_sec == p_deadline->tv_sec) &&
+       (now.tv_nsec >= p_deadline->tv_nsec));
+}
+
+/* END OF FILE ***************************************************************/
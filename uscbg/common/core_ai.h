@@ -0,0 +1,90 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_ai.h
+\brief Computer player, Monte Carlo tree search over the core moves.
+
+Root parallel: every search thread plays on its own copy of the game
+(core_copy) and grows its own tree with UCT selection and random playouts,
+playing and taking back moves with core_apply_move()/core_undo_move(). When
+the time budget or iteration limit is reached the root visits of all threads
+are added up and the most visited move is played. The threads of a search
+share a transposition table (core_tt) keyed by the position hash after a move,
+UCT rates a move with the visits and rewards of its position in all trees.
+
+Between moves the search follows the server state machine (next phase, next
+player). A playout ends when the game is over (core_game_over) or the undo
+stack is full, the player with most prestige, then wealth, wins it.
+
+Color selection is not searched (first available color) and the build action
+is not played, after the contract card it needs lot selections that are not
+moves. */
+/*---------------------------------------------------------------------------*/
+#ifndef CORE_AI_H
+#define CORE_AI_H
+/* INCLUDE FILES *************************************************************/
+#include "core.h"
+#include "core_move.h"
+
+/* EXPORTED DEFINES **********************************************************/
+#define CORE_AI_MAX_THREADS (64)
+#define CORE_AI_MAX_NODES (1 << 16) /* Tree nodes per thread */
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef struct
+{
+   int n_threads;          /*!< Search threads (0 = one per cpu) */
+   int budget_ms;          /*!< Time per move (0 = max_iterations only) */
+   int max_iterations;     /*!< Playouts per thread (0 = budget_ms only) */
+   unsigned int seed;      /*!< Random seed, thread i uses seed + i */
+} core_ai_cfg_t;
+
+typedef struct
+{
+   int n_moves;            /*!< Legal moves at the root */
+   int iterations;         /*!< Playouts of all threads */
+   int visits;             /*!< Root visits of the move played */
+   float value;            /*!< Mean reward (0-1) of the move played */
+} core_ai_stats_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Generate the moves the computer player may play (core_gen_moves
+without the build action).
+\return Number of moves */
+/*---------------------------------------------------------------------------*/
+int core_ai_gen_moves(
+   const core_t* p_core,   /*!< Game instance */
+   move_t* p_moves,        /*!< Moves */
+   int max                 /*!< Size of p_moves */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Next phase and player after a move of core_ai_gen_moves(), as the
+server state machine does. */
+/*---------------------------------------------------------------------------*/
+void core_ai_next(
+   core_t* p_core,         /*!< Game instance */
+   uint8_t state,          /*!< State before the move */
+   const move_t* p_move    /*!< Move played */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Search the best move of the active player. The game is only read,
+it must not change during the search. Blocks for the time budget.
+\return FALSE if the active player has no move */
+/*---------------------------------------------------------------------------*/
+bool_t core_ai_search(
+   const core_t* p_core,         /*!< Game instance */
+   const core_ai_cfg_t* p_cfg,   /*!< Configuration */
+   move_t* p_move,               /*!< Best move */
+   core_ai_stats_t* p_stats      /*!< Statistics (may be NULL) */
+   );
+
+#endif /* #ifndef CORE_AI_H */
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,248 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_bench.c
+\brief Block value benchmark.
+
+Usage: USCoreBench [rounds]
+Compares the block values kept by core_set_marker() with the walk over all 18
+markers that core_action_build() did before. Times both sides of the trade:
+the building cost lookup (walk/block_t.value) and a marker move (plain
+assignment/core_set_marker()). The values must match after every move. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "trc.h"
+#include "slnk.h"
+#include "net.h"
+#include "core.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define BENCH_MOVES (256)       /* Marker moves per round */
+
+/* LOCAL DATATYPES ***********************************************************/
+typedef struct
+{
+   bool_t wealth;
+   int marker;
+   uint8_t rows;
+   uint8_t columns;
+   int block;                 /* Block built on after the move */
+} bench_move_t;
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+STATIC int bench_calc_block_value(core_t* p_core, int block);
+STATIC void bench_move(core_t* p_core, bench_move_t const* p_move,
+   bool_t table);
+STATIC bool_t bench_check(core_t* p_core);
+STATIC double bench_ns(struct timespec const* p_t0,
+   struct timespec const* p_t1, int n);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+static char trc_buf[0x8000];
+static bench_move_t moves[BENCH_MOVES];
+static volatile int sink;      /* Keeps the timed loops */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int main(int argc, char* argv[])
+{
+   int rounds = (argc > 1)?atoi(argv[1]):20000;
+   core_t* p_core = (core_t*)malloc(sizeof(core_t));
+   struct timespec t0, t1;
+   double ns[4];
+   int sum = 0;
+   int r;
+   int i;
+
+   TRC_INIT((char*)&trc_buf, 0x8000);
+   TRC_MASK_FILTER(TRC_ERROR);
+   TRC_MODE_SET(TRC_MODE_PRINT);
+   core_init();
+
+   if ((rounds <= 0) || (p_core == NULL))
+   {
+      printf("Usage: %s [rounds]\n", argv[0]);
+      return 1;
+   }
+   srand(1);
+   for (i=0;i<BENCH_MOVES;i++)
+   {
+      moves[i].wealth = rand() % 2;
+      moves[i].marker = rand() % (moves[i].wealth ? 12 : 6);
+      moves[i].rows = rand() % 64;
+      moves[i].columns = rand() % 64;
+      moves[i].block = rand() % MAX_BOARD_BLOCKS;
+   }
+   core_ctor(p_core, NULL, NULL);
+   for (i=0;i<BENCH_MOVES;i++)
+   {
+      bench_move(p_core, &moves[i], TRUE);
+      if (!bench_check(p_core))
+      {
+         printf("Block values differ after move %d\n", i);
+         return 1;
+      }
+   }
+
+   /* Before: markers assigned, the cost walks the markers on each build */
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   for (r=0;r<rounds;r++)
+   {
+      for (i=0;i<BENCH_MOVES;i++)
+      {
+         sum += bench_calc_block_value(p_core, moves[i].block);
+      }
+   }
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   ns[0] = bench_ns(&t0, &t1, rounds * BENCH_MOVES);
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   for (r=0;r<rounds;r++)
+   {
+      for (i=0;i<BENCH_MOVES;i++)
+      {
+         bench_move(p_core, &moves[i], FALSE);
+      }
+   }
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   ns[1] = bench_ns(&t0, &t1, rounds * BENCH_MOVES);
+
+   /* After: core_set_marker() keeps the values, the cost is read */
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   for (r=0;r<rounds;r++)
+   {
+      for (i=0;i<BENCH_MOVES;i++)
+      {
+         sum += p_core->board_blocks[moves[i].block].value;
+      }
+   }
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   ns[2] = bench_ns(&t0, &t1, rounds * BENCH_MOVES);
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   for (r=0;r<rounds;r++)
+   {
+      for (i=0;i<BENCH_MOVES;i++)
+      {
+         bench_move(p_core, &moves[i], TRUE);
+      }
+   }
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   ns[3] = bench_ns(&t0, &t1, rounds * BENCH_MOVES);
+   sink = sum;
+   if (!bench_check(p_core))
+   { /* Both loops end on the last move */
+      printf("Block values differ after the timed moves\n");
+      return 1;
+   }
+
+   printf("before: build cost %.1f ns, marker move %.1f ns\n", ns[0], ns[1]);
+   printf("after:  build cost %.1f ns, marker move %.1f ns\n", ns[2], ns[3]);
+   core_free(p_core);
+   free(p_core);
+   return 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void assert(const char* test, const char* file, int line)
+{
+   printf("ASSERT %s %s %d", test, file, line);
+   exit(-1);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+The building cost as core_action_build() computed it before the block values.
+-----------------------------------------------------------------------------*/
+STATIC int bench_calc_block_value(core_t* p_core, int block)
+{
+   int i;
+   int cost = 0;
+   for (i=0;i<6;i++)
+   {
+      if (p_core->prestige_markers[i].columns & (1u << (block%6)))
+      {
+         cost += i + 1;
+      }
+      if (p_core->prestige_markers[i].rows & (1u << (block/6)))
+      {
+         cost += i + 1;
+      }
+   }
+   for (i=0;i<12;i++)
+   {
+      if (p_core->wealth_markers[i].columns & (1u << (block%6)))
+      {
+         cost += i + 1;
+      }
+      if (p_core->wealth_markers[i].rows & (1u << (block/6)))
+      {
+         cost += i + 1;
+      }
+   }
+   return cost;
+}
+
+/*-----------------------------------------------------------------------------
+Move a marker with core_set_marker() or by assigning it.
+-----------------------------------------------------------------------------*/
+STATIC void bench_move(core_t* p_core, bench_move_t const* p_move,
+   bool_t table)
+{
+   prestige_wealth_marker_t* p_mrk = (p_move->wealth) ?
+      &p_core->wealth_markers[p_move->marker] :
+      &p_core->prestige_markers[p_move->marker];
+
+   if (table)
+   {
+      core_set_marker(p_core, p_move->wealth, p_move->marker, p_move->rows,
+         p_move->columns);
+   }
+   else
+   {
+      p_mrk->rows = p_move->rows;
+      p_mrk->columns = p_move->columns;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+\return FALSE if a block value is not the one of the markers
+-----------------------------------------------------------------------------*/
+STATIC bool_t bench_check(core_t* p_core)
+{
+   int i;
+
+   for (i=0;i<MAX_BOARD_BLOCKS;i++)
+   {
+      if ((int)p_core->board_blocks[i].value !=
+          bench_calc_block_value(p_core, i))
+      {
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+\return ns per operation
+-----------------------------------------------------------------------------*/
+STATIC double bench_ns(struct timespec const* p_t0,
+   struct timespec const* p_t1, int n)
+{
+   return ((p_t1->tv_sec - p_t0->tv_sec) * 1e9 +
+      (p_t1->tv_nsec - p_t0->tv_nsec)) / n;
+}
+
+/* END OF FILE ***************************************************************/
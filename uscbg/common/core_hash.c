@@ -0,0 +1,190 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_hash.c
+\brief Zobrist hashing implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include "slnk.h"
+#include "core.h"
+#include "core_hash.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define CORE_HASH_SEED (0x9e3779b97f4a7c15ull)
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static uint64_t core_hash_counters(const core_t* p_core);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+uint64_t core_hash_key(core_hash_kind_t kind, uint32_t a, uint32_t b)
+{ /* splitmix64 finalizer */
+   uint64_t z = ((uint64_t)kind << 56) ^ ((uint64_t)a << 32) ^ b;
+   z += CORE_HASH_SEED;
+   z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+   z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+   return z ^ (z >> 31);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+uint64_t core_hash_card(core_hash_kind_t kind, uint32_t a,
+   const card_t* p_card)
+{
+   if (p_card == NULL)
+   {
+      return 0;
+   }
+   return core_hash_key(kind, a, (p_card->deck << 8) | p_card->id);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+uint64_t core_hash_block(const core_t* p_core, int block)
+{
+   uint64_t h = 0;
+   int zone;
+   int owner;
+
+   if (BB_BLOCK(&p_core->lots_built, block) == 0)
+   {
+      return 0;
+   }
+   for (zone=0;zone<ZONE_LAST;zone++)
+   {
+      uint8_t z = BB_BLOCK(&p_core->lots_zone[zone], block);
+      if (z == 0)
+      {
+         continue;
+      }
+      for (owner=0;owner<=PLAYER_COLOR_LAST;owner++)
+      {
+         uint8_t lots = z & BB_BLOCK(&p_core->lots_owner[owner], block);
+         int i;
+         for (i=0;i<4;i++)
+         {
+            if (lots & (1u << i))
+            {
+               h ^= core_hash_key(CORE_HASH_LOT, block * 4 + i,
+                  zone * 8 + owner);
+            }
+         }
+      }
+   }
+   return h;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+uint64_t core_hash_marker(bool_t wealth, int marker, uint8_t rows,
+   uint8_t columns)
+{
+   uint64_t h = 0;
+   int m = marker + (wealth ? 6 : 0);
+   int i;
+
+   for (i=0;i<6;i++)
+   {
+      if (rows & (1u << i))
+      {
+         h ^= core_hash_key(CORE_HASH_MARKER, m, i);
+      }
+      if (columns & (1u << i))
+      {
+         h ^= core_hash_key(CORE_HASH_MARKER, m, i + 6);
+      }
+   }
+   return h;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+uint64_t core_hash(const core_t* p_core)
+{
+   return p_core->hash ^ core_hash_counters(p_core);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+uint64_t core_hash_full(const core_t* p_core)
+{
+   uint64_t h = 0;
+   player_t* p_player;
+   int i;
+
+   for (i=0;i<MAX_BOARD_BLOCKS;i++)
+   {
+      h ^= core_hash_block(p_core, i);
+   }
+   for (i=0;i<6;i++)
+   {
+      h ^= core_hash_marker(FALSE, i, p_core->prestige_markers[i].rows,
+         p_core->prestige_markers[i].columns);
+   }
+   for (i=0;i<12;i++)
+   {
+      h ^= core_hash_marker(TRUE, i, p_core->wealth_markers[i].rows,
+         p_core->wealth_markers[i].columns);
+   }
+   for (i=0;i<5;i++)
+   {
+      h ^= core_hash_card(CORE_HASH_BOARD_CARD, i,
+         p_core->board_planning_cards[i]);
+   }
+   for (i=0;i<8;i++)
+   {
+      h ^= core_hash_card(CORE_HASH_BOARD_CARD, 5 + i,
+         p_core->board_contract_cards[i]);
+   }
+   p_player = SLNK_NEXT(player_t, &p_core->players_head);
+   while (p_player != NULL)
+   {
+      int i;
+      for (i=0;i<p_player->cards.n;i++)
+      {
+         h ^= core_hash_card(CORE_HASH_HAND, p_player->id,
+            p_player->cards.p_cards[i]);
+      }
+      p_player = SLNK_NEXT(player_t, p_player);
+   }
+   return h ^ core_hash_counters(p_core);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Keys of phase, active player and player counters.
+-----------------------------------------------------------------------------*/
+static uint64_t core_hash_counters(const core_t* p_core)
+{
+   uint64_t h = core_hash_key(CORE_HASH_PHASE, p_core->state,
+      p_core->current_round);
+   player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
+
+   if (p_core->active_player != NULL)
+   {
+      h ^= core_hash_key(CORE_HASH_ACTIVE_PLAYER, p_core->active_player->id,
+         0);
+   }
+   while (p_player != NULL)
+   {
+      h ^= core_hash_key(CORE_HASH_AP, p_player->id, p_player->ap);
+      h ^= core_hash_key(CORE_HASH_WEALTH, p_player->id, p_player->wealth);
+      h ^= core_hash_key(CORE_HASH_PRESTIGE, p_player->id, p_player->prestige);
+      p_player = SLNK_NEXT(player_t, p_player);
+   }
+   return h;
+}
+
+/* END OF FILE ***************************************************************/
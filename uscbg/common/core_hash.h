@@ -0,0 +1,107 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_hash.h
+\brief Zobrist hashing of a game position.
+
+Every feature of a position has a 64-bit key and the hash is the XOR of the
+keys of the features present, so a change only XORs the old and new keys.
+Keys are derived from the feature with a fixed mixing function instead of a
+table, they are the same in every process and game.
+
+The core keeps core_t.hash up to date when it changes
+   - the buildings on a lot (zone, owner), core_board_block_update()
+   - marker rows and columns, core_set_marker()
+   - the board card slots, core_board_card_set()
+   - the cards in a hand (invest, take card, undo)
+The plain counters written all over the server (phase, active player and
+the ap, wealth and prestige of the players) are folded in by core_hash().
+The client does not keep core_t.hash, use core_hash_full() there. */
+/*---------------------------------------------------------------------------*/
+#ifndef CORE_HASH_H
+#define CORE_HASH_H
+/* INCLUDE FILES *************************************************************/
+#include "core.h"
+
+/* EXPORTED DEFINES **********************************************************/
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef enum
+{
+   CORE_HASH_LOT = 1,         /*!< a: lot, b: zone * 8 + owner */
+   CORE_HASH_MARKER,          /*!< a: marker (+ 6 wealth), b: row/6 + column */
+   CORE_HASH_BOARD_CARD,      /*!< a: slot (0-12), b: deck * 256 + id */
+   CORE_HASH_HAND,            /*!< a: player id, b: deck * 256 + id */
+   CORE_HASH_PHASE,           /*!< a: state, b: current round */
+   CORE_HASH_ACTIVE_PLAYER,   /*!< a: player id */
+   CORE_HASH_AP,              /*!< a: player id, b: ap */
+   CORE_HASH_WEALTH,          /*!< a: player id, b: wealth */
+   CORE_HASH_PRESTIGE,        /*!< a: player id, b: prestige */
+   CORE_HASH_LAST
+} core_hash_kind_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Key of a position feature.
+\return Key */
+/*---------------------------------------------------------------------------*/
+uint64_t core_hash_key(
+   core_hash_kind_t kind,     /*!< Feature */
+   uint32_t a,                /*!< First value, see core_hash_kind_t */
+   uint32_t b                 /*!< Second value */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Key of a card in a board slot or a hand.
+\return Key */
+/*---------------------------------------------------------------------------*/
+uint64_t core_hash_card(
+   core_hash_kind_t kind,     /*!< CORE_HASH_BOARD_CARD or CORE_HASH_HAND */
+   uint32_t a,                /*!< Slot or player id */
+   const card_t* p_card       /*!< Card (NULL = none, key 0) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Keys of the buildings on the lots of a block.
+\return XOR of the lot keys */
+/*---------------------------------------------------------------------------*/
+uint64_t core_hash_block(
+   const core_t* p_core,      /*!< Game instance */
+   int block                  /*!< Block */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Keys of the rows and columns of a marker.
+\return XOR of the line keys */
+/*---------------------------------------------------------------------------*/
+uint64_t core_hash_marker(
+   bool_t wealth,             /*!< Wealth marker/Prestige marker */
+   int marker,                /*!< Marker */
+   uint8_t rows,              /*!< Rows (bit n = row n) */
+   uint8_t columns            /*!< Columns (bit n = column n) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Hash of the position, core_t.hash with the counters folded in.
+\return Hash */
+/*---------------------------------------------------------------------------*/
+uint64_t core_hash(
+   const core_t* p_core       /*!< Game instance */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Hash of the position computed from scratch (same value as
+core_hash() when core_t.hash is kept).
+\return Hash */
+/*---------------------------------------------------------------------------*/
+uint64_t core_hash_full(
+   const core_t* p_core       /*!< Game instance */
+   );
+
+#endif /* #ifndef CORE_HASH_H */
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,379 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_move.c
+\brief Legal moves implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <string.h>
+#include "slnk.h"
+#include "core.h"
+#include "core_move.h"
+#include "core_hash.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define CORE_MOVE_ADD(t, a) \
+   if (n < max) \
+   { \
+      p_moves[n].type = (t); \
+      p_moves[n].arg = (a); \
+      n++; \
+   }
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static bool_t core_move_planning_card(const core_t* p_core, int i);
+static bool_t core_move_contract_card(const core_t* p_core, int i);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int core_gen_moves(const core_t* p_core, move_t* p_moves, int max)
+{
+   int n = 0;
+   int i;
+
+   REQUIRE(p_core != NULL);
+   REQUIRE((p_moves != NULL) || (max == 0));
+   if (p_core->active_player == NULL)
+   {
+      return 0;
+   }
+   switch (p_core->state)
+   {
+   case CORE_STATE_NONE:
+   { /* Color selection */
+      for (i=0;i<PLAYER_COLOR_LAST;i++)
+      {
+         if (p_core->available_colors & (1u << i))
+         {
+            CORE_MOVE_ADD(MOVE_COLOR, i);
+         }
+      }
+      break;
+   }
+   case CORE_STATE_SETUP:
+   { /* Free startup lots, one per block */
+      bitboard_t lots;
+      if (p_core->startup_buildings <= 0)
+      {
+         break;
+      }
+      bb_blocks(&lots, &p_core->lots_built);
+      bb_andnot(&lots, &core_startup_lots, &lots);
+      for (i = bb_next(&lots, 0); i >= 0; i = bb_next(&lots, i + 1))
+      {
+         CORE_MOVE_ADD(MOVE_BOARD_LOT, i);
+      }
+      break;
+   }
+   case CORE_STATE_INVESTMENTS:
+   { /* Planning cards in hand */
+      card_hand_t* p_hand = &p_core->active_player->cards;
+      int i;
+      for (i=0;i<p_hand->n;i++)
+      {
+         if (p_hand->p_cards[i]->deck == CARD_DECK_PLANNING)
+         {
+            CORE_MOVE_ADD(MOVE_PLAYER_CARD, p_hand->p_cards[i]->id);
+         }
+      }
+      CORE_MOVE_ADD(MOVE_DONE, 0);
+      break;
+   }
+   case CORE_STATE_ACTIONS:
+   { /* Only actions with a card the player can pay for */
+      for (i=0;i<5;i++)
+      {
+         if (core_move_planning_card(p_core, i))
+         {
+            CORE_MOVE_ADD(MOVE_ACTION, 0);
+            break;
+         }
+      }
+      for (i=0;i<8;i++)
+      {
+         if (core_move_contract_card(p_core, i))
+         {
+            CORE_MOVE_ADD(MOVE_ACTION, 1);
+            break;
+         }
+      }
+      CORE_MOVE_ADD(MOVE_DONE, 0);
+      break;
+   }
+   case CORE_STATE_ACTION_TAKE_CARD:
+   {
+      for (i=0;i<5;i++)
+      {
+         if (core_move_planning_card(p_core, i))
+         {
+            CORE_MOVE_ADD(MOVE_BOARD_CARD, i);
+         }
+      }
+      CORE_MOVE_ADD(MOVE_DONE, 0);
+      break;
+   }
+   case CORE_STATE_ACTION_BUILD:
+   {
+      for (i=0;i<8;i++)
+      {
+         if (core_move_contract_card(p_core, i))
+         {
+            CORE_MOVE_ADD(MOVE_BOARD_CARD, 5 + i);
+         }
+      }
+      break;
+   }
+   case CORE_STATE_ACTION_END_OF_TURN:
+      CORE_MOVE_ADD(MOVE_DONE, 0);
+      break;
+   default:
+      break;
+   }
+   return n;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t core_game_over(const core_t* p_core)
+{
+   player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
+   uint8_t cheapest = 0xff;
+   int i;
+
+   for (i=0;i<5;i++)
+   {
+      if (p_core->board_planning_cards[i] != NULL)
+      {
+         cheapest = MIN(cheapest, i + 1);
+      }
+   }
+   for (i=0;i<8;i++)
+   {
+      if (p_core->board_contract_cards[i] != NULL)
+      {
+         cheapest = MIN(cheapest, contract_cards_ap_cost[i]);
+      }
+   }
+   while (p_player != NULL)
+   {
+      int j;
+      if (p_player->ap >= cheapest)
+      {
+         return FALSE;
+      }
+      for (j=0;j<p_player->cards.n;j++)
+      {
+         if (p_player->cards.p_cards[j]->deck == CARD_DECK_PLANNING)
+         {
+            return FALSE;
+         }
+      }
+      p_player = SLNK_NEXT(player_t, p_player);
+   }
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_apply_move(core_t* p_core, const move_t* p_move,
+   core_undo_stack_t* p_undo)
+{
+   player_t* p_player = p_core->active_player;
+   core_undo_t rec;
+
+   REQUIRE(p_player != NULL);
+   REQUIRE(p_move->type < MOVE_LAST);
+   memset(&rec, 0, sizeof(rec));
+   rec.move = *p_move;
+   rec.state = p_core->state;
+   rec.card_selection = p_core->card_selection;
+   rec.action_selection = p_core->action_selection;
+   rec.available_colors = p_core->available_colors;
+   rec.color = p_player->color;
+   rec.ap = p_player->ap;
+   rec.wealth = p_player->wealth;
+   rec.startup_buildings = p_core->startup_buildings;
+   rec.p_player = p_player;
+   rec.current_contract_card = p_core->current_contract_card;
+   rec.rng = p_core->rng;
+   switch (p_move->type)
+   {
+   case MOVE_COLOR:
+      p_core->color_selection = p_move->arg;
+      core_select_color(p_core);
+      break;
+   case MOVE_BOARD_LOT:
+      p_core->board_lot_selection = p_move->arg;
+      core_action_build(p_core);
+      break;
+   case MOVE_PLAYER_CARD:
+      rec.hand_pos = cards_hand_find(&p_player->cards, CARD_DECK_PLANNING,
+         p_move->arg);
+      REQUIRE(rec.hand_pos >= 0);
+      rec.p_card = p_player->cards.p_cards[rec.hand_pos];
+      p_core->card_selection = p_move->arg;
+      core_invest(p_core);
+      break;
+   case MOVE_ACTION:
+      p_core->action_selection = p_move->arg;
+      break;
+   case MOVE_BOARD_CARD:
+      p_core->card_selection = p_move->arg;
+      if (p_core->state == CORE_STATE_ACTION_BUILD)
+      { /* Contract card to build, the building follows */
+         REQUIRE((p_move->arg >= 5) && (p_move->arg < MAX_BOARD_CARDS));
+         p_core->current_contract_card = (const card_contract_t*)
+            p_core->board_contract_cards[p_move->arg - 5];
+      }
+      else
+      {
+         rec.p_card = (p_move->arg < 5) ?
+            p_core->board_planning_cards[p_move->arg] :
+            p_core->board_contract_cards[p_move->arg - 5];
+         core_action_take_card(p_core);
+      }
+      break;
+   default:
+      break;
+   }
+   if (p_undo != NULL)
+   {
+      p_undo->rec[p_undo->top] = rec;
+      p_undo->top = (p_undo->top + 1) % CORE_MAX_UNDO;
+      if (p_undo->n < CORE_MAX_UNDO)
+      {
+         p_undo->n++;
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t core_undo_move(core_t* p_core, core_undo_stack_t* p_undo)
+{
+   core_undo_t* p_rec;
+   player_t* p_player;
+
+   if (p_undo->n == 0)
+   {
+      return FALSE;
+   }
+   p_undo->top = (p_undo->top + CORE_MAX_UNDO - 1) % CORE_MAX_UNDO;
+   p_undo->n--;
+   p_rec = &p_undo->rec[p_undo->top];
+   p_player = p_rec->p_player;
+   switch (p_rec->move.type)
+   {
+   case MOVE_COLOR:
+      p_player->color = p_rec->color;
+      p_core->available_colors = p_rec->available_colors;
+      core_dirty_player(p_core, p_player, PLAYER_DIRTY_COLOR);
+      break;
+   case MOVE_BOARD_LOT:
+   { /* The building is the last one of the block */
+      int block = p_rec->move.arg / 4;
+      block_t* p_blk = &p_core->board_blocks[block];
+      REQUIRE(p_blk->n_buildings > 0);
+      p_blk->n_buildings--;
+      memset(&p_blk->buildings[p_blk->n_buildings], 0, sizeof(building_t));
+      core_board_block_update(p_core, block);
+      core_dirty_block(p_core, p_blk, BLOCK_DIRTY_BUILDINGS);
+      p_player->wealth = p_rec->wealth;
+      core_dirty_player(p_core, p_player, PLAYER_DIRTY_WEALTH);
+      break;
+   }
+   case MOVE_PLAYER_CARD:
+      /* The last investment is on top of the discard pile */
+      REQUIRE(cards_pile_top(&p_core->planning_discard) == p_rec->p_card);
+      cards_pile_draw(&p_core->planning_discard);
+      cards_hand_insert(&p_player->cards, p_rec->hand_pos, p_rec->p_card);
+      p_core->hash ^= core_hash_card(CORE_HASH_HAND, p_player->id,
+         p_rec->p_card);
+      p_player->wealth = p_rec->wealth;
+      core_dirty_player(p_core, p_player,
+         PLAYER_DIRTY_WEALTH | PLAYER_DIRTY_CARDS);
+      break;
+   case MOVE_BOARD_CARD:
+      if (p_rec->p_card != NULL)
+      { /* Card taken, back to the board */
+         /* The taken card is the last one in hand */
+         REQUIRE(p_player->cards.n > 0);
+         REQUIRE(p_player->cards.p_cards[p_player->cards.n - 1] ==
+            p_rec->p_card);
+         cards_hand_remove(&p_player->cards, p_player->cards.n - 1);
+         p_core->hash ^= core_hash_card(CORE_HASH_HAND, p_player->id,
+            p_rec->p_card);
+         core_board_card_set(p_core, p_rec->move.arg, p_rec->p_card);
+         p_player->ap = p_rec->ap;
+         core_dirty(p_core, CORE_DIRTY_BOARD_CARDS);
+         core_dirty_player(p_core, p_player,
+            PLAYER_DIRTY_AP | PLAYER_DIRTY_CARDS);
+      }
+      p_core->current_contract_card = p_rec->current_contract_card;
+      break;
+   default:
+      break;
+   }
+   p_core->card_selection = p_rec->card_selection;
+   p_core->action_selection = p_rec->action_selection;
+   p_core->startup_buildings = p_rec->startup_buildings;
+   p_core->rng = p_rec->rng;
+   if ((p_core->state != p_rec->state) || (p_core->active_player != p_player))
+   {
+      p_core->state = p_rec->state;
+      p_core->active_player = p_player;
+      core_dirty(p_core, CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER);
+   }
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+const move_t* core_undo_last(const core_undo_stack_t* p_undo)
+{
+   if (p_undo->n == 0)
+   {
+      return NULL;
+   }
+   return &p_undo->rec[(p_undo->top + CORE_MAX_UNDO - 1) % CORE_MAX_UNDO].move;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_undo_clear(core_undo_stack_t* p_undo)
+{
+   p_undo->top = 0;
+   p_undo->n = 0;
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Planning card i is on the board and costs i + 1 ap.
+-----------------------------------------------------------------------------*/
+static bool_t core_move_planning_card(const core_t* p_core, int i)
+{
+   return (p_core->board_planning_cards[i] != NULL) &&
+      (p_core->active_player->ap >= (i + 1));
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static bool_t core_move_contract_card(const core_t* p_core, int i)
+{
+   return (p_core->board_contract_cards[i] != NULL) &&
+      (p_core->active_player->ap >= contract_cards_ap_cost[i]);
+}
+
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,139 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_move.h
+\brief Legal moves of the active player.
+
+A move is one selection the server accepts from the active player in the
+current core state, the same selections the clients send as net commands:
+   CORE_STATE_NONE              MOVE_COLOR (color)
+   CORE_STATE_SETUP             MOVE_BOARD_LOT (lot)
+   CORE_STATE_INVESTMENTS       MOVE_PLAYER_CARD (planning card id), MOVE_DONE
+   CORE_STATE_ACTIONS           MOVE_ACTION (0 = take card, 1 = build),
+                                MOVE_DONE
+   CORE_STATE_ACTION_TAKE_CARD  MOVE_BOARD_CARD (0-4), MOVE_DONE
+   CORE_STATE_ACTION_BUILD      MOVE_BOARD_CARD (5-12)
+   CORE_STATE_ACTION_END_OF_TURN MOVE_DONE
+
+core_apply_move() plays a move with the core functions the server uses and
+pushes what it changed on an undo stack. core_undo_move() restores the game
+from the top record, so moves can be taken back in reverse order without
+copying the game. A record also holds state, active player, startup
+buildings and the random number generator (color pick) as they were before
+the move; the caller may change those after
+core_apply_move() (next phase, next player) and the undo restores them. Log
+entries already broadcast are not taken back. */
+/*---------------------------------------------------------------------------*/
+#ifndef CORE_MOVE_H
+#define CORE_MOVE_H
+/* INCLUDE FILES *************************************************************/
+#include "core.h"
+
+/* EXPORTED DEFINES **********************************************************/
+#define CORE_MAX_MOVES (MAX_BOARD_LOTS) /* More than any state has */
+#define CORE_MAX_UNDO (128)             /* Oldest records are overwritten */
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef enum
+{
+   MOVE_COLOR = 0,         /*!< arg: player color */
+   MOVE_BOARD_LOT,         /*!< arg: lot (block * 4 + position) */
+   MOVE_PLAYER_CARD,       /*!< arg: card id in hand */
+   MOVE_ACTION,            /*!< arg: action */
+   MOVE_BOARD_CARD,        /*!< arg: board card (0-4 planning, 5-12 contract) */
+   MOVE_DONE,              /*!< arg: 0 */
+   MOVE_LAST
+} move_type_t;
+
+typedef struct
+{
+   uint8_t type;           /*!< move_type_t */
+   uint8_t arg;
+} move_t;
+
+typedef struct
+{
+   move_t move;
+   uint8_t state;
+   uint8_t card_selection;
+   uint8_t action_selection;
+   uint8_t available_colors;
+   uint8_t color;             /*!< Player color before the move */
+   uint8_t ap;                /*!< Player ap before the move */
+   uint32_t wealth;           /*!< Player wealth before the move */
+   int startup_buildings;
+   player_t* p_player;        /*!< Active player */
+   const card_t* p_card;      /*!< Card moved by the move */
+   int hand_pos;              /*!< Position of p_card in hand (invest) */
+   const card_contract_t* current_contract_card;
+   core_rng_t rng;            /*!< Generator before the move */
+} core_undo_t;
+
+typedef struct
+{
+   core_undo_t rec[CORE_MAX_UNDO];
+   int top;                   /*!< Next free record */
+   int n;                     /*!< Number of records */
+} core_undo_stack_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Generate the legal moves of the active player. The game is not
+changed.
+\return Number of moves (at most max) */
+/*---------------------------------------------------------------------------*/
+int core_gen_moves(
+   const core_t* p_core,   /*!< Game instance */
+   move_t* p_moves,        /*!< Moves */
+   int max                 /*!< Size of p_moves, CORE_MAX_MOVES is enough */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Check if no player has a move left but MOVE_DONE: no planning card
+in hand to invest and not enough ap for any board card.
+\return TRUE if the game is over */
+/*---------------------------------------------------------------------------*/
+bool_t core_game_over(
+   const core_t* p_core    /*!< Game instance */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Play a legal move (see core_gen_moves) of the active player. */
+/*---------------------------------------------------------------------------*/
+void core_apply_move(
+   core_t* p_core,            /*!< Game instance */
+   const move_t* p_move,      /*!< Move */
+   core_undo_stack_t* p_undo  /*!< Undo stack (NULL = no undo) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Take back the last move on the undo stack.
+\return FALSE if the stack is empty */
+/*---------------------------------------------------------------------------*/
+bool_t core_undo_move(
+   core_t* p_core,            /*!< Game instance */
+   core_undo_stack_t* p_undo  /*!< Undo stack */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Get the last move on the undo stack.
+\return Move or NULL if the stack is empty */
+/*---------------------------------------------------------------------------*/
+const move_t* core_undo_last(
+   const core_undo_stack_t* p_undo  /*!< Undo stack */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Empty the undo stack. */
+/*---------------------------------------------------------------------------*/
+void core_undo_clear(
+   core_undo_stack_t* p_undo  /*!< Undo stack */
+   );
+
+#endif /* #ifndef CORE_MOVE_H */
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,92 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_rng.c
+\brief Game random numbers implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include "core_rng.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define CORE_RNG_ROTL(x, k) (((x) << (k)) | ((x) >> (32 - (k))))
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static uint64_t core_rng_splitmix(uint64_t* p_x);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+The state is filled with splitmix64, it is never all zero.
+-----------------------------------------------------------------------------*/
+void core_rng_seed(core_rng_t* p_rng, uint64_t seed)
+{
+   uint64_t z = core_rng_splitmix(&seed);
+   p_rng->s[0] = (uint32_t)z;
+   p_rng->s[1] = (uint32_t)(z >> 32);
+   z = core_rng_splitmix(&seed);
+   p_rng->s[2] = (uint32_t)z;
+   p_rng->s[3] = (uint32_t)(z >> 32);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+uint32_t core_rng_next(core_rng_t* p_rng)
+{
+   uint32_t* s = p_rng->s;
+   uint32_t r = CORE_RNG_ROTL(s[1] * 5, 7) * 9;
+   uint32_t t = s[1] << 9;
+
+   s[2] ^= s[0];
+   s[3] ^= s[1];
+   s[1] ^= s[2];
+   s[0] ^= s[3];
+   s[2] ^= t;
+   s[3] = CORE_RNG_ROTL(s[3], 11);
+   return r;
+}
+
+/*-----------------------------------------------------------------------------
+Multiply and shift (Lemire), numbers in the biased low range are drawn again.
+-----------------------------------------------------------------------------*/
+uint32_t core_rng_below(core_rng_t* p_rng, uint32_t n)
+{
+   uint64_t m;
+   uint32_t low;
+
+   REQUIRE(n > 0);
+   m = (uint64_t)core_rng_next(p_rng) * n;
+   low = (uint32_t)m;
+   if (low < n)
+   {
+      uint32_t threshold = (0u - n) % n;
+      while (low < threshold)
+      {
+         m = (uint64_t)core_rng_next(p_rng) * n;
+         low = (uint32_t)m;
+      }
+   }
+   return (uint32_t)(m >> 32);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static uint64_t core_rng_splitmix(uint64_t* p_x)
+{
+   uint64_t z = (*p_x += 0x9e3779b97f4a7c15ull);
+   z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+   z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+   return z ^ (z >> 31);
+}
+
+/* END OF FILE ***************************************************************/
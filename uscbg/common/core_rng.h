@@ -0,0 +1,55 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_rng.h
+\brief Random numbers of a game (xoshiro128**).
+
+Every game has its own generator in core_t, all chance in the game (deck
+shuffles, random color) is drawn from it. The same seed and the same moves
+give the same game, and games on different threads share no state. */
+/*---------------------------------------------------------------------------*/
+#ifndef CORE_RNG_H
+#define CORE_RNG_H
+/* INCLUDE FILES *************************************************************/
+
+/* EXPORTED DEFINES **********************************************************/
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef struct
+{
+   uint32_t s[4];
+} core_rng_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Seed a generator. Any seed (also 0) gives a valid state. */
+/*---------------------------------------------------------------------------*/
+void core_rng_seed(
+   core_rng_t* p_rng,   /*!< Generator */
+   uint64_t seed        /*!< Seed */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Next random number.
+\return 32 random bits */
+/*---------------------------------------------------------------------------*/
+uint32_t core_rng_next(
+   core_rng_t* p_rng    /*!< Generator */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Random number below n, without modulo bias.
+\return 0 to n - 1 */
+/*---------------------------------------------------------------------------*/
+uint32_t core_rng_below(
+   core_rng_t* p_rng,   /*!< Generator */
+   uint32_t n           /*!< Range (> 0) */
+   );
+
+#endif /* #ifndef CORE_RNG_H */
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,492 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_sync.c
+\brief Game state synchronisation implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <string.h>
+#include "slnk.h"
+#include "trc.h"
+#include "net_us.h"
+#include "core.h"
+#include "core_sync.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+/* Max encoded sizes, the packet size is checked once before encoding */
+#define CORE_SYNC_CARD_SZ (2)
+#define CORE_SYNC_HDR_SZ (2 + 4 + 1 + 1 + 2 + 4 + (5 + 8) * CORE_SYNC_CARD_SZ +\
+   1 + 1)
+#define CORE_SYNC_PLAYER_SZ (4 + 1 + 3 + 3*4 + 1 +\
+   CARDS_MAX_HAND * CORE_SYNC_CARD_SZ)
+#define CORE_SYNC_BLOCK_SZ (1 + 1 + 1 + 16 + 4)
+
+/* Decoder bounds check */
+#define CORE_SYNC_NEED(n) \
+   if (pos + (n) > len) \
+   { \
+      return -1; \
+   }
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static int core_sync_put_u32(uint8_t* p_buf, uint32_t value);
+static uint32_t core_sync_get_u32(const uint8_t* p_buf);
+static int core_sync_put_card(uint8_t* p_buf, const card_t* p_card);
+static const card_t* core_sync_get_card(const uint8_t* p_buf);
+static int core_sync_encode_player(player_t* p_player, uint8_t* p_buf,
+   uint8_t bits);
+static int core_sync_encode_block(block_t* p_blk, uint8_t* p_buf,
+   uint8_t bits);
+static int core_sync_player_cards(player_t* p_player,
+   const uint8_t* p_hand);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_ASSERT_FILE;
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+TRC_DEF(core_sync);
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_sync_init(void)
+{
+   TRC_REG(core_sync, TRC_ERROR);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t core_sync_pending(core_t* p_core)
+{
+   return (p_core->dirty != 0);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int core_sync_encode(core_t* p_core, uint8_t* p_buf, int size, bool_t full)
+{
+   uint8_t core_bits = (full)?(CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER |
+      CORE_DIRTY_BOARD_CARDS):(p_core->dirty);
+   player_t* p_player;
+   int n_players = 0;
+   int n_blocks = 0;
+   int pos;
+   int n_pos;
+   int i;
+
+   if (size < CORE_SYNC_HDR_SZ + p_core->n_players * CORE_SYNC_PLAYER_SZ +
+      MAX_BOARD_BLOCKS * CORE_SYNC_BLOCK_SZ)
+   {
+      return -1;
+   }
+   p_buf[0] = NET_CMD_SERVER_STATE_SYNC >> 8;
+   p_buf[1] = NET_CMD_SERVER_STATE_SYNC & 0xff;
+   pos = 2;
+   pos += core_sync_put_u32(&p_buf[pos],
+      (full)?p_core->version:p_core->version + 1);
+   p_buf[pos++] = (full)?CORE_SYNC_FULL:0;
+   p_buf[pos++] = core_bits & (CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER |
+      CORE_DIRTY_BOARD_CARDS);
+   if (core_bits & CORE_DIRTY_PHASE)
+   {
+      p_buf[pos++] = p_core->current_round;
+      p_buf[pos++] = p_core->state;
+   }
+   if (core_bits & CORE_DIRTY_ACTIVE_PLAYER)
+   {
+      pos += core_sync_put_u32(&p_buf[pos],
+         (p_core->active_player)?p_core->active_player->id:0);
+   }
+   if (core_bits & CORE_DIRTY_BOARD_CARDS)
+   {
+      for (i=0;i<5;i++)
+      {
+         pos += core_sync_put_card(&p_buf[pos],
+            p_core->board_planning_cards[i]);
+      }
+      for (i=0;i<8;i++)
+      {
+         pos += core_sync_put_card(&p_buf[pos],
+            p_core->board_contract_cards[i]);
+      }
+   }
+   /* Players */
+   n_pos = pos++;
+   if (full || (p_core->dirty & CORE_DIRTY_PLAYERS))
+   {
+      p_player = SLNK_NEXT(player_t, &p_core->players_head);
+      while(p_player != NULL)
+      {
+         uint8_t bits = (full)?PLAYER_DIRTY_ALL:p_player->dirty;
+         if (bits != 0)
+         {
+            pos += core_sync_encode_player(p_player, &p_buf[pos], bits);
+            n_players++;
+         }
+         p_player = SLNK_NEXT(player_t, p_player);
+      }
+   }
+   p_buf[n_pos] = n_players;
+   /* Blocks, a snapshot leaves out the empty ones */
+   n_pos = pos++;
+   if (full || (p_core->dirty & CORE_DIRTY_BLOCKS))
+   {
+      for (i=0;i<MAX_BOARD_BLOCKS;i++)
+      {
+         block_t* p_blk = &p_core->board_blocks[i];
+         uint8_t bits = p_blk->dirty;
+         if (full && ((p_blk->n_buildings > 0) || (p_blk->value > 0)))
+         {
+            bits = BLOCK_DIRTY_ALL;
+         }
+         else if (full)
+         {
+            bits = 0;
+         }
+         if (bits != 0)
+         {
+            pos += core_sync_encode_block(p_blk, &p_buf[pos], bits);
+            n_blocks++;
+         }
+      }
+   }
+   p_buf[n_pos] = n_blocks;
+   return pos;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_sync_clear(core_t* p_core)
+{
+   if (p_core->dirty & CORE_DIRTY_PLAYERS)
+   {
+      player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
+      while(p_player != NULL)
+      {
+         p_player->dirty = 0;
+         p_player = SLNK_NEXT(player_t, p_player);
+      }
+   }
+   if (p_core->dirty & CORE_DIRTY_BLOCKS)
+   {
+      int i;
+      for (i=0;i<MAX_BOARD_BLOCKS;i++)
+      {
+         p_core->board_blocks[i].dirty = 0;
+      }
+   }
+   p_core->dirty = 0;
+   p_core->version++;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int core_sync_decode(core_t* p_core, const uint8_t* p_buf, int len,
+   uint8_t* p_changed)
+{
+   uint32_t version;
+   uint8_t flags;
+   uint8_t core_bits;
+   int n;
+   int pos = 2;
+   int i;
+
+   *p_changed = 0;
+   CORE_SYNC_NEED(4 + 1 + 1);
+   if (((p_buf[0] << 8) | p_buf[1]) != NET_CMD_SERVER_STATE_SYNC)
+   {
+      return -1;
+   }
+   version = core_sync_get_u32(&p_buf[pos]);
+   pos += 4;
+   flags = p_buf[pos++];
+   core_bits = p_buf[pos++];
+   if (!(flags & CORE_SYNC_FULL) && (p_core->version != 0) &&
+       (version != p_core->version + 1))
+   {
+      TRC_ERR(core_sync, "State version %u after %u", version,
+         p_core->version);
+   }
+   p_core->version = version;
+   if (core_bits & CORE_DIRTY_PHASE)
+   {
+      CORE_SYNC_NEED(2);
+      p_core->current_round = p_buf[pos++];
+      p_core->state = p_buf[pos++];
+   }
+   if (core_bits & CORE_DIRTY_ACTIVE_PLAYER)
+   {
+      uint32_t id;
+      CORE_SYNC_NEED(4);
+      id = core_sync_get_u32(&p_buf[pos]);
+      pos += 4;
+      p_core->active_player = (id != 0)?core_find_player(p_core, id):NULL;
+   }
+   if (core_bits & CORE_DIRTY_BOARD_CARDS)
+   {
+      CORE_SYNC_NEED((5 + 8) * CORE_SYNC_CARD_SZ);
+      for (i=0;i<5;i++)
+      {
+         p_core->board_planning_cards[i] = core_sync_get_card(&p_buf[pos]);
+         pos += CORE_SYNC_CARD_SZ;
+      }
+      for (i=0;i<8;i++)
+      {
+         p_core->board_contract_cards[i] = core_sync_get_card(&p_buf[pos]);
+         pos += CORE_SYNC_CARD_SZ;
+      }
+   }
+   *p_changed |= core_bits;
+   /* Players */
+   CORE_SYNC_NEED(1);
+   n = p_buf[pos++];
+   while (n-- > 0)
+   {
+      player_t* p_player;
+      player_t dummy;
+      uint8_t bits;
+      CORE_SYNC_NEED(4 + 1);
+      p_player = core_find_player(p_core, core_sync_get_u32(&p_buf[pos]));
+      pos += 4;
+      bits = p_buf[pos++];
+      if (p_player == NULL)
+      { /* Not (yet) known here, parse only */
+         p_player = &dummy;
+      }
+      if (bits & PLAYER_DIRTY_COLOR)
+      {
+         CORE_SYNC_NEED(1);
+         p_player->color = p_buf[pos++];
+      }
+      if (bits & PLAYER_DIRTY_AP)
+      {
+         CORE_SYNC_NEED(1);
+         p_player->ap = p_buf[pos++];
+      }
+      if (bits & PLAYER_DIRTY_POLITICIANS)
+      {
+         CORE_SYNC_NEED(1);
+         p_player->politicians = p_buf[pos++];
+      }
+      if (bits & PLAYER_DIRTY_VOCATIONS)
+      {
+         CORE_SYNC_NEED(4);
+         p_player->vocations = core_sync_get_u32(&p_buf[pos]);
+         pos += 4;
+      }
+      if (bits & PLAYER_DIRTY_WEALTH)
+      {
+         CORE_SYNC_NEED(4);
+         p_player->wealth = core_sync_get_u32(&p_buf[pos]);
+         pos += 4;
+      }
+      if (bits & PLAYER_DIRTY_PRESTIGE)
+      {
+         CORE_SYNC_NEED(4);
+         p_player->prestige = core_sync_get_u32(&p_buf[pos]);
+         pos += 4;
+      }
+      if (bits & PLAYER_DIRTY_CARDS)
+      {
+         CORE_SYNC_NEED(1);
+         if (p_buf[pos] > CARDS_MAX_HAND)
+         {
+            return -1;
+         }
+         CORE_SYNC_NEED(1 + p_buf[pos] * CORE_SYNC_CARD_SZ);
+         if (core_sync_player_cards(p_player, &p_buf[pos]) < 0)
+         {
+            TRC_ERR(core_sync, "Unknown card in state version %u", version);
+            return -1;
+         }
+         pos += 1 + p_buf[pos] * CORE_SYNC_CARD_SZ;
+      }
+      if (p_player != &dummy)
+      {
+         *p_changed |= CORE_DIRTY_PLAYERS;
+      }
+   }
+   /* Blocks */
+   CORE_SYNC_NEED(1);
+   n = p_buf[pos++];
+   while (n-- > 0)
+   {
+      block_t* p_blk;
+      uint8_t bits;
+      CORE_SYNC_NEED(1 + 1);
+      if (p_buf[pos] >= MAX_BOARD_BLOCKS)
+      {
+         return -1;
+      }
+      p_blk = &p_core->board_blocks[p_buf[pos++]];
+      bits = p_buf[pos++];
+      if (bits & BLOCK_DIRTY_BUILDINGS)
+      {
+         CORE_SYNC_NEED(1 + 16);
+         p_blk->n_buildings = p_buf[pos++];
+         for (i=0;i<4;i++)
+         {
+            p_blk->buildings[i].zone = p_buf[pos++];
+            p_blk->buildings[i].size = p_buf[pos++];
+            p_blk->buildings[i].owner = p_buf[pos++];
+            p_blk->buildings[i].block_pos = p_buf[pos++];
+         }
+         core_board_block_update(p_core, p_blk->id);
+      }
+      if (bits & BLOCK_DIRTY_VALUE)
+      {
+         CORE_SYNC_NEED(4);
+         p_blk->value = core_sync_get_u32(&p_buf[pos]);
+         pos += 4;
+      }
+      *p_changed |= CORE_DIRTY_BLOCKS;
+   }
+   return pos;
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static int core_sync_put_u32(uint8_t* p_buf, uint32_t value)
+{
+   p_buf[0] = (uint8_t)(value);
+   p_buf[1] = (uint8_t)(value >> 8);
+   p_buf[2] = (uint8_t)(value >> 16);
+   p_buf[3] = (uint8_t)(value >> 24);
+   return 4;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static uint32_t core_sync_get_u32(const uint8_t* p_buf)
+{
+   return (uint32_t)p_buf[0] | ((uint32_t)p_buf[1] << 8) |
+      ((uint32_t)p_buf[2] << 16) | ((uint32_t)p_buf[3] << 24);
+}
+
+/*-----------------------------------------------------------------------------
+A card is its deck and its id, id 0 for none.
+-----------------------------------------------------------------------------*/
+static int core_sync_put_card(uint8_t* p_buf, const card_t* p_card)
+{
+   p_buf[0] = (p_card)?p_card->deck:0;
+   p_buf[1] = (p_card)?p_card->id:0;
+   return CORE_SYNC_CARD_SZ;
+}
+
+/*-----------------------------------------------------------------------------
+\return The card from the catalog, NULL for none or an unknown card
+-----------------------------------------------------------------------------*/
+static const card_t* core_sync_get_card(const uint8_t* p_buf)
+{
+   return (p_buf[1] > 0)?cards_get((card_deck_t)p_buf[0], p_buf[1]):NULL;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static int core_sync_encode_player(player_t* p_player, uint8_t* p_buf,
+   uint8_t bits)
+{
+   int pos = 0;
+   pos += core_sync_put_u32(&p_buf[pos], p_player->id);
+   p_buf[pos++] = bits;
+   if (bits & PLAYER_DIRTY_COLOR)
+   {
+      p_buf[pos++] = p_player->color;
+   }
+   if (bits & PLAYER_DIRTY_AP)
+   {
+      p_buf[pos++] = p_player->ap;
+   }
+   if (bits & PLAYER_DIRTY_POLITICIANS)
+   {
+      p_buf[pos++] = p_player->politicians;
+   }
+   if (bits & PLAYER_DIRTY_VOCATIONS)
+   {
+      pos += core_sync_put_u32(&p_buf[pos], p_player->vocations);
+   }
+   if (bits & PLAYER_DIRTY_WEALTH)
+   {
+      pos += core_sync_put_u32(&p_buf[pos], p_player->wealth);
+   }
+   if (bits & PLAYER_DIRTY_PRESTIGE)
+   {
+      pos += core_sync_put_u32(&p_buf[pos], p_player->prestige);
+   }
+   if (bits & PLAYER_DIRTY_CARDS)
+   {
+      int i;
+      p_buf[pos++] = p_player->cards.n;
+      for (i=0;i<p_player->cards.n;i++)
+      {
+         pos += core_sync_put_card(&p_buf[pos], p_player->cards.p_cards[i]);
+      }
+   }
+   return pos;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static int core_sync_encode_block(block_t* p_blk, uint8_t* p_buf,
+   uint8_t bits)
+{
+   int pos = 0;
+   int i;
+   p_buf[pos++] = p_blk->id;
+   p_buf[pos++] = bits;
+   if (bits & BLOCK_DIRTY_BUILDINGS)
+   {
+      p_buf[pos++] = p_blk->n_buildings;
+      for (i=0;i<4;i++)
+      {
+         p_buf[pos++] = p_blk->buildings[i].zone;
+         p_buf[pos++] = p_blk->buildings[i].size;
+         p_buf[pos++] = p_blk->buildings[i].owner;
+         p_buf[pos++] = p_blk->buildings[i].block_pos;
+      }
+   }
+   if (bits & BLOCK_DIRTY_VALUE)
+   {
+      pos += core_sync_put_u32(&p_buf[pos], p_blk->value);
+   }
+   return pos;
+}
+
+/*-----------------------------------------------------------------------------
+Replace the cards of a player by the hand (U8 n, n cards). The cards are looked
+up in the card catalog, the piles of the receiving game are not kept. The ids
+come from the network, the cards are left unchanged if one of them is not in
+the catalog.
+\return 0 or -1 if an id is unknown
+-----------------------------------------------------------------------------*/
+static int core_sync_player_cards(player_t* p_player,
+   const uint8_t* p_hand)
+{
+   int n = p_hand[0];
+   int i;
+   for (i=0;i<n;i++)
+   {
+      if (core_sync_get_card(&p_hand[1 + i * CORE_SYNC_CARD_SZ]) == NULL)
+      {
+         return -1;
+      }
+   }
+   p_player->cards.n = 0;
+   for (i=0;i<n;i++)
+   {
+      cards_hand_add(&p_player->cards,
+         core_sync_get_card(&p_hand[1 + i * CORE_SYNC_CARD_SZ]));
+   }
+   return 0;
+}
+
+/* END OF FILE ***************************************************************/
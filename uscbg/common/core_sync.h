@@ -0,0 +1,90 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_sync.h
+\brief Game state synchronisation, server to clients.
+
+The core marks changed fields dirty (core_dirty*). When a game event is
+handled the server encodes the dirty fields once into a state sync packet
+(a delta) and sends it to all players. A player joining late gets a full
+snapshot of the same format.
+
+Packet (U8, U32 little endian as in net_us.h):
+   U16  NET_CMD_SERVER_STATE_SYNC, big endian
+   U32  version, one more per delta
+   U8   flags, CORE_SYNC_FULL
+   U8   CORE_DIRTY_* bits, then present fields in bit order
+        PHASE          U8 current_round, U8 state
+        ACTIVE_PLAYER  U32 id, 0 = none
+        BOARD_CARDS    card x 5 planning, card x 8 contract
+   U8   number of players, per player
+        U32 id, U8 PLAYER_DIRTY_* bits, then present fields in bit order
+        COLOR U8, AP U8, POLITICIANS U8, VOCATIONS U32, WEALTH U32,
+        PRESTIGE U32, CARDS U8 n, card x n (the whole hand)
+   U8   number of blocks, per block
+        U8 id, U8 BLOCK_DIRTY_* bits, then present fields in bit order
+        BUILDINGS U8 n_buildings, U8 x 16 zone, size, owner, block_pos x 4
+        VALUE U32
+   card U8 card_deck_t, U8 id, id 0 = none */
+/*---------------------------------------------------------------------------*/
+#ifndef CORE_SYNC_H
+#define CORE_SYNC_H
+/* INCLUDE FILES *************************************************************/
+#include "core.h"
+
+/* EXPORTED DEFINES **********************************************************/
+#define CORE_SYNC_FULL (BIT(0)) /* Snapshot, not a delta */
+
+/* EXPORTED DATA TYPES *******************************************************/
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize. */
+/*---------------------------------------------------------------------------*/
+void core_sync_init(void);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Check for state changes not yet sent. */
+/*---------------------------------------------------------------------------*/
+bool_t core_sync_pending(
+   core_t* p_core       /*!< Game instance */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Encode the dirty state (delta) or all state (snapshot) of a game.
+The dirty marks are kept, see core_sync_clear.
+\return Packet length or -1 if it does not fit in size */
+/*---------------------------------------------------------------------------*/
+int core_sync_encode(
+   core_t* p_core,      /*!< Game instance */
+   uint8_t* p_buf,      /*!< Packet */
+   int size,            /*!< Size of p_buf */
+   bool_t full          /*!< Snapshot/Delta */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Clear the dirty marks of a game after a delta has been sent. */
+/*---------------------------------------------------------------------------*/
+void core_sync_clear(
+   core_t* p_core       /*!< Game instance */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Apply a state sync packet to a game. Players not in the game are
+skipped. Changed parts are returned as CORE_DIRTY_* bits.
+\return Packet length used or -1 if the packet is malformed */
+/*---------------------------------------------------------------------------*/
+int core_sync_decode(
+   core_t* p_core,      /*!< Game instance */
+   const uint8_t* p_buf, /*!< Packet */
+   int len,             /*!< Packet length */
+   uint8_t* p_changed   /*!< CORE_DIRTY_* of the applied changes */
+   );
+
+#endif /* #ifndef CORE_SYNC_H */
+/* END OF FILE ***************************************************************/
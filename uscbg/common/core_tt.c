@@ -0,0 +1,80 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_tt.c
+\brief Transposition table implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdlib.h>
+#include <string.h>
+#include "core_tt.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_tt_init(core_tt_t* p_tt, uint32_t n_entries)
+{
+   REQUIRE((n_entries > 1) && ((n_entries & (n_entries - 1)) == 0));
+   p_tt->p_entries = (core_tt_entry_t*)malloc(
+      n_entries * sizeof(core_tt_entry_t));
+   REQUIRE(p_tt->p_entries != NULL);
+   p_tt->mask = n_entries - 1;
+   core_tt_clear(p_tt);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_tt_free(core_tt_t* p_tt)
+{
+   free(p_tt->p_entries);
+   p_tt->p_entries = NULL;
+}
+
+/*-----------------------------------------------------------------------------
+An empty entry is all zero (only a store of data 0 for hash 0 looks the same).
+-----------------------------------------------------------------------------*/
+void core_tt_clear(core_tt_t* p_tt)
+{
+   memset(p_tt->p_entries, 0, (p_tt->mask + 1) * sizeof(core_tt_entry_t));
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void core_tt_store(core_tt_t* p_tt, uint64_t hash, uint64_t data)
+{
+   core_tt_entry_t* p_e = &p_tt->p_entries[hash & p_tt->mask];
+   __atomic_store_n(&p_e->check, hash ^ data, __ATOMIC_RELAXED);
+   __atomic_store_n(&p_e->data, data, __ATOMIC_RELAXED);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t core_tt_probe(const core_tt_t* p_tt, uint64_t hash, uint64_t* p_data)
+{
+   const core_tt_entry_t* p_e = &p_tt->p_entries[hash & p_tt->mask];
+   uint64_t check = __atomic_load_n(&p_e->check, __ATOMIC_RELAXED);
+   uint64_t data = __atomic_load_n(&p_e->data, __ATOMIC_RELAXED);
+   if (((check ^ data) != hash) || ((check | data) == 0))
+   {
+      return FALSE;
+   }
+   *p_data = data;
+   return TRUE;
+}
+
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,81 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file core_tt.h
+\brief Transposition table keyed by core_hash().
+Fixed number of entries (power of 2), one entry per hash index, a store
+always replaces. Lock-free for any number of threads: an entry holds the
+data and hash ^ data, written and read as two relaxed 64-bit atomics. A torn
+entry (two threads storing at once) fails the check and is a miss, so a
+probe never returns data of another position (R. Hyatt's lockless hashing).
+The data is the caller's, e.g. score, depth and best move packed in 64 bits.
+*/
+/*---------------------------------------------------------------------------*/
+#ifndef CORE_TT_H
+#define CORE_TT_H
+/* INCLUDE FILES *************************************************************/
+
+/* EXPORTED DEFINES **********************************************************/
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef struct
+{
+   uint64_t check;            /*!< hash ^ data */
+   uint64_t data;
+} core_tt_entry_t;
+
+typedef struct
+{
+   core_tt_entry_t* p_entries;
+   uint64_t mask;             /*!< Number of entries - 1 */
+} core_tt_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize table and allocate all entries (empty). */
+/*---------------------------------------------------------------------------*/
+void core_tt_init(
+   core_tt_t* p_tt,           /*!< Table */
+   uint32_t n_entries         /*!< Number of entries (power of 2) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Free entry memory. */
+/*---------------------------------------------------------------------------*/
+void core_tt_free(
+   core_tt_t* p_tt            /*!< Table */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Empty all entries (not while other threads use the table). */
+/*---------------------------------------------------------------------------*/
+void core_tt_clear(
+   core_tt_t* p_tt            /*!< Table */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Store data of a position. */
+/*---------------------------------------------------------------------------*/
+void core_tt_store(
+   core_tt_t* p_tt,           /*!< Table */
+   uint64_t hash,             /*!< Position hash */
+   uint64_t data              /*!< Data */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Look up data of a position.
+\return TRUE if found */
+/*---------------------------------------------------------------------------*/
+bool_t core_tt_probe(
+   const core_tt_t* p_tt,     /*!< Table */
+   uint64_t hash,             /*!< Position hash */
+   uint64_t* p_data           /*!< Data found */
+   );
+
+#endif /* #ifndef CORE_TT_H */
+/* END OF FILE ***************************************************************/
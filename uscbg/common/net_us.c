@@ -9,9 +9,85 @@ Copyright (c) 2013, All Rights Reserved.
 /* INCLUDE FILES *************************************************************/
 #include "sys_def.h"
 #include "sys_assert.h"
+#include <string.h>
 #include "net_us.h"
 
 /* CONSTANTS / MACROS ********************************************************/
+/* Encoders. The max size is checked once, the fields are stored straight. */
+#define NET_US_ENC_U8(name, n) \
+   p_buf[pos++] = p_msg->name;
+#define NET_US_ENC_U32(name, n) \
+   p_buf[pos++] = (uint8_t)(p_msg->name); \
+   p_buf[pos++] = (uint8_t)(p_msg->name >> 8); \
+   p_buf[pos++] = (uint8_t)(p_msg->name >> 16); \
+   p_buf[pos++] = (uint8_t)(p_msg->name >> 24);
+#define NET_US_ENC_U8S(name, n) \
+   memcpy(&p_buf[pos], p_msg->name, n); \
+   pos += n;
+#define NET_US_ENC_STR(name, n) \
+   { \
+      int l = strnlen(p_msg->name, (n) - 1); \
+      memcpy(&p_buf[pos], p_msg->name, l); \
+      p_buf[pos + l] = 0; \
+      pos += l + 1; \
+   }
+#define NET_US_ENC(type, name, n) NET_US_ENC_##type(name, n)
+
+/* Decoders. The fixed size part is checked once, strings on their own. */
+#define NET_US_MIN_SZ_U8(n) 1
+#define NET_US_MIN_SZ_U32(n) 4
+#define NET_US_MIN_SZ_U8S(n) (n)
+#define NET_US_MIN_SZ_STR(n) 1
+#define NET_US_MIN_SZ(type, name, n) + NET_US_MIN_SZ_##type(n)
+#define NET_US_DEC_U8(name, n) \
+   p_msg->name = p_buf[pos++];
+#define NET_US_DEC_U32(name, n) \
+   p_msg->name = (uint32_t)p_buf[pos] | ((uint32_t)p_buf[pos + 1] << 8) | \
+      ((uint32_t)p_buf[pos + 2] << 16) | ((uint32_t)p_buf[pos + 3] << 24); \
+   pos += 4;
+#define NET_US_DEC_U8S(name, n) \
+   memcpy(p_msg->name, &p_buf[pos], n); \
+   pos += n;
+#define NET_US_DEC_STR(name, n) \
+   { \
+      int l = strnlen((const char*)&p_buf[pos], len - pos); \
+      if ((pos + l == len) || (l >= (n))) \
+      { \
+         return -1; \
+      } \
+      memcpy(p_msg->name, &p_buf[pos], l + 1); \
+      pos += l + 1; \
+   }
+#define NET_US_DEC(type, name, n) NET_US_DEC_##type(name, n)
+
+/* Strings are the only variable size fields, they come last in a message so
+the fixed size check covers all fields before them. */
+#define NET_US_MSG_CODEC(CMD, msg) \
+int net_us_enc_##msg(uint8_t* p_buf, int size, const net_us_##msg##_t* p_msg) \
+{ \
+   int pos = 2; \
+   TOUCH(p_msg); \
+   if (size < NET_US_MAX_SZ_##msg) \
+   { \
+      return -1; \
+   } \
+   p_buf[0] = NET_CMD_##CMD >> 8; \
+   p_buf[1] = NET_CMD_##CMD & 0xff; \
+   NET_US_FIELDS_##msg(NET_US_ENC) \
+   return pos; \
+} \
+int net_us_dec_##msg(const uint8_t* p_buf, int len, net_us_##msg##_t* p_msg) \
+{ \
+   int pos = 2; \
+   TOUCH(p_msg); \
+   if ((len < (2 NET_US_FIELDS_##msg(NET_US_MIN_SZ))) || \
+       (((p_buf[0] << 8) | p_buf[1]) != NET_CMD_##CMD)) \
+   { \
+      return -1; \
+   } \
+   NET_US_FIELDS_##msg(NET_US_DEC) \
+   return pos; \
+}
 
 /* LOCAL DATATYPES ***********************************************************/
 
@@ -58,7 +134,8 @@ char* net_cmd_to_str[NET_CMD_LAST] =
    "Client Select Card Choice",
    "Client Pass",
    "Client Done",
-   "Client Back"
+   "Client Back",
+   "Server State Sync" /* NET_CMD_SERVER_STATE_SYNC */
 };
 
 /* GLOBAL FUNCTIONS **********************************************************/
@@ -80,6 +157,11 @@ const char* net_us_cmd_to_str(net_us_cmd_t cmd)
    return cmd_str;
 }
 
+/*-----------------------------------------------------------------------------
+Message encoders and decoders, net_us_enc_<message>/net_us_dec_<message>.
+-----------------------------------------------------------------------------*/
+NET_US_MSGS(NET_US_MSG_CODEC)
+
 /* LOCAL FUNCTIONS ***********************************************************/
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
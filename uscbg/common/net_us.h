@@ -9,50 +9,164 @@ Copyright (c) 2013, All Rights Reserved.
 #ifndef NET_US_H
 #define NET_US_H
 /* INCLUDE FILES *************************************************************/
+#include "net.h"
 
 /* EXPORTED DEFINES **********************************************************/
+#define NET_US_MAX_LOG_ENTRY (128) /* Log text incl NUL (MAX_CORE_LOG_ENTRY) */
+
+/*---------------------------------------------------------------------------*/
+/* Message schema. One entry per command, in command order:
+   M(COMMAND, message)
+The fields of a message are listed by NET_US_FIELDS_<message>(F) as
+   F(type, name, n)
+with the wire types
+   U8   8 bit value
+   U32  32 bit value, little endian
+   U8S  n bytes
+   STR  NUL terminated string, at most n bytes incl NUL
+Each message gets a struct net_us_<message>_t, an encoder net_us_enc_<message>
+and a decoder net_us_dec_<message>. A packet is the 2 byte big endian command
+followed by the fields in order. */
+/*---------------------------------------------------------------------------*/
+#define NET_US_MSGS(M) \
+   M(NONE, none) \
+   /* Server->Client messages */ \
+   M(SERVER_PLAYER_INFO, server_player_info) \
+   M(SERVER_PLAYER_REMOVE, server_player_remove) \
+   M(SERVER_START_GAME, server_start_game) \
+   M(SERVER_SELECT_COLOR, server_select_color) \
+   M(SERVER_SELECT_ACTION, server_select_action) \
+   M(SERVER_SELECT_BUILDING_ROTATION, server_select_building_rotation) \
+   M(SERVER_SELECT_BOARD_LOT, server_select_board_lot) \
+   M(SERVER_SELECT_BOARD_CARD, server_select_board_card) \
+   M(SERVER_SELECT_PLAYER_CARD, server_select_player_card) \
+   M(SERVER_SELECT_CARD_CHOICE, server_select_card_choice) \
+   M(SERVER_PLAYER_UPDATE, server_player_update) \
+   M(SERVER_BOARD_CARDS_UPDATE, server_board_cards_update) \
+   M(SERVER_BLOCK_UPDATE, server_block_update) \
+   M(SERVER_CARD_UPDATE, server_card_update) \
+   M(SERVER_ACTIVE_PLAYER, server_active_player) \
+   M(SERVER_PHASE_UPDATE, server_phase_update) \
+   M(SERVER_LOG_ENTRY, server_log_entry) \
+   M(SERVER_GAME_END, server_game_end) \
+   /* Client->Server messages */ \
+   M(CLIENT_PLAYER_NAME, client_player_name) \
+   M(CLIENT_START_GAME, client_start_game) \
+   M(CLIENT_LOAD_GAME, client_load_game) \
+   M(CLIENT_SAVE_GAME, client_save_game) \
+   M(CLIENT_SELECT_COLOR, client_select_color) \
+   M(CLIENT_SELECT_ACTION, client_select_action) \
+   M(CLIENT_SELECT_BUILDING_ROTATION, client_select_building_rotation) \
+   M(CLIENT_SELECT_BOARD_LOT, client_select_board_lot) \
+   M(CLIENT_SELECT_BOARD_CARD, client_select_board_card) \
+   M(CLIENT_SELECT_PLAYER_CARD, client_select_player_card) \
+   M(CLIENT_SELECT_CARD_CHOICE, client_select_card_choice) \
+   M(CLIENT_PASS, client_pass) \
+   M(CLIENT_DONE, client_done) \
+   M(CLIENT_BACK, client_back) \
+   /* Added later, kept last so earlier commands keep their numbers */ \
+   M(SERVER_STATE_SYNC, server_state_sync)
+
+#define NET_US_FIELDS_none(F)
+#define NET_US_FIELDS_server_player_info(F) \
+   F(U32, id, 1)              /* 0 for the receiving player */ \
+   F(U8S, name, MAX_CLIENT_NAME_LEN) \
+   F(U32, player_id, 1)
+#define NET_US_FIELDS_server_player_remove(F) \
+   F(U32, id, 1)
+#define NET_US_FIELDS_server_start_game(F)
+#define NET_US_FIELDS_server_select_color(F) \
+   F(U8, available_colors, 1)
+#define NET_US_FIELDS_server_select_action(F)
+#define NET_US_FIELDS_server_select_building_rotation(F)
+#define NET_US_FIELDS_server_select_board_lot(F)
+#define NET_US_FIELDS_server_select_board_card(F)
+#define NET_US_FIELDS_server_select_player_card(F)
+#define NET_US_FIELDS_server_select_card_choice(F)
+#define NET_US_FIELDS_server_player_update(F) \
+   F(U32, id, 1) \
+   F(U8, color, 1) \
+   F(U8, ap, 1) \
+   F(U8, politicians, 1) \
+   F(U32, vocations, 1) \
+   F(U32, wealth, 1) \
+   F(U32, prestige, 1) \
+   F(U8S, cards, 6)           /* Card ids, 0 = none */
+#define NET_US_FIELDS_server_board_cards_update(F) \
+   F(U8S, planning, 5)        /* Card ids, 0 = none */ \
+   F(U8S, contract, 8)
+#define NET_US_FIELDS_server_block_update(F) \
+   F(U8, id, 1) \
+   F(U8, n_buildings, 1) \
+   F(U32, value, 1) \
+   F(U8S, buildings, 16)      /* zone, size, owner, block_pos x 4 */
+#define NET_US_FIELDS_server_card_update(F)
+#define NET_US_FIELDS_server_active_player(F) \
+   F(U32, id, 1)
+#define NET_US_FIELDS_server_phase_update(F) \
+   F(U8, current_round, 1) \
+   F(U8, state, 1)
+#define NET_US_FIELDS_server_log_entry(F) \
+   F(U32, id, 1)              /* 0 = no player */ \
+   F(STR, text, NET_US_MAX_LOG_ENTRY)
+#define NET_US_FIELDS_server_game_end(F)
+#define NET_US_FIELDS_server_state_sync(F) /* Body by core_sync_encode */
+#define NET_US_FIELDS_client_player_name(F) \
+   F(U8S, name, MAX_CLIENT_NAME_LEN)
+#define NET_US_FIELDS_client_start_game(F)
+#define NET_US_FIELDS_client_load_game(F)
+#define NET_US_FIELDS_client_save_game(F)
+#define NET_US_FIELDS_client_select_color(F) \
+   F(U8, color, 1)
+#define NET_US_FIELDS_client_select_action(F) \
+   F(U8, action, 1)
+#define NET_US_FIELDS_client_select_building_rotation(F) \
+   F(U8, rotation, 1)
+#define NET_US_FIELDS_client_select_board_lot(F) \
+   F(U8, lot, 1)
+#define NET_US_FIELDS_client_select_board_card(F) \
+   F(U8, card, 1)
+#define NET_US_FIELDS_client_select_player_card(F) \
+   F(U8, card, 1)
+#define NET_US_FIELDS_client_select_card_choice(F)
+#define NET_US_FIELDS_client_pass(F)
+#define NET_US_FIELDS_client_done(F)
+#define NET_US_FIELDS_client_back(F)
+
+/* Field helpers used to expand the schema */
+#define NET_US_DECL_U8(name, n) uint8_t name;
+#define NET_US_DECL_U32(name, n) uint32_t name;
+#define NET_US_DECL_U8S(name, n) uint8_t name[n];
+#define NET_US_DECL_STR(name, n) char name[n];
+#define NET_US_DECL(type, name, n) NET_US_DECL_##type(name, n)
+#define NET_US_MAX_SZ_U8(n) 1
+#define NET_US_MAX_SZ_U32(n) 4
+#define NET_US_MAX_SZ_U8S(n) (n)
+#define NET_US_MAX_SZ_STR(n) (n)
+#define NET_US_MAX_SZ(type, name, n) + NET_US_MAX_SZ_##type(n)
 
 /* EXPORTED DATA TYPES *******************************************************/
+#define NET_US_CMD_ENUM(CMD, msg) NET_CMD_##CMD,
 typedef enum
 {
-   NET_CMD_NONE = 0,
-   /* Server->Client messages */
-   NET_CMD_SERVER_PLAYER_INFO,
-   NET_CMD_SERVER_PLAYER_REMOVE,
-   NET_CMD_SERVER_START_GAME,
-   NET_CMD_SERVER_SELECT_COLOR,
-   NET_CMD_SERVER_SELECT_ACTION,
-   NET_CMD_SERVER_SELECT_BUILDING_ROTATION,
-   NET_CMD_SERVER_SELECT_BOARD_LOT,
-   NET_CMD_SERVER_SELECT_BOARD_CARD,
-   NET_CMD_SERVER_SELECT_PLAYER_CARD,
-   NET_CMD_SERVER_SELECT_CARD_CHOICE,
-   NET_CMD_SERVER_PLAYER_UPDATE,
-   NET_CMD_SERVER_BOARD_CARDS_UPDATE,
-   NET_CMD_SERVER_BLOCK_UPDATE,
-   NET_CMD_SERVER_CARD_UPDATE,
-   NET_CMD_SERVER_ACTIVE_PLAYER,
-   NET_CMD_SERVER_PHASE_UPDATE,
-   NET_CMD_SERVER_LOG_ENTRY,
-   NET_CMD_SERVER_GAME_END,
-   /* Client->Server messages */
-   NET_CMD_CLIENT_PLAYER_NAME,
-   NET_CMD_CLIENT_START_GAME,
-   NET_CMD_CLIENT_LOAD_GAME,
-   NET_CMD_CLIENT_SAVE_GAME,
-   NET_CMD_CLIENT_SELECT_COLOR,
-   NET_CMD_CLIENT_SELECT_ACTION,
-   NET_CMD_CLIENT_SELECT_BUILDING_ROTATION,
-   NET_CMD_CLIENT_SELECT_BOARD_LOT,
-   NET_CMD_CLIENT_SELECT_BOARD_CARD,
-   NET_CMD_CLIENT_SELECT_PLAYER_CARD,
-   NET_CMD_CLIENT_SELECT_CARD_CHOICE,
-   NET_CMD_CLIENT_PASS,
-   NET_CMD_CLIENT_DONE,
-   NET_CMD_CLIENT_BACK,
+   NET_US_MSGS(NET_US_CMD_ENUM)
    NET_CMD_LAST
 } net_us_cmd_t;
 
+/* Message structs, net_us_<message>_t */
+#define NET_US_MSG_STRUCT(CMD, msg) \
+   typedef struct { NET_US_FIELDS_##msg(NET_US_DECL) } net_us_##msg##_t;
+NET_US_MSGS(NET_US_MSG_STRUCT)
+
+/* Max packet size of a message (command included), NET_US_MAX_SZ_<message> */
+#define NET_US_MSG_MAX_SZ(CMD, msg) \
+   NET_US_MAX_SZ_##msg = 2 NET_US_FIELDS_##msg(NET_US_MAX_SZ),
+enum
+{
+   NET_US_MSGS(NET_US_MSG_MAX_SZ)
+   NET_US_MAX_SZ_LAST
+};
+
 /* GLOBAL VARIABLES **********************************************************/
 
 /* INTERFACE FUNCTIONS *******************************************************/
@@ -71,5 +185,19 @@ const char* net_us_cmd_to_str(
    net_us_cmd_t cmd
    );
 
+/*---------------------------------------------------------------------------*/
+/*! \brief Encode a message into a packet (net_us_enc_<message>).
+\return Packet length or -1 if it does not fit in size */
+/*---------------------------------------------------------------------------*/
+/*! \brief Decode a packet into a message (net_us_dec_<message>).
+\return Packet length used or -1 if the packet is malformed */
+/*---------------------------------------------------------------------------*/
+#define NET_US_MSG_PROTO(CMD, msg) \
+   int net_us_enc_##msg(uint8_t* p_buf, int size, \
+      const net_us_##msg##_t* p_msg); \
+   int net_us_dec_##msg(const uint8_t* p_buf, int len, \
+      net_us_##msg##_t* p_msg);
+NET_US_MSGS(NET_US_MSG_PROTO)
+
 #endif /* #ifndef NET_US_H */
 /* END OF FILE ***************************************************************/
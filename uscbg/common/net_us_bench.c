@@ -0,0 +1,348 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file net_us_bench.c
+\brief Message codec benchmark.
+
+Usage: USNetBench [rounds]
+Encodes and decodes the biggest fixed size server messages (player and block
+update) with the generated codecs and with pbuf_pack/pbuf_unpack, the way the
+server and client did it before the codecs. Both paths must give the same
+packet and the same fields back. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "pbuf.h"
+#include "net_us.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define BENCH_MSGS (64)         /* Messages per round, different values */
+#define BENCH_PACKET_SZ (256)
+
+/* LOCAL DATATYPES ***********************************************************/
+typedef struct
+{
+   char const* p_name;
+   int (*p_enc)(uint8_t* p_buf, int size, int i);  /* Encode message i */
+   int (*p_dec)(const uint8_t* p_buf, int len, int i); /* Decode to slot i */
+} bench_path_t;
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+STATIC void bench_fill(void);
+STATIC int bench_player_enc_codec(uint8_t* p_buf, int size, int i);
+STATIC int bench_player_dec_codec(const uint8_t* p_buf, int len, int i);
+STATIC int bench_player_enc_pbuf(uint8_t* p_buf, int size, int i);
+STATIC int bench_player_dec_pbuf(const uint8_t* p_buf, int len, int i);
+STATIC int bench_block_enc_codec(uint8_t* p_buf, int size, int i);
+STATIC int bench_block_dec_codec(const uint8_t* p_buf, int len, int i);
+STATIC int bench_block_enc_pbuf(uint8_t* p_buf, int size, int i);
+STATIC int bench_block_dec_pbuf(const uint8_t* p_buf, int len, int i);
+STATIC bool_t bench_check(bench_path_t const* p_codec,
+   bench_path_t const* p_pbuf);
+STATIC double bench_run(bench_path_t const* p_path, bool_t dec, int rounds);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+static net_us_server_player_update_t players[BENCH_MSGS];
+static net_us_server_block_update_t blocks[BENCH_MSGS];
+static net_us_server_player_update_t players_out[BENCH_MSGS];
+static net_us_server_block_update_t blocks_out[BENCH_MSGS];
+static uint8_t packets[BENCH_MSGS][BENCH_PACKET_SZ];
+static int lens[BENCH_MSGS];
+static volatile int sink;      /* Keeps the timed loops */
+
+static bench_path_t const bench_paths[][2] =
+{
+   {
+      {"player update", bench_player_enc_codec, bench_player_dec_codec},
+      {"player update", bench_player_enc_pbuf, bench_player_dec_pbuf}
+   },
+   {
+      {"block update", bench_block_enc_codec, bench_block_dec_codec},
+      {"block update", bench_block_enc_pbuf, bench_block_dec_pbuf}
+   }
+};
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int main(int argc, char* argv[])
+{
+   int rounds = (argc > 1)?atoi(argv[1]):200000;
+   int i;
+
+   if (rounds <= 0)
+   {
+      printf("Usage: %s [rounds]\n", argv[0]);
+      return 1;
+   }
+   bench_fill();
+   for (i=0;i<(int)(sizeof(bench_paths) / sizeof(bench_paths[0]));i++)
+   {
+      bench_path_t const* p_codec = &bench_paths[i][0];
+      bench_path_t const* p_pbuf = &bench_paths[i][1];
+      double ns[4];
+      if (!bench_check(p_codec, p_pbuf))
+      {
+         printf("%s: codec and pbuf differ\n", p_codec->p_name);
+         return 1;
+      }
+      ns[0] = bench_run(p_pbuf, FALSE, rounds);
+      ns[1] = bench_run(p_codec, FALSE, rounds);
+      ns[2] = bench_run(p_pbuf, TRUE, rounds);
+      ns[3] = bench_run(p_codec, TRUE, rounds);
+      printf("%s (%d bytes): encode pbuf %.1f ns/msg, codec %.1f ns/msg, "
+         "decode pbuf %.1f ns/msg, codec %.1f ns/msg\n", p_codec->p_name,
+         lens[0], ns[0], ns[1], ns[2], ns[3]);
+   }
+   return 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void assert(const char* test, const char* file, int line)
+{
+   printf("ASSERT %s %s %d", test, file, line);
+   exit(-1);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Messages with values that use all bytes of the wide fields.
+-----------------------------------------------------------------------------*/
+STATIC void bench_fill(void)
+{
+   int i;
+   int j;
+
+   for (i=0;i<BENCH_MSGS;i++)
+   {
+      net_us_server_player_update_t* p_p = &players[i];
+      net_us_server_block_update_t* p_b = &blocks[i];
+      p_p->id = 0x01000000u + i;
+      p_p->color = i % 4;
+      p_p->ap = i % 7;
+      p_p->politicians = i % 64;
+      p_p->vocations = 0xa5a50000u | i;
+      p_p->wealth = 1000u * i + 7;
+      p_p->prestige = 0x00010000u * i + 3;
+      for (j=0;j<6;j++)
+      {
+         p_p->cards[j] = (uint8_t)((i + j) % 60);
+      }
+      p_b->id = i % 36;
+      p_b->n_buildings = i % 5;
+      p_b->value = 0x00020000u * i + 11;
+      for (j=0;j<16;j++)
+      {
+         p_b->buildings[j] = (uint8_t)(i * 16 + j);
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC int bench_player_enc_codec(uint8_t* p_buf, int size, int i)
+{
+   return net_us_enc_server_player_update(p_buf, size, &players[i]);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC int bench_player_dec_codec(const uint8_t* p_buf, int len, int i)
+{
+   return net_us_dec_server_player_update(p_buf, len, &players_out[i]);
+}
+
+/*-----------------------------------------------------------------------------
+A field list per call and one call per card, as the server did.
+-----------------------------------------------------------------------------*/
+STATIC int bench_player_enc_pbuf(uint8_t* p_buf, int size, int i)
+{
+   net_us_server_player_update_t* p_msg = &players[i];
+   int len;
+   int j;
+
+   TOUCH(size);
+   p_buf[0] = NET_CMD_SERVER_PLAYER_UPDATE >> 8;
+   p_buf[1] = NET_CMD_SERVER_PLAYER_UPDATE & 0xff;
+   len = 2;
+   len += pbuf_pack(&p_buf[2], "w", p_msg->id);
+   len += pbuf_pack(&p_buf[len], "bbbwww", p_msg->color, p_msg->ap,
+      p_msg->politicians, p_msg->vocations, p_msg->wealth, p_msg->prestige);
+   for (j=0;j<6;j++)
+   {
+      len += pbuf_pack(&p_buf[len], "b", p_msg->cards[j]);
+   }
+   return len;
+}
+
+/*-----------------------------------------------------------------------------
+pbuf_unpack has no length, the client trusted the packet.
+-----------------------------------------------------------------------------*/
+STATIC int bench_player_dec_pbuf(const uint8_t* p_buf, int len, int i)
+{
+   net_us_server_player_update_t* p_msg = &players_out[i];
+   uint8_t* p_data = (uint8_t*)p_buf;
+   int pos = 2;
+   int j;
+
+   TOUCH(len);
+   pos += pbuf_unpack(&p_data[pos], "w", &p_msg->id);
+   pos += pbuf_unpack(&p_data[pos], "bbbwww", &p_msg->color, &p_msg->ap,
+      &p_msg->politicians, &p_msg->vocations, &p_msg->wealth,
+      &p_msg->prestige);
+   for (j=0;j<6;j++)
+   {
+      pos += pbuf_unpack(&p_data[pos], "b", &p_msg->cards[j]);
+   }
+   return pos;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC int bench_block_enc_codec(uint8_t* p_buf, int size, int i)
+{
+   return net_us_enc_server_block_update(p_buf, size, &blocks[i]);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC int bench_block_dec_codec(const uint8_t* p_buf, int len, int i)
+{
+   return net_us_dec_server_block_update(p_buf, len, &blocks_out[i]);
+}
+
+/*-----------------------------------------------------------------------------
+One call per building, as the server did.
+-----------------------------------------------------------------------------*/
+STATIC int bench_block_enc_pbuf(uint8_t* p_buf, int size, int i)
+{
+   net_us_server_block_update_t* p_msg = &blocks[i];
+   uint8_t* p_bld = p_msg->buildings;
+   int len;
+   int j;
+
+   TOUCH(size);
+   p_buf[0] = NET_CMD_SERVER_BLOCK_UPDATE >> 8;
+   p_buf[1] = NET_CMD_SERVER_BLOCK_UPDATE & 0xff;
+   len = 2;
+   len += pbuf_pack(&p_buf[len], "bbw", p_msg->id, p_msg->n_buildings,
+      p_msg->value);
+   for (j=0;j<4;j++)
+   {
+      len += pbuf_pack(&p_buf[len], "bbbb", p_bld[j * 4], p_bld[j * 4 + 1],
+         p_bld[j * 4 + 2], p_bld[j * 4 + 3]);
+   }
+   return len;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC int bench_block_dec_pbuf(const uint8_t* p_buf, int len, int i)
+{
+   net_us_server_block_update_t* p_msg = &blocks_out[i];
+   uint8_t* p_bld = p_msg->buildings;
+   uint8_t* p_data = (uint8_t*)p_buf;
+   int pos = 2;
+   int j;
+
+   TOUCH(len);
+   pos += pbuf_unpack(&p_data[pos], "b", &p_msg->id);
+   pos += pbuf_unpack(&p_data[pos], "bw", &p_msg->n_buildings, &p_msg->value);
+   for (j=0;j<4;j++)
+   {
+      pos += pbuf_unpack(&p_data[pos], "bbbb", &p_bld[j * 4],
+         &p_bld[j * 4 + 1], &p_bld[j * 4 + 2], &p_bld[j * 4 + 3]);
+   }
+   return pos;
+}
+
+/*-----------------------------------------------------------------------------
+Both paths encode the same packets and decode them back to the messages.
+\return FALSE if they differ
+-----------------------------------------------------------------------------*/
+STATIC bool_t bench_check(bench_path_t const* p_codec,
+   bench_path_t const* p_pbuf)
+{
+   uint8_t packet[BENCH_PACKET_SZ];
+   int i;
+
+   for (i=0;i<BENCH_MSGS;i++)
+   {
+      int len = p_codec->p_enc(packets[i], BENCH_PACKET_SZ, i);
+      if ((len < 0) || (p_pbuf->p_enc(packet, BENCH_PACKET_SZ, i) != len) ||
+          (memcmp(packet, packets[i], len) != 0))
+      {
+         return FALSE;
+      }
+      lens[i] = len;
+   }
+   for (i=0;i<2;i++)
+   {
+      bench_path_t const* p_path = (i == 0)?p_codec:p_pbuf;
+      int j;
+      memset(players_out, 0, sizeof(players_out));
+      memset(blocks_out, 0, sizeof(blocks_out));
+      for (j=0;j<BENCH_MSGS;j++)
+      {
+         if (p_path->p_dec(packets[j], lens[j], j) != lens[j])
+         {
+            return FALSE;
+         }
+      }
+      if ((p_codec->p_enc == bench_player_enc_codec) ?
+          (memcmp(players_out, players, sizeof(players)) != 0) :
+          (memcmp(blocks_out, blocks, sizeof(blocks)) != 0))
+      {
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+Encode (or decode the packets of bench_check) all messages rounds times.
+\return ns per message
+-----------------------------------------------------------------------------*/
+STATIC double bench_run(bench_path_t const* p_path, bool_t dec, int rounds)
+{
+   uint8_t packet[BENCH_PACKET_SZ];
+   struct timespec t0, t1;
+   int sum = 0;
+   int r;
+   int i;
+
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   for (r=0;r<rounds;r++)
+   {
+      for (i=0;i<BENCH_MSGS;i++)
+      {
+         if (dec)
+         {
+            sum += p_path->p_dec(packets[i], lens[i], i);
+         }
+         else
+         {
+            sum += p_path->p_enc(packet, BENCH_PACKET_SZ, i);
+            sum += packet[i & 7];
+         }
+      }
+   }
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   sink = sum;
+   return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) /
+      ((double)rounds * BENCH_MSGS);
+}
+
+/* END OF FILE ***************************************************************/
@@ -12,6 +12,10 @@ UML state machine mechanisms in plain C.*/
 /* INCLUDE FILES *************************************************************/
 #include "sys_def.h"
 #include "sys_assert.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include "trc.h"
 #include "hsm.h"
 
@@ -22,14 +26,88 @@ UML state machine mechanisms in plain C.*/
 /*---------------------------------------------------------------------------*/
 /*! \brief HSM state event. */
 /*---------------------------------------------------------------------------*/
+#ifdef HSM_PROFILE
+#define hsm_state_evt(me, hsm, msg)\
+   hsm_prof_evt((me), (hsm), (msg))
+#else
 #define hsm_state_evt(me, hsm, msg)\
    (*(me)->evt_hnd)((hsm), (msg))
+#endif
 
 /* LOCAL DATATYPES ***********************************************************/
+/*---------------------------------------------------------------------------*/
+/*! \brief State table of a compiled state machine.
+
+The exit sequence from source s to target t is path[s] from depth[s] up to (not
+including) lca[s][t], the entry sequence is path[t] after lca[s][t] down to
+depth[t]. The bubbling order of an event is path[s] from depth[s] to 0. */
+/*---------------------------------------------------------------------------*/
+struct hsm_tbl
+{
+   uint8_t n_states;
+   uint8_t depth[HSM_MAX_STATES];   /*!< Levels below the top state */
+   hsm_state_t* path[HSM_MAX_STATES][MAX_STATE_NESTING]; /*!< Top to state */
+   uint8_t lca[HSM_MAX_STATES][HSM_MAX_STATES]; /*!< Depth of LCA (s, t) */
+};
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Profile of a state handler. */
+/*---------------------------------------------------------------------------*/
+typedef struct
+{
+   uint32_t n_calls;       /*!< Handler calls */
+   uint32_t n_offered;     /*!< User events offered */
+   uint32_t n_handled;     /*!< User events handled */
+   uint32_t n_entry;
+   uint32_t n_exit;
+   uint32_t n_init;
+   uint32_t max_ns;        /*!< Longest call */
+   uint64_t ns;            /*!< Total time */
+   uint64_t self_ns;       /*!< Total time without nested handler calls */
+} hsm_prof_state_t;
+
+typedef struct
+{
+   uint64_t t0;            /*!< Start, ns since the profile started */
+   uint32_t ns;            /*!< Duration */
+   hsm_evt_t evt;          /*!< Event */
+   uint8_t state;          /*!< State index */
+} hsm_prof_call_t;
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Profile of a state machine (HSM_PROFILE).
+
+The states are indexed in link order like the state table. A transition is
+counted from the current state when it is taken (the leaf state, also if a
+super state handles the event) to the target. child_ns collects the time of
+the handler calls nested in the running one (exit calls of a transition). */
+/*---------------------------------------------------------------------------*/
+struct hsm_prof
+{
+   uint8_t n_states;
+   hsm_state_t* p_states[HSM_MAX_STATES];
+   hsm_prof_state_t states[HSM_MAX_STATES];
+   uint32_t tran[HSM_MAX_STATES][HSM_MAX_STATES]; /*!< Source, target */
+   uint64_t epoch;         /*!< Start, ns */
+   uint64_t child_ns;
+   uint32_t n_calls;       /*!< Calls recorded in the ring */
+   hsm_prof_call_t ring[HSM_PROF_RING];
+};
 
 /* LOCAL FUNCTION PROTOTYPES *************************************************/
 STATIC void hsm_exit(hsm_t* p_me, uint8_t to_lca);
 STATIC uint8_t hsm_to_lca(hsm_t* p_me, hsm_state_t* p_trg);
+STATIC hsm_tbl_t* hsm_tbl_create(hsm_t* p_me);
+STATIC void hsm_tbl_evt(hsm_t* p_me, hsm_msg_t const* p_msg);
+STATIC void hsm_tbl_exit(hsm_t* p_me, hsm_state_t* p_trg);
+STATIC void hsm_tbl_enter(hsm_t* p_me);
+#ifdef HSM_PROFILE
+STATIC hsm_prof_t* hsm_prof_create(hsm_t* p_me);
+STATIC hsm_msg_t const* hsm_prof_evt(hsm_state_t* p_s, hsm_t* p_me,
+   hsm_msg_t const* p_msg);
+STATIC uint64_t hsm_prof_ns(void);
+#endif
+STATIC char const* hsm_prof_kind(hsm_evt_t evt);
 
 /* MODULE CONSTANTS / VARIABLES **********************************************/
 SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
@@ -46,7 +124,9 @@ static hsm_msg_t const hsm_msg_exit = {HSM_EVT_EXIT};
 -----------------------------------------------------------------------------*/
 void hsm_init(void)
 {
-#ifdef HSM_TRC_EVT
+#if defined(HSM_TRC_EVT) && defined(HSM_PROFILE)
+   TRC_REG(hsm, TRC_ERROR | TRC_EVT | TRC_INFO);
+#elif defined(HSM_TRC_EVT)
    TRC_REG(hsm, TRC_ERROR | TRC_EVT);
 #else
    TRC_REG(hsm, TRC_ERROR);
@@ -59,6 +139,31 @@ void hsm_ctor(hsm_t* p_me, char const* p_name, hsm_evt_hnd_t* hnd)
 {
    hsm_state_ctor(&p_me->top, "top", hnd, NULL);
    p_me->p_name = p_name;
+#ifdef HSM_COMPILED
+   p_me->compiled = TRUE;
+#else
+   p_me->compiled = FALSE;
+#endif
+   p_me->p_tbl = NULL;
+   p_me->p_prof = NULL;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void hsm_dtor(hsm_t* p_me)
+{
+   free(p_me->p_tbl);
+   p_me->p_tbl = NULL;
+   free(p_me->p_prof);
+   p_me->p_prof = NULL;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void hsm_compile(hsm_t* p_me, bool_t on)
+{
+   REQUIRE(p_me->p_tbl == NULL);
+   p_me->compiled = on;
 }
 
 /*-----------------------------------------------------------------------------
@@ -66,9 +171,23 @@ void hsm_ctor(hsm_t* p_me, char const* p_name, hsm_evt_hnd_t* hnd)
 void hsm_state_ctor(hsm_state_t* p_me, char const* p_name, hsm_evt_hnd_t* hnd,
    hsm_state_t* p_super)
 {
+   hsm_state_t* p_top = p_super;
+
    p_me->p_name = p_name;
    p_me->evt_hnd = hnd;
    p_me->p_super = p_super;
+   p_me->p_link = NULL;
+   p_me->idx = 0;
+   if (p_top != NULL)
+   {  /* Link the state after the top state of the machine */
+      REQUIRE(p_super->evt_hnd != NULL);
+      while (p_top->p_super != NULL)
+      {
+         p_top = p_top->p_super;
+      }
+      p_me->p_link = p_top->p_link;
+      p_top->p_link = p_me;
+   }
 }
 
 /*-----------------------------------------------------------------------------
@@ -79,10 +198,30 @@ void hsm_start(hsm_t* p_me)
    hsm_state_t** pp_trace;
    hsm_state_t* p_s;
 
+   if (p_me->compiled && (p_me->p_tbl == NULL))
+   {
+      p_me->p_tbl = hsm_tbl_create(p_me);
+   }
+#ifdef HSM_PROFILE
+   if (p_me->p_prof == NULL)
+   {
+      p_me->p_prof = hsm_prof_create(p_me);
+   }
+#endif
    p_me->p_curr = &p_me->top;
    p_me->p_next = NULL;
    TRC(hsm, TRC_EVT, "%s entry", p_me->p_name);
    hsm_state_evt(p_me->p_curr, p_me, &hsm_msg_entry);
+   if (p_me->p_tbl != NULL)
+   {
+      hsm_state_evt(p_me->p_curr, p_me, &hsm_msg_init);
+      if (p_me->p_next != NULL)
+      {
+         TRC(hsm, TRC_EVT, "%s init", p_me->p_curr->p_name);
+         hsm_tbl_enter(p_me);
+      }
+      return;
+   }
    while (hsm_state_evt(p_me->p_curr, p_me, &hsm_msg_init), p_me->p_next)
    {  /* For each init action execute the trace of entry actions. */
       TRC(hsm, TRC_EVT, "%s init", p_me->p_curr->p_name);
@@ -110,6 +249,11 @@ void hsm_evt(hsm_t* p_me, hsm_msg_t const* p_msg)
    hsm_state_t** pp_trace;
    hsm_state_t* p_s;
 
+   if (p_me->p_tbl != NULL)
+   {
+      hsm_tbl_evt(p_me, p_msg);
+      return;
+   }
    for (p_s = p_me->p_curr; p_s != NULL; p_s = p_s->p_super)
    {  /* Execute events down to the super state if not handled */
       TRC(hsm, TRC_EVT, "%s msg %d", p_s->p_name, *p_msg);
@@ -136,7 +280,7 @@ void hsm_evt(hsm_t* p_me, hsm_msg_t const* p_msg)
                TRC(hsm, TRC_EVT, "%s init", p_me->p_curr->p_name);
                pp_trace = entry_path;
                *pp_trace = 0;
-               for (p_s = p_me->p_next->p_super; p_me->p_curr;
+               for (p_s = p_me->p_next; p_s != p_me->p_curr;
                   p_s = p_s->p_super)
                {  /* Record the trace of entry actions to get to target */
                   *(++pp_trace) = p_s;
@@ -179,17 +323,148 @@ void hsm_state_init(hsm_t* p_me, hsm_state_t* p_trg)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void hsm_state_tran(hsm_t* p_me, hsm_state_t* p_trg, uint8_t* p_to_lca)
+void hsm_state_tran(hsm_t* p_me, hsm_state_t* p_trg)
 {
    REQUIRE(p_me->p_next == NULL);
-   if (*p_to_lca == 0)
-   {  /* Find out levels down to LCA */
-      *p_to_lca = hsm_to_lca(p_me, p_trg);
+#ifdef HSM_PROFILE
+   p_me->p_prof->tran[p_me->p_curr->idx][p_trg->idx]++;
+#endif
+   if (p_me->p_tbl != NULL)
+   {
+      hsm_tbl_exit(p_me, p_trg);
+   }
+   else
+   {
+      hsm_exit(p_me, hsm_to_lca(p_me, p_trg));
    }
-   hsm_exit(p_me, *p_to_lca);
    p_me->p_next = p_trg;
 }
 
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void hsm_prof_dump(hsm_t* p_me)
+{
+   hsm_prof_t* p_prof = p_me->p_prof;
+   int s;
+   int t;
+
+   if (p_prof == NULL)
+   {
+      return;
+   }
+   TRC(hsm, TRC_INFO, "%s profile: calls (offered/handled entry exit init), "
+      "total, self, max us", p_me->p_name);
+   for (s=0;s<p_prof->n_states;s++)
+   {
+      hsm_prof_state_t* p_st = &p_prof->states[s];
+      if (p_st->n_calls == 0)
+      {
+         continue;
+      }
+      TRC(hsm, TRC_INFO, "%-20s %8u (%u/%u %u %u %u) %.1f %.1f %.3f",
+         p_prof->p_states[s]->p_name, p_st->n_calls, p_st->n_offered,
+         p_st->n_handled, p_st->n_entry, p_st->n_exit, p_st->n_init,
+         p_st->ns / 1e3, p_st->self_ns / 1e3, p_st->max_ns / 1e3);
+   }
+   for (s=0;s<p_prof->n_states;s++)
+   {
+      for (t=0;t<p_prof->n_states;t++)
+      {
+         if (p_prof->tran[s][t] != 0)
+         {
+            TRC(hsm, TRC_INFO, "%s -> %s %u", p_prof->p_states[s]->p_name,
+               p_prof->p_states[t]->p_name, p_prof->tran[s][t]);
+         }
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t hsm_prof_csv(hsm_t* p_me, char const* p_file_name)
+{
+   hsm_prof_t* p_prof = p_me->p_prof;
+   FILE* p_file;
+   int s;
+   int t;
+
+   if ((p_prof == NULL) || ((p_file = fopen(p_file_name, "w")) == NULL))
+   {
+      return FALSE;
+   }
+   fprintf(p_file, "kind,machine,state,target,calls,offered,handled,entries,"
+      "exits,inits,total_ns,self_ns,max_ns\n");
+   for (s=0;s<p_prof->n_states;s++)
+   {
+      hsm_prof_state_t* p_st = &p_prof->states[s];
+      fprintf(p_file, "state,%s,%s,,%u,%u,%u,%u,%u,%u,%llu,%llu,%u\n",
+         p_me->p_name, p_prof->p_states[s]->p_name, p_st->n_calls,
+         p_st->n_offered, p_st->n_handled, p_st->n_entry, p_st->n_exit,
+         p_st->n_init, (unsigned long long)p_st->ns,
+         (unsigned long long)p_st->self_ns, p_st->max_ns);
+   }
+   for (s=0;s<p_prof->n_states;s++)
+   {
+      for (t=0;t<p_prof->n_states;t++)
+      {
+         if (p_prof->tran[s][t] != 0)
+         {
+            fprintf(p_file, "tran,%s,%s,%s,%u,,,,,,,,\n", p_me->p_name,
+               p_prof->p_states[s]->p_name, p_prof->p_states[t]->p_name,
+               p_prof->tran[s][t]);
+         }
+      }
+   }
+   return (fclose(p_file) == 0);
+}
+
+/*-----------------------------------------------------------------------------
+The ring is written from the oldest call on. Times are in us (the unit of the
+format) with ns precision.
+-----------------------------------------------------------------------------*/
+bool_t hsm_prof_chrome(hsm_t* p_me, char const* p_file_name)
+{
+   hsm_prof_t* p_prof = p_me->p_prof;
+   FILE* p_file;
+   uint32_t n;
+   uint32_t i;
+
+   if ((p_prof == NULL) || ((p_file = fopen(p_file_name, "w")) == NULL))
+   {
+      return FALSE;
+   }
+   fprintf(p_file, "{\"traceEvents\":[\n{\"name\":\"thread_name\",\"ph\":\"M\","
+      "\"pid\":1,\"tid\":1,\"args\":{\"name\":\"%s\"}}", p_me->p_name);
+   n = MIN(p_prof->n_calls, HSM_PROF_RING);
+   for (i=p_prof->n_calls - n;i!=p_prof->n_calls;i++)
+   {
+      hsm_prof_call_t* p_call = &p_prof->ring[i % HSM_PROF_RING];
+      fprintf(p_file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+         "\"ts\":%llu.%03u,\"dur\":%u.%03u,\"pid\":1,\"tid\":1,"
+         "\"args\":{\"evt\":%d}}",
+         p_prof->p_states[p_call->state]->p_name, hsm_prof_kind(p_call->evt),
+         (unsigned long long)(p_call->t0 / 1000), (unsigned)(p_call->t0 % 1000),
+         p_call->ns / 1000, p_call->ns % 1000, p_call->evt);
+   }
+   fprintf(p_file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+   return (fclose(p_file) == 0);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void hsm_prof_reset(hsm_t* p_me)
+{
+   hsm_prof_t* p_prof = p_me->p_prof;
+
+   if (p_prof == NULL)
+   {
+      return;
+   }
+   memset(p_prof->states, 0, sizeof(p_prof->states));
+   memset(p_prof->tran, 0, sizeof(p_prof->tran));
+   p_prof->n_calls = 0;
+}
+
 /* LOCAL FUNCTIONS ***********************************************************/
 /*-----------------------------------------------------------------------------
 Execute the exit actions for a state and it's super states down to LCA
@@ -229,4 +504,221 @@ STATIC uint8_t hsm_to_lca(hsm_t* p_me, hsm_state_t* p_trg)
    return 0;
 }
 
+/*-----------------------------------------------------------------------------
+Index the states in link order (top is 0) and record the path and the depth of
+each state. The LCA of (s, t) is the deepest proper super state of s that is
+on the path of t (the top state for s = top, it is never left).
+-----------------------------------------------------------------------------*/
+STATIC hsm_tbl_t* hsm_tbl_create(hsm_t* p_me)
+{
+   hsm_tbl_t* p_tbl = (hsm_tbl_t*)calloc(1, sizeof(hsm_tbl_t));
+   hsm_state_t* p_s;
+   int s;
+   int t;
+
+   REQUIRE(p_tbl != NULL);
+   for (p_s = &p_me->top; p_s != NULL; p_s = p_s->p_link)
+   {
+      REQUIRE(p_tbl->n_states < HSM_MAX_STATES);
+      p_s->idx = p_tbl->n_states++;
+   }
+   for (p_s = &p_me->top; p_s != NULL; p_s = p_s->p_link)
+   {
+      hsm_state_t* p_p;
+      int d = 0;
+      for (p_p = p_s->p_super; p_p != NULL; p_p = p_p->p_super)
+      {
+         d++;
+      }
+      REQUIRE(d < MAX_STATE_NESTING);
+      p_tbl->depth[p_s->idx] = d;
+      for (p_p = p_s; p_p != NULL; p_p = p_p->p_super)
+      {
+         p_tbl->path[p_s->idx][d--] = p_p;
+      }
+   }
+   for (s=0;s<p_tbl->n_states;s++)
+   {
+      for (t=0;t<p_tbl->n_states;t++)
+      {
+         int lca = 0;
+         while ((lca + 1 < p_tbl->depth[s]) && (lca + 1 <= p_tbl->depth[t]) &&
+                (p_tbl->path[s][lca + 1] == p_tbl->path[t][lca + 1]))
+         {
+            lca++;
+         }
+         p_tbl->lca[s][t] = lca;
+      }
+   }
+   TRC(hsm, TRC_EVT, "%s compiled, %d states", p_me->p_name, p_tbl->n_states);
+   return p_tbl;
+}
+
+/*-----------------------------------------------------------------------------
+Offer the event to the path of the current state, bottom up.
+-----------------------------------------------------------------------------*/
+STATIC void hsm_tbl_evt(hsm_t* p_me, hsm_msg_t const* p_msg)
+{
+   hsm_tbl_t* p_tbl = p_me->p_tbl;
+   hsm_state_t* const* pp_path = p_tbl->path[p_me->p_curr->idx];
+   int d;
+
+   for (d = p_tbl->depth[p_me->p_curr->idx]; d >= 0; d--)
+   {
+      hsm_state_t* p_s = pp_path[d];
+      TRC(hsm, TRC_EVT, "%s msg %d", p_s->p_name, *p_msg);
+      if ((p_msg = hsm_state_evt(p_s, p_me, p_msg)) == NULL)
+      {  /* Message handled. Execute possible events caused by state change */
+         if (p_me->p_next != NULL)
+         {
+            hsm_tbl_enter(p_me);
+         }
+         break;
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Execute the exit actions from the current state up to the LCA with p_trg.
+-----------------------------------------------------------------------------*/
+STATIC void hsm_tbl_exit(hsm_t* p_me, hsm_state_t* p_trg)
+{
+   hsm_tbl_t* p_tbl = p_me->p_tbl;
+   uint8_t s = p_me->p_curr->idx;
+   int lca = p_tbl->lca[s][p_trg->idx];
+   int d;
+
+   for (d = p_tbl->depth[s]; d > lca; d--)
+   {
+      TRC(hsm, TRC_EVT, "%s exit", p_tbl->path[s][d]->p_name);
+      hsm_state_evt(p_tbl->path[s][d], p_me, &hsm_msg_exit);
+   }
+   p_me->p_curr = p_tbl->path[s][lca];
+}
+
+/*-----------------------------------------------------------------------------
+Execute the entry actions from the current state down to the next state, then
+the init actions and their entry actions until no init transition is taken.
+-----------------------------------------------------------------------------*/
+STATIC void hsm_tbl_enter(hsm_t* p_me)
+{
+   hsm_tbl_t* p_tbl = p_me->p_tbl;
+
+   do
+   {
+      uint8_t t = p_me->p_next->idx;
+      int d = p_tbl->depth[p_me->p_curr->idx];
+
+      REQUIRE(p_tbl->path[t][d] == p_me->p_curr);
+      for (d++; d <= p_tbl->depth[t]; d++)
+      {
+         TRC(hsm, TRC_EVT, "%s entry", p_tbl->path[t][d]->p_name);
+         hsm_state_evt(p_tbl->path[t][d], p_me, &hsm_msg_entry);
+      }
+      p_me->p_curr = p_me->p_next;
+      p_me->p_next = NULL;
+      hsm_state_evt(p_me->p_curr, p_me, &hsm_msg_init);
+      if (p_me->p_next != NULL)
+      {
+         TRC(hsm, TRC_EVT, "%s init", p_me->p_curr->p_name);
+      }
+   } while (p_me->p_next != NULL);
+}
+
+#ifdef HSM_PROFILE
+/*-----------------------------------------------------------------------------
+Index the states in link order, the same as hsm_tbl_create().
+-----------------------------------------------------------------------------*/
+STATIC hsm_prof_t* hsm_prof_create(hsm_t* p_me)
+{
+   hsm_prof_t* p_prof = (hsm_prof_t*)calloc(1, sizeof(hsm_prof_t));
+   hsm_state_t* p_s;
+
+   REQUIRE(p_prof != NULL);
+   for (p_s = &p_me->top; p_s != NULL; p_s = p_s->p_link)
+   {
+      REQUIRE(p_prof->n_states < HSM_MAX_STATES);
+      p_s->idx = p_prof->n_states;
+      p_prof->p_states[p_prof->n_states++] = p_s;
+   }
+   p_prof->epoch = hsm_prof_ns();
+   return p_prof;
+}
+
+/*-----------------------------------------------------------------------------
+Call the handler of a state and account the call to it. The time of the calls
+nested in it is subtracted from its self time.
+-----------------------------------------------------------------------------*/
+STATIC hsm_msg_t const* hsm_prof_evt(hsm_state_t* p_s, hsm_t* p_me,
+   hsm_msg_t const* p_msg)
+{
+   hsm_prof_t* p_prof = p_me->p_prof;
+   hsm_prof_state_t* p_st = &p_prof->states[p_s->idx];
+   hsm_prof_call_t* p_call;
+   hsm_evt_t evt = p_msg->evt;
+   uint64_t child_ns = p_prof->child_ns;
+   uint64_t t0;
+   uint64_t ns;
+
+   p_prof->child_ns = 0;
+   t0 = hsm_prof_ns();
+   p_msg = (*p_s->evt_hnd)(p_me, p_msg);
+   ns = hsm_prof_ns() - t0;
+   switch (evt)
+   {
+   case HSM_EVT_ENTRY:
+      p_st->n_entry++;
+      break;
+   case HSM_EVT_EXIT:
+      p_st->n_exit++;
+      break;
+   case HSM_EVT_INIT:
+      p_st->n_init++;
+      break;
+   default:
+      p_st->n_offered++;
+      p_st->n_handled += (p_msg == NULL);
+      break;
+   }
+   p_st->n_calls++;
+   p_st->ns += ns;
+   p_st->self_ns += ns - p_prof->child_ns;
+   p_st->max_ns = MAX(p_st->max_ns, (uint32_t)MIN(ns, 0xffffffffu));
+   p_prof->child_ns = child_ns + ns;
+   p_call = &p_prof->ring[p_prof->n_calls++ % HSM_PROF_RING];
+   p_call->t0 = t0 - p_prof->epoch;
+   p_call->ns = (uint32_t)MIN(ns, 0xffffffffu);
+   p_call->evt = evt;
+   p_call->state = p_s->idx;
+   return p_msg;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC uint64_t hsm_prof_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC char const* hsm_prof_kind(hsm_evt_t evt)
+{
+   switch (evt)
+   {
+   case HSM_EVT_ENTRY:
+      return "entry";
+   case HSM_EVT_EXIT:
+      return "exit";
+   case HSM_EVT_INIT:
+      return "init";
+   default:
+      return "evt";
+   }
+}
+
 /* END OF FILE ***************************************************************/
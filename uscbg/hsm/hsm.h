@@ -7,7 +7,17 @@ Copyright (c) 2008, All Rights Reserved.
 \brief The hsm (Hierarchical State Machine) interface.
 
 This HSM implementation is based on an articel from
-Embedded System Programming August 2000, Miro Samek, Paul Montgomery. */
+Embedded System Programming August 2000, Miro Samek, Paul Montgomery.
+
+A state machine can be compiled (hsm_compile() or the HSM_COMPILED build flag).
+hsm_start() then flattens the states into a table with the path from the top
+state to every state and the least common anchestor of every (source, target)
+pair. Dispatch, exit and entry sequences are indexed in the table instead of
+following the super state pointers.
+
+The HSM_PROFILE build flag times every state handler call and counts the
+transitions of each machine, see hsm_prof_dump(). Without it the dispatch is
+unchanged and the hsm_prof functions do nothing. */
 /*---------------------------------------------------------------------------*/
 #ifndef HSM_H
 #define HSM_H
@@ -16,6 +26,10 @@ Embedded System Programming August 2000, Miro Samek, Paul Montgomery. */
 /* EXPORTED DEFINES **********************************************************/
 
 #define HSM_MSG_PROCESSED 0
+#define HSM_MAX_STATES 32  /*!< Max states (with top) of a compiled machine */
+#ifndef HSM_PROF_RING
+#define HSM_PROF_RING 1024 /*!< Handler calls kept for the Chrome trace */
+#endif
 
 /* EXPORTED DATA TYPES *******************************************************/
 typedef int hsm_evt_t;
@@ -56,14 +70,22 @@ typedef struct hsm_state
    struct hsm_state* p_super; /*!< Super state. Defines the nesting */
    hsm_evt_hnd_t* evt_hnd; /*!< The state event handler function */
    char const* p_name;     /*!< Name of the state */
+   struct hsm_state* p_link; /*!< Next state of the machine (top is first) */
+   uint8_t idx;            /*!< Index in the state table (compiled) */
 } hsm_state_t;
 
+typedef struct hsm_tbl hsm_tbl_t;   /*!< State table (hsm.c) */
+typedef struct hsm_prof hsm_prof_t; /*!< Profile (hsm.c) */
+
 struct hsm                 /*!< The state machine base class */
 {
    char const* p_name;     /*!< Name of the state machine*/
    hsm_state_t* p_curr;    /*!< Current state */
    hsm_state_t* p_next;    /*!< Next state. (Non 0 if transition taken) */
    hsm_state_t top;        /*!< Top most state */
+   bool_t compiled;        /*!< Build and use the state table on start */
+   hsm_tbl_t* p_tbl;       /*!< State table (NULL if not compiled) */
+   hsm_prof_t* p_prof;     /*!< Profile (NULL without HSM_PROFILE) */
 };
 
 /* GLOBAL VARIABLES **********************************************************/
@@ -89,11 +111,34 @@ void hsm_ctor(
 #define HSM_CTOR(me, name, hnd)\
    hsm_ctor(REINTERPRET_CAST(hsm_t*, (me)), name, hnd)
 
+/*---------------------------------------------------------------------------*/
+/*! \brief HSM destructor. Frees the state table of a compiled machine. */
+/*---------------------------------------------------------------------------*/
+void hsm_dtor(
+   hsm_t* p_me             /*!< this */
+   );
+#define HSM_DTOR(me)\
+   hsm_dtor(REINTERPRET_CAST(hsm_t*, (me)))
+
+/*---------------------------------------------------------------------------*/
+/*! \brief HSM compile.
+
+Selects table driven (TRUE) or pointer walking (FALSE) dispatch. Must be called
+before hsm_start(), the default is TRUE if built with HSM_COMPILED. */
+/*---------------------------------------------------------------------------*/
+void hsm_compile(
+   hsm_t* p_me,            /*!< this */
+   bool_t on               /*!< Compiled */
+   );
+#define HSM_COMPILE(me, on)\
+   hsm_compile(REINTERPRET_CAST(hsm_t*, (me)), (on))
+
 /*---------------------------------------------------------------------------*/
 /*! \brief HSM state constructor.
 
 This function creates the state objects and sets up the the state hierarchy.
-It must be called for each state during initialization. */
+It must be called for each state during initialization, after the super state
+is constructed. */
 /*---------------------------------------------------------------------------*/
 void hsm_state_ctor(
    hsm_state_t* p_me,      /*!< this */
@@ -110,7 +155,7 @@ void hsm_state_ctor(
 
 Enters and start the top state. After the top state entry it will follow the
 trace if init actions and for each init action the trace of entry actions will
-be executed. */
+be executed. A compiled state machine builds its state table first. */
 /*---------------------------------------------------------------------------*/
 void hsm_start(
    hsm_t* p_me             /*!< this */
@@ -165,18 +210,69 @@ void hsm_state_init(
 /*! \brief HSM state transition.
 
 This function will take the state mashine from the cureent state to the target
-state and call all defined exit, entry and init functions on the path. */
+state and call all defined exit, entry and init functions on the path.
+A state machine that is not compiled looks up the least common anchestor on
+every transition, a compiled one reads it from its table. */
 /*---------------------------------------------------------------------------*/
 void hsm_state_tran(
    hsm_t* p_me,            /*!< this */
-   hsm_state_t* p_trg,     /*!< The target state to transit to */
-   uint8_t* p_to_lca       /*!< Steps to the least common anchestor */
+   hsm_state_t* p_trg      /*!< The target state to transit to */
    );
 #define HSM_STATE_TRAN(me, trg)\
-{\
-   static uint8_t to_lca = 0;\
-   hsm_state_tran(REINTERPRET_CAST(hsm_t*, (me)), (trg), &to_lca);\
-}
+   hsm_state_tran(REINTERPRET_CAST(hsm_t*, (me)), (trg))
+
+/*---------------------------------------------------------------------------*/
+/*! \brief HSM profile dump.
+
+Traces (hsm component, TRC_INFO) the calls, user events handled, total and self
+time (without the nested exit calls of a transition) of each state handler and
+the transitions taken, source to target. Must be called by the thread that
+dispatches the events of the machine, like all hsm_prof functions. */
+/*---------------------------------------------------------------------------*/
+void hsm_prof_dump(
+   hsm_t* p_me             /*!< this */
+   );
+#define HSM_PROF_DUMP(me)\
+   hsm_prof_dump(REINTERPRET_CAST(hsm_t*, (me)))
+
+/*---------------------------------------------------------------------------*/
+/*! \brief HSM profile export to CSV.
+
+One "state" row per state (name, calls, user events offered and handled,
+entries, exits, inits, total, self and max ns) and one "tran" row per
+(source, target) pair taken.
+\return FALSE if there is no profile or the file could not be written */
+/*---------------------------------------------------------------------------*/
+bool_t hsm_prof_csv(
+   hsm_t* p_me,            /*!< this */
+   char const* p_file_name /*!< File to create */
+   );
+#define HSM_PROF_CSV(me, file_name)\
+   hsm_prof_csv(REINTERPRET_CAST(hsm_t*, (me)), (file_name))
+
+/*---------------------------------------------------------------------------*/
+/*! \brief HSM profile export to Chrome trace JSON.
+
+Writes the last HSM_PROF_RING handler calls as complete ("X") events of one
+thread, nested exit calls show inside the handler taking the transition. Open
+in chrome://tracing or Perfetto.
+\return FALSE if there is no profile or the file could not be written */
+/*---------------------------------------------------------------------------*/
+bool_t hsm_prof_chrome(
+   hsm_t* p_me,            /*!< this */
+   char const* p_file_name /*!< File to create */
+   );
+#define HSM_PROF_CHROME(me, file_name)\
+   hsm_prof_chrome(REINTERPRET_CAST(hsm_t*, (me)), (file_name))
+
+/*---------------------------------------------------------------------------*/
+/*! \brief HSM profile reset. Clears the counters, times and recent calls. */
+/*---------------------------------------------------------------------------*/
+void hsm_prof_reset(
+   hsm_t* p_me             /*!< this */
+   );
+#define HSM_PROF_RESET(me)\
+   hsm_prof_reset(REINTERPRET_CAST(hsm_t*, (me)))
 
 #endif /* #ifndef HSM_H */
 /* END OF FILE ***************************************************************/
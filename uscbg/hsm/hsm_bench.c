@@ -0,0 +1,370 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file hsm_bench.c
+\brief State machine dispatch benchmark.
+
+Usage: USHsmBench [rounds [profile]]
+Replays a game on copies of the server (srv_hsm) and client (main_hsm) state
+hierarchies, with and without the state table. The handlers only count, the
+time is the dispatch, exit, entry and init overhead of the framework.
+
+Built with HSM_PROFILE the profile of the compiled run of each machine is
+written to <profile>_<machine>.csv and <profile>_<machine>.json. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "trc.h"
+#include "hsm.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define BENCH_MAX_STATES (16)
+#define BENCH_MAX_STEPS  (64)
+#define BENCH_TOP        (-1)     /* Top state of the hsm */
+#define BENCH_NONE       (-1)     /* No transition */
+#define BENCH_UNHANDLED  (99)     /* Event not handled by any state */
+
+/* LOCAL DATATYPES ***********************************************************/
+typedef struct
+{
+   int up;                    /* Levels above the current state handling it */
+   int trg;                   /* Transition target or BENCH_NONE */
+   int leaf;                  /* Current state after the event */
+} bench_step_t;
+
+typedef struct
+{
+   char const* p_name;
+   int n_states;
+   char const* names[BENCH_MAX_STATES];
+   int super[BENCH_MAX_STATES];  /* Super state or BENCH_TOP */
+   int init[BENCH_MAX_STATES];   /* Init transition target or BENCH_NONE */
+   int init_top;                 /* Init transition of the top state */
+   int n_steps;
+   bench_step_t steps[BENCH_MAX_STEPS];
+} bench_def_t;
+
+typedef struct
+{
+   hsm_t super;
+   hsm_state_t states[BENCH_MAX_STATES];
+   bench_def_t const* p_def;
+   int step;                  /* Step dispatched */
+   int up;                    /* Levels left to the handling state */
+   long n_entry;
+   long n_exit;
+} bench_hsm_t;
+
+enum
+{  /* server_hsm.c */
+   SRV_TOP, SRV_LOBBY, SRV_SELECT_COLOR, SRV_GAME, SRV_SETUP,
+   SRV_INVESTMENTS, SRV_SELECT_ACTION, SRV_TAKE_CARD, SRV_BUILD,
+   SRV_END_OF_TURN, SRV_CARD, SRV_LAST
+};
+
+enum
+{  /* main_hsm.c */
+   MAIN_MAINMENU, MAIN_NEWGAME, MAIN_GAME, MAIN_LOBBY, MAIN_WAITNET,
+   MAIN_SELECT_COLOR, MAIN_SELECT_ACTION, MAIN_SELECT_BOARD_CARD,
+   MAIN_SELECT_PLAYER_CARD, MAIN_SELECT_ROTATION, MAIN_SELECT_BOARD_LOT,
+   MAIN_LAST
+};
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+STATIC hsm_msg_t const* bench_hnd(hsm_t* p_hsm, hsm_msg_t const* p_msg);
+STATIC void bench_ctor(bench_hsm_t* p_me, bench_def_t const* p_def,
+   bool_t compiled);
+STATIC bool_t bench_round(bench_hsm_t* p_me, bool_t check);
+STATIC double bench_run(bench_def_t const* p_def, bool_t compiled, int rounds,
+   char const* p_prof, long* p_entry, long* p_exit);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+static char trc_buf[0x8000];
+
+/* A game of two players seen from the server: lobby, colors, two rounds of
+investments, actions and end of turn, then back to the lobby */
+static bench_def_t const bench_srv =
+{
+   "srv", SRV_LAST,
+   {"top", "lobby", "select_color", "game", "setup", "investments",
+    "select_action", "action_take_card", "action_build", "end_of_turn",
+    "card"},
+   {BENCH_TOP, SRV_TOP, SRV_TOP, SRV_TOP, SRV_GAME, SRV_GAME, SRV_GAME,
+    SRV_GAME, SRV_GAME, SRV_GAME, SRV_GAME},
+   {BENCH_NONE, BENCH_NONE, BENCH_NONE, SRV_INVESTMENTS, BENCH_NONE,
+    BENCH_NONE, BENCH_NONE, BENCH_NONE, BENCH_NONE, BENCH_NONE, BENCH_NONE},
+   SRV_LOBBY,
+   26,
+   {
+      {0, BENCH_NONE, SRV_LOBBY},                     /* Join */
+      {0, BENCH_NONE, SRV_LOBBY},                     /* Join */
+      {0, SRV_SELECT_COLOR, SRV_SELECT_COLOR},        /* Start */
+      {0, BENCH_NONE, SRV_SELECT_COLOR},              /* Color */
+      {0, SRV_SELECT_COLOR, SRV_SELECT_COLOR},        /* Next player */
+      {0, BENCH_NONE, SRV_SELECT_COLOR},              /* Color */
+      {0, SRV_GAME, SRV_INVESTMENTS},                 /* All colors */
+      {0, BENCH_NONE, SRV_INVESTMENTS},               /* Player card */
+      {0, SRV_SELECT_ACTION, SRV_SELECT_ACTION},      /* Done */
+      {0, SRV_TAKE_CARD, SRV_TAKE_CARD},              /* Take card */
+      {2, BENCH_NONE, SRV_TAKE_CARD},                 /* Chat (top) */
+      {0, SRV_SELECT_ACTION, SRV_SELECT_ACTION},      /* Board card */
+      {BENCH_UNHANDLED, BENCH_NONE, SRV_SELECT_ACTION}, /* Stray command */
+      {0, SRV_BUILD, SRV_BUILD},                      /* Build */
+      {0, BENCH_NONE, SRV_BUILD},                     /* Board lot */
+      {0, SRV_SELECT_ACTION, SRV_SELECT_ACTION},      /* Built */
+      {0, SRV_END_OF_TURN, SRV_END_OF_TURN},          /* End of turn */
+      {0, SRV_INVESTMENTS, SRV_INVESTMENTS},          /* Next player */
+      {0, SRV_SELECT_ACTION, SRV_SELECT_ACTION},      /* Done */
+      {0, SRV_TAKE_CARD, SRV_TAKE_CARD},              /* Take card */
+      {0, SRV_CARD, SRV_CARD},                        /* Event card */
+      {1, SRV_SELECT_ACTION, SRV_SELECT_ACTION},      /* Done (game) */
+      {0, SRV_END_OF_TURN, SRV_END_OF_TURN},          /* End of turn */
+      {1, BENCH_NONE, SRV_END_OF_TURN},               /* Sync (game) */
+      {0, SRV_GAME, SRV_INVESTMENTS},                 /* Next round */
+      {2, SRV_LOBBY, SRV_LOBBY},                      /* Game over (top) */
+   }
+};
+
+/* The same game seen from a client, with gui events */
+static bench_def_t const bench_main =
+{
+   "main", MAIN_LAST,
+   {"mainmenu", "newgame", "game", "lobby", "waitnet", "select_color",
+    "select_action", "select_board_card", "select_player_card",
+    "select_building_rotation", "select_board_lot"},
+   {BENCH_TOP, BENCH_TOP, BENCH_TOP, MAIN_GAME, MAIN_GAME, MAIN_GAME,
+    MAIN_GAME, MAIN_GAME, MAIN_GAME, MAIN_GAME, MAIN_GAME},
+   {BENCH_NONE, BENCH_NONE, MAIN_WAITNET, BENCH_NONE, BENCH_NONE, BENCH_NONE,
+    BENCH_NONE, BENCH_NONE, BENCH_NONE, BENCH_NONE, BENCH_NONE},
+   MAIN_NEWGAME,
+   24,
+   {
+      {0, MAIN_MAINMENU, MAIN_MAINMENU},              /* Menu */
+      {BENCH_UNHANDLED, BENCH_NONE, MAIN_MAINMENU},   /* Mouse motion */
+      {0, MAIN_NEWGAME, MAIN_NEWGAME},                /* New game */
+      {0, MAIN_LOBBY, MAIN_LOBBY},                    /* Connected */
+      {0, BENCH_NONE, MAIN_LOBBY},                    /* Player joined */
+      {0, MAIN_WAITNET, MAIN_WAITNET},                /* Start */
+      {1, BENCH_NONE, MAIN_WAITNET},                  /* Update (game) */
+      {0, MAIN_SELECT_COLOR, MAIN_SELECT_COLOR},      /* Select color */
+      {BENCH_UNHANDLED, BENCH_NONE, MAIN_SELECT_COLOR}, /* Mouse motion */
+      {0, MAIN_WAITNET, MAIN_WAITNET},                /* Color */
+      {0, MAIN_SELECT_PLAYER_CARD, MAIN_SELECT_PLAYER_CARD}, /* Invest */
+      {1, BENCH_NONE, MAIN_SELECT_PLAYER_CARD},       /* Update (game) */
+      {0, MAIN_WAITNET, MAIN_WAITNET},                /* Card */
+      {0, MAIN_SELECT_ACTION, MAIN_SELECT_ACTION},    /* Select action */
+      {0, MAIN_SELECT_BOARD_CARD, MAIN_SELECT_BOARD_CARD}, /* Take card */
+      {0, MAIN_WAITNET, MAIN_WAITNET},                /* Card */
+      {0, MAIN_SELECT_ACTION, MAIN_SELECT_ACTION},    /* Select action */
+      {0, MAIN_SELECT_BOARD_LOT, MAIN_SELECT_BOARD_LOT}, /* Build */
+      {BENCH_UNHANDLED, BENCH_NONE, MAIN_SELECT_BOARD_LOT}, /* Mouse motion */
+      {0, MAIN_SELECT_ROTATION, MAIN_SELECT_ROTATION}, /* Lot */
+      {0, MAIN_WAITNET, MAIN_WAITNET},                /* Rotation */
+      {1, MAIN_GAME, MAIN_WAITNET},                   /* Resync (game) */
+      {1, BENCH_NONE, MAIN_WAITNET},                  /* Update (game) */
+      {1, MAIN_MAINMENU, MAIN_MAINMENU},              /* Disconnect (game) */
+   }
+};
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int main(int argc, char* argv[])
+{
+   bench_def_t const* defs[] = {&bench_srv, &bench_main};
+   int rounds = (argc > 1)?atoi(argv[1]):200000;
+   char const* p_prof = (argc > 2)?argv[2]:NULL;
+   int i;
+
+   TRC_INIT((char*)&trc_buf, 0x8000);
+   TRC_MASK_FILTER(TRC_ERROR);
+   TRC_MODE_SET(TRC_MODE_PRINT);
+   hsm_init();
+
+   if (rounds <= 0)
+   {
+      printf("Usage: %s [rounds [profile]]\n", argv[0]);
+      return 1;
+   }
+   for (i=0;i<2;i++)
+   {
+      long entries[2];
+      long exits[2];
+      double ns[2];
+      ns[0] = bench_run(defs[i], FALSE, rounds, NULL, &entries[0], &exits[0]);
+      ns[1] = bench_run(defs[i], TRUE, rounds, p_prof, &entries[1],
+         &exits[1]);
+      if ((ns[0] < 0) || (ns[1] < 0) ||
+          (entries[0] != entries[1]) || (exits[0] != exits[1]))
+      {
+         printf("%s: compiled and interpreted dispatch differ\n",
+            defs[i]->p_name);
+         return 1;
+      }
+      printf("%s: %d states, %d events per round, %.1f entries per round: "
+         "%.1f ns/event, compiled %.1f ns/event\n", defs[i]->p_name,
+         defs[i]->n_states + 1, defs[i]->n_steps,
+         (double)entries[0] / rounds, ns[0], ns[1]);
+   }
+   return 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void assert(const char* test, const char* file, int line)
+{
+   printf("ASSERT %s %s %d", test, file, line);
+   exit(-1);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+The handler of all states. Init transitions are looked up for the current
+state, a user event is handled 'up' levels above the current state.
+-----------------------------------------------------------------------------*/
+STATIC hsm_msg_t const* bench_hnd(hsm_t* p_hsm, hsm_msg_t const* p_msg)
+{
+   bench_hsm_t* p_h = REINTERPRET_CAST(bench_hsm_t*, p_hsm);
+
+   switch(HSM_EVT_GET(p_msg))
+   {
+   case HSM_EVT_ENTRY:
+      p_h->n_entry++;
+      return HSM_MSG_PROCESSED;
+   case HSM_EVT_EXIT:
+      p_h->n_exit++;
+      return HSM_MSG_PROCESSED;
+   case HSM_EVT_INIT:
+   {
+      int trg = p_h->p_def->init_top;
+      if (hsm_state_curr(p_hsm) != &p_hsm->top)
+      {
+         trg = p_h->p_def->init[hsm_state_curr(p_hsm) - p_h->states];
+      }
+      if (trg != BENCH_NONE)
+      {
+         HSM_STATE_INIT(p_hsm, &p_h->states[trg]);
+      }
+      return HSM_MSG_PROCESSED;
+   }
+   default:
+      if (p_h->up-- > 0)
+      {
+         return p_msg;
+      }
+      if (p_h->p_def->steps[p_h->step].trg != BENCH_NONE)
+      {
+         hsm_state_tran(p_hsm, &p_h->states[p_h->p_def->steps[p_h->step].trg]);
+      }
+      return HSM_MSG_PROCESSED;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC void bench_ctor(bench_hsm_t* p_me, bench_def_t const* p_def,
+   bool_t compiled)
+{
+   int i;
+
+   memset(p_me, 0, sizeof(bench_hsm_t));
+   p_me->p_def = p_def;
+   HSM_CTOR(p_me, p_def->p_name, bench_hnd);
+   HSM_COMPILE(p_me, compiled);
+   for (i=0;i<p_def->n_states;i++)
+   {  /* Super states are listed first */
+      REQUIRE(p_def->super[i] < i);
+      HSM_STATE_CTOR(&p_me->states[i], p_def->names[i], bench_hnd,
+         (p_def->super[i] == BENCH_TOP) ?
+         &p_me->super.top : &p_me->states[p_def->super[i]]);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Dispatch the steps once.
+\return FALSE if check is set and a step did not end in its leaf state
+-----------------------------------------------------------------------------*/
+STATIC bool_t bench_round(bench_hsm_t* p_me, bool_t check)
+{
+   bench_def_t const* p_def = p_me->p_def;
+   hsm_msg_t msg;
+
+   msg.evt = HSM_EVT_USER;
+   for (p_me->step=0;p_me->step<p_def->n_steps;p_me->step++)
+   {
+      p_me->up = p_def->steps[p_me->step].up;
+      HSM_EVT(p_me, &msg);
+      if (check && (hsm_state_curr(&p_me->super) !=
+                    &p_me->states[p_def->steps[p_me->step].leaf]))
+      {
+         printf("%s: step %d ends in %s\n", p_def->p_name, p_me->step,
+            hsm_state_curr(&p_me->super)->p_name);
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+One checked round, then the timed rounds. The profile (if any) is written to
+p_prof files.
+\return ns per event or -1 if the check failed
+-----------------------------------------------------------------------------*/
+STATIC double bench_run(bench_def_t const* p_def, bool_t compiled, int rounds,
+   char const* p_prof, long* p_entry, long* p_exit)
+{
+   bench_hsm_t* p_hsm = (bench_hsm_t*)malloc(sizeof(bench_hsm_t));
+   struct timespec t0, t1;
+   double ns;
+   int i;
+
+   REQUIRE(p_hsm != NULL);
+   bench_ctor(p_hsm, p_def, compiled);
+   HSM_START(p_hsm);
+   if (!bench_round(p_hsm, TRUE))
+   {
+      HSM_DTOR(p_hsm);
+      free(p_hsm);
+      return -1;
+   }
+   p_hsm->n_entry = 0;
+   p_hsm->n_exit = 0;
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   for (i=0;i<rounds;i++)
+   {
+      bench_round(p_hsm, FALSE);
+   }
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) /
+      ((double)rounds * p_def->n_steps);
+   *p_entry = p_hsm->n_entry;
+   *p_exit = p_hsm->n_exit;
+   if (p_prof != NULL)
+   {
+      char name[256];
+      snprintf(name, sizeof(name), "%s_%s.csv", p_prof, p_def->p_name);
+      if (!HSM_PROF_CSV(p_hsm, name))
+      {
+         printf("%s: no profile written (built without HSM_PROFILE?)\n",
+            p_def->p_name);
+      }
+      snprintf(name, sizeof(name), "%s_%s.json", p_prof, p_def->p_name);
+      HSM_PROF_CHROME(p_hsm, name);
+   }
+   HSM_DTOR(p_hsm);
+   free(p_hsm);
+   return ns;
+}
+
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,189 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file hsm_queue.c
+\brief The hsm event queue implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "trc.h"
+#include "hsm.h"
+#include "hsm_queue.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define HSM_QUEUE_MASK (HSM_QUEUE_SZ - 1)
+#define HSM_QUEUE_LOW (HSM_QUEUE_PRIOS - 1) /* Priority of recalled events */
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+STATIC bool_t hsm_ring_put(hsm_ring_t* p_r, hsm_queue_msg_t const* p_msg,
+   bool_t front);
+STATIC void hsm_ring_get(hsm_ring_t* p_r, hsm_queue_msg_t* p_msg);
+STATIC void hsm_queue_recall(hsm_queue_t* p_q);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+TRC_EXT(hsm);
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void hsm_queue_init(hsm_queue_t* p_q, hsm_t* p_hsm)
+{
+   memset(p_q, 0, sizeof(hsm_queue_t));
+   p_q->p_hsm = p_hsm;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t hsm_queue_post(hsm_queue_t* p_q, hsm_evt_t evt, int arg, int prio)
+{
+   hsm_queue_msg_t msg;
+
+   REQUIRE((prio >= 0) && (prio < HSM_QUEUE_PRIOS));
+   msg.super.evt = evt;
+   msg.arg = arg;
+   if (!hsm_ring_put(&p_q->rings[prio], &msg, FALSE))
+   {
+      TRC_ERR(hsm, "Error: %s queue full, event %d dropped",
+         p_q->p_hsm->p_name, evt);
+      return FALSE;
+   }
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+The highest priority event is dispatched first. An event deferred by its
+handler goes to the deferred ring, a state change recalls the deferred events.
+-----------------------------------------------------------------------------*/
+int hsm_queue_run(hsm_queue_t* p_q, int max)
+{
+   int n = 0;
+
+   if (p_q->running)
+   { /* Run to completion, the running hsm_queue_run() dispatches it */
+      return 0;
+   }
+   p_q->running = TRUE;
+   while ((max == 0) || (n < max))
+   {
+      hsm_state_t* p_state = hsm_state_curr(p_q->p_hsm);
+      hsm_queue_msg_t msg;
+      int prio;
+
+      for (prio=0;prio<HSM_QUEUE_PRIOS;prio++)
+      {
+         if (p_q->rings[prio].n > 0)
+         {
+            break;
+         }
+      }
+      if (prio == HSM_QUEUE_PRIOS)
+      {
+         break;
+      }
+      hsm_ring_get(&p_q->rings[prio], &msg);
+      p_q->defer = FALSE;
+      HSM_EVT(p_q->p_hsm, &msg);
+      n++;
+      if (p_q->defer && !hsm_ring_put(&p_q->deferred, &msg, FALSE))
+      {
+         TRC_ERR(hsm, "Error: %s deferred queue full, event %d dropped",
+            p_q->p_hsm->p_name, msg.super.evt);
+      }
+      if (hsm_state_curr(p_q->p_hsm) != p_state)
+      {
+         hsm_queue_recall(p_q);
+      }
+   }
+   p_q->running = FALSE;
+   return n;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void hsm_queue_defer(hsm_queue_t* p_q)
+{
+   REQUIRE(p_q->running);
+   p_q->defer = TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int hsm_queue_depth(hsm_queue_t const* p_q)
+{
+   int n = 0;
+   int prio;
+
+   for (prio=0;prio<HSM_QUEUE_PRIOS;prio++)
+   {
+      n += p_q->rings[prio].n;
+   }
+   return n;
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+\return FALSE if the ring is full
+-----------------------------------------------------------------------------*/
+STATIC bool_t hsm_ring_put(hsm_ring_t* p_r, hsm_queue_msg_t const* p_msg,
+   bool_t front)
+{
+   if (p_r->n == HSM_QUEUE_SZ)
+   {
+      return FALSE;
+   }
+   if (front)
+   {
+      p_r->head = (p_r->head - 1) & HSM_QUEUE_MASK;
+      p_r->msgs[p_r->head] = *p_msg;
+   }
+   else
+   {
+      p_r->msgs[(p_r->head + p_r->n) & HSM_QUEUE_MASK] = *p_msg;
+   }
+   p_r->n++;
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+Take the first message, the ring is not empty.
+-----------------------------------------------------------------------------*/
+STATIC void hsm_ring_get(hsm_ring_t* p_r, hsm_queue_msg_t* p_msg)
+{
+   REQUIRE(p_r->n > 0);
+   *p_msg = p_r->msgs[p_r->head];
+   p_r->head = (p_r->head + 1) & HSM_QUEUE_MASK;
+   p_r->n--;
+}
+
+/*-----------------------------------------------------------------------------
+Move the deferred messages to the front of the lowest priority, in the order
+they were deferred. The last ones stay deferred if they do not all fit.
+-----------------------------------------------------------------------------*/
+STATIC void hsm_queue_recall(hsm_queue_t* p_q)
+{
+   hsm_ring_t* p_d = &p_q->deferred;
+   hsm_ring_t* p_r = &p_q->rings[HSM_QUEUE_LOW];
+   int n = MIN(p_d->n, HSM_QUEUE_SZ - p_r->n);
+   int i;
+
+   for (i=n-1;i>=0;i--)
+   { /* Last recalled first, it ends up behind the others */
+      hsm_ring_put(p_r, &p_d->msgs[(p_d->head + i) & HSM_QUEUE_MASK], TRUE);
+   }
+   p_d->head = (p_d->head + n) & HSM_QUEUE_MASK;
+   p_d->n -= n;
+}
+
+/* END OF FILE ***************************************************************/
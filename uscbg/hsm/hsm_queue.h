@@ -0,0 +1,105 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file hsm_queue.h
+\brief The hsm event queue interface.
+
+A bounded event queue for one state machine, no allocation. Every event is
+posted with its argument, the message is copied into the queue entry. Events
+are dispatched run to completion: an event posted while another one is
+dispatched (from a handler or a function it calls) waits until the first one
+and all its transitions are done. Priority 0 is dispatched first.
+
+A handler can defer the event it is dispatching. Deferred events (with their
+arguments) are posted again after the next state change, first in the lowest
+priority and in the order they were deferred. */
+/*---------------------------------------------------------------------------*/
+#ifndef HSM_QUEUE_H
+#define HSM_QUEUE_H
+/* INCLUDE FILES *************************************************************/
+#include "hsm.h"
+
+/* EXPORTED DEFINES **********************************************************/
+#define HSM_QUEUE_SZ (16)     /*!< Events per priority (power of 2) */
+#define HSM_QUEUE_PRIOS (2)   /*!< Priorities (0 is the highest) */
+
+/*! Argument of a message dispatched from the queue */
+#define HSM_QUEUE_ARG(msg)\
+   ((REINTERPRET_CAST(hsm_queue_msg_t const*, (msg)))->arg)
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef struct
+{
+   hsm_msg_t super;
+   int arg;                /*!< Event argument */
+} hsm_queue_msg_t;         /*!< Queued message */
+
+typedef struct
+{
+   hsm_queue_msg_t msgs[HSM_QUEUE_SZ];
+   uint8_t head;           /*!< First message */
+   uint8_t n;              /*!< Queued messages */
+} hsm_ring_t;              /*!< Message ring */
+
+typedef struct
+{
+   hsm_t* p_hsm;           /*!< State machine */
+   hsm_ring_t rings[HSM_QUEUE_PRIOS]; /*!< Posted messages */
+   hsm_ring_t deferred;    /*!< Deferred messages */
+   bool_t running;         /*!< Dispatching a message */
+   bool_t defer;           /*!< Defer the dispatched message */
+} hsm_queue_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize an empty queue. */
+/*---------------------------------------------------------------------------*/
+void hsm_queue_init(
+   hsm_queue_t* p_q,       /*!< Queue */
+   hsm_t* p_hsm            /*!< State machine the queue dispatches to */
+   );
+#define HSM_QUEUE_INIT(q, me)\
+   hsm_queue_init((q), REINTERPRET_CAST(hsm_t*, (me)))
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Post an event.
+\return FALSE if the queue of the priority is full (event dropped) */
+/*---------------------------------------------------------------------------*/
+bool_t hsm_queue_post(
+   hsm_queue_t* p_q,       /*!< Queue */
+   hsm_evt_t evt,          /*!< Event */
+   int arg,                /*!< Event argument */
+   int prio                /*!< Priority (< HSM_QUEUE_PRIOS) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Dispatch the queued events. Does nothing when called while an
+event is dispatched, the running hsm_queue_run() dispatches them.
+\return Number of events dispatched */
+/*---------------------------------------------------------------------------*/
+int hsm_queue_run(
+   hsm_queue_t* p_q,       /*!< Queue */
+   int max                 /*!< Max events to dispatch (0 = until empty) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Defer the event being dispatched, called from a handler. */
+/*---------------------------------------------------------------------------*/
+void hsm_queue_defer(
+   hsm_queue_t* p_q        /*!< Queue */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Number of posted events (not deferred). */
+/*---------------------------------------------------------------------------*/
+int hsm_queue_depth(
+   hsm_queue_t const* p_q  /*!< Queue */
+   );
+
+#endif /* #ifndef HSM_QUEUE_H */
+/* END OF FILE ***************************************************************/
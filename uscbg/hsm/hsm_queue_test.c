@@ -0,0 +1,267 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file hsm_queue_test.c
+\brief Event queue test.
+
+Usage: USHsmQueueTest
+Drives a two state machine (wait, ready) through an hsm_queue_t and checks the
+dispatched events and their arguments: priorities, run to completion of events
+posted by a handler, deferral in wait with the recall on the change to ready,
+and a full queue. Returns 0 if all checks pass. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "trc.h"
+#include "hsm.h"
+#include "hsm_queue.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define TEST_MAX_LOG (64)
+
+/* LOCAL DATATYPES ***********************************************************/
+enum
+{
+   TEST_EVT_WORK = HSM_EVT_USER,   /* Deferred in wait */
+   TEST_EVT_READY,                 /* wait -> ready */
+   TEST_EVT_RESET,                 /* ready -> wait */
+   TEST_EVT_CHAIN                  /* Posts TEST_EVT_WORK (arg) in ready */
+};
+
+typedef struct
+{
+   hsm_t super;
+   hsm_state_t wait;
+   hsm_state_t ready;
+   hsm_queue_t queue;
+   int n_log;
+   int log[TEST_MAX_LOG];     /* Arguments of the events handled */
+} test_hsm_t;
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+STATIC hsm_msg_t const* test_top_hnd(test_hsm_t* p_hsm,
+   hsm_msg_t const* p_msg);
+STATIC hsm_msg_t const* test_wait_hnd(test_hsm_t* p_hsm,
+   hsm_msg_t const* p_msg);
+STATIC hsm_msg_t const* test_ready_hnd(test_hsm_t* p_hsm,
+   hsm_msg_t const* p_msg);
+STATIC void test_ctor(test_hsm_t* p_me);
+STATIC bool_t test_check(test_hsm_t* p_me, char const* p_name,
+   int const* p_log, int n);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+static char trc_buf[0x8000];
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int main(int argc, char* argv[])
+{
+   test_hsm_t* p_hsm = (test_hsm_t*)malloc(sizeof(test_hsm_t));
+   bool_t ok = TRUE;
+   int i;
+
+   TOUCH(argc);
+   TOUCH(argv);
+   TRC_INIT((char*)&trc_buf, 0x8000);
+   TRC_MASK_FILTER(TRC_ERROR);
+   TRC_MODE_SET(TRC_MODE_PRINT);
+   hsm_init();
+   REQUIRE(p_hsm != NULL);
+   test_ctor(p_hsm);
+   HSM_START(p_hsm);
+
+   { /* High priority first, normal in posting order */
+      static int const log[] = {3, 1, 2};
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_RESET, 1, 1);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_RESET, 2, 1);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_RESET, 3, 0);
+      ok &= test_check(p_hsm, "priority", log, 3);
+   }
+   { /* Deferred in wait, recalled in order before the later work */
+      static int const log[] = {10, 11, 12, 0, 10, 11, 13};
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_WORK, 10, 1);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_WORK, 11, 1);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_READY, 12, 1);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_WORK, 13, 1);
+      ok &= test_check(p_hsm, "defer", log, 7);
+   }
+   { /* Posted by a handler, dispatched after the handler is done */
+      static int const log[] = {20, 21, 20};
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_CHAIN, 20, 1);
+      ok &= test_check(p_hsm, "run to completion", log, 3);
+   }
+   { /* Deferred events that do not fit wait for the next state change */
+      static int const log[] = {0, 30, 31, 32, 0, 30, 33, 34, 35, 36, 37, 38,
+         39, 40, 41, 42, 43, 44, 45, 46, 47};
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_RESET, 0, 1);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_WORK, 30, 1);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_WORK, 31, 1);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_READY, 32, 1);
+      for (i=33;i<=44;i++)
+      {
+         hsm_queue_post(&p_hsm->queue, TEST_EVT_WORK, i, 1);
+      }
+      hsm_queue_run(&p_hsm->queue, 3);  /* Reset and two deferred */
+      for (i=45;i<=47;i++)
+      {
+         hsm_queue_post(&p_hsm->queue, TEST_EVT_WORK, i, 1);
+      }
+      if (hsm_queue_post(&p_hsm->queue, TEST_EVT_WORK, 48, 1) ||
+          (hsm_queue_depth(&p_hsm->queue) != HSM_QUEUE_SZ))
+      {
+         printf("full: event posted to a full queue\n");
+         ok = FALSE;
+      }
+      ok &= test_check(p_hsm, "recall", log, 21);
+   }
+   { /* The one left is deferred again in wait and recalled in ready */
+      static int const log[] = {0, 31, 50, 0, 31};
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_RESET, 0, 1);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_READY, 50, 1);
+      ok &= test_check(p_hsm, "recall rest", log, 5);
+   }
+   HSM_DTOR(p_hsm);
+   free(p_hsm);
+   printf("hsm queue: %s\n", ok ? "ok" : "FAILED");
+   return ok ? 0 : 1;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void assert(const char* test, const char* file, int line)
+{
+   printf("ASSERT %s %s %d", test, file, line);
+   exit(-1);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC hsm_msg_t const* test_top_hnd(test_hsm_t* p_hsm,
+   hsm_msg_t const* p_msg)
+{
+   switch(HSM_EVT_GET(p_msg))
+   {
+   case HSM_EVT_INIT:
+      HSM_STATE_INIT(p_hsm, &p_hsm->wait);
+      p_msg = HSM_MSG_PROCESSED;
+      break;
+   case TEST_EVT_RESET:
+      p_hsm->log[p_hsm->n_log++] = HSM_QUEUE_ARG(p_msg);
+      HSM_STATE_TRAN(p_hsm, &p_hsm->wait);
+      p_msg = HSM_MSG_PROCESSED;
+      break;
+   default:
+      break;
+   }
+   return p_msg;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC hsm_msg_t const* test_wait_hnd(test_hsm_t* p_hsm,
+   hsm_msg_t const* p_msg)
+{
+   switch(HSM_EVT_GET(p_msg))
+   {
+   case HSM_EVT_ENTRY:
+   case HSM_EVT_EXIT:
+      p_msg = HSM_MSG_PROCESSED;
+      break;
+   case TEST_EVT_WORK:
+      p_hsm->log[p_hsm->n_log++] = HSM_QUEUE_ARG(p_msg);
+      hsm_queue_defer(&p_hsm->queue);
+      p_msg = HSM_MSG_PROCESSED;
+      break;
+   case TEST_EVT_READY:
+      p_hsm->log[p_hsm->n_log++] = HSM_QUEUE_ARG(p_msg);
+      HSM_STATE_TRAN(p_hsm, &p_hsm->ready);
+      p_msg = HSM_MSG_PROCESSED;
+      break;
+   default:
+      break;
+   }
+   return p_msg;
+}
+
+/*-----------------------------------------------------------------------------
+The entry of ready logs 0.
+-----------------------------------------------------------------------------*/
+STATIC hsm_msg_t const* test_ready_hnd(test_hsm_t* p_hsm,
+   hsm_msg_t const* p_msg)
+{
+   switch(HSM_EVT_GET(p_msg))
+   {
+   case HSM_EVT_ENTRY:
+      p_hsm->log[p_hsm->n_log++] = 0;
+      p_msg = HSM_MSG_PROCESSED;
+      break;
+   case HSM_EVT_EXIT:
+      p_msg = HSM_MSG_PROCESSED;
+      break;
+   case TEST_EVT_WORK:
+      p_hsm->log[p_hsm->n_log++] = HSM_QUEUE_ARG(p_msg);
+      p_msg = HSM_MSG_PROCESSED;
+      break;
+   case TEST_EVT_CHAIN:
+      p_hsm->log[p_hsm->n_log++] = HSM_QUEUE_ARG(p_msg);
+      hsm_queue_post(&p_hsm->queue, TEST_EVT_WORK, HSM_QUEUE_ARG(p_msg), 1);
+      hsm_queue_run(&p_hsm->queue, 0);  /* Does nothing while dispatching */
+      p_hsm->log[p_hsm->n_log++] = HSM_QUEUE_ARG(p_msg) + 1;
+      p_msg = HSM_MSG_PROCESSED;
+      break;
+   default:
+      break;
+   }
+   return p_msg;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC void test_ctor(test_hsm_t* p_me)
+{
+   memset(p_me, 0, sizeof(test_hsm_t));
+   HSM_CTOR(p_me, "test", (hsm_evt_hnd_t*)test_top_hnd);
+   HSM_STATE_CTOR(&p_me->wait, "wait", test_wait_hnd, &p_me->super.top);
+   HSM_STATE_CTOR(&p_me->ready, "ready", test_ready_hnd, &p_me->super.top);
+   HSM_QUEUE_INIT(&p_me->queue, p_me);
+}
+
+/*-----------------------------------------------------------------------------
+Run the queue and compare the log with the expected arguments.
+\return FALSE if they differ
+-----------------------------------------------------------------------------*/
+STATIC bool_t test_check(test_hsm_t* p_me, char const* p_name,
+   int const* p_log, int n)
+{
+   int i;
+
+   hsm_queue_run(&p_me->queue, 0);
+   if ((p_me->n_log != n) ||
+       (memcmp(p_me->log, p_log, n * sizeof(int)) != 0))
+   {
+      printf("%s: handled", p_name);
+      for (i=0;i<p_me->n_log;i++)
+      {
+         printf(" %d", p_me->log[i]);
+      }
+      printf(", expected %d events\n", n);
+      p_me->n_log = 0;
+      return FALSE;
+   }
+   p_me->n_log = 0;
+   return TRUE;
+}
+
+/* END OF FILE ***************************************************************/
@@ -29,13 +29,37 @@ Copyright (c) 2013, All Rights Reserved.
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <sys/select.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+#ifdef __linux__
+#define NET_HAS_EPOLL
+#include <sys/epoll.h>
+#include <sys/resource.h>
 #endif
 #include "slnk.h"
 #include "scf.h"
 #include "trc.h"
 #include "net.h"
+#include "net_queue.h"
 
 /* CONSTANTS / MACROS ********************************************************/
+#define NET_MAX_READY (64) /* Max sockets reported per event loop wakeup */
+#define NET_QUEUE_SLOTS (256) /* Poll queue size (power of 2) */
+#define NET_RX_BUF_SZ (4 * (MAX_PACKET_SZ + NET_FRAME_HDR_SZ))
+#define NET_MAX_SOCKETS (65536) /* Sockets above are refused */
+#define NET_TX_MIN_BUFS (16) /* First outbound queue allocation */
+#define NET_MAX_IOV (64) /* Buffers sent per writev */
+#define NET_TX_HIGH_WATER (256 * 1024) /* Default net_cfg_t tx_high_water */
+#define NET_MAX_BATCH (64) /* Connections flushed per net_write_end */
+#define NET_N_FRAMES(len) \
+   (((len) == 0)?1:(((len) + MAX_PACKET_SZ - 1) / MAX_PACKET_SZ))
+#define NET_WIRE_SZ(p_buf) \
+   ((p_buf)->len + NET_FRAME_HDR_SZ * NET_N_FRAMES((p_buf)->len))
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL (0)
+#endif
 
 /* LOCAL DATATYPES ***********************************************************/
 typedef struct
@@ -47,28 +71,113 @@ typedef struct
 
 typedef struct
 {
-   slnk_t slnk;
    int evt;
    int sock;
-   void* data;
    int len;
-} net_evt_t;
+   uint8_t* p_msg;               /*!< Packet larger than data (malloc) */
+   uint8_t data[MAX_PACKET_SZ];
+} net_evt_t;                     /*!< Poll queue slot */
+
+typedef struct
+{
+   int start;                    /*!< First byte of the oldest partial frame */
+   int end;                      /*!< End of received data */
+   uint8_t* p_msg;               /*!< Reassembled frames of a large packet */
+   int msg_len;                  /*!< Bytes in p_msg */
+   int msg_cap;                  /*!< Size of p_msg */
+   uint8_t buf[NET_RX_BUF_SZ];
+} net_rx_t;                      /*!< Receive buffer of a socket */
+
+typedef struct
+{
+   net_rx_t rx;                  /*!< Receive buffer (net thread only) */
+   pthread_mutex_t tx_mutex;     /*!< Protects all tx fields */
+   net_buf_t** pp_tx;            /*!< Ring of queued buffers */
+   int tx_cap;                   /*!< Size of pp_tx (power of 2) */
+   int tx_head;                  /*!< Oldest queued buffer */
+   int tx_n;                     /*!< Number of queued buffers */
+   int tx_off;                   /*!< Bytes of the oldest buffer already sent */
+   int tx_bytes;                 /*!< Unsent bytes */
+   bool_t tx_open;               /*!< Outbound bytes are accepted */
+   bool_t tx_want_write;         /*!< Writable notification enabled */
+   bool_t tx_batched;            /*!< In the flush list of a batch */
+} net_conn_t;                    /*!< Connection state of a socket */
+
+typedef struct
+{
+   int sock;
+   bool_t rd;                    /*!< Readable (or hung up) */
+   bool_t wr;                    /*!< Writable */
+} net_ready_t;
+
+/*---------------------------------------------------------------------------*/
+/* Event loop backend. wait returns the number of ready sockets (or -1).
+want_write may be called from any thread. */
+/*---------------------------------------------------------------------------*/
+typedef bool_t net_loop_open_fn_t(int listener);
+typedef bool_t net_loop_add_fn_t(int sock);
+typedef void net_loop_del_fn_t(int sock);
+typedef void net_loop_want_write_fn_t(int sock, bool_t enable);
+typedef int net_loop_wait_fn_t(net_ready_t* p_ready, int max_socks);
+
+typedef struct
+{
+   const char* p_name;
+   bool_t edge_triggered;        /*!< Sockets must be drained on wakeup */
+   net_loop_open_fn_t* open;
+   net_loop_add_fn_t* add;
+   net_loop_del_fn_t* del;
+   net_loop_want_write_fn_t* want_write;
+   net_loop_wait_fn_t* wait;
+} net_loop_ops_t;
 
 typedef struct
 {
    bool_t started;
    pthread_t thread_id;
-   pthread_mutex_t queue_mutex;
-   slnk_t queue_head;
+   net_queue_t queue;            /*!< Poll queue (net thread to net_poll) */
    slnk_t client_head;
+   net_conn_t** pp_conn;         /*!< Connections indexed by socket */
    net_cfg_t net_cfg;
+   const net_loop_ops_t* p_loop;
+   fd_set master;                /*!< Select: master file descriptor list */
+   fd_set write_master;          /*!< Select: sockets waiting to write */
+   pthread_mutex_t write_mutex;  /*!< Select: protects write_master */
+   int wake_fd[2];               /*!< Select: pipe waking up select */
+   int fdmax;                    /*!< Select: maximum file descriptor */
+#ifdef NET_HAS_EPOLL
+   int epoll_fd;                 /*!< Epoll: instance */
+#endif
 } net_t;
 
 /* LOCAL FUNCTION PROTOTYPES *************************************************/
 static void *server_thread(void *arg);
 static void *client_thread(void *arg);
 static int recv_complete_packet(int sock);
+static bool_t recv_fragment(net_rx_t* p_rx, uint8_t* p_data, int len);
+static net_conn_t* conn_open(int sock);
+static void conn_close(int sock);
+static void conn_flush(net_conn_t* p_conn, int sock);
+static void conn_drop(net_conn_t* p_conn, int sock);
+static void conn_clear(net_conn_t* p_conn);
+static int buf_iov(const net_buf_t* p_buf, int off, struct iovec* p_iov,
+   int max_iov);
 static void add_to_queue(int sock, int evt, void* data, int len);
+static void server_accept(int listener);
+static void server_read(int sock);
+static void server_write(int sock);
+static net_loop_open_fn_t select_open;
+static net_loop_add_fn_t select_add;
+static net_loop_del_fn_t select_del;
+static net_loop_want_write_fn_t select_want_write;
+static net_loop_wait_fn_t select_wait;
+#ifdef NET_HAS_EPOLL
+static net_loop_open_fn_t epoll_open;
+static net_loop_add_fn_t epoll_add;
+static net_loop_del_fn_t epoll_del;
+static net_loop_want_write_fn_t epoll_want_write;
+static net_loop_wait_fn_t epoll_wait_ready;
+#endif
 
 /* MODULE CONSTANTS / VARIABLES **********************************************/
 /*** Remove this comment if you want to use an ASSERT
@@ -80,6 +189,22 @@ TRC_DEF(net);
 
 static net_t net;
 
+/* Connections written to during the current net_write_begin/end batch */
+static __thread int batch_depth;
+static __thread int n_batch;
+static __thread int batch_socks[NET_MAX_BATCH];
+
+static const net_loop_ops_t net_loop_select = {
+   "select", FALSE, select_open, select_add, select_del, select_want_write,
+   select_wait
+};
+#ifdef NET_HAS_EPOLL
+static const net_loop_ops_t net_loop_epoll = {
+   "epoll", TRUE, epoll_open, epoll_add, epoll_del, epoll_want_write,
+   epoll_wait_ready
+};
+#endif
+
 /* GLOBAL CONSTANTS / VARIABLES **********************************************/
 
 /* GLOBAL FUNCTIONS **********************************************************/
@@ -96,8 +221,10 @@ void net_init(void)
    }
 #endif
    net.started = FALSE;
-   pthread_mutex_init(&net.queue_mutex, NULL);
-   SLNK_INIT(&net.queue_head);
+   net.pp_conn = (net_conn_t**)calloc(NET_MAX_SOCKETS, sizeof(net_conn_t*));
+   REQUIRE(net.pp_conn != NULL);
+   pthread_mutex_init(&net.write_mutex, NULL);
+   net_queue_init(&net.queue, NET_QUEUE_SLOTS, sizeof(net_evt_t));
    TRC_REG(net, TRC_ERROR /*| TRC_DEBUG */);
 }
 
@@ -107,6 +234,19 @@ void net_start(net_cfg_t* p_cfg)
 {
    REQUIRE(p_cfg != NULL);
    net.net_cfg = *p_cfg;
+   if (net.net_cfg.tx_high_water <= 0) {
+      net.net_cfg.tx_high_water = NET_TX_HIGH_WATER;
+   }
+   net.p_loop = &net_loop_select;
+#ifdef NET_HAS_EPOLL
+   if (net.net_cfg.loop != NET_LOOP_SELECT) {
+      net.p_loop = &net_loop_epoll;
+   }
+#else
+   if (net.net_cfg.loop == NET_LOOP_EPOLL) {
+      TRC_ERR(net, "Error: epoll not supported, using select\n");
+   }
+#endif
    if (net.net_cfg.is_server) {
       /* Create server thread */
       pthread_create(&net.thread_id, NULL, server_thread, NULL);
@@ -129,46 +269,135 @@ void net_stop(void)
 void net_poll(void)
 {
    net_evt_t* p_evt;
-   while((p_evt = SLNK_NEXT(net_evt_t, &net.queue_head)) != NULL) {
-      pthread_mutex_lock(&net.queue_mutex);
-      SLNK_REMOVE(&net.queue_head, p_evt);
-      pthread_mutex_unlock(&net.queue_mutex);
-      net.net_cfg.evt_fn(p_evt->evt, p_evt->sock, p_evt->data, p_evt->len);
-      if (p_evt->len != 0) {
-         free(p_evt->data);
+   while((p_evt = (net_evt_t*)net_queue_peek(&net.queue)) != NULL) {
+      if (p_evt->p_msg != NULL) {
+         net.net_cfg.evt_fn(p_evt->evt, p_evt->sock, p_evt->p_msg,
+            p_evt->len);
+         free(p_evt->p_msg);
+      } else {
+         net.net_cfg.evt_fn(p_evt->evt, p_evt->sock, p_evt->data, p_evt->len);
       }
-      free(p_evt);
+      net_queue_release(&net.queue);
    }
 }
 
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_release(int sock)
+{
+   TRC_DBG(net, "Release socket %d", sock);
+   close(sock);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int net_poll_depth(void)
+{
+   return (int)net_queue_depth(&net.queue);
+}
+
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 int net_write_packet(int sock, void* data, int len)
 {
-   char packet[MAX_PACKET_SZ+2];
-   int ntot = 0;
-   int nleft = len+2;
-   REQUIRE(len <= MAX_PACKET_SZ);
-   packet[0] = (len >> 8) &0xff; /* 2 bytes packet size info */
-   packet[1] = len & 0xff;
-   memcpy(packet+2, data, len);
-   TRC_DBG(net, "Sending %d bytes", nleft);
-   /* Make sure complete packet is sent */
-   while(nleft > 0)
-   {
-      int nbytes = send(sock, packet + ntot, nleft, 0);
-      if (nbytes <= 0) {
-         TRC_ERR(net, "Error: send\n");
-         //add_to_queue(sock, NET_EVT_DISCONNECTED, packet, ntot);
-         close(sock);
-         ntot = -1;
-         break;
+   net_buf_t* p_buf;
+   int ret;
+
+   REQUIRE(len <= NET_MAX_MSG_SZ);
+   p_buf = net_buf_alloc(len);
+   memcpy(NET_BUF_DATA(p_buf), data, len);
+   net_buf_set_len(p_buf, len);
+   ret = net_write_buf(sock, p_buf);
+   net_buf_unref(p_buf);
+   return ret;
+}
+
+/*-----------------------------------------------------------------------------
+A reference to the buffer is queued on the connection. Outside a batch it is
+sent right away, inside a batch when the batch ends. Whatever the socket does
+not take is sent by the net thread when it becomes writable.
+-----------------------------------------------------------------------------*/
+int net_write_buf(int sock, net_buf_t* p_buf)
+{
+   net_conn_t* p_conn;
+   int need = NET_WIRE_SZ(p_buf);
+
+   if ((sock < 0) || (sock >= NET_MAX_SOCKETS) ||
+       ((p_conn = net.pp_conn[sock]) == NULL)) {
+      TRC_ERR(net, "Error: send: unknown socket %d\n", sock);
+      return -1;
+   }
+   pthread_mutex_lock(&p_conn->tx_mutex);
+   if (!p_conn->tx_open) {
+      pthread_mutex_unlock(&p_conn->tx_mutex);
+      return -1;
+   }
+   if (p_conn->tx_bytes > net.net_cfg.tx_high_water) {
+      /* Only the queued bytes count, a packet up to NET_MAX_MSG_SZ is legal */
+      TRC_ERR(net, "Error: socket %d not reading, disconnecting\n", sock);
+      conn_drop(p_conn, sock);
+      pthread_mutex_unlock(&p_conn->tx_mutex);
+      return -1;
+   }
+   if (p_conn->tx_n == p_conn->tx_cap) {
+      /* Grow and unwrap the ring */
+      int cap = MAX(NET_TX_MIN_BUFS, 2 * p_conn->tx_cap);
+      net_buf_t** pp_tx = (net_buf_t**)malloc(cap * sizeof(net_buf_t*));
+      int i;
+      REQUIRE(pp_tx != NULL);
+      for (i = 0; i < p_conn->tx_n; i++) {
+         pp_tx[i] = p_conn->pp_tx[(p_conn->tx_head + i) & (p_conn->tx_cap - 1)];
+      }
+      free(p_conn->pp_tx);
+      p_conn->pp_tx = pp_tx;
+      p_conn->tx_cap = cap;
+      p_conn->tx_head = 0;
+   }
+   p_conn->pp_tx[(p_conn->tx_head + p_conn->tx_n) & (p_conn->tx_cap - 1)] =
+      net_buf_ref(p_buf);
+   p_conn->tx_n++;
+   p_conn->tx_bytes += need;
+   TRC_DBG(net, "Queued %d bytes", need);
+   if (batch_depth == 0) {
+      conn_flush(p_conn, sock);
+   } else if (!p_conn->tx_batched) {
+      if (n_batch < NET_MAX_BATCH) {
+         p_conn->tx_batched = TRUE;
+         batch_socks[n_batch++] = sock;
       } else {
-         nleft -= nbytes;
-         ntot += nbytes;
+         conn_flush(p_conn, sock);
       }
    }
-   return ntot;
+   pthread_mutex_unlock(&p_conn->tx_mutex);
+   return need;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_write_begin(void)
+{
+   batch_depth++;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_write_end(void)
+{
+   int i;
+
+   REQUIRE(batch_depth > 0);
+   if (--batch_depth > 0) {
+      return;
+   }
+   for (i = 0; i < n_batch; i++) {
+      int sock = batch_socks[i];
+      net_conn_t* p_conn = net.pp_conn[sock];
+      pthread_mutex_lock(&p_conn->tx_mutex);
+      p_conn->tx_batched = FALSE;
+      conn_flush(p_conn, sock);
+      pthread_mutex_unlock(&p_conn->tx_mutex);
+   }
+   n_batch = 0;
 }
 
 /*-----------------------------------------------------------------------------
@@ -178,31 +407,120 @@ int net_read_packet(int sock, void* data, int max_len)
    return 0;
 }
 
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+net_buf_t* net_buf_alloc(int max_len)
+{
+   net_buf_t* p_buf;
+
+   REQUIRE((max_len >= 0) && (max_len <= NET_MAX_MSG_SZ));
+   p_buf = (net_buf_t*)malloc(sizeof(net_buf_t) + max_len +
+      NET_FRAME_HDR_SZ * NET_N_FRAMES(max_len));
+   REQUIRE(p_buf != NULL);
+   p_buf->refs = 1;
+   p_buf->len = 0;
+   p_buf->size = max_len;
+   p_buf->p_data = &p_buf->frame[NET_FRAME_HDR_SZ];
+   p_buf->p_hdrs = &p_buf->frame[NET_FRAME_HDR_SZ + max_len];
+   p_buf->p_free_fn = NULL;
+   p_buf->p_ctx = NULL;
+   return p_buf;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+net_buf_t* net_buf_wrap(const void* p_data, int len,
+   net_buf_free_fn_t* p_free_fn, void* p_ctx)
+{
+   net_buf_t* p_buf;
+
+   REQUIRE((len >= 0) && (len <= NET_MAX_MSG_SZ));
+   p_buf = (net_buf_t*)malloc(sizeof(net_buf_t) +
+      NET_FRAME_HDR_SZ * NET_N_FRAMES(len));
+   REQUIRE(p_buf != NULL);
+   p_buf->refs = 1;
+   p_buf->size = len;
+   p_buf->p_data = (uint8_t*)p_data;
+   p_buf->p_hdrs = &p_buf->frame[NET_FRAME_HDR_SZ];
+   p_buf->p_free_fn = p_free_fn;
+   p_buf->p_ctx = p_ctx;
+   net_buf_set_len(p_buf, len);
+   return p_buf;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_buf_set_len(net_buf_t* p_buf, int len)
+{
+   int n = NET_N_FRAMES(len);
+   int i;
+
+   REQUIRE((len >= 0) && (len <= p_buf->size));
+   p_buf->len = len;
+   for (i = 0; i < n; i++) {
+      /* 2 bytes frame size info, the first one in front of the packet */
+      uint8_t* p_hdr = (i == 0)?p_buf->frame:
+         &p_buf->p_hdrs[NET_FRAME_HDR_SZ * (i - 1)];
+      int size = MIN(MAX_PACKET_SZ, len - i * MAX_PACKET_SZ);
+      if (i < (n - 1)) {
+         size |= NET_FRAME_MORE;
+      }
+      p_hdr[0] = (size >> 8) & 0xff;
+      p_hdr[1] = size & 0xff;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+net_buf_t* net_buf_ref(net_buf_t* p_buf)
+{
+   __atomic_add_fetch(&p_buf->refs, 1, __ATOMIC_RELAXED);
+   return p_buf;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_buf_unref(net_buf_t* p_buf)
+{
+   if (__atomic_sub_fetch(&p_buf->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+      if (p_buf->p_free_fn != NULL) {
+         p_buf->p_free_fn(p_buf->p_ctx);
+      }
+      free(p_buf);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+net_buf_t* net_buf_patch(const net_buf_t* p_buf, int offset,
+   const void* p_bytes, int n)
+{
+   net_buf_t* p_copy;
+
+   REQUIRE((offset >= 0) && ((offset + n) <= p_buf->len));
+   p_copy = net_buf_alloc(p_buf->len);
+   memcpy(NET_BUF_DATA(p_copy), NET_BUF_DATA(p_buf), p_buf->len);
+   memcpy(NET_BUF_DATA(p_copy) + offset, p_bytes, n);
+   net_buf_set_len(p_copy, p_buf->len);
+   return p_copy;
+}
+
 /* LOCAL FUNCTIONS ***********************************************************/
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 static void *server_thread(void *arg)
 {
-   fd_set master;    /* Master file descriptor list */
-   fd_set read_fds;  /* Temp file descriptor list for select() */
-   int fdmax;        /* Maximum file descriptor number */
    int listener;     /* Listener socket */
-   int sock;         /* Socket for new connections */
+   net_ready_t ready[NET_MAX_READY];
    struct addrinfo hints, *servinfo, *p;
-   struct sockaddr_storage remoteaddr; /* Client address information */
-   socklen_t addrlen;
-   //char s[INET6_ADDRSTRLEN];
    char port[6];
    int yes = 1;
    int rv;
    int i;
 
-   TRC_DBG(net, "Starting server thread\n");
+   TRC_DBG(net, "Starting server thread (%s)\n", net.p_loop->p_name);
 
    /* Setup */
-   FD_ZERO(&master); /* Clear the master and temp sets */
-   FD_ZERO(&read_fds);
-
    memset(&hints, 0, sizeof(hints));
    hints.ai_family = AF_INET; /* IPv4 */
    hints.ai_socktype = SOCK_STREAM;
@@ -237,71 +555,42 @@ static void *server_thread(void *arg)
    }
    freeaddrinfo(servinfo);
 
-   if (listen(listener, 1) == -1) {
+   if (listen(listener, SOMAXCONN) == -1) {
       TRC_ERR(net, "Error: server: listen\n");
       close(listener);
       goto server_error;
    }
-   /* Add the listener to the master set */
-   FD_SET(listener, &master);
-   /* Keep track of the biggest file descriptor */
-   fdmax = listener; /* So far, it's this one */
+#ifndef WIN32
+   /* Accept is done until the backlog is empty */
+   fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+#endif
+   if (!net.p_loop->open(listener)) {
+      TRC_ERR(net, "Error: server: %s\n", net.p_loop->p_name);
+      close(listener);
+      goto server_error;
+   }
 
    TRC_DBG(net, "Server: waiting for connection(s)...\n");
 
-   while(1)  /* main select() loop */
+   while(1)  /* main event loop */
    {
-      read_fds = master;
-      if (select(fdmax+1, &read_fds, NULL, NULL, NULL) == -1) {
-         TRC_ERR(net, "Error: select\n");
+      int n = net.p_loop->wait(ready, NET_MAX_READY);
+      if (n == -1) {
+         TRC_ERR(net, "Error: %s\n", net.p_loop->p_name);
          break;
       }
-      /* Run through the existing connections looking for data to read */
-      for(i = 0; i <= fdmax; i++) {
-         if (FD_ISSET(i, &read_fds)) {
-            if (i == listener) {
-               /* Handle new connections */
-               addrlen = sizeof(remoteaddr);
-               sock = accept(listener, (struct sockaddr *)&remoteaddr,
-                              &addrlen);
-               if (sock == -1) {
-                   TRC_ERR(net, "Error: accept\n");
-               } else {
-                  FD_SET(sock, &master); /* Add to master set */
-                  if (sock > fdmax) {    /* Keep track of the max */
-                     fdmax = sock;
-                  }
-#if 0
-                  TRC_DBG(net, "selectserver: new connection from %s on "
-                         "socket %d\n",
-                         inet_ntop(remoteaddr.ss_family,
-                            get_in_addr((struct sockaddr*)&remoteaddr),
-                            remoteIP, INET6_ADDRSTRLEN),
-                            sock);
-#endif
-                  /* Add new connecton event to queue */
-                  add_to_queue(sock, NET_EVT_NEW_CONNECTION, NULL, 0);
-               }
-            } else {
-               /* Handle data from a client */
-               int ret = recv_complete_packet(i);
-               if (ret <= 0) {
-                  /* Got error or connection closed by client */
-                  if (ret == 0) {
-                     /* Connection closed */
-                     TRC_DBG(net, "selectserver: socket %d hung up\n", i);
-                     /* Add disconnect event to queue */
-                     add_to_queue(i, NET_EVT_DISCONNECTED, NULL, 0);
-                  } else if (ret == -1) {
-                     TRC_ERR(net, "Error: recv\n");
-                     add_to_queue(i, NET_EVT_DISCONNECTED, NULL, 0);
-                  }
-                  close(i);
-                  FD_CLR(i, &master); /* Remove from master set */
-               }
-            } /* END Handle data from client */
-         } /* END Got new incoming connection */
-      } /* END Looping through file descriptors */
+      for(i = 0; i < n; i++) {
+         if (ready[i].sock == listener) {
+            server_accept(listener);
+         } else {
+            if (ready[i].rd) {
+               server_read(ready[i].sock);
+            }
+            if (ready[i].wr) {
+               server_write(ready[i].sock);
+            }
+         }
+      }
    }
    close(listener);
 server_error:
@@ -355,6 +644,7 @@ static void *client_thread(void *arg)
 #endif
    freeaddrinfo(servinfo);
 
+   conn_open(sock);
    /* Add new connecton event to queue */
    add_to_queue(sock, NET_EVT_NEW_CONNECTION, NULL, 0);
 
@@ -367,78 +657,285 @@ static void *client_thread(void *arg)
       } else if (ret == 0) {
          /* Add disconnect event to queue */
          add_to_queue(sock, NET_EVT_DISCONNECTED, NULL, 0);
+         break;
       }
    }
 
-   close(sock);
+   conn_close(sock);
+   /* Closed by net_release once the disconnect event is handled */
 client_error:
    pthread_exit(NULL);
    return NULL;
 }
 
 /*-----------------------------------------------------------------------------
+Receive into the socket buffer and report all complete packets. The reported
+data points into the buffer and is only valid during the callback. Frames and
+frame headers may be split over any number of reads. When the end of the
+buffer is reached the partial frame (at most MAX_PACKET_SZ+1 bytes) is moved to
+the start, complete frames are never copied. Frames of a larger packet are
+collected in a separate buffer until the last one.
+\return recv result or -1 on a malformed frame
 -----------------------------------------------------------------------------*/
 static int recv_complete_packet(int sock)
 {
-   char buf[MAX_PACKET_SZ];
-   char* p_buf;
+   net_rx_t* p_rx = &net.pp_conn[sock]->rx;
    int nbytes;
-   int rc;
-   char packet[MAX_PACKET_SZ];
-   int ntot = 0;
-   int nleft = MAX_PACKET_SZ+1;
 
-   while(nleft > 0)
+   if (p_rx->end == NET_RX_BUF_SZ) {
+      memmove(p_rx->buf, p_rx->buf + p_rx->start, p_rx->end - p_rx->start);
+      p_rx->end -= p_rx->start;
+      p_rx->start = 0;
+   }
+   nbytes = recv(sock, p_rx->buf + p_rx->end, NET_RX_BUF_SZ - p_rx->end, 0);
+   TRC_DBG(net, "Received %d bytes", nbytes);
+   if (nbytes <= 0) {
+      return nbytes;
+   }
+   p_rx->end += nbytes;
+   while ((p_rx->end - p_rx->start) >= NET_FRAME_HDR_SZ)
    {
-      rc = nbytes = recv(sock, buf, MAX_PACKET_SZ, 0);
-      TRC_DBG(net, "Received %d bytes", nbytes);
+      uint8_t* p_frame = p_rx->buf + p_rx->start;
+      int len = ((p_frame[0] << 8) | p_frame[1]) & ~NET_FRAME_MORE;
+      bool_t more = ((p_frame[0] << 8) & NET_FRAME_MORE) != 0;
+      if (len > MAX_PACKET_SZ) {
+         TRC_ERR(net, "Error: socket %d packet length %d\n", sock, len);
+#ifndef WIN32
+         errno = EPROTO;
+#endif
+         return -1;
+      }
+      if ((p_rx->end - p_rx->start) < (NET_FRAME_HDR_SZ + len)) {
+         break; /* Wait for the rest */
+      }
+      p_rx->start += NET_FRAME_HDR_SZ + len;
+      if (more || (p_rx->msg_len > 0)) {
+         if (!recv_fragment(p_rx, p_frame + NET_FRAME_HDR_SZ, len)) {
+            TRC_ERR(net, "Error: socket %d packet too large\n", sock);
+#ifndef WIN32
+            errno = EPROTO;
+#endif
+            return -1;
+         }
+         if (more) {
+            continue;
+         }
+         TRC_DBG(net, "Packet length %d received", p_rx->msg_len);
+         len = p_rx->msg_len;
+         p_rx->msg_len = 0;
+         add_to_queue(sock, NET_EVT_RX, p_rx->p_msg, len);
+      } else {
+         TRC_DBG(net, "Packet length %d received", len);
+         add_to_queue(sock, NET_EVT_RX, p_frame + NET_FRAME_HDR_SZ, len);
+      }
+   }
+   if (p_rx->start == p_rx->end) {
+      p_rx->start = 0;
+      p_rx->end = 0;
+   }
+   return nbytes;
+}
+
+/*-----------------------------------------------------------------------------
+Append a frame to the packet being reassembled.
+\return FALSE if the packet gets larger than NET_MAX_MSG_SZ
+-----------------------------------------------------------------------------*/
+static bool_t recv_fragment(net_rx_t* p_rx, uint8_t* p_data, int len)
+{
+   int need = p_rx->msg_len + len;
+
+   if (need > NET_MAX_MSG_SZ) {
+      return FALSE;
+   }
+   if (need > p_rx->msg_cap) {
+      int cap = MIN(MAX(need, 2 * p_rx->msg_cap), NET_MAX_MSG_SZ);
+      uint8_t* p_msg = (uint8_t*)realloc(p_rx->p_msg, cap);
+      REQUIRE(p_msg != NULL);
+      p_rx->p_msg = p_msg;
+      p_rx->msg_cap = cap;
+   }
+   memcpy(p_rx->p_msg + p_rx->msg_len, p_data, len);
+   p_rx->msg_len = need;
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+Reset the connection state of a new socket. The state is allocated on first
+use and kept for the socket number, so other threads never see it freed.
+-----------------------------------------------------------------------------*/
+static net_conn_t* conn_open(int sock)
+{
+   net_conn_t* p_conn;
+
+   REQUIRE((sock >= 0) && (sock < NET_MAX_SOCKETS));
+   p_conn = net.pp_conn[sock];
+   if (p_conn == NULL) {
+      p_conn = (net_conn_t*)calloc(1, sizeof(net_conn_t));
+      REQUIRE(p_conn != NULL);
+      pthread_mutex_init(&p_conn->tx_mutex, NULL);
+      net.pp_conn[sock] = p_conn;
+   }
+   p_conn->rx.start = 0;
+   p_conn->rx.end = 0;
+   p_conn->rx.msg_len = 0;
+   pthread_mutex_lock(&p_conn->tx_mutex);
+   conn_clear(p_conn);
+   p_conn->tx_want_write = FALSE;
+   p_conn->tx_open = TRUE;
+   pthread_mutex_unlock(&p_conn->tx_mutex);
+   return p_conn;
+}
+
+/*-----------------------------------------------------------------------------
+Stop sending on a socket about to be closed, unsent bytes are dropped.
+-----------------------------------------------------------------------------*/
+static void conn_close(int sock)
+{
+   net_conn_t* p_conn = net.pp_conn[sock];
+
+   free(p_conn->rx.p_msg);
+   p_conn->rx.p_msg = NULL;
+   p_conn->rx.msg_len = 0;
+   p_conn->rx.msg_cap = 0;
+   pthread_mutex_lock(&p_conn->tx_mutex);
+   p_conn->tx_open = FALSE;
+   conn_clear(p_conn);
+   free(p_conn->pp_tx);
+   p_conn->pp_tx = NULL;
+   p_conn->tx_cap = 0;
+   pthread_mutex_unlock(&p_conn->tx_mutex);
+}
+
+/*-----------------------------------------------------------------------------
+Send as much as the socket takes (tx_mutex held). The rest waits for the
+socket to become writable. An edge triggered loop only reports the socket
+again once it was full, so it is written until it refuses.
+-----------------------------------------------------------------------------*/
+static void conn_flush(net_conn_t* p_conn, int sock)
+{
+   struct iovec iov[NET_MAX_IOV];
+   int n_iov;
+   int nbytes;
+   int i;
+
+   if (!p_conn->tx_open) {
+      return;
+   }
+   do {
+      if (p_conn->tx_n == 0) {
+         return;
+      }
+      n_iov = 0;
+      for (i = 0; (i < p_conn->tx_n) && (n_iov < NET_MAX_IOV); i++) {
+         net_buf_t* p_buf =
+            p_conn->pp_tx[(p_conn->tx_head + i) & (p_conn->tx_cap - 1)];
+         n_iov += buf_iov(p_buf, (i == 0)?p_conn->tx_off:0, &iov[n_iov],
+            NET_MAX_IOV - n_iov);
+      }
+      do {
+         nbytes = writev(sock, iov, n_iov);
+      } while ((nbytes == -1) && (errno == EINTR));
+      TRC_DBG(net, "Sent %d of %d bytes", nbytes, p_conn->tx_bytes);
       if (nbytes <= 0) {
          break;
-      } else {
-         /* Check if more than one packet */
-         p_buf = buf;
-         while (nbytes > 0)
-         {
-            if (nleft == MAX_PACKET_SZ+1)
-            {
-               REQUIRE(nbytes >= 2); /* 2 packet bytes size info */
-               nleft = (p_buf[0] << 8) | p_buf[1];
-               REQUIRE(nleft <= MAX_PACKET_SZ);
-               nbytes -= 2;
-               p_buf += 2;
-               TRC_DBG(net, "New packet: length %d", nleft);
-            }
-            if (nleft > nbytes)
-            {
-               nleft -= nbytes;
-               memcpy(packet + ntot, p_buf, nbytes);
-               ntot += nbytes;
-               nbytes = 0;
-            }
-            else if (nleft == nbytes)
-            {
-               memcpy(packet + ntot, p_buf, nbytes);
-               ntot += nbytes;
-               add_to_queue(sock, NET_EVT_RX, packet, ntot);
-               TRC_DBG(net, "Packet length %d added to queue", ntot);
-               nleft = 0;
-               nbytes = 0;
-            }
-            else
-            {  /* More than one packet in buffer. Send packet and start a new.*/
-               memcpy(packet + ntot, p_buf, nleft);
-               ntot += nleft;
-               add_to_queue(sock, NET_EVT_RX, packet, ntot);
-               TRC_DBG(net, "Packet length %d added to queue", ntot);
-               ntot = 0;
-               nbytes -= nleft;
-               p_buf += nleft;
-               nleft = MAX_PACKET_SZ+1;
-            }
+      }
+      p_conn->tx_bytes -= nbytes;
+      nbytes += p_conn->tx_off;
+      while (p_conn->tx_n > 0) {
+         net_buf_t* p_buf = p_conn->pp_tx[p_conn->tx_head];
+         int size = NET_WIRE_SZ(p_buf);
+         if (nbytes < size) {
+            break;
          }
+         nbytes -= size;
+         net_buf_unref(p_buf);
+         p_conn->tx_head = (p_conn->tx_head + 1) & (p_conn->tx_cap - 1);
+         p_conn->tx_n--;
       }
+      p_conn->tx_off = nbytes;
+   } while (net.p_loop->edge_triggered);
+   if ((nbytes == -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+      TRC_ERR(net, "Error: send\n");
+      conn_drop(p_conn, sock);
+      return;
+   }
+   if ((p_conn->tx_n != 0) && !p_conn->tx_want_write) {
+      p_conn->tx_want_write = TRUE;
+      net.p_loop->want_write(sock, TRUE);
    }
-   return rc;
+}
+
+/*-----------------------------------------------------------------------------
+Give up on a connection (tx_mutex held). The net thread sees the shutdown as a
+hang up. The socket stays open until its owner calls net_release, so the
+number is not reused while other threads may still write to it.
+-----------------------------------------------------------------------------*/
+static void conn_drop(net_conn_t* p_conn, int sock)
+{
+   p_conn->tx_open = FALSE;
+   conn_clear(p_conn);
+   shutdown(sock, SHUT_RDWR);
+}
+
+/*-----------------------------------------------------------------------------
+Release all queued buffers (tx_mutex held).
+-----------------------------------------------------------------------------*/
+static void conn_clear(net_conn_t* p_conn)
+{
+   while (p_conn->tx_n > 0) {
+      net_buf_unref(p_conn->pp_tx[p_conn->tx_head]);
+      p_conn->tx_head = (p_conn->tx_head + 1) & (p_conn->tx_cap - 1);
+      p_conn->tx_n--;
+   }
+   p_conn->tx_head = 0;
+   p_conn->tx_off = 0;
+   p_conn->tx_bytes = 0;
+}
+
+/*-----------------------------------------------------------------------------
+Scatter list of the frames of a packet from byte off of the frame stream on.
+Size infos in front of their frame data share its entry.
+\return Number of entries used (at most max_iov)
+-----------------------------------------------------------------------------*/
+static int buf_iov(const net_buf_t* p_buf, int off, struct iovec* p_iov,
+   int max_iov)
+{
+   int n_frames = NET_N_FRAMES(p_buf->len);
+   int n = 0;
+   int i;
+
+   for (i = 0; (i < n_frames) && (n < max_iov); i++) {
+      uint8_t* p_hdr = (i == 0)?(uint8_t*)p_buf->frame:
+         &p_buf->p_hdrs[NET_FRAME_HDR_SZ * (i - 1)];
+      uint8_t* p_data = p_buf->p_data + i * MAX_PACKET_SZ;
+      int size = MIN(MAX_PACKET_SZ, p_buf->len - i * MAX_PACKET_SZ);
+      if (off >= NET_FRAME_HDR_SZ + size) {
+         off -= NET_FRAME_HDR_SZ + size;
+         continue;
+      }
+      if (off < NET_FRAME_HDR_SZ) {
+         if (p_hdr + NET_FRAME_HDR_SZ == p_data) {
+            p_iov[n].iov_base = p_hdr + off;
+            p_iov[n++].iov_len = NET_FRAME_HDR_SZ + size - off;
+            off = 0;
+            continue;
+         }
+         p_iov[n].iov_base = p_hdr + off;
+         p_iov[n++].iov_len = NET_FRAME_HDR_SZ - off;
+         off = 0;
+         if (n == max_iov) {
+            break;
+         }
+      } else {
+         off -= NET_FRAME_HDR_SZ;
+      }
+      if (size > off) {
+         p_iov[n].iov_base = p_data + off;
+         p_iov[n++].iov_len = size - off;
+      }
+      off = 0;
+   }
+   return n;
 }
 
 /*-----------------------------------------------------------------------------
@@ -448,20 +945,23 @@ static void add_to_queue(int sock, int evt, void* data, int len)
    net_evt_t* p_evt;
    if (net.net_cfg.poll)
    {
-      p_evt = (net_evt_t*)malloc(sizeof(net_evt_t));
-      REQUIRE(p_evt != NULL);
-      SLNK_INIT(p_evt);
+      REQUIRE((len >= 0) && (len <= NET_MAX_MSG_SZ));
+      while ((p_evt = (net_evt_t*)net_queue_reserve(&net.queue)) == NULL) {
+         /* Full, wait for net_poll to catch up */
+         usleep(1000);
+      }
       p_evt->evt = evt;
       p_evt->sock = sock;
-      if (len > 0) {
-         p_evt->data = malloc(len);
-         REQUIRE(p_evt->data != NULL);
+      p_evt->len = len;
+      p_evt->p_msg = NULL;
+      if (len > MAX_PACKET_SZ) {
+         p_evt->p_msg = (uint8_t*)malloc(len);
+         REQUIRE(p_evt->p_msg != NULL);
+         memcpy(p_evt->p_msg, data, len);
+      } else if (len > 0) {
          memcpy(p_evt->data, data, len);
       }
-      p_evt->len = len;
-      pthread_mutex_lock(&net.queue_mutex);
-      SLNK_ADD(&net.queue_head, p_evt);
-      pthread_mutex_unlock(&net.queue_mutex);
+      net_queue_commit(&net.queue, p_evt);
    }
    else
    {
@@ -469,4 +969,264 @@ static void add_to_queue(int sock, int evt, void* data, int len)
    }
 }
 
+/*-----------------------------------------------------------------------------
+Accept all pending connections on the listener.
+-----------------------------------------------------------------------------*/
+static void server_accept(int listener)
+{
+   struct sockaddr_storage remoteaddr; /* Client address information */
+   socklen_t addrlen;
+   int sock;
+
+   while (1)
+   {
+      addrlen = sizeof(remoteaddr);
+      sock = accept(listener, (struct sockaddr *)&remoteaddr, &addrlen);
+      if (sock == -1) {
+#ifndef WIN32
+         if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            TRC_ERR(net, "Error: accept\n");
+         }
+#endif
+         break;
+      }
+      if (sock >= NET_MAX_SOCKETS) {
+         TRC_ERR(net, "Error: too many sockets (%d)\n", sock);
+         close(sock);
+         continue;
+      }
+#ifndef WIN32
+      /* Sends never block the game threads */
+      fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+      if (!net.p_loop->add(sock)) {
+         TRC_ERR(net, "Error: %s: can't add socket %d\n",
+            net.p_loop->p_name, sock);
+         close(sock);
+         continue;
+      }
+      conn_open(sock);
+      /* Add new connecton event to queue */
+      add_to_queue(sock, NET_EVT_NEW_CONNECTION, NULL, 0);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Handle data from a client. An edge triggered loop only reports new data once so
+the socket is read until it would block.
+-----------------------------------------------------------------------------*/
+static void server_read(int sock)
+{
+   int ret;
+
+   do {
+      ret = recv_complete_packet(sock);
+   } while ((ret > 0) && net.p_loop->edge_triggered);
+#ifndef WIN32
+   if ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      return; /* Drained */
+   }
+#endif
+   if (ret <= 0) {
+      /* Got error or connection closed by client */
+      if (ret == 0) {
+         /* Connection closed */
+         TRC_DBG(net, "server: socket %d hung up\n", sock);
+      } else {
+         TRC_ERR(net, "Error: recv\n");
+      }
+      /* Add disconnect event to queue */
+      net.p_loop->del(sock);
+      conn_close(sock);
+      /* Closed by net_release once the event is handled */
+      add_to_queue(sock, NET_EVT_DISCONNECTED, NULL, 0);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Send queued bytes of a writable socket.
+-----------------------------------------------------------------------------*/
+static void server_write(int sock)
+{
+   net_conn_t* p_conn = net.pp_conn[sock];
+
+   pthread_mutex_lock(&p_conn->tx_mutex);
+   conn_flush(p_conn, sock);
+   if ((p_conn->tx_n == 0) && p_conn->tx_want_write) {
+      p_conn->tx_want_write = FALSE;
+      net.p_loop->want_write(sock, FALSE);
+   }
+   pthread_mutex_unlock(&p_conn->tx_mutex);
+}
+
+/*-----------------------------------------------------------------------------
+The wake up pipe lets other threads change write_master while select sleeps.
+-----------------------------------------------------------------------------*/
+static bool_t select_open(int listener)
+{
+   FD_ZERO(&net.master);
+   FD_ZERO(&net.write_master);
+   FD_SET(listener, &net.master);
+   net.fdmax = listener;
+#ifndef WIN32
+   if (pipe(net.wake_fd) == -1) {
+      return FALSE;
+   }
+   fcntl(net.wake_fd[0], F_SETFL, fcntl(net.wake_fd[0], F_GETFL, 0) | O_NONBLOCK);
+   fcntl(net.wake_fd[1], F_SETFL, fcntl(net.wake_fd[1], F_GETFL, 0) | O_NONBLOCK);
+   return select_add(net.wake_fd[0]);
+#else
+   return TRUE;
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static bool_t select_add(int sock)
+{
+   if (sock >= FD_SETSIZE) {
+      return FALSE;
+   }
+   FD_SET(sock, &net.master);
+   if (sock > net.fdmax) {
+      net.fdmax = sock;
+   }
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void select_del(int sock)
+{
+   FD_CLR(sock, &net.master);
+   pthread_mutex_lock(&net.write_mutex);
+   FD_CLR(sock, &net.write_master);
+   pthread_mutex_unlock(&net.write_mutex);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void select_want_write(int sock, bool_t enable)
+{
+   pthread_mutex_lock(&net.write_mutex);
+   if (enable) {
+      FD_SET(sock, &net.write_master);
+   } else {
+      FD_CLR(sock, &net.write_master);
+   }
+   pthread_mutex_unlock(&net.write_mutex);
+#ifndef WIN32
+   if (enable && (write(net.wake_fd[1], "w", 1) == -1)) {
+      /* Pipe full, select wakes up anyway */
+   }
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static int select_wait(net_ready_t* p_ready, int max_socks)
+{
+   fd_set read_fds = net.master;
+   fd_set write_fds;
+   int n = 0;
+   int i;
+
+   pthread_mutex_lock(&net.write_mutex);
+   write_fds = net.write_master;
+   pthread_mutex_unlock(&net.write_mutex);
+   if (select(net.fdmax+1, &read_fds, &write_fds, NULL, NULL) == -1) {
+      return (errno == EINTR) ? 0 : -1;
+   }
+#ifndef WIN32
+   if (FD_ISSET(net.wake_fd[0], &read_fds)) {
+      char buf[64];
+      while (read(net.wake_fd[0], buf, sizeof(buf)) > 0);
+      FD_CLR(net.wake_fd[0], &read_fds);
+   }
+#endif
+   /* Sockets not reported now are still ready on the next call */
+   for(i = 0; (i <= net.fdmax) && (n < max_socks); i++) {
+      bool_t rd = FD_ISSET(i, &read_fds) ? TRUE : FALSE;
+      bool_t wr = FD_ISSET(i, &write_fds) ? TRUE : FALSE;
+      if (rd || wr) {
+         p_ready[n].sock = i;
+         p_ready[n].rd = rd;
+         p_ready[n].wr = wr;
+         n++;
+      }
+   }
+   return n;
+}
+
+#ifdef NET_HAS_EPOLL
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static bool_t epoll_open(int listener)
+{
+   struct rlimit rl;
+
+   /* One descriptor per client, so allow as many as the system does */
+   if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+      rl.rlim_cur = rl.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &rl);
+   }
+   net.epoll_fd = epoll_create1(0);
+   if (net.epoll_fd == -1) {
+      return FALSE;
+   }
+   return epoll_add(listener);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static bool_t epoll_add(int sock)
+{
+   struct epoll_event ev;
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+   ev.data.fd = sock;
+   return (epoll_ctl(net.epoll_fd, EPOLL_CTL_ADD, sock, &ev) == 0);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void epoll_del(int sock)
+{
+   struct epoll_event ev; /* Non NULL for kernels before 2.6.9 */
+   epoll_ctl(net.epoll_fd, EPOLL_CTL_DEL, sock, &ev);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void epoll_want_write(int sock, bool_t enable)
+{
+   struct epoll_event ev;
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (enable ? EPOLLOUT : 0);
+   ev.data.fd = sock;
+   epoll_ctl(net.epoll_fd, EPOLL_CTL_MOD, sock, &ev);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static int epoll_wait_ready(net_ready_t* p_ready, int max_socks)
+{
+   struct epoll_event evs[NET_MAX_READY];
+   int n;
+   int i;
+
+   do {
+      n = epoll_wait(net.epoll_fd, evs, MIN(max_socks, NET_MAX_READY), -1);
+   } while ((n == -1) && (errno == EINTR));
+   for (i = 0; i < n; i++) {
+      p_ready[i].sock = evs[i].data.fd;
+      p_ready[i].rd = (evs[i].events & ~EPOLLOUT) ? TRUE : FALSE;
+      p_ready[i].wr = (evs[i].events & EPOLLOUT) ? TRUE : FALSE;
+   }
+   return n;
+}
+#endif
+
 /* END OF FILE ***************************************************************/
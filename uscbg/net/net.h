@@ -11,8 +11,12 @@ Copyright (c) 2013, All Rights Reserved.
 /* INCLUDE FILES *************************************************************/
 
 /* EXPORTED DEFINES **********************************************************/
-#define MAX_PACKET_SZ (1024)
+#define MAX_PACKET_SZ (1024) /* Max frame payload, larger packets are split */
 #define MAX_CLIENT_NAME_LEN (32)
+#define NET_MAX_MSG_SZ (1024 * 1024) /* Max packet (reassembled frames) */
+#define NET_FRAME_HDR_SZ (2) /* 2 bytes frame size info */
+#define NET_FRAME_MORE (0x8000) /* Size info flag, more frames follow */
+#define NET_BUF_DATA(p_buf) ((p_buf)->p_data)
 
 /* EXPORTED DATA TYPES *******************************************************/
 enum
@@ -24,8 +28,38 @@ enum
    NET_EVT_LAST
 };
 
+typedef enum
+{
+   NET_LOOP_DEFAULT = 0,         /*!< Best backend for the platform */
+   NET_LOOP_SELECT,              /*!< select() (limited by FD_SETSIZE) */
+   NET_LOOP_EPOLL,               /*!< Edge triggered epoll (Linux only) */
+   NET_LOOP_LAST
+} net_loop_t;
+
 typedef void net_evt_cb_fn_t(int evt, int sock, void* data, int len);
 
+typedef void net_buf_free_fn_t(void* p_ctx);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Shared outbound packet.
+A packet is sent as frames of at most MAX_PACKET_SZ bytes, each preceded by
+its 2 byte big endian size info. All frames but the last have NET_FRAME_MORE
+set. A packet that fits one frame is sent as before. The frames are written
+straight from the packet data, only the size infos are kept apart. */
+/*---------------------------------------------------------------------------*/
+typedef struct
+{
+   int refs;                     /*!< Reference count (atomic) */
+   int len;                      /*!< Packet length */
+   int size;                     /*!< Max packet length */
+   uint8_t* p_data;              /*!< Packet, in frame[] or wrapped */
+   uint8_t* p_hdrs;              /*!< Size infos of frames 2..n */
+   net_buf_free_fn_t* p_free_fn; /*!< Releases wrapped data (or NULL) */
+   void* p_ctx;                  /*!< p_free_fn argument */
+   uint8_t frame[];              /*!< Size info of frame 1, then the packet
+                                      (unless wrapped) and p_hdrs */
+} net_buf_t;
+
 typedef struct
 {
    bool_t is_server;             /*!< Server or client */
@@ -35,6 +69,10 @@ typedef struct
    int max_connections;          /*!< Max connections (server only) */
    net_evt_cb_fn_t* evt_fn;      /*!< Net event callback function */
    bool_t poll;                  /*!< Polling or not */
+   net_loop_t loop;              /*!< Event loop backend (server only) */
+   int tx_high_water;            /*!< Max unsent bytes per connection before
+                                      it is disconnected, one more packet is
+                                      queued below it (0 = default) */
 } net_cfg_t;
 
 /* GLOBAL VARIABLES **********************************************************/
@@ -59,8 +97,23 @@ void net_start(
 void net_poll(void);
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Send packet.
-\return Number of bytes written or -1 if error */
+/*! \brief Number of events waiting for net_poll. */
+/*---------------------------------------------------------------------------*/
+int net_poll_depth(void);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Close a socket reported by NET_EVT_DISCONNECTED. Call it when no
+thread writes to the socket any more; until then the socket number is not
+reused for a new connection and writes to it fail. */
+/*---------------------------------------------------------------------------*/
+void net_release(
+   int sock             /*!< Network socket */
+);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Send packet. Never blocks on a server socket, unsent bytes are
+queued per connection.
+\return Number of bytes queued or -1 if error */
 /*---------------------------------------------------------------------------*/
 int net_write_packet(
    int sock,            /*!< Network socket */
@@ -68,6 +121,27 @@ int net_write_packet(
    int len              /*!< Length of packet */
 );
 
+/*---------------------------------------------------------------------------*/
+/*! \brief Queue a reference to a packet buffer. The same buffer can be
+written to any number of sockets. Like net_write_packet otherwise.
+\return Number of bytes queued or -1 if error */
+/*---------------------------------------------------------------------------*/
+int net_write_buf(
+   int sock,            /*!< Network socket */
+   net_buf_t* p_buf     /*!< Buffer (net_buf_set_len done) */
+);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Start collecting packets written by this thread. Batches nest. */
+/*---------------------------------------------------------------------------*/
+void net_write_begin(void);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Send all packets collected since net_write_begin, one system call
+per connection. */
+/*---------------------------------------------------------------------------*/
+void net_write_end(void);
+
 /*---------------------------------------------------------------------------*/
 /*! \brief Read packet.
 \return Length of packet */
@@ -78,5 +152,62 @@ int net_read_packet(
    int max_len          /*!< Max length of packet */
 );
 
+/*---------------------------------------------------------------------------*/
+/*! \brief Allocate a packet buffer with one reference. Fill in the packet at
+NET_BUF_DATA and call net_buf_set_len before writing it.
+\return Buffer */
+/*---------------------------------------------------------------------------*/
+net_buf_t* net_buf_alloc(
+   int max_len          /*!< Max length of packet */
+);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Wrap caller data in a packet buffer with one reference. The data is
+sent in place and must stay unchanged until p_free_fn(p_ctx) is called when
+the last reference is dropped.
+\return Buffer (length set) */
+/*---------------------------------------------------------------------------*/
+net_buf_t* net_buf_wrap(
+   const void* p_data,  /*!< Packet */
+   int len,             /*!< Length of packet */
+   net_buf_free_fn_t* p_free_fn, /*!< Release function (NULL = none) */
+   void* p_ctx          /*!< Release function argument */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Set packet length (and frame size infos). */
+/*---------------------------------------------------------------------------*/
+void net_buf_set_len(
+   net_buf_t* p_buf,    /*!< Buffer */
+   int len              /*!< Length of packet */
+);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Add a reference.
+\return p_buf */
+/*---------------------------------------------------------------------------*/
+net_buf_t* net_buf_ref(
+   net_buf_t* p_buf     /*!< Buffer */
+);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Drop a reference, the last one frees the buffer. */
+/*---------------------------------------------------------------------------*/
+void net_buf_unref(
+   net_buf_t* p_buf     /*!< Buffer */
+);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Copy of a buffer with some packet bytes replaced. Used for fields
+that differ per recipient of a broadcast.
+\return New buffer with one reference */
+/*---------------------------------------------------------------------------*/
+net_buf_t* net_buf_patch(
+   const net_buf_t* p_buf, /*!< Buffer */
+   int offset,          /*!< Packet offset of the bytes */
+   const void* p_bytes, /*!< New bytes */
+   int n                /*!< Number of bytes */
+);
+
 #endif /* #ifndef NET_H */
 /* END OF FILE ***************************************************************/
@@ -0,0 +1,200 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file net_queue.c
+\brief The net queue implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "net_queue.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+/* Each slot starts with its sequence number, payload is 8 byte aligned */
+#define SLOT_HDR_SZ (8)
+#define SLOT_SEQ(p_q, pos)\
+   ((uint32_t*)&(p_q)->p_slots[((pos) & (p_q)->mask) * (p_q)->stride])
+#define SLOT_DATA(p_seq) ((void*)((uint8_t*)(p_seq) + SLOT_HDR_SZ))
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+A slot is free for position pos when its sequence is pos, and committed for
+position pos when its sequence is pos + 1. The condition waits on the monotonic
+clock, a timed wait is not affected by changes of the wall clock.
+-----------------------------------------------------------------------------*/
+void net_queue_init(net_queue_t* p_q, uint32_t n_slots, uint32_t slot_sz)
+{
+   pthread_condattr_t attr;
+   uint32_t i;
+
+   REQUIRE((n_slots > 1) && ((n_slots & (n_slots - 1)) == 0));
+   p_q->mask = n_slots - 1;
+   p_q->stride = SLOT_HDR_SZ + ((slot_sz + 7) & ~7u);
+   p_q->p_slots = (uint8_t*)malloc(n_slots * p_q->stride);
+   REQUIRE(p_q->p_slots != NULL);
+   for (i=0;i<n_slots;i++)
+   {
+      *SLOT_SEQ(p_q, i) = i;
+   }
+   p_q->head = 0;
+   p_q->tail = 0;
+   p_q->waiting = 0;
+   pthread_mutex_init(&p_q->mutex, NULL);
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&p_q->cond, &attr);
+   pthread_condattr_destroy(&attr);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_queue_free(net_queue_t* p_q)
+{
+   free(p_q->p_slots);
+   p_q->p_slots = NULL;
+   pthread_mutex_destroy(&p_q->mutex);
+   pthread_cond_destroy(&p_q->cond);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void* net_queue_reserve(net_queue_t* p_q)
+{
+   uint32_t pos = __atomic_load_n(&p_q->head, __ATOMIC_RELAXED);
+
+   while (1)
+   {
+      uint32_t* p_seq = SLOT_SEQ(p_q, pos);
+      int32_t dif = (int32_t)(__atomic_load_n(p_seq, __ATOMIC_ACQUIRE) - pos);
+      if (dif == 0)
+      { /* Free, try to claim it */
+         if (__atomic_compare_exchange_n(&p_q->head, &pos, pos + 1, TRUE,
+               __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+         {
+            return SLOT_DATA(p_seq);
+         }
+         /* pos reloaded by the failed exchange */
+      }
+      else if (dif < 0)
+      { /* Not yet released by the consumer, full */
+         return NULL;
+      }
+      else
+      { /* Claimed by another producer */
+         pos = __atomic_load_n(&p_q->head, __ATOMIC_RELAXED);
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_queue_commit(net_queue_t* p_q, void* p_slot)
+{
+   uint32_t* p_seq = (uint32_t*)((uint8_t*)p_slot - SLOT_HDR_SZ);
+   uint32_t pos = *p_seq;  /* Only written by the consumer at release */
+
+   __atomic_store_n(p_seq, pos + 1, __ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&p_q->waiting, __ATOMIC_SEQ_CST))
+   {
+      pthread_mutex_lock(&p_q->mutex);
+      pthread_cond_signal(&p_q->cond);
+      pthread_mutex_unlock(&p_q->mutex);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void* net_queue_peek(net_queue_t* p_q)
+{
+   uint32_t pos = p_q->tail;
+   uint32_t* p_seq = SLOT_SEQ(p_q, pos);
+
+   if (__atomic_load_n(p_seq, __ATOMIC_SEQ_CST) != (pos + 1))
+   {
+      return NULL;
+   }
+   return SLOT_DATA(p_seq);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_queue_release(net_queue_t* p_q)
+{
+   uint32_t pos = p_q->tail;
+
+   __atomic_store_n(SLOT_SEQ(p_q, pos), pos + p_q->mask + 1,
+      __ATOMIC_RELEASE);
+   __atomic_store_n(&p_q->tail, pos + 1, __ATOMIC_RELAXED);
+}
+
+/*-----------------------------------------------------------------------------
+The waiting flag and the slot sequence are both accessed sequentially
+consistent, so either the producer sees the flag or the consumer sees the slot.
+-----------------------------------------------------------------------------*/
+bool_t net_queue_wait(net_queue_t* p_q, int timeout_ms)
+{
+   struct timespec deadline;
+
+   if (net_queue_peek(p_q) != NULL)
+   {
+      return TRUE;
+   }
+   if (timeout_ms == 0)
+   {
+      return FALSE;
+   }
+   if (timeout_ms > 0)
+   {
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      deadline.tv_sec += timeout_ms / 1000;
+      deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+      if (deadline.tv_nsec >= 1000000000)
+      {
+         deadline.tv_sec++;
+         deadline.tv_nsec -= 1000000000;
+      }
+   }
+   pthread_mutex_lock(&p_q->mutex);
+   __atomic_store_n(&p_q->waiting, 1, __ATOMIC_SEQ_CST);
+   while (net_queue_peek(p_q) == NULL)
+   {
+      if (timeout_ms < 0)
+      {
+         pthread_cond_wait(&p_q->cond, &p_q->mutex);
+      }
+      else if (pthread_cond_timedwait(&p_q->cond, &p_q->mutex, &deadline) ==
+         ETIMEDOUT)
+      {
+         break;
+      }
+   }
+   __atomic_store_n(&p_q->waiting, 0, __ATOMIC_SEQ_CST);
+   pthread_mutex_unlock(&p_q->mutex);
+   return (net_queue_peek(p_q) != NULL);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+uint32_t net_queue_depth(net_queue_t* p_q)
+{
+   return __atomic_load_n(&p_q->head, __ATOMIC_RELAXED) -
+      __atomic_load_n(&p_q->tail, __ATOMIC_RELAXED);
+}
+
+/* END OF FILE ***************************************************************/
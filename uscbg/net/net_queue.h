@@ -0,0 +1,102 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file net_queue.h
+\brief The net queue interface.
+Bounded lock-free queue of preallocated slots (D. Vyukov's bounded queue).
+Any number of producers and one consumer. A producer reserves a slot, fills
+it in place and commits it. The consumer peeks at the oldest committed slot,
+uses it in place and releases it. Nothing is allocated or copied by the
+queue after init. */
+/*---------------------------------------------------------------------------*/
+#ifndef NET_QUEUE_H
+#define NET_QUEUE_H
+/* INCLUDE FILES *************************************************************/
+#include <pthread.h>
+
+/* EXPORTED DEFINES **********************************************************/
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef struct
+{
+   uint8_t* p_slots;          /*!< Slot memory */
+   uint32_t mask;             /*!< Number of slots - 1 */
+   uint32_t stride;           /*!< Bytes per slot (sequence + payload) */
+   uint32_t head;             /*!< Next slot to reserve (producers) */
+   uint32_t tail;             /*!< Next slot to consume (consumer) */
+   int waiting;               /*!< Consumer is sleeping in net_queue_wait */
+   pthread_mutex_t mutex;     /*!< Only used to sleep/wake the consumer */
+   pthread_cond_t cond;
+} net_queue_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize queue and allocate all slots. */
+/*---------------------------------------------------------------------------*/
+void net_queue_init(
+   net_queue_t* p_q,    /*!< Queue */
+   uint32_t n_slots,    /*!< Number of slots (power of 2) */
+   uint32_t slot_sz     /*!< Payload size of a slot */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Free slot memory. */
+/*---------------------------------------------------------------------------*/
+void net_queue_free(
+   net_queue_t* p_q     /*!< Queue */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Reserve a slot (producer).
+\return Slot payload to fill in or NULL if the queue is full. */
+/*---------------------------------------------------------------------------*/
+void* net_queue_reserve(
+   net_queue_t* p_q     /*!< Queue */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Commit a reserved slot and wake the consumer if it sleeps. */
+/*---------------------------------------------------------------------------*/
+void net_queue_commit(
+   net_queue_t* p_q,    /*!< Queue */
+   void* p_slot         /*!< Slot from net_queue_reserve */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Oldest committed slot (consumer).
+\return Slot payload or NULL if the queue is empty. */
+/*---------------------------------------------------------------------------*/
+void* net_queue_peek(
+   net_queue_t* p_q     /*!< Queue */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Release the slot returned by net_queue_peek (consumer). */
+/*---------------------------------------------------------------------------*/
+void net_queue_release(
+   net_queue_t* p_q     /*!< Queue */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Sleep until the queue is not empty or the timeout (consumer).
+\return TRUE if the queue is not empty */
+/*---------------------------------------------------------------------------*/
+bool_t net_queue_wait(
+   net_queue_t* p_q,    /*!< Queue */
+   int timeout_ms       /*!< Timeout (-1 = none) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Number of reserved but not yet released slots. */
+/*---------------------------------------------------------------------------*/
+uint32_t net_queue_depth(
+   net_queue_t* p_q     /*!< Queue */
+   );
+
+#endif /* #ifndef NET_QUEUE_H */
+/* END OF FILE ***************************************************************/
@@ -11,24 +11,46 @@ Copyright (c) 2013, All Rights Reserved.
 #include "sys_assert.h"
 #include "slnk.h"
 #include "trc.h"
-#include "pbuf.h"
 #include "net.h"
 #include "net_us.h"
 #include "net_server.h"
 #include "core.h"
+#include "core_sync.h"
 #include "server_hsm.h"
+#include "server_game.h"
+#include "server_worker.h"
+#include "server_bot.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <malloc.h>
 #include <string.h>
 
 /* CONSTANTS / MACROS ********************************************************/
+#define NET_SERVER_SYNC_SZ (4 * MAX_PACKET_SZ) /* Max state sync packet */
 
 /* LOCAL DATATYPES ***********************************************************/
+typedef struct
+{
+   int offset;                   /*!< Packet offset */
+   int n;                        /*!< Number of bytes */
+   uint8_t bytes[4];
+} net_server_patch_t;            /*!< Per recipient bytes of a broadcast */
 
 /* LOCAL FUNCTION PROTOTYPES *************************************************/
 static net_evt_cb_fn_t net_server_evt_cb_fn;
-static void net_server_parse_command(int sock, void* data, int len);
+static srv_worker_fn_t net_server_game_evt_fn;
+static srv_worker_fn_t net_server_bot_start_fn;
+static srv_worker_after_fn_t net_server_game_run;
+static void net_server_bot_prompt(core_t* p_core, int cmd);
+static void net_server_seat_bots(srv_game_t* p_game, int n_players);
+static void net_server_parse_command(srv_game_t* p_game, int sock, void* data,
+   int len);
+static net_buf_t* net_server_encode(core_t* p_core, int sock, int cmd,
+   void* data);
+static bool_t net_server_patch(int cmd, int sock, void* data,
+   net_server_patch_t* p_patch);
+static void net_server_sync(core_t* p_core);
+static void net_server_send_snapshot(core_t* p_core, int sock);
 
 /* MODULE CONSTANTS / VARIABLES **********************************************/
 SYS_ASSERT_FILE;
@@ -39,11 +61,14 @@ TRC_DEF(net_server);
 static net_cfg_t net_cfg = {
    .is_server = TRUE,
    .port = 5050,
-   .max_connections = 4,
+   .max_connections = SRV_GAME_MAX_GAMES * SRV_GAME_MAX_PLAYERS,
    .poll = FALSE,
-   .evt_fn = net_server_evt_cb_fn
+   .evt_fn = net_server_evt_cb_fn,
+   .tx_high_water = 64 * 1024
 };
 
+static int bot_players; /* Players a started game is filled up to */
+
 /* GLOBAL CONSTANTS / VARIABLES **********************************************/
 
 /* GLOBAL FUNCTIONS **********************************************************/
@@ -63,12 +88,143 @@ void net_server_start(void)
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void net_server_send_cmd(int sock, int cmd, void* data)
+void net_server_send_cmd(core_t* p_core, int sock, int cmd, void* data)
+{
+   net_buf_t* p_buf;
+   if (SRV_BOT_IS_BOT(sock))
+   { /* No socket, a bot only answers prompts */
+      net_server_bot_prompt(p_core, cmd);
+      return;
+   }
+   if (cmd != NET_CMD_SERVER_LOG_ENTRY)
+   { /* Clients act on the state before the command */
+      net_server_sync(p_core);
+   }
+   p_buf = net_server_encode(p_core, sock, cmd, data);
+   if (p_buf != NULL)
+   {
+      net_write_buf(sock, p_buf);
+      net_buf_unref(p_buf);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+The packet is encoded once and the same buffer is queued to every player.
+Players with their own value of a field get a patched copy.
+-----------------------------------------------------------------------------*/
+void net_server_broadcast_cmd(core_t* p_core, int cmd, void* data)
+{
+   player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
+   net_buf_t* p_buf;
+
+   if (p_player == NULL)
+   {
+      return;
+   }
+   if (cmd != NET_CMD_SERVER_LOG_ENTRY)
+   { /* Clients act on the state before the command */
+      net_server_sync(p_core);
+   }
+   p_buf = net_server_encode(p_core, -1, cmd, data);
+   if (p_buf == NULL)
+   {
+      return;
+   }
+   while(p_player != NULL)
+   {
+      net_server_patch_t patch;
+      if (SRV_BOT_IS_BOT(p_player->id))
+      { /* No socket */
+      }
+      else if (net_server_patch(cmd, p_player->id, data, &patch))
+      {
+         net_buf_t* p_own = net_buf_patch(p_buf, patch.offset, patch.bytes,
+            patch.n);
+         net_write_buf(p_player->id, p_own);
+         net_buf_unref(p_own);
+      }
+      else
+      {
+         net_write_buf(p_player->id, p_buf);
+      }
+      p_player = SLNK_NEXT(player_t, p_player);
+   }
+   net_buf_unref(p_buf);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_server_set_bots(int n_players)
+{
+   bot_players = n_players;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_server_bot_game(void)
+{
+   srv_game_t* p_game = srv_game_add();
+
+   if (p_game == NULL)
+   {
+      TRC_ERR(net_server, "Error: No game for bots");
+      return;
+   }
+   srv_worker_post(p_game, net_server_bot_start_fn, 0, -1, NULL, 0);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void net_server_start_game(core_t* p_core, int n_players)
+{
+   srv_game_t* p_game = SRV_GAME_OF(p_core);
+
+   srv_game_close(p_game);
+   net_server_seat_bots(p_game, n_players);
+   srv_hsm_post(p_game->p_hsm, HSM_EVT_NET_START_GAME, 0,
+      SRV_HSM_PRIO_NORMAL);
+}
+
+/*-----------------------------------------------------------------------------
+Timers go before the net events already posted. A removed game waits for its
+queued bot moves, it has nothing to time.
+-----------------------------------------------------------------------------*/
+void net_server_timer_evt(core_t* p_core)
+{
+   srv_game_t* p_game = SRV_GAME_OF(p_core);
+
+   if (p_game->removed)
+   {
+      return;
+   }
+   srv_hsm_post(p_game->p_hsm, HSM_EVT_TIMER, 0, SRV_HSM_PRIO_HIGH);
+   srv_worker_after(p_game, net_server_game_run);
+}
+
+/*-----------------------------------------------------------------------------
+A searched move is played as if the client of the player sent it.
+-----------------------------------------------------------------------------*/
+void net_server_bot_evt(core_t* p_core, int evt, int arg)
+{
+   srv_game_t* p_game = SRV_GAME_OF(p_core);
+
+   TRC_DBG(net_server, "Player %d plays searched move (evt %d) game %d",
+      p_core->active_player->id, evt, p_game->id);
+   srv_hsm_post(p_game->p_hsm, evt, arg, SRV_HSM_PRIO_NORMAL);
+   srv_worker_after(p_game, net_server_game_run);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Encode a command for a socket (-1 for all, see net_server_patch).
+\return Buffer with one reference or NULL if unknown command
+-----------------------------------------------------------------------------*/
+static net_buf_t* net_server_encode(core_t* p_core, int sock, int cmd,
+   void* data)
 {
-   uint8_t packet[MAX_PACKET_SZ];
-   int len = 2;
-   packet[0] = cmd >> 8;
-   packet[1] = cmd & 0xff;
+   net_buf_t* p_buf = net_buf_alloc(MAX_PACKET_SZ);
+   uint8_t* packet = NET_BUF_DATA(p_buf);
+   int len = -1;
    TRC_DBG(net_server, "Sending command %s (%d) ",
       net_us_cmd_to_str(cmd), cmd);
    switch (cmd)
@@ -76,280 +232,425 @@ void net_server_send_cmd(int sock, int cmd, void* data)
       case NET_CMD_SERVER_PLAYER_INFO:
       { /* Only name (fixed values) */
          player_t* p_player = (player_t*)data;
-         int id = (p_player->id == sock)?0:p_player->id;
-         len += pbuf_pack(&packet[2], "wsdw", id, MAX_CLIENT_NAME_LEN,
-            p_player->name, p_player->id);
+         net_us_server_player_info_t msg;
+         msg.id = (p_player->id == sock)?0:p_player->id;
+         memcpy(msg.name, p_player->name, MAX_CLIENT_NAME_LEN);
+         msg.player_id = p_player->id;
+         len = net_us_enc_server_player_info(packet, MAX_PACKET_SZ, &msg);
          break;
       }
       case NET_CMD_SERVER_PLAYER_REMOVE:
       {
-         int id = (int)data;
-         len += pbuf_pack(&packet[2], "w", id);
-         break;
-      }
-      case NET_CMD_SERVER_PLAYER_UPDATE:
-      { /* Used for any other player updates during the game */
-         player_t* p_player = (player_t*)data;
-         card_t* p_card = SLNK_NEXT(card_t, &p_player->cards_head);
-         int i;
-         len += pbuf_pack(&packet[2], "w", p_player->id);
-         len += pbuf_pack(&packet[len], "bbbwww", p_player->color,
-            p_player->ap, p_player->politicians, p_player->vocations,
-            p_player->wealth, p_player->prestige);
-         /* Cards */
-         for (i=0;i<6;i++)
-         {
-            uint8_t id = (p_card)?p_card->id:0;
-            len += pbuf_pack(&packet[len], "b", id);
-            if (p_card)
-            {
-               p_card = SLNK_NEXT(card_t, p_card);
-            }
-         }
-         break;
-      }
-      case NET_CMD_SERVER_BOARD_CARDS_UPDATE:
-      {
-         int i;
-         for (i=0;i<5;i++)
-         {
-            card_t* p_card = core_get()->board_planning_cards[i];
-            uint8_t id = (p_card)?p_card->id:0;
-            len += pbuf_pack(&packet[len], "b", id);
-         }
-         for (i=0;i<8;i++)
-         {
-            card_t* p_card = core_get()->board_contract_cards[i];
-            uint8_t id = (p_card)?p_card->id:0;
-            len += pbuf_pack(&packet[len], "b", id);
-         }
+         net_us_server_player_remove_t msg;
+         msg.id = (intptr_t)data;
+         len = net_us_enc_server_player_remove(packet, MAX_PACKET_SZ, &msg);
          break;
       }
       case NET_CMD_SERVER_START_GAME:
+         len = net_us_enc_server_start_game(packet, MAX_PACKET_SZ, NULL);
          break;
       case NET_CMD_SERVER_SELECT_COLOR:
-         len += pbuf_pack(&packet[2], "b", core_get()->available_colors);
-         break;
-      case NET_CMD_SERVER_BLOCK_UPDATE:
       {
-         block_t* p_blk = (block_t*)data;
-         int i;
-         len += pbuf_pack(&packet[len], "bbw", p_blk->id,
-            p_blk->n_buildings, p_blk->value);
-         for (i=0;i<4;i++)
-         {
-            len += pbuf_pack(&packet[len], "bbbb",
-               p_blk->buildings[i].zone, p_blk->buildings[i].size,
-               p_blk->buildings[i].owner, p_blk->buildings[i].block_pos);
-         }
-         TRC_DBG(net_server, "Block: id %d, n_buildings %d, value %d",
-            p_blk->id, p_blk->n_buildings, p_blk->value);
-         break;
-      }
-      case NET_CMD_SERVER_ACTIVE_PLAYER:
-      {
-         int id = core_get()->active_player->id;
-         len += pbuf_pack(&packet[2], "w", id);
+         net_us_server_select_color_t msg;
+         msg.available_colors = p_core->available_colors;
+         len = net_us_enc_server_select_color(packet, MAX_PACKET_SZ, &msg);
          break;
       }
       case NET_CMD_SERVER_SELECT_ACTION:
+         len = net_us_enc_server_select_action(packet, MAX_PACKET_SZ, NULL);
          break;
       case NET_CMD_SERVER_SELECT_BUILDING_ROTATION:
+         len = net_us_enc_server_select_building_rotation(packet,
+            MAX_PACKET_SZ, NULL);
          break;
       case NET_CMD_SERVER_SELECT_BOARD_LOT:
+         len = net_us_enc_server_select_board_lot(packet, MAX_PACKET_SZ,
+            NULL);
          break;
       case NET_CMD_SERVER_SELECT_BOARD_CARD:
+         len = net_us_enc_server_select_board_card(packet, MAX_PACKET_SZ,
+            NULL);
          break;
       case NET_CMD_SERVER_SELECT_PLAYER_CARD:
+         len = net_us_enc_server_select_player_card(packet, MAX_PACKET_SZ,
+            NULL);
          break;
       case NET_CMD_SERVER_SELECT_CARD_CHOICE:
+         len = net_us_enc_server_select_card_choice(packet, MAX_PACKET_SZ,
+            NULL);
          break;
-      case NET_CMD_SERVER_PHASE_UPDATE:
-      {
-         core_t* p_core = core_get();
-         len += pbuf_pack(&packet[2], "bb", p_core->current_round,
-            p_core->state);
-         break;
-      }
       case NET_CMD_SERVER_LOG_ENTRY:
       {
-         core_log_entry_t* p_clog = &core_get()->log_entry;
-         int id = (p_clog->p_player)?p_clog->p_player->id:0;
-         len += pbuf_pack(&packet[2], "wsd", id,
-               strlen(p_clog->text) + 1, p_clog->text);
+         core_log_entry_t* p_clog = &p_core->log_entry;
+         net_us_server_log_entry_t msg;
+         msg.id = (p_clog->p_player)?p_clog->p_player->id:0;
+         snprintf(msg.text, NET_US_MAX_LOG_ENTRY, "%s", p_clog->text);
+         len = net_us_enc_server_log_entry(packet, MAX_PACKET_SZ, &msg);
          break;
       }
       default:
          TRC_ERR(net_server, "Error: Unknown command %d", cmd);
-         return;
+         break;
    }
-   net_write_packet(sock, packet, len);
+   if (len < 0)
+   {
+      net_buf_unref(p_buf);
+      return NULL;
+   }
+   net_buf_set_len(p_buf, len);
+   return p_buf;
 }
 
 /*-----------------------------------------------------------------------------
+Fields of a broadcast that depend on the recipient.
+\return TRUE if the recipient needs p_patch applied
 -----------------------------------------------------------------------------*/
-void net_server_broadcast_cmd(int cmd, void* data)
+static bool_t net_server_patch(int cmd, int sock, void* data,
+   net_server_patch_t* p_patch)
 {
-   player_t* p_player = SLNK_NEXT(player_t, &core_get()->players_head);
-   while(p_player != NULL)
+   switch (cmd)
    {
-      net_server_send_cmd(p_player->id, cmd, data);
-      p_player = SLNK_NEXT(player_t, p_player);
+      case NET_CMD_SERVER_PLAYER_INFO:
+      { /* A player gets its own info with id 0 */
+         player_t* p_player = (player_t*)data;
+         if (p_player->id != sock)
+         {
+            return FALSE;
+         }
+         p_patch->offset = 2; /* U32 id */
+         p_patch->n = 4;
+         memset(p_patch->bytes, 0, 4);
+         return TRUE;
+      }
+      default:
+         return FALSE;
    }
 }
 
-/* LOCAL FUNCTIONS ***********************************************************/
 /*-----------------------------------------------------------------------------
+Send the state changes of a game to all players as one delta.
+-----------------------------------------------------------------------------*/
+static void net_server_sync(core_t* p_core)
+{
+   player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
+   net_buf_t* p_buf;
+   int len;
+
+   if (!core_sync_pending(p_core))
+   {
+      return;
+   }
+   if (p_player != NULL)
+   {
+      p_buf = net_buf_alloc(NET_SERVER_SYNC_SZ);
+      len = core_sync_encode(p_core, NET_BUF_DATA(p_buf), NET_SERVER_SYNC_SZ,
+         FALSE);
+      REQUIRE(len > 0);
+      net_buf_set_len(p_buf, len);
+      TRC_DBG(net_server, "Sending state delta %u (%d bytes)",
+         p_core->version + 1, len);
+      while(p_player != NULL)
+      {
+         if (!SRV_BOT_IS_BOT(p_player->id))
+         {
+            net_write_buf(p_player->id, p_buf);
+         }
+         p_player = SLNK_NEXT(player_t, p_player);
+      }
+      net_buf_unref(p_buf);
+   }
+   core_sync_clear(p_core);
+}
+
+/*-----------------------------------------------------------------------------
+Send all state of a game to a (late joining) player.
+-----------------------------------------------------------------------------*/
+static void net_server_send_snapshot(core_t* p_core, int sock)
+{
+   net_buf_t* p_buf = net_buf_alloc(NET_SERVER_SYNC_SZ);
+   int len = core_sync_encode(p_core, NET_BUF_DATA(p_buf), NET_SERVER_SYNC_SZ,
+      TRUE);
+   REQUIRE(len > 0);
+   net_buf_set_len(p_buf, len);
+   TRC_DBG(net_server, "Sending state snapshot %u (%d bytes)",
+      p_core->version, len);
+   net_write_buf(sock, p_buf);
+   net_buf_unref(p_buf);
+}
+
+/*-----------------------------------------------------------------------------
+Net thread. Map the socket to its game and hand the event to the game worker.
 -----------------------------------------------------------------------------*/
 static void net_server_evt_cb_fn(int evt, int sock, void* data, int len)
 {
+   srv_game_t* p_game;
+
+   if (evt == NET_EVT_NEW_CONNECTION)
+   { /* Seat the new player in a game */
+      p_game = srv_game_join(sock);
+      if (p_game == NULL)
+      {
+         TRC_ERR(net_server, "Error: No game for socket %d", sock);
+         return;
+      }
+      srv_worker_post(p_game, net_server_game_evt_fn, evt, sock, NULL, 0);
+   }
+   else if (evt == NET_EVT_DISCONNECTED)
+   {
+      p_game = srv_game_find_by_sock(sock);
+      if (p_game != NULL)
+      {
+         /* The worker releases the socket when it is done with it */
+         srv_worker_post(p_game, net_server_game_evt_fn, evt, sock, NULL, 0);
+         srv_game_leave(sock);
+      }
+      else
+      {
+         net_release(sock);
+      }
+   }
+   else if (evt == NET_EVT_RX)
+   {
+      p_game = srv_game_find_by_sock(sock);
+      if (p_game == NULL)
+      {
+         TRC_ERR(net_server, "Error: Socket %d not in a game", sock);
+         return;
+      }
+      srv_worker_post(p_game, net_server_game_evt_fn, evt, sock, data, len);
+   }
+   else
+   {
+      TRC_ERR(net_server, "Error: Unknown net event");
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Game worker. Handle a net event for the game. Commands post their state machine
+events, the events of all net events queued for the game in a row are run once
+after them (net_server_game_run). The events posted before a player joins or
+leaves are run first, they are dispatched with the players they were sent for.
+-----------------------------------------------------------------------------*/
+static void net_server_game_evt_fn(srv_game_t* p_game, int evt, int sock,
+   void* data, int len)
+{
+   core_t* p_core = &p_game->core;
+
+   net_write_begin();
+   if (evt != NET_EVT_RX)
+   {
+      srv_hsm_run(p_game->p_hsm, 0);
+   }
    if (evt == NET_EVT_NEW_CONNECTION)
    { /* Don't update other clients until name is sent */
       /* Create new player */
       player_t* p_player = (player_t*)calloc(1, sizeof(player_t));
       REQUIRE(p_player != NULL);
       p_player->id = sock;
-      core_add_player(p_player);
-      TRC_DBG(net_server, "New connection on socket %d", sock);
-      //net_server_send_cmd(sock, );
+      core_add_player(p_core, p_player);
+      TRC_DBG(net_server, "New connection on socket %d (game %d)", sock,
+         p_game->id);
    }
    else if (evt == NET_EVT_DISCONNECTED)
    { /* Client disconnected from server */
-      player_t* p_player = core_find_player(sock);
+      player_t* p_player = core_find_player(p_core, sock);
       TRC_DBG(net_server, "Client disconnected (socket %d)", sock);
       if (p_player != NULL)
       {
          /* Remove client/player */
-         core_rm_player(p_player);
+         core_rm_player(p_core, p_player);
          /*  Update other clients */
-         p_player = SLNK_NEXT(player_t, &core_get()->players_head);
+         p_player = SLNK_NEXT(player_t, &p_core->players_head);
          while(p_player != NULL)
          {
-            net_server_send_cmd(p_player->id, NET_CMD_SERVER_PLAYER_REMOVE,
-               (void*)sock);
+            net_server_send_cmd(p_core, p_player->id,
+               NET_CMD_SERVER_PLAYER_REMOVE, (void*)(intptr_t)sock);
             p_player = SLNK_NEXT(player_t, p_player);
          }
       }
    }
    else if (evt == NET_EVT_RX)
    {
-      net_server_parse_command(sock, data, len);
+      net_server_parse_command(p_game, sock, data, len);
    }
-   else
-   {
-      TRC_ERR(net_server, "Error: Unknown net event");
+   net_write_end();
+   srv_worker_after(p_game, net_server_game_run);
+   if (evt == NET_EVT_DISCONNECTED)
+   { /* Nothing in this game writes to the socket any more */
+      net_release(sock);
    }
 }
 
+/*-----------------------------------------------------------------------------
+Game worker, after the work queued for the game. Run the posted events, all
+packets sent go out together when they are done, state changes as one delta.
+-----------------------------------------------------------------------------*/
+static void net_server_game_run(srv_game_t* p_game)
+{
+   net_write_begin();
+   srv_hsm_run(p_game->p_hsm, 0);
+   net_server_sync(&p_game->core);
+   net_write_end();
+}
+
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-static void net_server_parse_command(int sock, void* data, int len)
+static void net_server_parse_command(srv_game_t* p_game, int sock, void* data,
+   int len)
 {
    uint8_t* p_data = (uint8_t*)data;
    net_us_cmd_t cmd = (p_data[0] << 8) + p_data[1];
-   core_t* p_core = core_get();
-   TRC_DBG(net_server, "Command received: %s (%d) ",
-      net_us_cmd_to_str(cmd), cmd);
+   srv_hsm_t* p_hsm = p_game->p_hsm;
+   core_t* p_core = &p_game->core;
+   TRC_DBG(net_server, "Command received: %s (%d) game %d",
+      net_us_cmd_to_str(cmd), cmd, p_game->id);
+   srv_hsm_player_seen(p_hsm, sock);
    switch (cmd)
    {
       case NET_CMD_CLIENT_PLAYER_NAME:
       { /* Update player name and send player info to clients */
-         player_t* p_player = core_find_player(sock);
+         player_t* p_player = core_find_player(p_core, sock);
          player_t* p_player2;
-         memset(p_player->name, 0, MAX_CLIENT_NAME_LEN);
-         memcpy(p_player->name, &p_data[2], len-2);
+         net_us_client_player_name_t msg;
+         if (net_us_dec_client_player_name(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_server, "Error: Malformed command %d", cmd);
+            break;
+         }
+         memset(p_player->name, 0, MAX_NAME_LENGTH);
+         memcpy(p_player->name, msg.name, MAX_CLIENT_NAME_LEN);
          p_player2 = SLNK_NEXT(player_t, &p_core->players_head);
          while(p_player2 != NULL)
          {
-            /* Update new player with all players info */
-            net_server_send_cmd(p_player->id, NET_CMD_SERVER_PLAYER_INFO,
-               p_player2);
-            /* Update players with new player info */
+            /* Update new player with all other players info */
             if (p_player->id != p_player2->id)
             {
-               net_server_send_cmd(p_player2->id, NET_CMD_SERVER_PLAYER_INFO,
-                  p_player);
+               net_server_send_cmd(p_core, p_player->id,
+                  NET_CMD_SERVER_PLAYER_INFO, p_player2);
             }
             p_player2 = SLNK_NEXT(player_t, p_player2);
          }
+         /* Update all players (new player last) with new player info */
+         net_server_broadcast_cmd(p_core, NET_CMD_SERVER_PLAYER_INFO,
+            p_player);
+         /* Bring new player up to date */
+         net_server_send_snapshot(p_core, p_player->id);
          /* Send greeting to new player */
          p_core->log_entry.p_player = NULL;
          strcpy(p_core->log_entry.text, "Welcome!");
          //core_log(NULL, "Welcome!");
-         net_server_send_cmd(p_player->id, NET_CMD_SERVER_LOG_ENTRY, NULL);
+         net_server_send_cmd(p_core, p_player->id, NET_CMD_SERVER_LOG_ENTRY,
+            NULL);
          break;
       }
       case NET_CMD_CLIENT_START_GAME:
       {
-         srv_hsm_evt(HSM_EVT_NET_START_GAME);
+         net_server_start_game(p_core, bot_players);
          break;
       }
       case NET_CMD_CLIENT_LOAD_GAME:
       {
-         srv_hsm_evt(HSM_EVT_NET_LOAD_GAME);
+         srv_hsm_post(p_hsm, HSM_EVT_NET_LOAD_GAME, 0, SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_SELECT_COLOR:
       {
-         pbuf_unpack(&p_data[2], "b", &core_get()->color_selection);
-         REQUIRE(core_get()->color_selection <= PLAYER_COLOR_LAST);
-         srv_hsm_evt(HSM_EVT_NET_SELECT_COLOR);
+         net_us_client_select_color_t msg;
+         if (net_us_dec_client_select_color(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_server, "Error: Malformed command %d", cmd);
+            break;
+         }
+         REQUIRE(msg.color <= PLAYER_COLOR_LAST);
+         srv_hsm_post(p_hsm, HSM_EVT_NET_SELECT_COLOR, msg.color,
+            SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_SELECT_ACTION:
       {
-         pbuf_unpack(&p_data[2], "b", &core_get()->action_selection);
-         srv_hsm_evt(HSM_EVT_NET_SELECT_ACTION);
+         net_us_client_select_action_t msg;
+         if (net_us_dec_client_select_action(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_server, "Error: Malformed command %d", cmd);
+            break;
+         }
+         srv_hsm_post(p_hsm, HSM_EVT_NET_SELECT_ACTION, msg.action,
+            SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_SELECT_BUILDING_ROTATION:
       {
-         pbuf_unpack(&p_data[2], "b", &core_get()->rotation_selection);
-         srv_hsm_evt(HSM_EVT_NET_SELECT_BUILDING_ROTATION);
+         net_us_client_select_building_rotation_t msg;
+         if (net_us_dec_client_select_building_rotation(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_server, "Error: Malformed command %d", cmd);
+            break;
+         }
+         srv_hsm_post(p_hsm, HSM_EVT_NET_SELECT_BUILDING_ROTATION,
+            msg.rotation, SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_SELECT_BOARD_LOT:
       {
-         pbuf_unpack(&p_data[2], "b", &core_get()->board_lot_selection);
-         //REQUIRE(core_get()->board_lot_selection < MAX_BOARD_LOTS);
-         srv_hsm_evt(HSM_EVT_NET_SELECT_BOARD_LOT);
+         net_us_client_select_board_lot_t msg;
+         if (net_us_dec_client_select_board_lot(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_server, "Error: Malformed command %d", cmd);
+            break;
+         }
+         //REQUIRE(msg.lot < MAX_BOARD_LOTS);
+         srv_hsm_post(p_hsm, HSM_EVT_NET_SELECT_BOARD_LOT, msg.lot,
+            SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_SELECT_BOARD_CARD:
       {
-         pbuf_unpack(&p_data[2], "b", &core_get()->card_selection);
-         srv_hsm_evt(HSM_EVT_NET_SELECT_BOARD_CARD);
+         net_us_client_select_board_card_t msg;
+         if (net_us_dec_client_select_board_card(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_server, "Error: Malformed command %d", cmd);
+            break;
+         }
+         srv_hsm_post(p_hsm, HSM_EVT_NET_SELECT_BOARD_CARD, msg.card,
+            SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_SELECT_PLAYER_CARD:
       {
-         pbuf_unpack(&p_data[2], "b", &core_get()->card_selection);
-         srv_hsm_evt(HSM_EVT_NET_SELECT_PLAYER_CARD);
+         net_us_client_select_player_card_t msg;
+         if (net_us_dec_client_select_player_card(p_data, len, &msg) < 0)
+         {
+            TRC_ERR(net_server, "Error: Malformed command %d", cmd);
+            break;
+         }
+         srv_hsm_post(p_hsm, HSM_EVT_NET_SELECT_PLAYER_CARD, msg.card,
+            SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_SELECT_CARD_CHOICE:
       {
-         //pbuf_unpack(&p_data[2], "b", &core_get()->card_choice);
-         //srv_hsm_evt(HSM_EVT_NET_SELECT_CARD_CHOICE);
+         //pbuf_unpack(&p_data[2], "b", &p_core->card_choice);
+         //srv_hsm_post(p_hsm, HSM_EVT_NET_SELECT_CARD_CHOICE, 0,
+         //   SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_PASS:
       {
-         core_log(p_core->active_player, "passed");
+         core_log(p_core, p_core->active_player, "passed");
          p_core->active_player->passed = TRUE;
-         srv_hsm_evt(HSM_EVT_NET_PASS);
+         srv_hsm_post(p_hsm, HSM_EVT_NET_PASS, 0, SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_DONE:
       {
-         core_log(p_core->active_player, "done");
+         core_log(p_core, p_core->active_player, "done");
          //p_core->active_player->done = TRUE;
-         srv_hsm_evt(HSM_EVT_NET_DONE);
+         srv_hsm_post(p_hsm, HSM_EVT_NET_DONE, 0, SRV_HSM_PRIO_NORMAL);
          break;
       }
       case NET_CMD_CLIENT_BACK:
       {
-         srv_hsm_evt(HSM_EVT_NET_BACK);
+         srv_hsm_post(p_hsm, HSM_EVT_NET_BACK, 0, SRV_HSM_PRIO_NORMAL);
          break;
       }
       default:
@@ -358,5 +659,72 @@ static void net_server_parse_command(int sock, void* data, int len)
    }
 }
 
+/*-----------------------------------------------------------------------------
+Queue a move of the active bot for a prompt. One queued move is enough, it is
+searched for the state when it is handled.
+-----------------------------------------------------------------------------*/
+static void net_server_bot_prompt(core_t* p_core, int cmd)
+{
+   srv_game_t* p_game = SRV_GAME_OF(p_core);
+
+   switch (cmd)
+   {
+      case NET_CMD_SERVER_SELECT_COLOR:
+      case NET_CMD_SERVER_SELECT_ACTION:
+      case NET_CMD_SERVER_SELECT_BUILDING_ROTATION:
+      case NET_CMD_SERVER_SELECT_BOARD_LOT:
+      case NET_CMD_SERVER_SELECT_BOARD_CARD:
+      case NET_CMD_SERVER_SELECT_PLAYER_CARD:
+      case NET_CMD_SERVER_SELECT_CARD_CHOICE:
+         if (p_game->bot_moves == 0)
+         {
+            srv_bot_search(p_game, -1);
+         }
+         break;
+      default:
+         break;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Game worker. Seat bots in a new game without sockets and start it.
+-----------------------------------------------------------------------------*/
+static void net_server_bot_start_fn(srv_game_t* p_game, int evt, int sock,
+   void* data, int len)
+{
+   TOUCH(evt);
+   TOUCH(sock);
+   TOUCH(data);
+   TOUCH(len);
+   net_write_begin();
+   net_server_seat_bots(p_game, SRV_GAME_MAX_PLAYERS);
+   srv_hsm_post(p_game->p_hsm, HSM_EVT_NET_START_GAME, 0,
+      SRV_HSM_PRIO_NORMAL);
+   net_write_end();
+   srv_worker_after(p_game, net_server_game_run);
+}
+
+/*-----------------------------------------------------------------------------
+Seat bots up to n_players and tell the clients about them.
+-----------------------------------------------------------------------------*/
+static void net_server_seat_bots(srv_game_t* p_game, int n_players)
+{
+   core_t* p_core = &p_game->core;
+   int n = srv_bot_fill(p_game, n_players);
+   player_t* p_player = SLNK_NEXT(player_t, &p_core->players_head);
+   int i = 0;
+
+   while(p_player != NULL)
+   { /* New bots are last */
+      if (i >= p_core->n_players - n)
+      {
+         net_server_broadcast_cmd(p_core, NET_CMD_SERVER_PLAYER_INFO,
+            p_player);
+      }
+      i++;
+      p_player = SLNK_NEXT(player_t, p_player);
+   }
+}
+
 /* END OF FILE ***************************************************************/
 
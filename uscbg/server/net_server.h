@@ -9,6 +9,7 @@ Copyright (c) 2013, All Rights Reserved.
 #ifndef NET_SERVER_H
 #define NET_SERVER_H
 /* INCLUDE FILES *************************************************************/
+#include "core.h"
 
 /* EXPORTED DEFINES **********************************************************/
 
@@ -36,18 +37,65 @@ void net_server_start(
 /*! \brief Send command to client. */
 /*---------------------------------------------------------------------------*/
 void net_server_send_cmd(
+   core_t* p_core,      /*!< Game instance */
    int sock,
    int cmd,
    void* data
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Send command to all clients. */
+/*! \brief Send command to all clients. Encoded once, shared by all. */
 /*---------------------------------------------------------------------------*/
 void net_server_broadcast_cmd(
+   core_t* p_core,      /*!< Game instance */
    int cmd,
    void* data
    );
 
+/*---------------------------------------------------------------------------*/
+/*! \brief Fill games with bots up to n_players when started (0 = no bots).
+Called before net_server_start(). */
+/*---------------------------------------------------------------------------*/
+void net_server_set_bots(
+   int n_players
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Create and start a game of bots only (no sockets). Called before
+net_server_start(). */
+/*---------------------------------------------------------------------------*/
+void net_server_bot_game(
+   void
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Close a game for new players, seat bots up to n_players and post
+the start of the game. Called on the worker owning the game. */
+/*---------------------------------------------------------------------------*/
+void net_server_start_game(
+   core_t* p_core,      /*!< Game instance */
+   int n_players        /*!< Players wanted (0 = no bots) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Post a timer event of a game, it is run and the changes are sent
+as for a net event. Called on the worker owning the game (from a timer
+callback). */
+/*---------------------------------------------------------------------------*/
+void net_server_timer_evt(
+   core_t* p_core       /*!< Game instance */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Post the event of a searched move, it is run and the changes are
+sent as for a net event. Called on the worker owning the game (srv_bot_init
+event function). */
+/*---------------------------------------------------------------------------*/
+void net_server_bot_evt(
+   core_t* p_core,      /*!< Game instance */
+   int evt,             /*!< HSM event */
+   int arg              /*!< Event argument (selection) */
+   );
+
 #endif /* #ifndef NET_SERVER_H */
 /* END OF FILE ***************************************************************/
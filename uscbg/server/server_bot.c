@@ -0,0 +1,297 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file server_bot.c
+\brief The Urban Sprawl server computer players implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+#include <pthread.h>
+#include "slnk.h"
+#include "trc.h"
+#include "core.h"
+#include "core_move.h"
+#include "core_ai.h"
+#include "server_hsm.h"
+#include "server_game.h"
+#include "server_worker.h"
+#include "server_bot.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+
+/* LOCAL DATATYPES ***********************************************************/
+typedef struct
+{
+   uint32_t version;          /*!< Game version searched */
+   int player;                /*!< Player searched for */
+   bool_t found;              /*!< FALSE if the player has no move */
+   move_t move;
+} srv_bot_move_t;             /*!< Search result */
+
+typedef struct srv_bot_job
+{
+   struct srv_bot_job* p_next;
+   srv_game_t* p_game;        /*!< Game the move is posted back to */
+   srv_bot_move_t result;
+   core_t core;               /*!< Copy of the game searched */
+} srv_bot_job_t;              /*!< Queued search */
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static srv_worker_fn_t srv_bot_start_fn;
+static srv_worker_fn_t srv_bot_move_fn;
+static int srv_bot_play(core_t* p_core, const srv_bot_move_t* p_move,
+   int* p_arg);
+static void *srv_bot_thread(void *arg);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_ASSERT_FILE;
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+TRC_DEF(srv_bot);
+
+static core_ai_cfg_t ai_cfg;  /* Read only after init */
+static int n_bots;            /* Bots created (all games) */
+static srv_bot_evt_fn_t* evt_fn; /* Plays the searched moves */
+/* Searches not started yet (any worker), one at most per game and player out
+of time, so the queue is not bounded */
+static srv_bot_job_t* p_jobs_head;
+static srv_bot_job_t* p_jobs_tail;
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_bot_init(int n_threads, int budget_ms, srv_bot_evt_fn_t* p_evt_fn)
+{
+   pthread_t thread_id;
+   int i;
+
+   TRC_REG(srv_bot, TRC_ERROR | TRC_DEBUG);
+   memset(&ai_cfg, 0, sizeof(ai_cfg));
+   ai_cfg.n_threads = n_threads;
+   ai_cfg.budget_ms = (budget_ms > 0) ? budget_ms : 1;
+   n_bots = 0;
+   evt_fn = p_evt_fn;
+   p_jobs_head = NULL;
+   p_jobs_tail = NULL;
+   for (i=0;i<srv_worker_count();i++)
+   {
+      pthread_create(&thread_id, NULL, srv_bot_thread, NULL);
+      pthread_detach(thread_id);
+   }
+   TRC_DBG(srv_bot, "Started %d search thread(s)", srv_worker_count());
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int srv_bot_fill(srv_game_t* p_game, int n_players)
+{
+   core_t* p_core = &p_game->core;
+   int n = 0;
+
+   n_players = MIN(n_players, SRV_GAME_MAX_PLAYERS);
+   while (p_core->n_players < n_players)
+   {
+      player_t* p_player = (player_t*)calloc(1, sizeof(player_t));
+      int bot = __atomic_fetch_add(&n_bots, 1, __ATOMIC_RELAXED);
+      REQUIRE(p_player != NULL);
+      p_player->id = SRV_BOT_ID_BASE + bot;
+      snprintf(p_player->name, MAX_NAME_LENGTH, "bot%d", bot + 1);
+      core_add_player(p_core, p_player);
+      p_game->n_bots++;
+      TRC_DBG(srv_bot, "Bot %d seated in game %d", p_player->id, p_game->id);
+      n++;
+   }
+   return n;
+}
+
+/*-----------------------------------------------------------------------------
+The search starts from a work function of its own, the work function calling
+srv_bot_search may still change the game (e.g. a prompt during a transition).
+-----------------------------------------------------------------------------*/
+void srv_bot_search(srv_game_t* p_game, int id)
+{
+   p_game->bot_moves++;
+   srv_worker_post(p_game, srv_bot_start_fn, 0, id, NULL, 0);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Game worker. Copy the game and queue the search for the search threads. sock
+is the player searched for (-1 = the active player if it is a bot).
+-----------------------------------------------------------------------------*/
+static void srv_bot_start_fn(srv_game_t* p_game, int evt, int sock,
+   void* data, int len)
+{
+   core_t* p_core = &p_game->core;
+   srv_bot_job_t* p_job;
+
+   TOUCH(evt);
+   TOUCH(data);
+   TOUCH(len);
+   if (!srv_game_bot_done(p_game))
+   {
+      return;
+   }
+   if ((p_core->active_player == NULL) ||
+       ((sock < 0) ? !SRV_BOT_IS_BOT(p_core->active_player->id) :
+                     (p_core->active_player->id != sock)))
+   { /* Not the player's turn any more */
+      return;
+   }
+   p_job = (srv_bot_job_t*)malloc(sizeof(srv_bot_job_t));
+   REQUIRE(p_job != NULL);
+   p_job->p_next = NULL;
+   p_job->p_game = p_game;
+   p_job->result.version = p_core->version;
+   p_job->result.player = p_core->active_player->id;
+   core_copy(&p_job->core, p_core);
+   /* Until the move function is done with the result */
+   p_game->bot_moves++;
+   pthread_mutex_lock(&jobs_mutex);
+   if (p_jobs_tail != NULL)
+   {
+      p_jobs_tail->p_next = p_job;
+   }
+   else
+   {
+      p_jobs_head = p_job;
+   }
+   p_jobs_tail = p_job;
+   pthread_cond_signal(&jobs_cond);
+   pthread_mutex_unlock(&jobs_mutex);
+}
+
+/*-----------------------------------------------------------------------------
+Game worker. Play a searched move. The events posted for the game before the
+move are run first, a move searched on a game that went on in the meantime is
+dropped. A bot is searched for again if it is still its turn (its prompt was
+skipped during the search). The run starts the clock of a player out of time
+again.
+-----------------------------------------------------------------------------*/
+static void srv_bot_move_fn(srv_game_t* p_game, int evt, int sock,
+   void* data, int len)
+{
+   core_t* p_core = &p_game->core;
+   srv_bot_move_t move;
+   int hsm_evt;
+   int arg;
+
+   TOUCH(evt);
+   TOUCH(sock);
+   REQUIRE(len == sizeof(move));
+   memcpy(&move, data, sizeof(move));
+   if (!srv_game_bot_done(p_game))
+   {
+      return;
+   }
+   srv_hsm_run(p_game->p_hsm, 0);
+   hsm_evt = srv_bot_play(p_core, &move, &arg);
+   if (hsm_evt >= 0)
+   {
+      evt_fn(p_core, hsm_evt, arg);
+   }
+   else if ((p_core->version != move.version) &&
+      (p_core->active_player != NULL) &&
+      SRV_BOT_IS_BOT(p_core->active_player->id) && (p_game->bot_moves == 0))
+   {
+      srv_bot_search(p_game, -1);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+The event and selection the client command of the move would post.
+\return HSM event of the move or -1 if there is no move to play
+-----------------------------------------------------------------------------*/
+static int srv_bot_play(core_t* p_core, const srv_bot_move_t* p_move,
+   int* p_arg)
+{
+   if ((p_core->version != p_move->version) ||
+       (p_core->active_player == NULL) ||
+       (p_core->active_player->id != p_move->player))
+   { /* The game went on during the search */
+      TRC_DBG(srv_bot, "Move of player %d dropped (version %u, now %u)",
+         p_move->player, p_move->version, p_core->version);
+      return -1;
+   }
+   if (!p_move->found)
+   {
+      return -1;
+   }
+   *p_arg = p_move->move.arg;
+   switch (p_move->move.type)
+   {
+   case MOVE_COLOR:
+      return HSM_EVT_NET_SELECT_COLOR;
+   case MOVE_BOARD_LOT:
+      return HSM_EVT_NET_SELECT_BOARD_LOT;
+   case MOVE_PLAYER_CARD:
+      return HSM_EVT_NET_SELECT_PLAYER_CARD;
+   case MOVE_ACTION:
+      return HSM_EVT_NET_SELECT_ACTION;
+   case MOVE_BOARD_CARD:
+      return HSM_EVT_NET_SELECT_BOARD_CARD;
+   case MOVE_DONE:
+      core_log(p_core, p_core->active_player, "done");
+      return HSM_EVT_NET_DONE;
+   default:
+      return -1;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Search thread. Search the queued games and post the moves back to their
+workers. The search is seeded with the game version.
+-----------------------------------------------------------------------------*/
+static void *srv_bot_thread(void *arg)
+{
+   TOUCH(arg);
+   while (1)
+   {
+      core_ai_cfg_t cfg = ai_cfg;
+      core_ai_stats_t stats;
+      srv_bot_job_t* p_job;
+
+      pthread_mutex_lock(&jobs_mutex);
+      while (p_jobs_head == NULL)
+      {
+         pthread_cond_wait(&jobs_cond, &jobs_mutex);
+      }
+      p_job = p_jobs_head;
+      p_jobs_head = p_job->p_next;
+      if (p_jobs_head == NULL)
+      {
+         p_jobs_tail = NULL;
+      }
+      pthread_mutex_unlock(&jobs_mutex);
+
+      cfg.seed = p_job->result.version;
+      p_job->result.found = core_ai_search(&p_job->core, &cfg,
+         &p_job->result.move, &stats);
+      if (p_job->result.found)
+      {
+         TRC_DBG(srv_bot,
+            "Player %d move %d %d (%d of %d moves, %d playouts, %.2f)",
+            p_job->result.player, p_job->result.move.type,
+            p_job->result.move.arg, stats.visits, stats.n_moves,
+            stats.iterations, stats.value);
+      }
+      core_free(&p_job->core);
+      srv_worker_post(p_job->p_game, srv_bot_move_fn, 0, -1, &p_job->result,
+         sizeof(p_job->result));
+      free(p_job);
+   }
+   return NULL;
+}
+
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,75 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file server_bot.h
+\brief The Urban Sprawl server computer players (bots).
+A bot is a player_t without a socket, its id is above all socket numbers.
+The net server does not send anything to a bot, a prompt (select command)
+starts a search of the bot move instead. The move is searched with
+core_ai_search() on a copy of the game by a pool of search threads, so the
+worker of the game keeps running its other games and timers. The move is
+posted back to the worker and handled as the same net command from a
+client. */
+/*---------------------------------------------------------------------------*/
+#ifndef SERVER_BOT_H
+#define SERVER_BOT_H
+/* INCLUDE FILES *************************************************************/
+#include "core.h"
+#include "core_move.h"
+#include "server_game.h"
+
+/* EXPORTED DEFINES **********************************************************/
+#define SRV_BOT_ID_BASE (SRV_GAME_MAX_SOCKETS) /*!< First bot player id */
+#define SRV_BOT_IS_BOT(id) ((id) >= SRV_BOT_ID_BASE)
+
+/* EXPORTED DATA TYPES *******************************************************/
+/*---------------------------------------------------------------------------*/
+/*! \brief Post the HSM event of a searched move. Called on the worker owning
+the game. */
+/*---------------------------------------------------------------------------*/
+typedef void srv_bot_evt_fn_t(
+   core_t* p_core,      /*!< Game instance */
+   int evt,             /*!< HSM event */
+   int arg              /*!< Event argument (selection) */
+   );
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize and start one search thread per worker (after
+srv_worker_init, before the workers are started). */
+/*---------------------------------------------------------------------------*/
+void srv_bot_init(
+   int n_threads,       /*!< Search threads per move (0 = one per cpu) */
+   int budget_ms,       /*!< Search time per move */
+   srv_bot_evt_fn_t* p_evt_fn /*!< Plays the searched moves */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Seat bots in a game until it has n_players. Called on the worker
+owning the game, before the game is started.
+\return Number of bots seated */
+/*---------------------------------------------------------------------------*/
+int srv_bot_fill(
+   srv_game_t* p_game,  /*!< Game */
+   int n_players        /*!< Players wanted (max SRV_GAME_MAX_PLAYERS) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Search the move of the active player (a bot or a player out of
+time). Called on the worker owning the game. The game is copied after the
+current work function, the move is played with the event function if the game
+has not changed by then. A search counts as a queued bot move of the game. */
+/*---------------------------------------------------------------------------*/
+void srv_bot_search(
+   srv_game_t* p_game,  /*!< Game */
+   int id               /*!< Player searched for (-1 = the active player if
+                             it is a bot) */
+   );
+
+#endif /* #ifndef SERVER_BOT_H */
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,252 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file server_game.c
+\brief The Urban Sprawl server game instance implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+#include "slnk.h"
+#include "trc.h"
+#include "core.h"
+#include "server_hsm.h"
+#include "server_game.h"
+#include "server_worker.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static srv_game_t* srv_game_create(void);
+static srv_worker_fn_t srv_game_destroy;
+static void srv_game_free(srv_game_t* p_game);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_ASSERT_FILE;
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+TRC_DEF(srv_game);
+
+static srv_game_t* games[SRV_GAME_MAX_GAMES];
+static srv_game_t* sock_game[SRV_GAME_MAX_SOCKETS];
+static srv_game_t* p_open_game; /* Game new players are seated in */
+static int n_games;
+static core_net_send_fn_t* net_send;
+static core_net_broadcast_fn_t* net_broadcast;
+static uint64_t next_seed; /* Seed of the next game created */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_game_init(core_net_send_fn_t* p_fn_send,
+   core_net_broadcast_fn_t* p_fn_bc, uint64_t seed)
+{
+   TRC_REG(srv_game, TRC_ERROR | TRC_DEBUG);
+   memset(games, 0, sizeof(games));
+   memset(sock_game, 0, sizeof(sock_game));
+   p_open_game = NULL;
+   n_games = 0;
+   net_send = p_fn_send;
+   net_broadcast = p_fn_bc;
+   next_seed = seed;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+srv_game_t* srv_game_join(int sock)
+{
+   srv_game_t* p_game = p_open_game;
+
+   if ((sock < 0) || (sock >= SRV_GAME_MAX_SOCKETS))
+   {
+      TRC_ERR(srv_game, "Error: socket %d out of range", sock);
+      return NULL;
+   }
+   REQUIRE(sock_game[sock] == NULL);
+   if ((p_game == NULL) || !__atomic_load_n(&p_game->open, __ATOMIC_ACQUIRE) ||
+       (p_game->n_seats >= SRV_GAME_MAX_PLAYERS))
+   {
+      p_game = srv_game_create();
+      p_open_game = p_game;
+   }
+   if (p_game != NULL)
+   {
+      sock_game[sock] = p_game;
+      p_game->n_seats++;
+      TRC_DBG(srv_game, "Socket %d joined game %d", sock, p_game->id);
+   }
+   return p_game;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+srv_game_t* srv_game_add(void)
+{
+   srv_game_t* p_game = srv_game_create();
+
+   if (p_game != NULL)
+   {
+      p_game->open = FALSE;
+   }
+   return p_game;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_game_leave(int sock)
+{
+   srv_game_t* p_game = srv_game_find_by_sock(sock);
+
+   if (p_game != NULL)
+   {
+      sock_game[sock] = NULL;
+      p_game->n_seats--;
+      TRC_DBG(srv_game, "Socket %d left game %d", sock, p_game->id);
+      if (p_game->n_seats == 0)
+      { /* Remove from registry, the worker frees it after pending events */
+         if (p_open_game == p_game)
+         {
+            p_open_game = NULL;
+         }
+         games[p_game->id] = NULL;
+         n_games--;
+         TRC_DBG(srv_game, "Game %d removed (%d running)", p_game->id,
+            n_games);
+         srv_worker_post(p_game, srv_game_destroy, 0, -1, NULL, 0);
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t srv_game_bot_done(srv_game_t* p_game)
+{
+   REQUIRE(p_game->bot_moves > 0);
+   p_game->bot_moves--;
+   if (p_game->removed)
+   {
+      if (p_game->bot_moves == 0)
+      {
+         srv_game_free(p_game);
+      }
+      return FALSE;
+   }
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_game_close(srv_game_t* p_game)
+{
+   __atomic_store_n(&p_game->open, FALSE, __ATOMIC_RELEASE);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+srv_game_t* srv_game_find(int id)
+{
+   if ((id < 0) || (id >= SRV_GAME_MAX_GAMES))
+   {
+      return NULL;
+   }
+   return games[id];
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+srv_game_t* srv_game_find_by_sock(int sock)
+{
+   if ((sock < 0) || (sock >= SRV_GAME_MAX_SOCKETS))
+   {
+      return NULL;
+   }
+   return sock_game[sock];
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int srv_game_count(void)
+{
+   return n_games;
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Create a game in the first free slot and start its state machine.
+-----------------------------------------------------------------------------*/
+static srv_game_t* srv_game_create(void)
+{
+   srv_game_t* p_game;
+   int id;
+
+   for (id=0;id<SRV_GAME_MAX_GAMES;id++)
+   {
+      if (games[id] == NULL)
+      {
+         break;
+      }
+   }
+   if (id == SRV_GAME_MAX_GAMES)
+   {
+      TRC_ERR(srv_game, "Error: max number of games reached");
+      return NULL;
+   }
+   p_game = (srv_game_t*)calloc(1, sizeof(srv_game_t));
+   REQUIRE(p_game != NULL);
+   p_game->id = id;
+   p_game->worker = id % srv_worker_count();
+   p_game->open = TRUE;
+   core_ctor(&p_game->core, net_send, net_broadcast);
+   p_game->core.is_server = TRUE;
+   p_game->core.game_id = id;
+   core_seed(&p_game->core, next_seed++);
+   p_game->p_hsm = srv_hsm_create(&p_game->core);
+   srv_hsm_start(p_game->p_hsm);
+   games[id] = p_game;
+   n_games++;
+   TRC_DBG(srv_game, "Game %d created on worker %d (%d running), seed %llu",
+      id, p_game->worker, n_games,
+      (unsigned long long)p_game->core.seed);
+   return p_game;
+}
+
+/*-----------------------------------------------------------------------------
+Free a removed game. Runs on the worker owning the game. Bot moves queued
+while the last player left come after this, the last one frees the game.
+-----------------------------------------------------------------------------*/
+static void srv_game_destroy(srv_game_t* p_game, int evt, int sock,
+   void* data, int len)
+{
+   TOUCH(evt);
+   TOUCH(sock);
+   TOUCH(data);
+   TOUCH(len);
+   p_game->removed = TRUE;
+   if (p_game->bot_moves == 0)
+   {
+      srv_game_free(p_game);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void srv_game_free(srv_game_t* p_game)
+{
+   TRC_DBG(srv_game, "Game %d destroyed", p_game->id);
+   srv_worker_forget(p_game);
+   srv_hsm_destroy(p_game->p_hsm);
+   core_free(&p_game->core);
+   free(p_game);
+}
+
+/* END OF FILE ***************************************************************/
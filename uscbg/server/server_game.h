@@ -0,0 +1,124 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file server_game.h
+\brief The Urban Sprawl server game instance interface.
+A server runs any number of games. Each game has its own core_t and server
+state machine. Every connected socket is seated in exactly one game.
+The game registry (join, leave, find) is only used by the net thread. The
+core and state machine of a game are only used by the worker owning it. */
+/*---------------------------------------------------------------------------*/
+#ifndef SERVER_GAME_H
+#define SERVER_GAME_H
+/* INCLUDE FILES *************************************************************/
+#include <stddef.h>
+#include "core.h"
+#include "server_hsm.h"
+
+/* EXPORTED DEFINES **********************************************************/
+#define SRV_GAME_MAX_GAMES (1024)   /*!< Max concurrent games */
+#define SRV_GAME_MAX_PLAYERS (4)    /*!< Max players in one game */
+#define SRV_GAME_MAX_SOCKETS (65536) /*!< Max socket number (sock to game) */
+/*! Game of a core_t (the core is embedded in the game) */
+#define SRV_GAME_OF(p_core) \
+   ((srv_game_t*)((uint8_t*)(p_core) - offsetof(srv_game_t, core)))
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef struct
+{
+   int id;                 /*!< Game id (index in game table) */
+   int worker;             /*!< Worker thread owning the game */
+   int n_seats;            /*!< Seated sockets (net thread) */
+   bool_t open;            /*!< Accepting new players (lobby) */
+   core_t core;            /*!< Game state */
+   srv_hsm_t* p_hsm;       /*!< Game state machine */
+   int n_bots;             /*!< Seated bots (worker) */
+   int bot_moves;          /*!< Queued bot moves (worker) */
+   bool_t removed;         /*!< Removed, freed after the queued bot moves
+                                (worker) */
+} srv_game_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize. */
+/*---------------------------------------------------------------------------*/
+void srv_game_init(
+   core_net_send_fn_t* p_fn_send,      /*!< Send function for all games */
+   core_net_broadcast_fn_t* p_fn_bc,   /*!< Broadcast function for all games */
+   uint64_t seed                       /*!< Seed of the first game, the next
+                                            games count up */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Seat a socket in an open game. A new game is created if no open
+game has a free seat.
+\return The game or NULL if no game could be created. */
+/*---------------------------------------------------------------------------*/
+srv_game_t* srv_game_join(
+   int sock             /*!< Socket */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Create a closed game without sockets (bot game). Only called
+before the net server is started.
+\return The game or NULL if no game could be created. */
+/*---------------------------------------------------------------------------*/
+srv_game_t* srv_game_add(
+   void
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Remove a socket from its game. When the last player has left the
+game is removed and destroyed by its worker after all queued events. */
+/*---------------------------------------------------------------------------*/
+void srv_game_leave(
+   int sock             /*!< Socket */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief A queued bot move of the game is taken off the queue. Called on the
+worker owning the game, a removed game is freed after its last bot move.
+\return FALSE if the game is removed (not to be used) */
+/*---------------------------------------------------------------------------*/
+bool_t srv_game_bot_done(
+   srv_game_t* p_game   /*!< Game */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Close a game for new players (game started). May be called from
+the worker owning the game. */
+/*---------------------------------------------------------------------------*/
+void srv_game_close(
+   srv_game_t* p_game   /*!< Game */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Find game by id.
+\return The game or NULL. */
+/*---------------------------------------------------------------------------*/
+srv_game_t* srv_game_find(
+   int id               /*!< Game id */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Find the game a socket is seated in.
+\return The game or NULL. */
+/*---------------------------------------------------------------------------*/
+srv_game_t* srv_game_find_by_sock(
+   int sock             /*!< Socket */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Number of running games. */
+/*---------------------------------------------------------------------------*/
+int srv_game_count(
+   void
+   );
+
+#endif /* #ifndef SERVER_GAME_H */
+/* END OF FILE ***************************************************************/
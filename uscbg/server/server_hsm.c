@@ -14,17 +14,27 @@ Copyright (c) 2013, All Rights Reserved.
 #include <malloc.h>
 #include <string.h>
 #include "slnk.h"
+#include "dlnk.h"
 #include "trc.h"
+#include "tmr.h"
 #include "hsm.h"
+#include "hsm_queue.h"
 #include "server_hsm.h"
 #include "net_us.h"
 #include "net_server.h"
 #include "core.h"
+#include "core_move.h"
+#include "core_ai.h"
+#include "server_game.h"
+#include "server_worker.h"
+#include "server_bot.h"
 
 /* CONSTANTS / MACROS ********************************************************/
+#define SRV_HSM_CLOCK_NONE (-1) /* Clock id: nothing to time */
+#define SRV_HSM_CLOCK_LOBBY (-2) /* Clock id: the lobby (>= 0 a player id) */
 
 /* LOCAL DATATYPES ***********************************************************/
-typedef struct
+struct srv_hsm
 {
    hsm_t super;
    hsm_state_t top;                       /*!< Top (all common messages) */
@@ -39,7 +49,14 @@ typedef struct
          hsm_state_t end_of_turn;         /*!< End of turn */
          hsm_state_t card;                /*!< Card (event) */
    bool_t started;
-} srv_hsm_t;            /*!< Server state machine states */
+   core_t* p_core;                        /*!< Game instance */
+   core_undo_stack_t undo;                /*!< Moves of the active player */
+   int passes;                            /*!< Turns in a row without a move */
+   hsm_queue_t queue;                     /*!< Posted events */
+   tmr_t clock;                           /*!< Lobby or turn clock */
+   int clock_id;                          /*!< What the clock runs for */
+   bool_t out_of_time;                    /*!< Playing for the clock player */
+};                      /*!< Server state machine states */
 
 /* LOCAL FUNCTION PROTOTYPES *************************************************/
 STATIC void srv_hsm_ctor(srv_hsm_t* p_me);
@@ -57,6 +74,11 @@ STATIC hsm_msg_t const* srv_end_of_turn_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p
 STATIC hsm_msg_t const* srv_card_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p_msg);
 
 STATIC void server_hsm_action_next_state(srv_hsm_t* p_hsm);
+STATIC bool_t srv_move(srv_hsm_t* p_hsm, move_type_t type, int arg);
+STATIC bool_t srv_undo(srv_hsm_t* p_hsm, move_type_t type);
+STATIC void srv_hsm_clock(srv_hsm_t* p_hsm);
+STATIC tmr_fn_t srv_hsm_clock_fn;
+STATIC void srv_hsm_out_of_time(srv_hsm_t* p_hsm);
 
 /* MODULE CONSTANTS / VARIABLES **********************************************/
 SYS_ASSERT_FILE;
@@ -64,7 +86,8 @@ SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
 
 TRC_DEF(srv_hsm);
 
-static srv_hsm_t srv_hsm;
+static int turn_ms;     /* Read only after init */
+static int lobby_ms;
 
 /* GLOBAL CONSTANTS / VARIABLES **********************************************/
 
@@ -74,39 +97,110 @@ static srv_hsm_t srv_hsm;
 void srv_hsm_init(void)
 {
    TRC_REG(srv_hsm, TRC_DEBUG | TRC_ERROR);
-   srv_hsm.started = FALSE;
-   srv_hsm_ctor(&srv_hsm);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void srv_hsm_start(void)
+void srv_hsm_set_clocks(int turn, int lobby)
 {
-   if (!srv_hsm.started)
+   turn_ms = turn;
+   lobby_ms = lobby;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+srv_hsm_t* srv_hsm_create(core_t* p_core)
+{
+   srv_hsm_t* p_hsm = (srv_hsm_t*)calloc(1, sizeof(srv_hsm_t));
+   REQUIRE(p_hsm != NULL);
+   p_hsm->started = FALSE;
+   p_hsm->p_core = p_core;
+   tmr_init(&p_hsm->clock, srv_hsm_clock_fn, p_hsm);
+   p_hsm->clock_id = SRV_HSM_CLOCK_NONE;
+   srv_hsm_ctor(p_hsm);
+   HSM_QUEUE_INIT(&p_hsm->queue, p_hsm);
+   return p_hsm;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_hsm_destroy(srv_hsm_t* p_hsm)
+{
+   srv_worker_timer_stop(SRV_GAME_OF(p_hsm->p_core), &p_hsm->clock);
+   HSM_PROF_DUMP(p_hsm);
+   HSM_DTOR(p_hsm);
+   free(p_hsm);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_hsm_start(srv_hsm_t* p_hsm)
+{
+   if (!p_hsm->started)
    {
-      HSM_START(&srv_hsm);
-      srv_hsm.started = TRUE;
+      HSM_START(p_hsm);
+      p_hsm->started = TRUE;
    }
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void srv_hsm_stop(void)
+void srv_hsm_stop(srv_hsm_t* p_hsm)
 {
-   hsm_msg_t msg;
+   srv_hsm_post(p_hsm, HSM_EVT_STOP, 0, SRV_HSM_PRIO_HIGH);
+   srv_hsm_run(p_hsm, 0);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t srv_hsm_post(srv_hsm_t* p_hsm, int evt, int arg, srv_hsm_prio_t prio)
+{
+   REQUIRE(prio < SRV_HSM_PRIO_LAST);
+   if (p_hsm->queue.rings[prio].n == HSM_QUEUE_SZ)
+   { /* Make room, does nothing from a handler */
+      srv_hsm_run(p_hsm, 0);
+   }
+   return hsm_queue_post(&p_hsm->queue, evt, arg, prio);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int srv_hsm_run(srv_hsm_t* p_hsm, int max)
+{
+   int n;
+
+   if (p_hsm->queue.running)
+   { /* Run to completion, the running srv_hsm_run() dispatches it */
+      return 0;
+   }
+   n = hsm_queue_run(&p_hsm->queue, max);
+   srv_hsm_clock(p_hsm);
+   return n;
+}
 
-   msg.evt = HSM_EVT_STOP;
-   HSM_EVT(&srv_hsm, &msg);
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_hsm_defer(srv_hsm_t* p_hsm)
+{
+   hsm_queue_defer(&p_hsm->queue);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-void srv_hsm_evt(int evt)
+void srv_hsm_player_seen(srv_hsm_t* p_hsm, int id)
 {
-   hsm_msg_t msg;
+   player_t* p_player = core_find_player(p_hsm->p_core, id);
 
-   msg.evt = evt;
-   HSM_EVT(&srv_hsm, &msg);
+   if ((p_player == NULL) || (p_player->timeouts == 0))
+   {
+      return;
+   }
+   if (p_player->timeouts >= SRV_HSM_AWAY_TURNS)
+   {
+      TRC_DBG(srv_hsm, "Player %d is back (game %d)", id,
+         SRV_GAME_OF(p_hsm->p_core)->id);
+   }
+   p_player->timeouts = 0;
 }
 
 /* LOCAL FUNCTIONS ***********************************************************/
@@ -164,6 +258,10 @@ STATIC hsm_msg_t const* srv_top_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p_msg)
    case HSM_EVT_ENTRY:
       p_msg = HSM_MSG_PROCESSED;
       break;
+   case HSM_EVT_TIMER:
+      srv_hsm_out_of_time(p_hsm);
+      p_msg = HSM_MSG_PROCESSED;
+      break;
    case HSM_EVT_EXIT:
       p_msg = HSM_MSG_PROCESSED;
       break;
@@ -177,6 +275,8 @@ STATIC hsm_msg_t const* srv_top_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p_msg)
 -----------------------------------------------------------------------------*/
 STATIC hsm_msg_t const* srv_lobby_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p_msg)
 {
+   core_t* p_core = p_hsm->p_core;
+
    switch(HSM_EVT_GET(p_msg))
    {
    case HSM_EVT_ENTRY:
@@ -186,10 +286,10 @@ STATIC hsm_msg_t const* srv_lobby_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p_msg)
    {
       player_t* p_player;
       /* Send start game command to all clients */
-      net_server_broadcast_cmd(NET_CMD_SERVER_START_GAME, NULL);
+      net_server_broadcast_cmd(p_core, NET_CMD_SERVER_START_GAME, NULL);
       /* Go to color selection */
-      p_player = SLNK_NEXT(player_t, &core_get()->players_head);
-      core_get()->active_player = p_player;
+      p_player = SLNK_NEXT(player_t, &p_core->players_head);
+      p_core->active_player = p_player;
       HSM_STATE_TRAN(p_hsm, &p_hsm->select_color);
       p_msg = HSM_MSG_PROCESSED;
       break;
@@ -197,20 +297,29 @@ STATIC hsm_msg_t const* srv_lobby_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p_msg)
    case HSM_EVT_NET_LOAD_GAME:
    {
       /* Load game */
-      if (core_newgame(TRUE))
+      if (core_newgame(p_core, TRUE))
       {
          /* Send start game command to all clients */
-         net_server_broadcast_cmd(NET_CMD_SERVER_START_GAME, NULL);
-         net_server_broadcast_cmd(NET_CMD_SERVER_PHASE_UPDATE, NULL);
+         net_server_broadcast_cmd(p_core, NET_CMD_SERVER_START_GAME, NULL);
+         core_dirty(p_core, CORE_DIRTY_PHASE);
          //server_hsm_action_next_state(p_hsm);
       }
       else
       {
-         core_log(NULL, "Load game failed");
+         core_log(p_core, NULL, "Load game failed");
       }
       p_msg = HSM_MSG_PROCESSED;
       break;
    }
+   case HSM_EVT_TIMER:
+      if (p_core->n_players > 0)
+      { /* Nobody started the game, play against bots */
+         TRC_DBG(srv_hsm, "Lobby of game %d expired",
+            SRV_GAME_OF(p_core)->id);
+         net_server_start_game(p_core, SRV_GAME_MAX_PLAYERS);
+      }
+      p_msg = HSM_MSG_PROCESSED;
+      break;
    case HSM_EVT_EXIT:
       p_msg = HSM_MSG_PROCESSED;
       break;
@@ -225,32 +334,35 @@ STATIC hsm_msg_t const* srv_lobby_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p_msg)
 STATIC hsm_msg_t const* srv_select_color_hnd(srv_hsm_t* p_hsm,
    hsm_msg_t const* p_msg)
 {
+   core_t* p_core = p_hsm->p_core;
+
    switch(HSM_EVT_GET(p_msg))
    {
    case HSM_EVT_ENTRY:
-      net_server_broadcast_cmd(NET_CMD_SERVER_ACTIVE_PLAYER, NULL);
-      net_server_send_cmd(core_get()->active_player->id,
+      core_dirty(p_core, CORE_DIRTY_ACTIVE_PLAYER);
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_COLOR, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_NET_SELECT_COLOR:
    {
       player_t* p_player;
-      core_select_color();
-      p_player = SLNK_NEXT(player_t, core_get()->active_player);
+      p_core->color_selection = HSM_QUEUE_ARG(p_msg);
+      core_select_color(p_core);
+      p_player = SLNK_NEXT(player_t, p_core->active_player);
       if (p_player == NULL)
       { /* All players have made a selection */
          /* Start new game */
-         core_newgame(FALSE);
+         core_newgame(p_core, FALSE);
          /* Update phase */
-         core_get()->state = CORE_STATE_SETUP;
-         net_server_broadcast_cmd(NET_CMD_SERVER_PHASE_UPDATE, NULL);
+         p_core->state = CORE_STATE_SETUP;
+         core_dirty(p_core, CORE_DIRTY_PHASE);
          //HSM_STATE_TRAN(p_hsm, &p_hsm->setup);
          HSM_STATE_TRAN(p_hsm, &p_hsm->investments); // Temporary
       }
       else
       {
-         core_get()->active_player = p_player;
+         p_core->active_player = p_player;
          HSM_STATE_TRAN(p_hsm, &p_hsm->select_color);
       }
       p_msg = HSM_MSG_PROCESSED;
@@ -300,20 +412,21 @@ STATIC hsm_msg_t const* srv_game_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p_msg)
 STATIC hsm_msg_t const* srv_setup_hnd(srv_hsm_t* p_hsm,
    hsm_msg_t const* p_msg)
 {
-   core_t* p_core = core_get();
+   core_t* p_core = p_hsm->p_core;
 
    switch(HSM_EVT_GET(p_msg))
    {
    case HSM_EVT_ENTRY:
-      net_server_broadcast_cmd(NET_CMD_SERVER_ACTIVE_PLAYER, NULL);
-      net_server_send_cmd(p_core->active_player->id,
+      core_dirty(p_core, CORE_DIRTY_ACTIVE_PLAYER);
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_BOARD_LOT, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_NET_SELECT_BOARD_LOT:
-      core_action_build();
+      p_core->board_lot_selection = HSM_QUEUE_ARG(p_msg);
+      core_action_build(p_core);
       p_core->startup_buildings--;
-      p_core->active_player = core_get_next_player();
+      p_core->active_player = core_get_next_player(p_core);
       if (p_core->startup_buildings > 0)
       {
          HSM_STATE_TRAN(p_hsm, &p_hsm->setup);
@@ -321,8 +434,8 @@ STATIC hsm_msg_t const* srv_setup_hnd(srv_hsm_t* p_hsm,
       else
       {
          /* Update phase */
-         core_get()->state = CORE_STATE_INVESTMENTS;
-         net_server_broadcast_cmd(NET_CMD_SERVER_PHASE_UPDATE, NULL);
+         p_core->state = CORE_STATE_INVESTMENTS;
+         core_dirty(p_core, CORE_DIRTY_PHASE);
          HSM_STATE_TRAN(p_hsm, &p_hsm->investments);
       }
       p_msg = HSM_MSG_PROCESSED;
@@ -341,23 +454,23 @@ STATIC hsm_msg_t const* srv_setup_hnd(srv_hsm_t* p_hsm,
 STATIC hsm_msg_t const* srv_investments_hnd(srv_hsm_t* p_hsm,
    hsm_msg_t const* p_msg)
 {
-   core_t* p_core = core_get();
+   core_t* p_core = p_hsm->p_core;
 
    switch(HSM_EVT_GET(p_msg))
    {
    case HSM_EVT_ENTRY:
-      net_server_broadcast_cmd(NET_CMD_SERVER_ACTIVE_PLAYER, NULL);
-      net_server_send_cmd(p_core->active_player->id,
+      /* Update phase (setup is skipped for now) */
+      p_core->state = CORE_STATE_INVESTMENTS;
+      core_dirty(p_core, CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER);
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_PLAYER_CARD, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_NET_SELECT_PLAYER_CARD:
    {
-      card_t* p_card = cards_find(&p_core->active_player->cards_head,
-         p_core->card_selection);
-      REQUIRE(p_card != NULL);
-      core_log(p_core->active_player, "selected card %d", p_card->id);
-      core_invest();
+      core_log(p_core, p_core->active_player, "selected card %d",
+         HSM_QUEUE_ARG(p_msg));
+      srv_move(p_hsm, MOVE_PLAYER_CARD, HSM_QUEUE_ARG(p_msg));
       HSM_STATE_TRAN(p_hsm, &p_hsm->investments);
       p_msg = HSM_MSG_PROCESSED;
       break;
@@ -366,6 +479,12 @@ STATIC hsm_msg_t const* srv_investments_hnd(srv_hsm_t* p_hsm,
       HSM_STATE_TRAN(p_hsm, &p_hsm->select_action);
       p_msg = HSM_MSG_PROCESSED;
       break;
+   case HSM_EVT_NET_BACK:
+      /* Take back the last investment */
+      srv_undo(p_hsm, MOVE_PLAYER_CARD);
+      HSM_STATE_TRAN(p_hsm, &p_hsm->investments);
+      p_msg = HSM_MSG_PROCESSED;
+      break;
    case HSM_EVT_EXIT:
       p_msg = HSM_MSG_PROCESSED;
       break;
@@ -380,21 +499,21 @@ STATIC hsm_msg_t const* srv_investments_hnd(srv_hsm_t* p_hsm,
 STATIC hsm_msg_t const* srv_select_action_hnd(srv_hsm_t* p_hsm,
    hsm_msg_t const* p_msg)
 {
-   core_t* p_core = core_get();
+   core_t* p_core = p_hsm->p_core;
 
    switch(HSM_EVT_GET(p_msg))
    {
    case HSM_EVT_ENTRY:
       /* Update phase */
-      core_get()->state = CORE_STATE_ACTIONS;
-      net_server_broadcast_cmd(NET_CMD_SERVER_PHASE_UPDATE, NULL);
-      net_server_broadcast_cmd(NET_CMD_SERVER_ACTIVE_PLAYER, NULL);
-      net_server_send_cmd(p_core->active_player->id,
+      p_core->state = CORE_STATE_ACTIONS;
+      core_dirty(p_core, CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER);
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_ACTION, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_NET_SELECT_ACTION:
    {
+      p_core->action_selection = HSM_QUEUE_ARG(p_msg);
       if (p_core->action_selection == 0)
       {
          HSM_STATE_TRAN(p_hsm, &p_hsm->action_take_card);
@@ -410,6 +529,12 @@ STATIC hsm_msg_t const* srv_select_action_hnd(srv_hsm_t* p_hsm,
       HSM_STATE_TRAN(p_hsm, &p_hsm->end_of_turn);
       p_msg = HSM_MSG_PROCESSED;
       break;
+   case HSM_EVT_NET_BACK:
+      /* Put the last taken card back on the board */
+      srv_undo(p_hsm, MOVE_BOARD_CARD);
+      HSM_STATE_TRAN(p_hsm, &p_hsm->select_action);
+      p_msg = HSM_MSG_PROCESSED;
+      break;
    case HSM_EVT_EXIT:
       p_msg = HSM_MSG_PROCESSED;
       break;
@@ -424,26 +549,25 @@ STATIC hsm_msg_t const* srv_select_action_hnd(srv_hsm_t* p_hsm,
 STATIC hsm_msg_t const* srv_action_take_card_hnd(srv_hsm_t* p_hsm,
    hsm_msg_t const* p_msg)
 {
-   core_t* p_core = core_get();
+   core_t* p_core = p_hsm->p_core;
 
    switch(HSM_EVT_GET(p_msg))
    {
    case HSM_EVT_ENTRY:
       /* Update phase */
-      core_get()->state = CORE_STATE_ACTION_TAKE_CARD;
-      net_server_broadcast_cmd(NET_CMD_SERVER_PHASE_UPDATE, NULL);
-      net_server_broadcast_cmd(NET_CMD_SERVER_ACTIVE_PLAYER, NULL);
-      net_server_send_cmd(p_core->active_player->id,
+      p_core->state = CORE_STATE_ACTION_TAKE_CARD;
+      core_dirty(p_core, CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER);
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_BOARD_CARD, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_NET_SELECT_BOARD_CARD:
-      core_action_take_card();
+      srv_move(p_hsm, MOVE_BOARD_CARD, HSM_QUEUE_ARG(p_msg));
       HSM_STATE_TRAN(p_hsm, &p_hsm->select_action);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_NET_DONE:
-      //HSM_STATE_TRAN(p_hsm, &p_hsm->end_of_turn);
+      HSM_STATE_TRAN(p_hsm, &p_hsm->select_action);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_EXIT:
@@ -460,39 +584,39 @@ STATIC hsm_msg_t const* srv_action_take_card_hnd(srv_hsm_t* p_hsm,
 STATIC hsm_msg_t const* srv_action_build_hnd(srv_hsm_t* p_hsm,
    hsm_msg_t const* p_msg)
 {
-   core_t* p_core = core_get();
+   core_t* p_core = p_hsm->p_core;
 
    switch(HSM_EVT_GET(p_msg))
    {
    case HSM_EVT_ENTRY:
-      core_get()->state = CORE_STATE_ACTION_BUILD;
-      net_server_broadcast_cmd(NET_CMD_SERVER_PHASE_UPDATE, NULL);
-      net_server_broadcast_cmd(NET_CMD_SERVER_ACTIVE_PLAYER, NULL);
-      net_server_send_cmd(p_core->active_player->id,
+      p_core->state = CORE_STATE_ACTION_BUILD;
+      core_dirty(p_core, CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER);
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_BOARD_CARD, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_NET_SELECT_BOARD_CARD:
-      p_core->current_contract_card = (card_contract_t*)
+      p_core->card_selection = HSM_QUEUE_ARG(p_msg);
+      p_core->current_contract_card = (const card_contract_t*)
          p_core->board_contract_cards[p_core->card_selection - 5];
-      net_server_send_cmd(p_core->active_player->id,
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_PLAYER_CARD, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_NET_SELECT_PLAYER_CARD:
    {
-      card_t* p_card = cards_find(&p_core->active_player->cards_head,
-         p_core->card_selection);
-      REQUIRE(p_card != NULL);
+      p_core->card_selection = HSM_QUEUE_ARG(p_msg);
+      REQUIRE(cards_hand_find(&p_core->active_player->cards,
+         CARD_DECK_PLANNING, p_core->card_selection) >= 0);
       if ((p_core->current_contract_card->size == 2) ||
           (p_core->current_contract_card->size == 3))
       {
-         net_server_send_cmd(p_core->active_player->id,
+         net_server_send_cmd(p_core, p_core->active_player->id,
             NET_CMD_SERVER_SELECT_BUILDING_ROTATION, NULL);
       }
       else
       {
-         net_server_send_cmd(p_core->active_player->id,
+         net_server_send_cmd(p_core, p_core->active_player->id,
             NET_CMD_SERVER_SELECT_BOARD_LOT, NULL);
       }
       p_msg = HSM_MSG_PROCESSED;
@@ -500,14 +624,18 @@ STATIC hsm_msg_t const* srv_action_build_hnd(srv_hsm_t* p_hsm,
    }
    case HSM_EVT_NET_SELECT_BUILDING_ROTATION:
    {
-      net_server_send_cmd(p_core->active_player->id,
+      p_core->rotation_selection = HSM_QUEUE_ARG(p_msg);
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_BOARD_LOT, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
    }
    case HSM_EVT_NET_SELECT_BOARD_LOT:
    {
-      core_action_build();
+      p_core->board_lot_selection = HSM_QUEUE_ARG(p_msg);
+      core_action_build(p_core);
+      /* Not on the undo stack, the turn is no pass */
+      p_hsm->passes = -1;
       HSM_STATE_TRAN(p_hsm, &p_hsm->select_action);
       p_msg = HSM_MSG_PROCESSED;
       break;
@@ -532,13 +660,17 @@ STATIC hsm_msg_t const* srv_action_build_hnd(srv_hsm_t* p_hsm,
 STATIC hsm_msg_t const* srv_end_of_turn_hnd(srv_hsm_t* p_hsm,
    hsm_msg_t const* p_msg)
 {
-   core_t* p_core = core_get();
+   core_t* p_core = p_hsm->p_core;
 
    switch(HSM_EVT_GET(p_msg))
    {
    case HSM_EVT_ENTRY:
-      net_server_broadcast_cmd(NET_CMD_SERVER_ACTIVE_PLAYER, NULL);
-      net_server_send_cmd(p_core->active_player->id,
+      /* The turn is over, no more taking back */
+      p_hsm->passes = (p_hsm->undo.n > 0) ? 0 : p_hsm->passes + 1;
+      core_undo_clear(&p_hsm->undo);
+      p_core->state = CORE_STATE_ACTION_END_OF_TURN;
+      core_dirty(p_core, CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER);
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_BOARD_LOT, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
@@ -548,6 +680,25 @@ STATIC hsm_msg_t const* srv_end_of_turn_hnd(srv_hsm_t* p_hsm,
       break;
    }
    case HSM_EVT_NET_DONE:
+      if (p_core->state == CORE_STATE_GAME_END)
+      { /* Nothing left to do */
+         p_msg = HSM_MSG_PROCESSED;
+         break;
+      }
+      core_next_player(p_core);
+      /* A new turn, also for the same player */
+      p_hsm->clock_id = SRV_HSM_CLOCK_NONE;
+      if (core_game_over(p_core) || (p_hsm->passes >= p_core->n_players))
+      { /* Nothing left to play or all players passed a round */
+         p_core->state = CORE_STATE_GAME_END;
+         core_dirty(p_core, CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER);
+         core_log(p_core, NULL, "game over");
+      }
+      else
+      {
+         HSM_STATE_TRAN(p_hsm, &p_hsm->investments);
+      }
+      p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_EXIT:
       p_msg = HSM_MSG_PROCESSED;
@@ -563,19 +714,19 @@ STATIC hsm_msg_t const* srv_end_of_turn_hnd(srv_hsm_t* p_hsm,
 STATIC hsm_msg_t const* srv_card_hnd(srv_hsm_t* p_hsm, hsm_msg_t const* p_msg)
 {
 #if 0
-   core_t* p_core = core_get();
+   core_t* p_core = p_hsm->p_core;
    switch(HSM_EVT_GET(p_msg))
    {
    case HSM_EVT_ENTRY:
-      net_server_broadcast_cmd(NET_CMD_SERVER_ACTIVE_PLAYER, NULL);
-      net_server_send_cmd(p_core->active_player->id,
+      core_dirty(p_core, CORE_DIRTY_ACTIVE_PLAYER);
+      net_server_send_cmd(p_core, p_core->active_player->id,
          NET_CMD_SERVER_SELECT_CARD, NULL);
       p_msg = HSM_MSG_PROCESSED;
       break;
    case HSM_EVT_NET_SELECT_CARD:
    {
       p_core->current_card = p_core->board_cards[p_core->card_selection];
-      core_log(p_core->active_player, "selected card %s",
+      core_log(p_core, p_core->active_player, "selected card %s",
          cards_get_name(p_core->current_card));
       if (cards_use(p_core->current_card, CARD_EVT_START) != CARD_ACTION_DONE)
       {
@@ -715,4 +866,144 @@ STATIC void server_hsm_action_next_state(srv_hsm_t* p_hsm)
 }
 #endif
 
+/*-----------------------------------------------------------------------------
+Play a move of the active player if it is legal.
+\return TRUE if played
+-----------------------------------------------------------------------------*/
+STATIC bool_t srv_move(srv_hsm_t* p_hsm, move_type_t type, int arg)
+{
+   move_t moves[CORE_MAX_MOVES];
+   int n = core_gen_moves(p_hsm->p_core, moves, CORE_MAX_MOVES);
+   int i;
+
+   for (i=0;i<n;i++)
+   {
+      if ((moves[i].type == type) && (moves[i].arg == arg))
+      {
+         core_apply_move(p_hsm->p_core, &moves[i], &p_hsm->undo);
+         return TRUE;
+      }
+   }
+   TRC_ERR(srv_hsm, "Illegal move %d %d", type, arg);
+   return FALSE;
+}
+
+/*-----------------------------------------------------------------------------
+Take back the last move of the turn if it is of the given type.
+\return TRUE if taken back
+-----------------------------------------------------------------------------*/
+STATIC bool_t srv_undo(srv_hsm_t* p_hsm, move_type_t type)
+{
+   const move_t* p_move = core_undo_last(&p_hsm->undo);
+
+   if ((p_move == NULL) || (p_move->type != type))
+   {
+      return FALSE;
+   }
+   return core_undo_move(p_hsm->p_core, &p_hsm->undo);
+}
+
+/*-----------------------------------------------------------------------------
+Keep the clock running for what the game waits for, the start in the lobby or
+the end of the turn of the active player. A new turn starts the turn clock
+(at 0 for an away player). A player out of time is played for on every tick
+until the turn is over, the clock waits while a move is searched.
+-----------------------------------------------------------------------------*/
+STATIC void srv_hsm_clock(srv_hsm_t* p_hsm)
+{
+   core_t* p_core = p_hsm->p_core;
+   srv_game_t* p_game = SRV_GAME_OF(p_core);
+   player_t* p_player = p_core->active_player;
+   int id = SRV_HSM_CLOCK_NONE;
+   int ms = 0;
+
+   if (hsm_state_curr(&p_hsm->super) == &p_hsm->lobby)
+   {
+      id = SRV_HSM_CLOCK_LOBBY;
+      ms = lobby_ms;
+   }
+   else if ((p_core->state != CORE_STATE_GAME_END) && (p_player != NULL) &&
+            !SRV_BOT_IS_BOT(p_player->id))
+   {
+      id = p_player->id;
+      ms = turn_ms;
+   }
+   if ((id == p_hsm->clock_id) && (id != SRV_HSM_CLOCK_NONE))
+   { /* Same turn (or still in the lobby) */
+      if (p_hsm->out_of_time && !tmr_running(&p_hsm->clock) &&
+          (p_game->bot_moves == 0))
+      {
+         srv_worker_timer_start(p_game, &p_hsm->clock, 0);
+      }
+      return;
+   }
+   p_hsm->clock_id = id;
+   p_hsm->out_of_time = (id >= 0) &&
+      (p_player->timeouts >= SRV_HSM_AWAY_TURNS);
+   if (p_hsm->out_of_time)
+   {
+      TRC_DBG(srv_hsm, "Player %d is away (game %d)", id, p_game->id);
+      srv_worker_timer_start(p_game, &p_hsm->clock, 0);
+   }
+   else if ((id != SRV_HSM_CLOCK_NONE) && (ms > 0))
+   {
+      srv_worker_timer_start(p_game, &p_hsm->clock, ms);
+   }
+   else
+   {
+      srv_worker_timer_stop(p_game, &p_hsm->clock);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Worker of the game. The clock expired.
+-----------------------------------------------------------------------------*/
+STATIC void srv_hsm_clock_fn(tmr_t* p_tmr, void* p_ctx)
+{
+   srv_hsm_t* p_hsm = (srv_hsm_t*)p_ctx;
+
+   TOUCH(p_tmr);
+   net_server_timer_evt(p_hsm->p_core);
+}
+
+/*-----------------------------------------------------------------------------
+The turn clock expired, search the next move of the player as for a bot. The
+move is played when the search is done, the clock is started again then.
+-----------------------------------------------------------------------------*/
+STATIC void srv_hsm_out_of_time(srv_hsm_t* p_hsm)
+{
+   core_t* p_core = p_hsm->p_core;
+   player_t* p_player = p_core->active_player;
+   move_t moves[CORE_MAX_MOVES];
+
+   if ((p_hsm->clock_id < 0) || (p_player == NULL) ||
+       (p_player->id != p_hsm->clock_id))
+   { /* Not a turn clock (any more) */
+      return;
+   }
+   if (SRV_GAME_OF(p_core)->bot_moves > 0)
+   { /* A search is under way */
+      return;
+   }
+   if (!p_hsm->out_of_time)
+   {
+      p_hsm->out_of_time = TRUE;
+      if (p_player->timeouts < 0xff)
+      {
+         p_player->timeouts++;
+      }
+      core_log(p_core, p_player, "out of time");
+      TRC_DBG(srv_hsm, "Player %d out of time (game %d, %d in a row)",
+         p_player->id, SRV_GAME_OF(p_core)->id, p_player->timeouts);
+   }
+   if (core_ai_gen_moves(p_core, moves, CORE_MAX_MOVES) == 0)
+   { /* Nothing to play for the player, it gets the turn time again */
+      TRC_ERR(srv_hsm, "No move for player %d", p_player->id);
+      p_hsm->out_of_time = FALSE;
+      srv_worker_timer_start(SRV_GAME_OF(p_core), &p_hsm->clock, turn_ms);
+      return;
+   }
+   srv_bot_search(SRV_GAME_OF(p_core), p_player->id);
+}
+
 /* END OF FILE ***************************************************************/
@@ -4,14 +4,31 @@ Copyright (c) 2013, All Rights Reserved.
 
 /*---------------------------------------------------------------------------*/
 /*! \file server_hsm.h
-\brief The Server Hierarchical State Machine interface. */
+\brief The Server Hierarchical State Machine interface.
+
+Events are posted with their argument (the selection of a net event) to the
+hsm_queue_t of the state machine, see hsm_queue.h: run to completion, high
+priority events before normal ones. The handlers take the selection from the
+event, a later command can not change it before the event is dispatched. A
+handler can defer the event it is dispatching until the next state change.
+The net server posts the events of all work queued for a game and runs them
+once after it (srv_worker_after()).
+
+Every game has one clock, kept up to date after each srv_hsm_run(). In the
+lobby it runs until the game is started with bots, in a game it is the turn
+clock of the active (not bot) player. A player out of time is played for with
+the bot search until the turn is over. A player out of time SRV_HSM_AWAY_TURNS
+turns in a row is away, its turns are played at once until a command is
+received from it. Expiry is dispatched as HSM_EVT_TIMER (high priority). */
 /*---------------------------------------------------------------------------*/
 #ifndef SERVER_HSM_H
 #define SERVER_HSM_H
 /* INCLUDE FILES *************************************************************/
 #include "hsm.h"
+#include "core.h"
 
 /* EXPORTED DEFINES **********************************************************/
+#define SRV_HSM_AWAY_TURNS (2) /*!< Turns out of time before a player is away */
 
 /* EXPORTED DATA TYPES *******************************************************/
 enum
@@ -35,6 +52,15 @@ enum
    HSM_EVT_TIMER
 };
 
+typedef enum
+{
+   SRV_HSM_PRIO_HIGH,      /*!< Before all normal events (stop, timers) */
+   SRV_HSM_PRIO_NORMAL,    /*!< Net events */
+   SRV_HSM_PRIO_LAST
+} srv_hsm_prio_t;
+
+typedef struct srv_hsm srv_hsm_t; /*!< Forward srv hsm declaration */
+
 /* GLOBAL VARIABLES **********************************************************/
 
 /* INTERFACE FUNCTIONS *******************************************************/
@@ -46,25 +72,79 @@ void srv_hsm_init(
    void
    );
 
+/*---------------------------------------------------------------------------*/
+/*! \brief Set the clocks of all games (0 = no limit). Called before the
+workers are started. */
+/*---------------------------------------------------------------------------*/
+void srv_hsm_set_clocks(
+   int turn_ms,         /*!< Time for a turn */
+   int lobby_ms         /*!< Time in the lobby before the game is started */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Create a state machine for a game. */
+/*---------------------------------------------------------------------------*/
+srv_hsm_t* srv_hsm_create(
+   core_t* p_core       /*!< Game instance */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Destroy state machine. Traces its profile (HSM_PROFILE). */
+/*---------------------------------------------------------------------------*/
+void srv_hsm_destroy(
+   srv_hsm_t* p_hsm     /*!< State machine */
+   );
+
 /*---------------------------------------------------------------------------*/
 /*! \brief Start state machine. */
 /*---------------------------------------------------------------------------*/
 void srv_hsm_start(
-   void
+   srv_hsm_t* p_hsm     /*!< State machine */
    );
 
 /*---------------------------------------------------------------------------*/
 /*! \brief Stop state machine. */
 /*---------------------------------------------------------------------------*/
 void srv_hsm_stop(
-   void
+   srv_hsm_t* p_hsm     /*!< State machine */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Post an event, it is dispatched by the next srv_hsm_run(). A full
+queue is run first to make room, except from a handler.
+\return FALSE if the queue is full (the event is dropped) */
+/*---------------------------------------------------------------------------*/
+bool_t srv_hsm_post(
+   srv_hsm_t* p_hsm,    /*!< State machine */
+   int evt,             /*!< Event */
+   int arg,             /*!< Event argument (selection, 0 if none) */
+   srv_hsm_prio_t prio  /*!< Priority */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Dispatch queued events, each one to completion, then update the
+clock. Does nothing when called from a handler.
+\return Number of events dispatched */
+/*---------------------------------------------------------------------------*/
+int srv_hsm_run(
+   srv_hsm_t* p_hsm,    /*!< State machine */
+   int max              /*!< Max events to dispatch (0 = until empty) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Defer the event being dispatched, called from a handler. It is
+posted again (with its argument) after the next state change. */
+/*---------------------------------------------------------------------------*/
+void srv_hsm_defer(
+   srv_hsm_t* p_hsm     /*!< State machine */
    );
 
 /*---------------------------------------------------------------------------*/
-/*! \brief Send event to srv hsm. */
+/*! \brief A command was received from a player, it is not away. */
 /*---------------------------------------------------------------------------*/
-void srv_hsm_evt(
-   int evt
+void srv_hsm_player_seen(
+   srv_hsm_t* p_hsm,    /*!< State machine */
+   int id               /*!< Player id */
    );
 
 #endif /* #ifndef SERVER_HSM_H */
@@ -0,0 +1,346 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file server_worker.c
+\brief The Urban Sprawl server worker pool implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "trc.h"
+#include "dlnk.h"
+#include "tmr.h"
+#include "net.h"
+#include "net_queue.h"
+#include "server_game.h"
+#include "server_worker.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define SRV_WORKER_QUEUE_SLOTS (1024) /* Queue size per worker (power of 2) */
+#define SRV_WORKER_TICK_MS (10)       /* Timer resolution */
+#define SRV_WORKER_BATCH (64)         /* Work run between timer checks */
+
+/* LOCAL DATATYPES ***********************************************************/
+typedef struct srv_work
+{
+   struct srv_work* p_next;   /*!< Overflow list of the worker */
+   srv_game_t* p_game;
+   srv_worker_fn_t* p_fn;
+   int evt;
+   int sock;
+   int len;
+   uint8_t* p_msg;            /*!< Data larger than data[] (malloc) */
+   uint8_t data[MAX_PACKET_SZ];
+} srv_work_t;                 /*!< Queue slot */
+
+typedef struct
+{
+   int id;
+   pthread_t thread_id;
+   net_queue_t queue;
+   tmr_wheel_t wheel;         /*!< Timers of the games (worker thread) */
+   srv_work_t* p_over_head;   /*!< Own posts that did not fit (malloc) */
+   srv_work_t* p_over_tail;
+   srv_game_t* p_after_game;  /*!< Game to call p_after_fn for */
+   srv_worker_after_fn_t* p_after_fn;
+} srv_worker_t;
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static void *srv_worker_thread(void *arg);
+static void srv_worker_overflow(srv_worker_t* p_worker);
+static void srv_worker_after_run(srv_worker_t* p_worker);
+static uint64_t srv_worker_ms(void);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_ASSERT_FILE;
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+TRC_DEF(srv_worker);
+
+static srv_worker_t workers[SRV_WORKER_MAX];
+static int n_workers;
+static __thread srv_worker_t* p_worker_own; /* Worker of this thread */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_worker_init(int n)
+{
+   int i;
+
+   TRC_REG(srv_worker, TRC_ERROR | TRC_DEBUG);
+   if (n <= 0)
+   {
+#ifdef _SC_NPROCESSORS_ONLN
+      n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+      if (n <= 0)
+      {
+         n = 1;
+      }
+   }
+   n_workers = MIN(n, SRV_WORKER_MAX);
+   for (i=0;i<n_workers;i++)
+   {
+      srv_worker_t* p_worker = &workers[i];
+      p_worker->id = i;
+      net_queue_init(&p_worker->queue, SRV_WORKER_QUEUE_SLOTS,
+         sizeof(srv_work_t));
+      tmr_wheel_init(&p_worker->wheel,
+         (uint32_t)(srv_worker_ms() / SRV_WORKER_TICK_MS));
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_worker_start(void)
+{
+   int i;
+
+   for (i=0;i<n_workers;i++)
+   {
+      pthread_create(&workers[i].thread_id, NULL, srv_worker_thread,
+         &workers[i]);
+   }
+   TRC_DBG(srv_worker, "Started %d worker(s)", n_workers);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int srv_worker_count(void)
+{
+   return n_workers;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int srv_worker_depth(int worker)
+{
+   REQUIRE(worker < n_workers);
+   return (int)net_queue_depth(&workers[worker].queue);
+}
+
+/*-----------------------------------------------------------------------------
+Only the worker drains its queue, so a worker posting to its own full queue
+would wait for itself. Its posts go to the overflow list instead (also while
+the list is not empty, to keep them in order), queued after the current batch.
+-----------------------------------------------------------------------------*/
+void srv_worker_post(srv_game_t* p_game, srv_worker_fn_t* p_fn, int evt,
+   int sock, void* data, int len)
+{
+   srv_worker_t* p_worker = &workers[p_game->worker];
+   srv_work_t* p_work = NULL;
+   bool_t over = FALSE;
+
+   REQUIRE((len >= 0) && (len <= NET_MAX_MSG_SZ));
+   if ((p_worker != p_worker_own) || (p_worker->p_over_head == NULL))
+   {
+      p_work = (srv_work_t*)net_queue_reserve(&p_worker->queue);
+   }
+   if ((p_work == NULL) && (p_worker == p_worker_own))
+   {
+      over = TRUE;
+      p_work = (srv_work_t*)malloc(sizeof(srv_work_t));
+      REQUIRE(p_work != NULL);
+      p_work->p_next = NULL;
+      if (p_worker->p_over_tail != NULL)
+      {
+         p_worker->p_over_tail->p_next = p_work;
+      }
+      else
+      {
+         p_worker->p_over_head = p_work;
+      }
+      p_worker->p_over_tail = p_work;
+      TRC_DBG(srv_worker, "Worker %d queue full, work kept", p_worker->id);
+   }
+   while (p_work == NULL)
+   { /* Full, wait for the worker to catch up */
+      usleep(1000);
+      p_work = (srv_work_t*)net_queue_reserve(&p_worker->queue);
+   }
+   p_work->p_game = p_game;
+   p_work->p_fn = p_fn;
+   p_work->evt = evt;
+   p_work->sock = sock;
+   p_work->len = len;
+   p_work->p_msg = NULL;
+   if (len > MAX_PACKET_SZ)
+   {
+      p_work->p_msg = (uint8_t*)malloc(len);
+      REQUIRE(p_work->p_msg != NULL);
+      memcpy(p_work->p_msg, data, len);
+   }
+   else if (len > 0)
+   {
+      memcpy(p_work->data, data, len);
+   }
+   if (!over)
+   {
+      net_queue_commit(&p_worker->queue, p_work);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+A pending call for another game (or function) is made first.
+-----------------------------------------------------------------------------*/
+void srv_worker_after(srv_game_t* p_game, srv_worker_after_fn_t* p_fn)
+{
+   srv_worker_t* p_worker = &workers[p_game->worker];
+
+   REQUIRE(p_worker == p_worker_own);
+   if ((p_worker->p_after_game != NULL) &&
+       ((p_worker->p_after_game != p_game) || (p_worker->p_after_fn != p_fn)))
+   {
+      srv_worker_after_run(p_worker);
+   }
+   p_worker->p_after_game = p_game;
+   p_worker->p_after_fn = p_fn;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_worker_forget(srv_game_t* p_game)
+{
+   srv_worker_t* p_worker = &workers[p_game->worker];
+
+   REQUIRE(p_worker == p_worker_own);
+   if (p_worker->p_after_game == p_game)
+   {
+      p_worker->p_after_game = NULL;
+      p_worker->p_after_fn = NULL;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+The timeout is rounded up to whole ticks.
+-----------------------------------------------------------------------------*/
+void srv_worker_timer_start(srv_game_t* p_game, tmr_t* p_tmr, int ms)
+{
+   REQUIRE(ms >= 0);
+   tmr_start(&workers[p_game->worker].wheel, p_tmr,
+      (uint32_t)((ms + SRV_WORKER_TICK_MS - 1) / SRV_WORKER_TICK_MS));
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void srv_worker_timer_stop(srv_game_t* p_game, tmr_t* p_tmr)
+{
+   tmr_stop(&workers[p_game->worker].wheel, p_tmr);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Run expired timers and queued work, sleep until the next timer when there is no
+work. Timers are checked at least every SRV_WORKER_BATCH work functions, also
+when the queue never runs empty. The after function of a game is called when
+the work moves on to another game and at the end of the batch.
+-----------------------------------------------------------------------------*/
+static void *srv_worker_thread(void *arg)
+{
+   srv_worker_t* p_worker = (srv_worker_t*)arg;
+
+   p_worker_own = p_worker;
+   TRC_DBG(srv_worker, "Starting worker %d", p_worker->id);
+   while (1)
+   {
+      srv_work_t* p_work;
+      uint64_t now = srv_worker_ms();
+      int ticks;
+      int timeout_ms = -1;
+      int n = 0;
+
+      tmr_advance(&p_worker->wheel, (uint32_t)(now / SRV_WORKER_TICK_MS));
+      ticks = tmr_next(&p_worker->wheel);
+      if (ticks >= 0)
+      { /* Until the start of the tick of the next timer */
+         timeout_ms = (ticks + 1) * SRV_WORKER_TICK_MS -
+            (int)(now % SRV_WORKER_TICK_MS);
+      }
+      if (p_worker->p_over_head != NULL)
+      {
+         timeout_ms = 0;
+      }
+      if (net_queue_wait(&p_worker->queue, timeout_ms))
+      {
+         while ((n++ < SRV_WORKER_BATCH) &&
+            ((p_work = (srv_work_t*)net_queue_peek(&p_worker->queue)) != NULL))
+         {
+            if ((p_worker->p_after_game != NULL) &&
+                (p_worker->p_after_game != p_work->p_game))
+            {
+               srv_worker_after_run(p_worker);
+            }
+            p_work->p_fn(p_work->p_game, p_work->evt, p_work->sock,
+               (p_work->p_msg != NULL)?p_work->p_msg:p_work->data,
+               p_work->len);
+            free(p_work->p_msg);
+            net_queue_release(&p_worker->queue);
+         }
+      }
+      srv_worker_after_run(p_worker);
+      srv_worker_overflow(p_worker);
+   }
+   return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+Move the own posts that did not fit to the queue, behind the own posts queued
+before them. What still does not fit waits for the next batch.
+-----------------------------------------------------------------------------*/
+static void srv_worker_overflow(srv_worker_t* p_worker)
+{
+   srv_work_t* p_work;
+   srv_work_t* p_slot;
+
+   while (((p_work = p_worker->p_over_head) != NULL) &&
+      ((p_slot = (srv_work_t*)net_queue_reserve(&p_worker->queue)) != NULL))
+   {
+      p_worker->p_over_head = p_work->p_next;
+      if (p_worker->p_over_head == NULL)
+      {
+         p_worker->p_over_tail = NULL;
+      }
+      *p_slot = *p_work;
+      net_queue_commit(&p_worker->queue, p_slot);
+      free(p_work);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Call the pending after function (if any), it may ask for the next call.
+-----------------------------------------------------------------------------*/
+static void srv_worker_after_run(srv_worker_t* p_worker)
+{
+   srv_game_t* p_game = p_worker->p_after_game;
+
+   if (p_game != NULL)
+   {
+      p_worker->p_after_game = NULL;
+      p_worker->p_after_fn(p_game);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+\return Monotonic time in ms
+-----------------------------------------------------------------------------*/
+static uint64_t srv_worker_ms(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* END OF FILE ***************************************************************/
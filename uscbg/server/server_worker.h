@@ -0,0 +1,130 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file server_worker.h
+\brief The Urban Sprawl server worker pool interface.
+Game logic runs on a pool of worker threads. Each game is pinned to one
+worker, so all events of a game are handled in order by the same thread and
+the game state needs no locking.
+Each worker has a timer wheel for the timers of its games. The worker sleeps
+until the next timer or new work, expired timers are called on the worker
+between two work functions. */
+/*---------------------------------------------------------------------------*/
+#ifndef SERVER_WORKER_H
+#define SERVER_WORKER_H
+/* INCLUDE FILES *************************************************************/
+#include "tmr.h"
+#include "server_game.h"
+
+/* EXPORTED DEFINES **********************************************************/
+#define SRV_WORKER_MAX (64)         /*!< Max number of worker threads */
+
+/* EXPORTED DATA TYPES *******************************************************/
+/*---------------------------------------------------------------------------*/
+/*! \brief Work function. Called on the worker thread owning the game. */
+/*---------------------------------------------------------------------------*/
+typedef void srv_worker_fn_t(
+   srv_game_t* p_game,  /*!< Game */
+   int evt,             /*!< Event */
+   int sock,            /*!< Socket */
+   void* data,          /*!< Data (only valid during the call) */
+   int len              /*!< Data length */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief After function. Called on the worker owning the game after the work
+queued for it. */
+/*---------------------------------------------------------------------------*/
+typedef void srv_worker_after_fn_t(
+   srv_game_t* p_game   /*!< Game */
+   );
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize. */
+/*---------------------------------------------------------------------------*/
+void srv_worker_init(
+   int n_workers        /*!< Number of workers (0 = one per cpu) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Start worker threads. */
+/*---------------------------------------------------------------------------*/
+void srv_worker_start(
+   void
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Number of workers. */
+/*---------------------------------------------------------------------------*/
+int srv_worker_count(
+   void
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Number of queued events for a worker. */
+/*---------------------------------------------------------------------------*/
+int srv_worker_depth(
+   int worker           /*!< Worker */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Queue work for a game. The data is copied into a preallocated queue
+slot, data larger than MAX_PACKET_SZ (max NET_MAX_MSG_SZ) into a heap copy.
+Blocks while the worker queue is full, except on the worker itself: its posts
+are kept until the current batch is done. */
+/*---------------------------------------------------------------------------*/
+void srv_worker_post(
+   srv_game_t* p_game,  /*!< Game (selects the worker) */
+   srv_worker_fn_t* p_fn, /*!< Work function */
+   int evt,             /*!< Event */
+   int sock,            /*!< Socket */
+   void* data,          /*!< Data (may be NULL) */
+   int len              /*!< Data length */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Call a function for a game after its work: before the worker runs
+work of another game, at the latest at the end of the batch. Called any number
+of times before that, the function is called once. Only called on the worker
+owning the game. */
+/*---------------------------------------------------------------------------*/
+void srv_worker_after(
+   srv_game_t* p_game,  /*!< Game (selects the worker) */
+   srv_worker_after_fn_t* p_fn /*!< After function */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Forget the after function of a game that is freed. Only called on
+the worker owning the game. */
+/*---------------------------------------------------------------------------*/
+void srv_worker_forget(
+   srv_game_t* p_game   /*!< Game (selects the worker) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Start (or restart) a timer of a game. Only called on the worker
+owning the game, the timer callback is called on it. */
+/*---------------------------------------------------------------------------*/
+void srv_worker_timer_start(
+   srv_game_t* p_game,  /*!< Game (selects the worker) */
+   tmr_t* p_tmr,        /*!< Timer (see tmr_init()) */
+   int ms               /*!< Timeout */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Stop a timer of a game. Only called on the worker owning the
+game. */
+/*---------------------------------------------------------------------------*/
+void srv_worker_timer_stop(
+   srv_game_t* p_game,  /*!< Game (selects the worker) */
+   tmr_t* p_tmr         /*!< Timer */
+   );
+
+#endif /* #ifndef SERVER_WORKER_H */
+/* END OF FILE ***************************************************************/
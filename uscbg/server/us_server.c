@@ -23,8 +23,14 @@ Copyright (c) 2013, All Rights Reserved.
 #include "net_us.h"
 #include "net_server.h"
 #include "core.h"
+#include "server_game.h"
+#include "server_worker.h"
+#include "server_bot.h"
 
 /* CONSTANTS / MACROS ********************************************************/
+#define US_SERVER_BOT_MS (200) /* Default bot search time per move */
+#define US_SERVER_TURN_S (120) /* Default time for a turn */
+#define US_SERVER_LOBBY_S (300) /* Default time before a lobby is started */
 
 /* LOCAL DATATYPES ***********************************************************/
 
@@ -46,35 +52,96 @@ static char trc_buf[0x8000];
 
 /* GLOBAL FUNCTIONS **********************************************************/
 /*-----------------------------------------------------------------------------
+Usage: us_server [-s seed] [-b players] [-g games] [-t ms] [-j threads]
+                 [-c s] [-l s]
+-s Seed of the first game (default time), replays the same games
+-b Fill started games with bots up to players
+-g Start games of bots only
+-t Bot search time per move in ms
+-j Bot search threads per move (0 = one per cpu)
+-c Time for a turn in s, then the server plays for the player (0 = no limit)
+-l Time in the lobby in s, then the game is started with bots (0 = no limit)
 -----------------------------------------------------------------------------*/
 int main(int argc, char* argv[])
 {
-   TOUCH(argc);
-   TOUCH(argv);
+   int bot_players = 0;
+   int bot_games = 0;
+   int bot_ms = US_SERVER_BOT_MS;
+   int bot_threads = 1;
+   int turn_s = US_SERVER_TURN_S;
+   int lobby_s = US_SERVER_LOBBY_S;
+   uint64_t seed = (uint64_t)time(NULL);
+   int i;
+
+   for (i=1;i+1<argc;i+=2)
+   {
+      int val = atoi(argv[i+1]);
+      if (strcmp(argv[i], "-s") == 0)
+      {
+         seed = strtoull(argv[i+1], NULL, 0);
+      }
+      else if (strcmp(argv[i], "-b") == 0)
+      {
+         bot_players = val;
+      }
+      else if (strcmp(argv[i], "-g") == 0)
+      {
+         bot_games = val;
+      }
+      else if (strcmp(argv[i], "-t") == 0)
+      {
+         bot_ms = val;
+      }
+      else if (strcmp(argv[i], "-j") == 0)
+      {
+         bot_threads = val;
+      }
+      else if (strcmp(argv[i], "-c") == 0)
+      {
+         turn_s = val;
+      }
+      else if (strcmp(argv[i], "-l") == 0)
+      {
+         lobby_s = val;
+      }
+      else
+      {
+         printf("Unknown option %s\n", argv[i]);
+      }
+   }
 
    /* Print program version, date and time */
    printf("%s %s %s\n", b_rev, b_date, b_time);
 
    TRC_INIT((char*)&trc_buf, 0x8000);
    TRC_MASK_FILTER(0xffffffff);
-   TRC_MODE_SET(TRC_MODE_PRINT);
+   /* Threads trace to their own buffer, printed by the trc thread */
+   TRC_MODE_SET(TRC_MODE_BUF);
+   TRC_START();
 
    /* Start server */
    net_init();
    net_server_init();
-   net_server_start();
-
-   /* Seed the random-number generator with current time so that
-   * the numbers will be different every time we run.
-   */
-   srand((unsigned)time( NULL ));
-   //printf ("First number: %d\n", rand() % 100);
-
-   core_init(net_server_send_cmd, net_server_broadcast_cmd);
 
+   core_init();
    hsm_init();
    srv_hsm_init();
-   srv_hsm_start();
+   srv_hsm_set_clocks(turn_s * 1000, lobby_s * 1000);
+   /* Games are created as players connect, each with its own seed */
+   printf("Seed %llu\n", (unsigned long long)seed);
+   srv_game_init(net_server_send_cmd, net_server_broadcast_cmd, seed);
+   /* Game logic runs on one worker per cpu */
+   srv_worker_init(0);
+   /* Bots search on their own threads, the moves are played on the worker
+      of their game */
+   srv_bot_init(bot_threads, bot_ms, net_server_bot_evt);
+   net_server_set_bots(bot_players);
+   srv_worker_start();
+   for (i=0;i<bot_games;i++)
+   {
+      net_server_bot_game();
+   }
+   net_server_start();
 
    while(1)
    { /* Wait for commands */
@@ -100,6 +167,7 @@ int main(int argc, char* argv[])
       {
          if (ch == 'e')
          {
+            TRC_VIEW_BUF();
             exit(0);
          }
          /* Todo: Add command handler */
@@ -0,0 +1,393 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file sim.c
+\brief Headless game simulation implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slnk.h"
+#include "trc.h"
+#include "net.h"
+#include "core.h"
+#include "core_sync.h"
+#include "core_move.h"
+#include "core_hash.h"
+#include "core_ai.h"
+#include "sim.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define SIM_SYNC_SZ (4 * MAX_PACKET_SZ) /* Max state sync packet */
+
+/* LOCAL DATATYPES ***********************************************************/
+typedef struct
+{
+   core_t core;               /*!< First, the net callbacks get the core */
+   const sim_cfg_t* p_cfg;
+   sim_result_t* p_result;
+   unsigned int seed;
+} sim_game_t;                 /*!< Game being played */
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static core_net_send_fn_t sim_net_send;
+static core_net_broadcast_fn_t sim_net_broadcast;
+static int sim_decide(sim_game_t* p_game, const move_t* p_moves,
+   int n_moves);
+static void sim_sync(sim_game_t* p_game);
+static void sim_check_hash(sim_game_t* p_game);
+static void sim_add_players(sim_game_t* p_game);
+static void sim_select_colors(sim_game_t* p_game);
+static void sim_play(sim_game_t* p_game);
+static void sim_score(sim_game_t* p_game);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+TRC_DEF(sim);
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void sim_init(void)
+{
+   TRC_REG(sim, TRC_ERROR);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void sim_run(const sim_cfg_t* p_cfg, sim_result_t* p_result)
+{
+   sim_game_t game;
+   core_t* p_core = &game.core;
+
+   REQUIRE((p_cfg->n_players >= 2) && (p_cfg->n_players <= SIM_MAX_PLAYERS));
+   memset(p_result, 0, sizeof(sim_result_t));
+   core_ctor(p_core, (p_cfg->sink)?sim_net_send:NULL,
+      (p_cfg->sink)?sim_net_broadcast:NULL);
+   game.p_cfg = p_cfg;
+   game.p_result = p_result;
+   game.seed = p_cfg->seed;
+   core_seed(p_core, p_cfg->seed);
+   sim_add_players(&game);
+   sim_select_colors(&game);
+   core_newgame(p_core, FALSE);
+   sim_sync(&game);
+   sim_play(&game);
+   sim_score(&game);
+   core_free(p_core);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int sim_policy_random(core_t* p_core, sim_decision_t decision,
+   const int* p_options, int n_options, unsigned int* p_seed, void* p_ctx)
+{
+   return rand_r(p_seed) % n_options;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int sim_policy_first(core_t* p_core, sim_decision_t decision,
+   const int* p_options, int n_options, unsigned int* p_seed, void* p_ctx)
+{
+   return 0;
+}
+
+/*-----------------------------------------------------------------------------
+The sim plays the moves of the search, the option of a move is its arg
+(SIM_OPTION_DONE for MOVE_DONE).
+-----------------------------------------------------------------------------*/
+int sim_policy_ai(core_t* p_core, sim_decision_t decision,
+   const int* p_options, int n_options, unsigned int* p_seed, void* p_ctx)
+{
+   core_ai_cfg_t cfg = *(const core_ai_cfg_t*)p_ctx;
+   move_t move;
+   int option;
+   int i;
+
+   cfg.seed = rand_r(p_seed);
+   if (!core_ai_search(p_core, &cfg, &move, NULL))
+   {
+      return 0;
+   }
+   option = (move.type == MOVE_DONE) ? SIM_OPTION_DONE : move.arg;
+   for (i=0;i<n_options;i++)
+   {
+      if (p_options[i] == option)
+      {
+         return i;
+      }
+   }
+   return 0;
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+In memory sink, commands are only counted.
+-----------------------------------------------------------------------------*/
+static void sim_net_send(core_t* p_core, int sock, int cmd, void* data)
+{
+   ((sim_game_t*)p_core)->p_result->n_cmds++;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void sim_net_broadcast(core_t* p_core, int cmd, void* data)
+{
+   ((sim_game_t*)p_core)->p_result->n_cmds++;
+}
+
+/*-----------------------------------------------------------------------------
+Ask the policy of the active player to pick one of the moves of the current
+state. The options are the move args, SIM_OPTION_DONE for MOVE_DONE.
+\return Index of the selected move
+-----------------------------------------------------------------------------*/
+static int sim_decide(sim_game_t* p_game, const move_t* p_moves,
+   int n_moves)
+{
+   int player = p_game->core.active_player->id - 1;
+   sim_policy_fn_t* p_fn = p_game->p_cfg->p_policy[player];
+   int options[SIM_MAX_OPTIONS];
+   sim_decision_t decision;
+   int i;
+
+   switch (p_game->core.state)
+   {
+   case CORE_STATE_NONE:
+      decision = SIM_DECISION_COLOR;
+      break;
+   case CORE_STATE_SETUP:
+      decision = SIM_DECISION_SETUP_LOT;
+      break;
+   case CORE_STATE_INVESTMENTS:
+      decision = SIM_DECISION_INVEST;
+      break;
+   default:
+      decision = SIM_DECISION_ACTION;
+      break;
+   }
+   for (i=0;i<n_moves;i++)
+   {
+      options[i] = (p_moves[i].type == MOVE_DONE)?SIM_OPTION_DONE:
+         p_moves[i].arg;
+   }
+   if (p_fn == NULL)
+   {
+      p_fn = sim_policy_random;
+   }
+   if (p_game->p_cfg->check_hash)
+   {
+      sim_check_hash(p_game);
+   }
+   i = p_fn(&p_game->core, decision, options, n_moves, &p_game->seed,
+      p_game->p_cfg->p_ctx[player]);
+   REQUIRE((i >= 0) && (i < n_moves));
+   p_game->p_result->decisions++;
+   return i;
+}
+
+/*-----------------------------------------------------------------------------
+State changes of a move, one delta as the server would send it.
+-----------------------------------------------------------------------------*/
+static void sim_sync(sim_game_t* p_game)
+{
+   if (!core_sync_pending(&p_game->core))
+   {
+      return;
+   }
+   if (p_game->p_cfg->sink)
+   {
+      uint8_t buf[SIM_SYNC_SZ];
+      int len = core_sync_encode(&p_game->core, buf, SIM_SYNC_SZ, FALSE);
+      REQUIRE(len > 0);
+      p_game->p_result->n_syncs++;
+      p_game->p_result->sync_bytes += len;
+   }
+   core_sync_clear(&p_game->core);
+}
+
+/*-----------------------------------------------------------------------------
+The incremental hash of the game must be the hash computed from scratch. Every
+legal move is played and taken back on a copy of the game (the game keeps its
+dirty bits), the hash must match after the move and be the old one after the
+undo.
+-----------------------------------------------------------------------------*/
+static void sim_check_hash(sim_game_t* p_game)
+{
+   core_undo_stack_t undo;
+   move_t moves[CORE_MAX_MOVES];
+   core_t copy;
+   uint64_t hash = core_hash(&p_game->core);
+   int n;
+   int i;
+
+   if (hash != core_hash_full(&p_game->core))
+   {
+      TRC_ERR(sim, "Hash error, game seed %u", p_game->p_cfg->seed);
+      p_game->p_result->hash_errors++;
+      return;
+   }
+   core_copy(&copy, &p_game->core);
+   core_undo_clear(&undo);
+   n = core_gen_moves(&copy, moves, CORE_MAX_MOVES);
+   for (i=0;i<n;i++)
+   {
+      core_apply_move(&copy, &moves[i], &undo);
+      if (core_hash(&copy) != core_hash_full(&copy))
+      {
+         TRC_ERR(sim, "Hash error after move %d %d, game seed %u",
+            moves[i].type, moves[i].arg, p_game->p_cfg->seed);
+         p_game->p_result->hash_errors++;
+      }
+      core_undo_move(&copy, &undo);
+      if (core_hash(&copy) != hash)
+      {
+         TRC_ERR(sim, "Hash error after undo %d %d, game seed %u",
+            moves[i].type, moves[i].arg, p_game->p_cfg->seed);
+         p_game->p_result->hash_errors++;
+      }
+   }
+   core_free(&copy);
+}
+
+/*-----------------------------------------------------------------------------
+The players are seated in a random order (drawn from the game generator), the
+first one seated starts. Player ids are the policy index + 1, so a policy does
+not keep its seat.
+-----------------------------------------------------------------------------*/
+static void sim_add_players(sim_game_t* p_game)
+{
+   int seats[SIM_MAX_PLAYERS];
+   int n = p_game->p_cfg->n_players;
+   int i;
+
+   for (i=0;i<n;i++)
+   {
+      seats[i] = i;
+   }
+   for (i=n-1;i>0;i--)
+   {
+      int j = core_rng_below(&p_game->core.rng, i + 1);
+      int tmp = seats[i];
+      seats[i] = seats[j];
+      seats[j] = tmp;
+   }
+   for (i=0;i<n;i++)
+   {
+      player_t* p_player = (player_t*)calloc(1, sizeof(player_t));
+      REQUIRE(p_player != NULL);
+      p_player->id = seats[i] + 1;
+      snprintf(p_player->name, MAX_NAME_LENGTH, "sim%d", seats[i] + 1);
+      core_add_player(&p_game->core, p_player);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void sim_select_colors(sim_game_t* p_game)
+{
+   core_t* p_core = &p_game->core;
+   move_t moves[CORE_MAX_MOVES];
+
+   p_core->active_player = SLNK_NEXT(player_t, &p_core->players_head);
+   while (p_core->active_player != NULL)
+   {
+      int n = core_gen_moves(p_core, moves, CORE_MAX_MOVES);
+      REQUIRE(n > 0);
+      core_apply_move(p_core, &moves[sim_decide(p_game, moves, n)], NULL);
+      p_game->p_result->moves++;
+      sim_sync(p_game);
+      p_core->active_player = SLNK_NEXT(player_t, p_core->active_player);
+   }
+   p_core->active_player = SLNK_NEXT(player_t, &p_core->players_head);
+}
+
+/*-----------------------------------------------------------------------------
+Setup and turns, the moves of the search (core_ai_gen_moves) played with
+core_apply_move() and the phase and player changes of the server state
+machine (core_ai_next). A turn ends with DONE in the action selection. The
+game ends when it is over (core_game_over), when every player passed a turn
+in a row or after max_rounds.
+-----------------------------------------------------------------------------*/
+static void sim_play(sim_game_t* p_game)
+{
+   core_t* p_core = &p_game->core;
+   sim_result_t* p_result = p_game->p_result;
+   int max_turns = p_game->p_cfg->max_rounds * p_core->n_players;
+   move_t moves[CORE_MAX_MOVES];
+   bool_t moved = FALSE;
+   int passes = 0;
+   int turns = 0;
+
+   while (1)
+   {
+      uint8_t state = p_core->state;
+      player_t* p_player = p_core->active_player;
+      int n = core_ai_gen_moves(p_core, moves, CORE_MAX_MOVES);
+      int i;
+
+      if (n == 0)
+      {
+         break;
+      }
+      i = sim_decide(p_game, moves, n);
+      core_apply_move(p_core, &moves[i], NULL);
+      core_ai_next(p_core, state, &moves[i]);
+      if ((p_core->state != state) || (p_core->active_player != p_player))
+      {
+         core_dirty(p_core, CORE_DIRTY_PHASE | CORE_DIRTY_ACTIVE_PLAYER);
+      }
+      if (moves[i].type != MOVE_DONE)
+      {
+         p_result->moves++;
+         moved |= (state != CORE_STATE_SETUP);
+      }
+      sim_sync(p_game);
+      if ((state == CORE_STATE_ACTIONS) && (moves[i].type == MOVE_DONE))
+      { /* End of turn */
+         passes = (moved)?0:passes + 1;
+         moved = FALSE;
+         turns++;
+         if (core_game_over(p_core) || (passes >= p_core->n_players) ||
+             ((max_turns > 0) && (turns >= max_turns)))
+         {
+            break;
+         }
+      }
+   }
+   p_result->rounds = (turns + p_core->n_players - 1) / p_core->n_players;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void sim_score(sim_game_t* p_game)
+{
+   sim_result_t* p_result = p_game->p_result;
+   player_t* p_player = SLNK_NEXT(player_t, &p_game->core.players_head);
+   int best = -1;
+
+   while (p_player != NULL)
+   {
+      int i = p_player->id - 1;
+      p_result->wealth[i] = p_player->wealth;
+      p_result->prestige[i] = p_player->prestige;
+      if ((best < 0) || (p_result->prestige[i] > p_result->prestige[best]) ||
+          ((p_result->prestige[i] == p_result->prestige[best]) &&
+           (p_result->wealth[i] > p_result->wealth[best])))
+      {
+         best = i;
+      }
+      p_player = SLNK_NEXT(player_t, p_player);
+   }
+   p_result->winner = best;
+}
+
+/* END OF FILE ***************************************************************/
@@ -0,0 +1,135 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file sim.h
+\brief Headless game simulation for batch self-play.
+
+Plays complete games on a core_t in the calling thread, without server, hsm
+or sockets. The game follows the server state machine: color selection,
+setup (startup buildings), then turns of investments and actions until the
+game is over, every player passed a turn in a row or max_rounds is reached.
+The options are the moves of the computer player (core_ai_gen_moves), every
+decision is made by a policy function that picks one of them. The players
+are seated in a random order (from the seed) in every game. */
+/*---------------------------------------------------------------------------*/
+#ifndef SIM_H
+#define SIM_H
+/* INCLUDE FILES *************************************************************/
+#include "core.h"
+
+/* EXPORTED DEFINES **********************************************************/
+#define SIM_MAX_PLAYERS (PLAYER_COLOR_LAST)
+#define SIM_MAX_OPTIONS (MAX_BOARD_LOTS)
+#define SIM_OPTION_DONE (-1) /* Ends investments or actions of a turn */
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef enum
+{
+   SIM_DECISION_COLOR = 0,    /*!< Options: available colors */
+   SIM_DECISION_SETUP_LOT,    /*!< Options: free startup lots */
+   SIM_DECISION_INVEST,       /*!< Options: planning card ids in hand, DONE */
+   SIM_DECISION_ACTION,       /*!< Options: action 0 (take a card), DONE or
+                                   board cards to take (0-4), DONE */
+   SIM_DECISION_LAST
+} sim_decision_t;
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Policy. Picks one of n_options (> 0) for the active player.
+\return Option index */
+/*---------------------------------------------------------------------------*/
+typedef int sim_policy_fn_t(
+   core_t* p_core,            /*!< Game instance */
+   sim_decision_t decision,   /*!< Decision */
+   const int* p_options,      /*!< Legal options */
+   int n_options,             /*!< Number of options */
+   unsigned int* p_seed,      /*!< Random seed of the game (rand_r) */
+   void* p_ctx                /*!< Policy context */
+   );
+
+typedef struct
+{
+   int n_players;             /*!< 2 - SIM_MAX_PLAYERS */
+   int max_rounds;            /*!< Round limit (0 = no limit) */
+   unsigned int seed;         /*!< Random seed of the game */
+   bool_t sink;               /*!< Count net traffic in memory instead of
+                                   dropping it */
+   bool_t check_hash;         /*!< Check the incremental hash at every
+                                   decision, also after core_apply_move() and
+                                   core_undo_move() of every legal move */
+   sim_policy_fn_t* p_policy[SIM_MAX_PLAYERS]; /*!< NULL = random */
+   void* p_ctx[SIM_MAX_PLAYERS];
+} sim_cfg_t;
+
+typedef struct
+{
+   int rounds;                /*!< Rounds played (turns / players) */
+   int decisions;             /*!< Policy calls */
+   int moves;                 /*!< Decisions that changed the game */
+   int winner;                /*!< Player index, most prestige then wealth */
+   uint32_t wealth[SIM_MAX_PLAYERS];
+   uint32_t prestige[SIM_MAX_PLAYERS];
+   int n_cmds;                /*!< Commands to the sink */
+   int n_syncs;               /*!< State sync packets to the sink */
+   int sync_bytes;            /*!< State sync bytes to the sink */
+   int hash_errors;           /*!< core_hash() != core_hash_full() */
+} sim_result_t;
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize (after core_init). */
+/*---------------------------------------------------------------------------*/
+void sim_init(void);
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Play one complete game. */
+/*---------------------------------------------------------------------------*/
+void sim_run(
+   const sim_cfg_t* p_cfg,    /*!< Configuration */
+   sim_result_t* p_result     /*!< Result */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Policy picking a random option. */
+/*---------------------------------------------------------------------------*/
+int sim_policy_random(
+   core_t* p_core,
+   sim_decision_t decision,
+   const int* p_options,
+   int n_options,
+   unsigned int* p_seed,
+   void* p_ctx
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Scripted policy picking the first option (cheapest card, DONE when
+nothing else is legal). */
+/*---------------------------------------------------------------------------*/
+int sim_policy_first(
+   core_t* p_core,
+   sim_decision_t decision,
+   const int* p_options,
+   int n_options,
+   unsigned int* p_seed,
+   void* p_ctx
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Policy playing the computer player (core_ai_search), p_ctx is the
+core_ai_cfg_t. The search seed is drawn from the game seed. */
+/*---------------------------------------------------------------------------*/
+int sim_policy_ai(
+   core_t* p_core,
+   sim_decision_t decision,
+   const int* p_options,
+   int n_options,
+   unsigned int* p_seed,
+   void* p_ctx
+   );
+
+#endif /* #ifndef SIM_H */
+/* END OF FILE ***************************************************************/
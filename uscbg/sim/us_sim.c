@@ -0,0 +1,143 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file us_sim.c
+\brief Urban Sprawl batch self-play.
+
+Usage: USSim [games] [players] [random|first|ai] [seed] [check]
+With ai player 1 is the computer player, the others play random. With check
+the incremental position hash is checked at every decision (slow). */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "trc.h"
+#include "core.h"
+#include "core_ai.h"
+#include "sim.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define SIM_AI_ITERATIONS (256) /* Playouts per search thread and decision */
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+/*** Remove this comment if you want to use an ASSERT
+SYS_ASSERT_FILE;
+***/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+/* ver strings */
+static const char b_rev[] = "@(#) us_sim_0_0_1";
+static const char b_date[] = __DATE__;
+static const char b_time[] = __TIME__;
+
+static char trc_buf[0x8000];
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int main(int argc, char* argv[])
+{
+   sim_cfg_t cfg;
+   sim_result_t result;
+   core_ai_cfg_t ai_cfg;
+   int games = (argc > 1)?atoi(argv[1]):10000;
+   int wins[SIM_MAX_PLAYERS] = {0};
+   long rounds = 0;
+   long moves = 0;
+   long sync_bytes = 0;
+   long hash_errors = 0;
+   struct timespec t0, t1;
+   double secs;
+   int i;
+
+   /* Print program version, date and time */
+   printf("%s %s %s\n", b_rev, b_date, b_time);
+
+   TRC_INIT((char*)&trc_buf, 0x8000);
+   TRC_MASK_FILTER(TRC_ERROR);
+   TRC_MODE_SET(TRC_MODE_PRINT);
+
+   core_init();
+   sim_init();
+
+   memset(&cfg, 0, sizeof(cfg));
+   cfg.n_players = (argc > 2)?atoi(argv[2]):4;
+   cfg.sink = TRUE;
+   if ((argc > 3) && (strcmp(argv[3], "first") == 0))
+   {
+      for (i=0;i<SIM_MAX_PLAYERS;i++)
+      {
+         cfg.p_policy[i] = sim_policy_first;
+      }
+   }
+   else if ((argc > 3) && (strcmp(argv[3], "ai") == 0))
+   { /* Computer player 1 against random players */
+      memset(&ai_cfg, 0, sizeof(ai_cfg));
+      ai_cfg.max_iterations = SIM_AI_ITERATIONS;
+      cfg.p_policy[0] = sim_policy_ai;
+      cfg.p_ctx[0] = &ai_cfg;
+   }
+   cfg.seed = (argc > 4)?(unsigned int)strtoul(argv[4], NULL, 0):1;
+   cfg.check_hash = (argc > 5) && (strcmp(argv[5], "check") == 0);
+   if ((games <= 0) || (cfg.n_players < 2) ||
+       (cfg.n_players > SIM_MAX_PLAYERS))
+   {
+      printf("Usage: %s [games] [players 2-%d] [random|first|ai] [seed] "
+         "[check]\n", argv[0], SIM_MAX_PLAYERS);
+      return 1;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   for (i=0;i<games;i++)
+   { /* Game i is reproducible with seed + i */
+      sim_run(&cfg, &result);
+      wins[result.winner]++;
+      rounds += result.rounds;
+      moves += result.moves;
+      sync_bytes += result.sync_bytes;
+      hash_errors += result.hash_errors;
+      cfg.seed++;
+   }
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+   printf("%d games, %d players: %.0f games/s, %.1f rounds, %.1f moves, "
+      "%.0f sync bytes per game\n", games, cfg.n_players, games / secs,
+      (double)rounds / games, (double)moves / games,
+      (double)sync_bytes / games);
+   for (i=0;i<cfg.n_players;i++)
+   {
+      printf("player %d: %d wins\n", i + 1, wins[i]);
+   }
+   if (cfg.check_hash)
+   {
+      printf("%ld hash errors\n", hash_errors);
+   }
+   return (hash_errors == 0) ? 0 : 1;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void assert(const char* test, const char* file, int line)
+{
+   printf("ASSERT %s %s %d", test, file, line);
+   exit(-1);
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+
+/* END OF FILE ***************************************************************/
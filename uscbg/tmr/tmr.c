@@ -0,0 +1,267 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file tmr.c
+\brief The tmr implementation. */
+/*---------------------------------------------------------------------------*/
+/* INCLUDE FILES *************************************************************/
+#include "sys_def.h"
+#include "sys_assert.h"
+#include "dlnk.h"
+#include "tmr.h"
+
+/* CONSTANTS / MACROS ********************************************************/
+#define TMR_MASK (TMR_SLOTS - 1)
+#define TMR_INDEX(tick, level) \
+   (((tick) >> ((level) * TMR_SLOT_BITS)) & TMR_MASK)
+/* Rotate the slot bits right, slot n is bit 0 */
+#define TMR_ROTR(bits, n) \
+   (((bits) >> (n)) | ((bits) << ((TMR_SLOTS - (n)) & TMR_MASK)))
+
+/* LOCAL DATATYPES ***********************************************************/
+
+/* LOCAL FUNCTION PROTOTYPES *************************************************/
+static void tmr_add(tmr_wheel_t* p_wheel, tmr_t* p_tmr);
+static void tmr_cascade(tmr_wheel_t* p_wheel);
+static void tmr_detach(tmr_wheel_t* p_wheel, int level, uint32_t idx,
+   dlnk_t* p_list);
+
+/* MODULE CONSTANTS / VARIABLES **********************************************/
+SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
+
+/* GLOBAL CONSTANTS / VARIABLES **********************************************/
+
+/* GLOBAL FUNCTIONS **********************************************************/
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void tmr_wheel_init(tmr_wheel_t* p_wheel, uint32_t now)
+{
+   int i;
+
+   p_wheel->now = now;
+   p_wheel->n_timers = 0;
+   for (i=0;i<TMR_LEVELS;i++)
+   {
+      p_wheel->used[i] = 0;
+   }
+   for (i=0;i<TMR_LEVELS * TMR_SLOTS;i++)
+   {
+      DLNK_INIT(&p_wheel->slots[i]);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void tmr_init(tmr_t* p_tmr, tmr_fn_t* p_fn, void* p_ctx)
+{
+   REQUIRE(p_fn != NULL);
+   DLNK_INIT(&p_tmr->lnk);
+   p_tmr->expires = 0;
+   p_tmr->slot = 0;
+   p_tmr->p_fn = p_fn;
+   p_tmr->p_ctx = p_ctx;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void tmr_start(tmr_wheel_t* p_wheel, tmr_t* p_tmr, uint32_t ticks)
+{
+   REQUIRE(ticks <= 0x7fffffffu);
+   tmr_stop(p_wheel, p_tmr);
+   p_tmr->expires = p_wheel->now + ticks;
+   tmr_add(p_wheel, p_tmr);
+   p_wheel->n_timers++;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void tmr_stop(tmr_wheel_t* p_wheel, tmr_t* p_tmr)
+{
+   dlnk_t* p_head;
+
+   if (!tmr_running(p_tmr))
+   {
+      return;
+   }
+   DLNK_REMOVE(tmr_t, &p_tmr->lnk);
+   p_head = &p_wheel->slots[p_tmr->slot];
+   if (p_head->p_next == p_head)
+   {
+      p_wheel->used[p_tmr->slot / TMR_SLOTS] &=
+         ~(1ull << (p_tmr->slot & TMR_MASK));
+   }
+   p_wheel->n_timers--;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool_t tmr_running(const tmr_t* p_tmr)
+{
+   return (p_tmr->lnk.p_next != &p_tmr->lnk);
+}
+
+/*-----------------------------------------------------------------------------
+Empty stretches of the lowest level are skipped with the slot bits, a lowest
+level round without timers costs one cascade.
+-----------------------------------------------------------------------------*/
+void tmr_advance(tmr_wheel_t* p_wheel, uint32_t now)
+{
+   while ((int32_t)(now - p_wheel->now) >= 0)
+   {
+      uint32_t idx = p_wheel->now & TMR_MASK;
+      uint64_t bits;
+      uint32_t skip;
+      dlnk_t list;
+
+      if (idx == 0)
+      {
+         tmr_cascade(p_wheel);
+      }
+      bits = p_wheel->used[0] >> idx;
+      skip = (bits == 0) ? (TMR_SLOTS - idx) : (uint32_t)__builtin_ctzll(bits);
+      if (skip > 0)
+      { /* Next timer (or round) is later */
+         if (now - p_wheel->now < skip)
+         {
+            p_wheel->now = now + 1;
+            break;
+         }
+         p_wheel->now += skip;
+         continue;
+      }
+      /* Timers started by the callbacks may go to this slot (next round) */
+      tmr_detach(p_wheel, 0, idx, &list);
+      p_wheel->now++;
+      while (list.p_next != &list)
+      {
+         tmr_t* p_tmr = (tmr_t*)list.p_next;
+         DLNK_REMOVE(tmr_t, &p_tmr->lnk);
+         p_wheel->n_timers--;
+         p_tmr->p_fn(p_tmr, p_tmr->p_ctx);
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+The lowest level slots are searched from the next tick on (slots before it are
+the next round). A slot of a higher level is cascaded when the levels below
+wrap to it, the current slot is still to be cascaded if they are at 0.
+-----------------------------------------------------------------------------*/
+int tmr_next(const tmr_wheel_t* p_wheel)
+{
+   uint32_t now = p_wheel->now;
+   uint32_t next;
+   int level;
+
+   if (p_wheel->n_timers == 0)
+   {
+      return -1;
+   }
+   next = TMR_MAX_TICKS;
+   if (p_wheel->used[0] != 0)
+   {
+      next = (uint32_t)__builtin_ctzll(TMR_ROTR(p_wheel->used[0],
+         now & TMR_MASK));
+   }
+   for (level=1;level<TMR_LEVELS;level++)
+   {
+      int shift = level * TMR_SLOT_BITS;
+      bool_t pending = ((now & ((1u << shift) - 1)) == 0);
+      uint32_t first = (TMR_INDEX(now, level) + (pending ? 0 : 1)) & TMR_MASK;
+      uint32_t d;
+
+      if (p_wheel->used[level] == 0)
+      {
+         continue;
+      }
+      d = (uint32_t)__builtin_ctzll(TMR_ROTR(p_wheel->used[level], first)) +
+         (pending ? 0 : 1);
+      d = (((now >> shift) + d) << shift) - now;
+      next = MIN(next, d);
+   }
+   return (int)next;
+}
+
+/* LOCAL FUNCTIONS ***********************************************************/
+/*-----------------------------------------------------------------------------
+Link a timer into the slot of its expiry. An expiry already passed is run on
+the next tick, one beyond the wheel is placed at the end and cascaded again.
+-----------------------------------------------------------------------------*/
+static void tmr_add(tmr_wheel_t* p_wheel, tmr_t* p_tmr)
+{
+   uint32_t expires = p_tmr->expires;
+   uint32_t delta = expires - p_wheel->now;
+   int level = 0;
+   uint32_t idx;
+
+   if ((int32_t)delta < 0)
+   {
+      expires = p_wheel->now;
+      delta = 0;
+   }
+   else if (delta > TMR_MAX_TICKS)
+   {
+      expires = p_wheel->now + TMR_MAX_TICKS;
+      delta = TMR_MAX_TICKS;
+   }
+   while (delta >= (1u << ((level + 1) * TMR_SLOT_BITS)))
+   {
+      level++;
+   }
+   idx = TMR_INDEX(expires, level);
+   p_tmr->slot = (uint16_t)(level * TMR_SLOTS + idx);
+   DLNK_INSERT(&p_wheel->slots[p_tmr->slot], &p_tmr->lnk);
+   p_wheel->used[level] |= 1ull << idx;
+}
+
+/*-----------------------------------------------------------------------------
+The lowest level wrapped, move the current slot of level 1 down (and of the
+levels above as long as the level below wrapped too).
+-----------------------------------------------------------------------------*/
+static void tmr_cascade(tmr_wheel_t* p_wheel)
+{
+   int level;
+
+   for (level=1;level<TMR_LEVELS;level++)
+   {
+      uint32_t idx = TMR_INDEX(p_wheel->now, level);
+      dlnk_t list;
+
+      tmr_detach(p_wheel, level, idx, &list);
+      while (list.p_next != &list)
+      {
+         tmr_t* p_tmr = (tmr_t*)list.p_next;
+         DLNK_REMOVE(tmr_t, &p_tmr->lnk);
+         tmr_add(p_wheel, p_tmr);
+      }
+      if (idx != 0)
+      {
+         break;
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+Move the timers of a slot to a list head (empty list if the slot is empty).
+-----------------------------------------------------------------------------*/
+static void tmr_detach(tmr_wheel_t* p_wheel, int level, uint32_t idx,
+   dlnk_t* p_list)
+{
+   dlnk_t* p_head = &p_wheel->slots[level * TMR_SLOTS + idx];
+
+   DLNK_INIT(p_list);
+   if (p_head->p_next == p_head)
+   {
+      return;
+   }
+   p_list->p_next = p_head->p_next;
+   p_list->p_prev = p_head->p_prev;
+   p_list->p_next->p_prev = p_list;
+   p_list->p_prev->p_next = p_list;
+   DLNK_INIT(p_head);
+   p_wheel->used[level] &= ~(1ull << idx);
+}
+
+/* END OF FILE ***************************************************************/
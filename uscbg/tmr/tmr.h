@@ -0,0 +1,126 @@
+/******************************************************************************
+Copyright (c) 2013, All Rights Reserved.
+******************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \file tmr.h
+\brief The tmr interface (hierarchical timer wheel).
+
+A wheel has TMR_LEVELS levels of TMR_SLOTS slots. A timer is linked into the
+slot of the lowest level its expiry fits in, level n slots span
+TMR_SLOTS^n ticks. When the lowest level wraps, the next slot of the level
+above is cascaded down. Start and stop are O(1), a tick costs O(1) plus the
+callbacks of the expired timers. Timers are embedded in their owner, the
+wheel allocates nothing.
+
+A wheel is not thread safe, it is used (started, stopped and advanced) by one
+thread. Callbacks are called from tmr_advance() and may start or stop any
+timer of the wheel. */
+/*---------------------------------------------------------------------------*/
+#ifndef TMR_H
+#define TMR_H
+/* INCLUDE FILES *************************************************************/
+
+/* EXPORTED DEFINES **********************************************************/
+#define TMR_SLOT_BITS (6)
+#define TMR_SLOTS (1 << TMR_SLOT_BITS)    /*!< Slots per level */
+#define TMR_LEVELS (4)                    /*!< Levels */
+/*! Longest timeout in one pass, longer ones are cascaded from the top again */
+#define TMR_MAX_TICKS ((1u << (TMR_SLOT_BITS * TMR_LEVELS)) - 1)
+
+/* EXPORTED DATA TYPES *******************************************************/
+typedef struct tmr tmr_t;
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Expiry callback. The timer is stopped when it is called. */
+/*---------------------------------------------------------------------------*/
+typedef void tmr_fn_t(
+   tmr_t* p_tmr,        /*!< Expired timer */
+   void* p_ctx          /*!< Context given to tmr_init() */
+   );
+
+struct tmr
+{
+   dlnk_t lnk;          /*!< Slot list (self linked when stopped) */
+   uint32_t expires;    /*!< Expiry tick */
+   uint16_t slot;       /*!< Level * TMR_SLOTS + slot */
+   tmr_fn_t* p_fn;      /*!< Expiry callback */
+   void* p_ctx;         /*!< Callback context */
+};                      /*!< Timer */
+
+typedef struct
+{
+   uint32_t now;        /*!< Next tick to run */
+   int n_timers;        /*!< Running timers */
+   uint64_t used[TMR_LEVELS]; /*!< Non empty slots */
+   dlnk_t slots[TMR_LEVELS * TMR_SLOTS];
+} tmr_wheel_t;          /*!< Timer wheel */
+
+/* GLOBAL VARIABLES **********************************************************/
+
+/* INTERFACE FUNCTIONS *******************************************************/
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize a wheel. */
+/*---------------------------------------------------------------------------*/
+void tmr_wheel_init(
+   tmr_wheel_t* p_wheel,   /*!< Wheel */
+   uint32_t now            /*!< Current tick */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Initialize a timer (stopped). */
+/*---------------------------------------------------------------------------*/
+void tmr_init(
+   tmr_t* p_tmr,           /*!< Timer */
+   tmr_fn_t* p_fn,         /*!< Expiry callback */
+   void* p_ctx             /*!< Callback context */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Start a timer, a running timer is restarted. It expires when
+tmr_advance() runs the tick ticks after the next tick to run (0 expires on the
+next tick). */
+/*---------------------------------------------------------------------------*/
+void tmr_start(
+   tmr_wheel_t* p_wheel,   /*!< Wheel */
+   tmr_t* p_tmr,           /*!< Timer */
+   uint32_t ticks          /*!< Timeout (max 2^31 ticks) */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Stop a timer. A stopped timer is ignored. */
+/*---------------------------------------------------------------------------*/
+void tmr_stop(
+   tmr_wheel_t* p_wheel,   /*!< Wheel */
+   tmr_t* p_tmr            /*!< Timer */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Timer is running.
+\return TRUE if started and not yet expired or stopped */
+/*---------------------------------------------------------------------------*/
+bool_t tmr_running(
+   const tmr_t* p_tmr      /*!< Timer */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Run all ticks up to now, expired timers are called. */
+/*---------------------------------------------------------------------------*/
+void tmr_advance(
+   tmr_wheel_t* p_wheel,   /*!< Wheel */
+   uint32_t now            /*!< Current tick */
+   );
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Ticks to the next tick tmr_advance() has work at (an expiry or the
+cascade of a non empty slot), counted from the next tick to run. Never later
+than the first expiry.
+\return Ticks or -1 if no timer is running */
+/*---------------------------------------------------------------------------*/
+int tmr_next(
+   const tmr_wheel_t* p_wheel /*!< Wheel */
+   );
+
+#endif /* #ifndef TMR_H */
+/* END OF FILE ***************************************************************/
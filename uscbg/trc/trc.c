@@ -4,7 +4,18 @@ Copyright (c) 2013, All Rights Reserved.
 
 /*---------------------------------------------------------------------------*/
 /*! \file trc.c
-\brief The trc implementation. */
+\brief The trc implementation.
+
+In TRC_MODE_BUF each tracing thread writes binary records to a ring of its
+own: the time, the client, the format pointer and the arguments packed in
+format order (8 bytes each, strings copied). The thread is the only writer and
+trc_view_buf() the only reader of a ring, head and tail are the only shared
+words. A full ring drops the record and counts it, tracing never blocks and
+never formats. Rings are linked into one list on the first trace of a thread
+and never freed: a thread that exits hands its ring to a free list (the
+records it holds are still drained), the next new tracing thread takes it. The
+list of rings grows to the most threads tracing at once, not to all the
+threads ever started. */
 /*---------------------------------------------------------------------------*/
 /* INCLUDE FILES *************************************************************/
 #include "sys_def.h"
@@ -13,11 +24,21 @@ Copyright (c) 2013, All Rights Reserved.
 #include "dlnk.h"
 #include "trc.h"
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 
 /* CONTANTS / MACROS *********************************************************/
 #define TRC_MAX_STR_LEN 256
+#define TRC_RING_SZ 0x10000   /* Ring of a thread (power of 2) */
+#define TRC_REC_MAX 512       /* Largest record with arguments */
+#define TRC_DRAIN_MS 10       /* Interval of the trc_start() thread */
+#define TRC_ALIGN(n) (((n) + 7) & ~(size_t)7)
 
 /* LOCAL DATATYPES ***********************************************************/
 typedef struct
@@ -28,12 +49,65 @@ typedef struct
    uint32_t mask;       /*!< Trace mask */
 } search_prm_t;         /*!< Search paramter structure */
 
+/*---------------------------------------------------------------------------*/
+/*! \brief Binary trace record, followed by the arguments. */
+/*---------------------------------------------------------------------------*/
+typedef struct
+{
+   uint32_t sz;         /*!< Record size (multiple of 8) */
+   uint32_t mask;       /*!< Trace mask, 0 pads the ring to its end */
+   uint64_t ts;         /*!< Time, ns */
+   trc_reg_t* p_client; /*!< Client */
+   const char* p_fmt;   /*!< Format, must outlive the record */
+} trc_rec_t;
+
+typedef struct trc_ring
+{
+   struct trc_ring* p_next; /*!< Rings of all threads */
+   struct trc_ring* p_free; /*!< Rings of exited threads (free_lock) */
+   char* p_data;
+   uint32_t size;       /*!< Bytes (power of 2) */
+   uint32_t head;       /*!< Bytes written (writer) */
+   uint32_t tail;       /*!< Bytes read (reader) */
+   uint32_t lost;       /*!< Records dropped on a full ring (writer) */
+   uint32_t lost_seen;  /*!< Drops reported (reader) */
+} trc_ring_t;
+
+/*---------------------------------------------------------------------------*/
+/*! \brief Conversion specification of a format. */
+/*---------------------------------------------------------------------------*/
+typedef struct
+{
+   const char* p_len;   /*!< Length modifier (end of flags, width, precision) */
+   char len;            /*!< 'H' hh, 'h', 'l', 'q' ll, 'j', 'z', 't', 'L' */
+   char conv;           /*!< Conversion, 0 at the end of the format */
+   int stars;           /*!< Width and precision arguments */
+} trc_spec_t;
+
+typedef union
+{
+   long long i;
+   unsigned long long u;
+   double d;
+   const void* p;
+} trc_arg_t;            /*!< Packed argument */
+
 /* LOCAL FUNCTION PROTOTYPES *************************************************/
 STATIC size_t prefix_info(char* p_dst, uint32_t mask, const char* name,
    uint32_t time);
 STATIC dlnk_fn_t trc_set_client;
 STATIC trc_print_co_t trc_print_def;
 STATIC int bit_num(uint32_t mask);
+STATIC const char* trc_spec(const char* p_fmt, trc_spec_t* p_spec);
+STATIC size_t trc_pack(trc_rec_t* p_rec, size_t sz, va_list ap);
+STATIC size_t trc_unpack(char* p_dst, size_t sz, trc_rec_t const* p_rec);
+STATIC trc_ring_t* trc_ring_own(void);
+STATIC void trc_ring_key(void);
+STATIC void trc_ring_free(void* p_arg);
+STATIC bool_t trc_ring_put(trc_ring_t* p_ring, trc_rec_t const* p_rec);
+STATIC bool_t trc_ring_peek(trc_ring_t* p_ring, trc_rec_t* p_rec);
+STATIC uint64_t trc_ns(void);
+STATIC void* trc_drain(void* p_arg);
 
 /* MODULE CONSTANTS / VARIABLES **********************************************/
 SYS_DBC_FILE;  /*!< Defines the name of this source file once for all */
@@ -41,9 +115,15 @@ trc_lnk_t trc_lnk = {{NULL, NULL}, NULL};
 uint32_t trc_mask = 0xffffffff;
 static trc_print_co_t* trc_print_co = trc_print_def;
 static trc_mode_t modei = TRC_MODE_PRINT;
-static char* p_buf_start;
-static char* p_buf_end;
-static char* p_buf_head;
+static trc_ring_t* p_rings;          /* Pushed by the writers */
+static __thread trc_ring_t* p_ring_own;
+static trc_ring_t ring_init;        /* Ring of trc_init() on its buffer */
+static pthread_mutex_t view_lock = PTHREAD_MUTEX_INITIALIZER;
+static trc_ring_t* p_rings_free;    /* Rings of exited threads */
+static pthread_mutex_t free_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;      /* Hands the ring back on thread exit */
+static uint64_t trc_epoch;
 static const char* type_nm[] =
 {
    "", "error", "dbg", "info", "data", "evt"
@@ -61,17 +141,31 @@ void trc_init(char* p_buf, uint32_t buf_sz)
    trc_print_co = trc_print_def;
    dlnk_init(&trc_lnk.dlnk);
    REQUIRE(p_buf);
-   REQUIRE(buf_sz > TRC_MAX_STR_LEN);
-   p_buf_start = p_buf;
-   p_buf_head = p_buf;
-   p_buf_end = p_buf_start + buf_sz - 1;
+   REQUIRE(buf_sz >= 2 * TRC_REC_MAX);
+   ring_init.p_data = p_buf;
+   ring_init.size = 2 * TRC_REC_MAX;
+   while (ring_init.size * 2 <= buf_sz)
+   {  /* Largest power of 2 in the buffer */
+      ring_init.size *= 2;
+   }
+   ring_init.p_next = p_rings;
+   p_rings = &ring_init;
+   p_ring_own = &ring_init;
+   trc_epoch = trc_ns();
    trc_prn_mask = TRC_PREFIX_COMP | TRC_PREFIX_TYPE;
 }
 
 /*-----------------------------------------------------------------------------
+The thread formats the buffered traces every TRC_DRAIN_MS.
 -----------------------------------------------------------------------------*/
 void trc_start(void)
 {
+   pthread_t thread;
+
+   if (pthread_create(&thread, NULL, trc_drain, NULL) == 0)
+   {
+      pthread_detach(thread);
+   }
 }
 
 /*-----------------------------------------------------------------------------
@@ -129,6 +223,26 @@ int trc_trace(trc_lnk_t* p_obj, uint32_t mask, const char* p_fmt, ...)
    size_t n = 0;
    char trc_str[TRC_MAX_STR_LEN+1];
 
+   if ((p_obj->p_client->mask & mask) && (modei == TRC_MODE_BUF))
+   {
+      uint64_t rec[TRC_REC_MAX / sizeof(uint64_t)];
+      trc_rec_t* p_rec = (trc_rec_t*)rec;
+      trc_ring_t* p_ring = trc_ring_own();
+      va_list ap;
+
+      if (p_ring == NULL)
+      {
+         return 0;
+      }
+      p_rec->mask = mask;
+      p_rec->ts = trc_ns();
+      p_rec->p_client = p_obj->p_client;
+      p_rec->p_fmt = p_fmt;
+      va_start(ap, p_fmt);
+      n = trc_pack(p_rec, sizeof(rec), ap);
+      va_end(ap);
+      return trc_ring_put(p_ring, p_rec) ? n : 0;
+   }
    if (p_obj->p_client->mask & mask)
    {
       va_list ap;
@@ -137,17 +251,11 @@ int trc_trace(trc_lnk_t* p_obj, uint32_t mask, const char* p_fmt, ...)
       n += vsnprintf(&trc_str[n], TRC_MAX_STR_LEN-n, p_fmt, ap);
       va_end(ap);
 
+      n = MIN(n, TRC_MAX_STR_LEN - 1);
       trc_str[n++] = '\n';
       trc_str[n] = 0;
       switch (modei)
       {
-      case TRC_MODE_BUF:
-         if ((p_buf_head + n) < p_buf_end)
-         {
-            strcpy(p_buf_head, trc_str);
-            p_buf_head += n;
-         }
-         break;
       case TRC_MODE_PRINT:
          trc_print_co(trc_str, n);
          break;
@@ -172,66 +280,96 @@ trc_mode_t trc_mode_get(void)
    return modei;
 }
 
-#if 0
 /*----------------------------------------------------------------------------
+The rings are merged by time, the oldest queued record of all rings is output
+first.
 ----------------------------------------------------------------------------*/
 void trc_view_buf(void)
 {
-   trc_buf_t* p_buf;
-   trc_buf_t* p_buf_end;
-   char txt[TRC_MAX_STR];
-   size_t n;
+   uint64_t rec[TRC_REC_MAX / sizeof(uint64_t)];
+   trc_rec_t* p_rec = (trc_rec_t*)rec;
+   char trc_str[TRC_MAX_STR_LEN+1];
+   trc_ring_t* p_ring;
 
-   switch (part)
+   pthread_mutex_lock(&view_lock);
+   for (;;)
    {
-   case TRC_VIEW_PART_QUEUED:
-      p_buf = p_buf_tail;
-      p_buf_end = p_buf_head;
-      break;
-   case TRC_VIEW_PART_ALL:
-      p_buf = p_buf_first;
-      p_buf_end = p_buf_head;
-      break;
-   default:
-      break;
+      trc_ring_t* p_min = NULL;
+      uint64_t ts = 0;
+      size_t n;
+
+      for (p_ring = __atomic_load_n(&p_rings, __ATOMIC_ACQUIRE);
+           p_ring != NULL; p_ring = p_ring->p_next)
+      {
+         if (trc_ring_peek(p_ring, p_rec) && ((p_min == NULL) ||
+             (p_rec->ts < ts)))
+         {
+            p_min = p_ring;
+            ts = p_rec->ts;
+         }
+      }
+      if (p_min == NULL)
+      {
+         break;
+      }
+      trc_ring_peek(p_min, p_rec);
+      memcpy(p_rec, &p_min->p_data[p_min->tail & (p_min->size - 1)],
+         p_rec->sz);
+      n = trc_unpack(trc_str, sizeof(trc_str), p_rec);
+      __atomic_store_n(&p_min->tail, p_min->tail + p_rec->sz,
+         __ATOMIC_RELEASE);
+      trc_print_co(trc_str, n);
    }
-   while (p_buf != p_buf_end)
+   for (p_ring = __atomic_load_n(&p_rings, __ATOMIC_ACQUIRE); p_ring != NULL;
+        p_ring = p_ring->p_next)
    {
-      n = unpack_trc(txt, STATIC_CAST(trc_head_t*, p_buf++));
-      INVARIANT(n < TRC_MAX_STR);
-      switch (dst)
+      uint32_t lost = __atomic_load_n(&p_ring->lost, __ATOMIC_RELAXED);
+      if (lost != p_ring->lost_seen)
       {
-      case TRC_VIEW_DST_TRCP:
-         trc_print_co(txt, n);
-         break;
-      case TRC_VIEW_DST_CMDP:
-         dcp_printf(id, p_nm, txt);
-         break;
-      default:
-         break;
+         snprintf(trc_str, sizeof(trc_str), "[trc]: %u traces lost\n",
+            lost - p_ring->lost_seen);
+         p_ring->lost_seen = lost;
+         trc_print_co(trc_str, strlen(trc_str));
       }
    }
+   pthread_mutex_unlock(&view_lock);
 }
-#endif
 
 /*---------------------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 void trc_get_buf_sz(uint32_t* p_no_used, uint32_t* p_no_free)
 {
-  uint32_t u;
-  uint32_t f;
-  u = (uint32_t)(p_buf_head - p_buf_start);
-  f = (uint32_t)(p_buf_end -  p_buf_head);
-  *p_no_used = u;
-  *p_no_free = f;
+   trc_ring_t* p_ring;
+   uint32_t u = 0;
+   uint32_t f = 0;
+
+   for (p_ring = __atomic_load_n(&p_rings, __ATOMIC_ACQUIRE); p_ring != NULL;
+        p_ring = p_ring->p_next)
+   {
+      uint32_t used = __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE) -
+         __atomic_load_n(&p_ring->tail, __ATOMIC_ACQUIRE);
+      u += used;
+      f += p_ring->size - used;
+   }
+   *p_no_used = u;
+   *p_no_free = f;
 }
 
 /*---------------------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 void trc_clear_buf(void)
 {
-   p_buf_head = p_buf_start;
-   p_buf_head[0] = 0;
+   trc_ring_t* p_ring;
+
+   pthread_mutex_lock(&view_lock);
+   for (p_ring = __atomic_load_n(&p_rings, __ATOMIC_ACQUIRE); p_ring != NULL;
+        p_ring = p_ring->p_next)
+   {
+      __atomic_store_n(&p_ring->tail,
+         __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+      p_ring->lost_seen = __atomic_load_n(&p_ring->lost, __ATOMIC_RELAXED);
+   }
+   pthread_mutex_unlock(&view_lock);
 }
 
 /*-----------------------------------------------------------------------------
@@ -330,4 +468,438 @@ STATIC int bit_num(uint32_t mask)
    return num;
 }
 
+/*-----------------------------------------------------------------------------
+Parse a conversion specification, p_fmt is after the '%'.
+\return After the specification
+-----------------------------------------------------------------------------*/
+STATIC const char* trc_spec(const char* p_fmt, trc_spec_t* p_spec)
+{
+   p_spec->stars = 0;
+   while ((*p_fmt != 0) && (strchr("-+ #0'", *p_fmt) != NULL))
+   {
+      p_fmt++;
+   }
+   for (;;)
+   {  /* Width, then precision */
+      if (*p_fmt == '*')
+      {
+         p_spec->stars++;
+         p_fmt++;
+      }
+      while ((*p_fmt >= '0') && (*p_fmt <= '9'))
+      {
+         p_fmt++;
+      }
+      if (*p_fmt != '.')
+      {
+         break;
+      }
+      p_fmt++;
+   }
+   p_spec->p_len = p_fmt;
+   p_spec->len = 0;
+   if ((*p_fmt != 0) && (strchr("hljztL", *p_fmt) != NULL))
+   {
+      p_spec->len = *p_fmt++;
+      if ((p_spec->len == 'h') && (*p_fmt == 'h'))
+      {
+         p_spec->len = 'H';
+         p_fmt++;
+      }
+      else if ((p_spec->len == 'l') && (*p_fmt == 'l'))
+      {
+         p_spec->len = 'q';
+         p_fmt++;
+      }
+   }
+   p_spec->conv = *p_fmt;
+   if (*p_fmt != 0)
+   {
+      p_fmt++;
+   }
+   return p_fmt;
+}
+
+/*-----------------------------------------------------------------------------
+Pack the arguments after the record header in format order. Integers are
+widened to 64 bits, floating point to double, a string is its length (with the
+terminator) followed by the characters. Packing stops at an unknown conversion
+or when the record is full, formatting stops at the same place.
+\return Record size
+-----------------------------------------------------------------------------*/
+STATIC size_t trc_pack(trc_rec_t* p_rec, size_t sz, va_list ap)
+{
+   char* p_buf = (char*)p_rec;
+   size_t n = sizeof(trc_rec_t);
+   const char* p_fmt = p_rec->p_fmt;
+
+   while ((p_fmt = strchr(p_fmt, '%')) != NULL)
+   {
+      trc_spec_t spec;
+      trc_arg_t arg[3];
+      int n_arg = 0;
+      const char* p_str = NULL;
+      int i;
+
+      if (p_fmt[1] == '%')
+      {
+         p_fmt += 2;
+         continue;
+      }
+      p_fmt = trc_spec(p_fmt + 1, &spec);
+      for (i=0;i<spec.stars;i++)
+      {
+         arg[n_arg++].i = va_arg(ap, int);
+      }
+      switch (spec.conv)
+      {
+      case 'd':
+      case 'i':
+         switch (spec.len)
+         {
+         case 'H': arg[n_arg].i = (signed char)va_arg(ap, int); break;
+         case 'h': arg[n_arg].i = (short)va_arg(ap, int); break;
+         case 'l': arg[n_arg].i = va_arg(ap, long); break;
+         case 'q': arg[n_arg].i = va_arg(ap, long long); break;
+         case 'j': arg[n_arg].i = va_arg(ap, intmax_t); break;
+         case 'z': arg[n_arg].i = (ptrdiff_t)va_arg(ap, size_t); break;
+         case 't': arg[n_arg].i = va_arg(ap, ptrdiff_t); break;
+         default: arg[n_arg].i = va_arg(ap, int); break;
+         }
+         n_arg++;
+         break;
+      case 'o':
+      case 'u':
+      case 'x':
+      case 'X':
+         switch (spec.len)
+         {
+         case 'H': arg[n_arg].u = (unsigned char)va_arg(ap, unsigned); break;
+         case 'h': arg[n_arg].u = (unsigned short)va_arg(ap, unsigned); break;
+         case 'l': arg[n_arg].u = va_arg(ap, unsigned long); break;
+         case 'q': arg[n_arg].u = va_arg(ap, unsigned long long); break;
+         case 'j': arg[n_arg].u = va_arg(ap, uintmax_t); break;
+         case 'z': arg[n_arg].u = va_arg(ap, size_t); break;
+         case 't': arg[n_arg].u = (size_t)va_arg(ap, ptrdiff_t); break;
+         default: arg[n_arg].u = va_arg(ap, unsigned); break;
+         }
+         n_arg++;
+         break;
+      case 'c':
+         arg[n_arg++].i = va_arg(ap, int);
+         break;
+      case 'e':
+      case 'E':
+      case 'f':
+      case 'F':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A':
+         arg[n_arg++].d = (spec.len == 'L') ?
+            (double)va_arg(ap, long double) : va_arg(ap, double);
+         break;
+      case 'p':
+         arg[n_arg++].p = va_arg(ap, void*);
+         break;
+      case 's':
+         p_str = va_arg(ap, const char*);
+         p_str = (p_str == NULL) ? "(null)" : p_str;
+         break;
+      case 'n':
+         (void)va_arg(ap, void*);
+         continue;
+      default:
+         p_fmt = NULL;
+         break;
+      }
+      if ((p_fmt == NULL) || (n + (n_arg + ((p_str != NULL) ? 2 : 0)) *
+          sizeof(trc_arg_t) > sz))
+      {
+         break;
+      }
+      memcpy(&p_buf[n], arg, n_arg * sizeof(trc_arg_t));
+      n += n_arg * sizeof(trc_arg_t);
+      if (p_str != NULL)
+      {  /* Length, then the (truncated) string */
+         size_t len = MIN(strlen(p_str) + 1, sz - n - sizeof(trc_arg_t));
+         arg[0].u = len;
+         memcpy(&p_buf[n], arg, sizeof(trc_arg_t));
+         memcpy(&p_buf[n + sizeof(trc_arg_t)], p_str, len);
+         p_buf[n + sizeof(trc_arg_t) + len - 1] = 0;
+         n += sizeof(trc_arg_t) + TRC_ALIGN(len);
+      }
+   }
+   p_rec->sz = (uint32_t)n;
+   return n;
+}
+
+/*-----------------------------------------------------------------------------
+Format a record as trc_trace() does in TRC_MODE_PRINT, the time is in ms since
+trc_init(). Each conversion is printed on its own with the packed (widened)
+argument.
+\return Length
+-----------------------------------------------------------------------------*/
+STATIC size_t trc_unpack(char* p_dst, size_t sz, trc_rec_t const* p_rec)
+{
+   char const* p_buf = (char const*)p_rec;
+   size_t arg_n = sizeof(trc_rec_t);
+   const char* p_fmt = p_rec->p_fmt;
+   size_t n;
+
+   n = prefix_info(p_dst, p_rec->mask, p_rec->p_client->p_name,
+      (uint32_t)((p_rec->ts - trc_epoch) / 1000000));
+   sz -= 2;    /* Newline and terminator */
+   while ((*p_fmt != 0) && (n < sz))
+   {
+      trc_spec_t spec;
+      trc_arg_t arg[3];
+      char conv[32];
+      const char* p_pct = strchr(p_fmt, '%');
+      size_t len = (p_pct == NULL) ? strlen(p_fmt) : (size_t)(p_pct - p_fmt);
+      int n_arg;
+      int i;
+
+      len = MIN(len, sz - n);
+      memcpy(&p_dst[n], p_fmt, len);
+      n += len;
+      p_fmt += len;
+      if ((p_pct == NULL) || (p_fmt != p_pct))
+      {
+         break;
+      }
+      if (p_pct[1] == '%')
+      {
+         p_dst[n] = '%';
+         n += (n < sz);
+         p_fmt += 2;
+         continue;
+      }
+      p_fmt = trc_spec(p_pct + 1, &spec);
+      if (spec.conv == 'n')
+      {
+         continue;
+      }
+      n_arg = spec.stars + ((spec.conv == 's') ? 0 : 1);
+      if ((strchr("diouxXceEfFgGaAps", spec.conv) == NULL) ||
+          (spec.conv == 0) ||
+          (arg_n + (n_arg + (spec.conv == 's')) * sizeof(trc_arg_t) >
+           p_rec->sz) ||
+          ((size_t)(spec.p_len - p_pct) + 4 > sizeof(conv)))
+      {  /* Not packed */
+         break;
+      }
+      memcpy(arg, &p_buf[arg_n], n_arg * sizeof(trc_arg_t));
+      arg_n += n_arg * sizeof(trc_arg_t);
+      /* The specification with the length of the packed argument */
+      len = spec.p_len - p_pct;
+      memcpy(conv, p_pct, len);
+      if (strchr("diouxX", spec.conv) != NULL)
+      {
+         conv[len++] = 'l';
+         conv[len++] = 'l';
+      }
+      conv[len++] = spec.conv;
+      conv[len] = 0;
+      i = spec.stars;
+      switch (spec.conv)
+      {
+      case 's':
+      {
+         const char* p_str = &p_buf[arg_n + sizeof(trc_arg_t)];
+         memcpy(&arg[i], &p_buf[arg_n], sizeof(trc_arg_t));
+         arg_n += sizeof(trc_arg_t) + TRC_ALIGN(arg[i].u);
+         arg[i].p = p_str;
+         break;
+      }
+      default:
+         break;
+      }
+#define TRC_UNPACK(type, val)\
+      ((i == 0) ? snprintf(&p_dst[n], sz - n + 1, conv, (type)(val)) :\
+       (i == 1) ? snprintf(&p_dst[n], sz - n + 1, conv, (int)arg[0].i,\
+                     (type)(val)) :\
+       snprintf(&p_dst[n], sz - n + 1, conv, (int)arg[0].i, (int)arg[1].i,\
+          (type)(val)))
+      switch (spec.conv)
+      {
+      case 'd':
+      case 'i':
+         len = TRC_UNPACK(long long, arg[i].i);
+         break;
+      case 'c':
+         len = TRC_UNPACK(int, arg[i].i);
+         break;
+      case 'e':
+      case 'E':
+      case 'f':
+      case 'F':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A':
+         len = TRC_UNPACK(double, arg[i].d);
+         break;
+      case 'p':
+         len = TRC_UNPACK(const void*, arg[i].p);
+         break;
+      case 's':
+         len = TRC_UNPACK(const char*, arg[i].p);
+         break;
+      default:
+         len = TRC_UNPACK(unsigned long long, arg[i].u);
+         break;
+      }
+#undef TRC_UNPACK
+      n += MIN(len, sz - n);
+   }
+   p_dst[n++] = '\n';
+   p_dst[n] = 0;
+   return n;
+}
+
+/*-----------------------------------------------------------------------------
+The ring of the calling thread, taken from the free list or created on its
+first trace. A ring taken from the list keeps its place in the list of rings
+and the records of the exited thread, the new thread writes behind them.
+\return NULL if out of memory
+-----------------------------------------------------------------------------*/
+STATIC trc_ring_t* trc_ring_own(void)
+{
+   trc_ring_t* p_ring = p_ring_own;
+
+   if (p_ring != NULL)
+   {
+      return p_ring;
+   }
+   pthread_once(&ring_once, trc_ring_key);
+   pthread_mutex_lock(&free_lock);
+   p_ring = p_rings_free;
+   if (p_ring != NULL)
+   {
+      p_rings_free = p_ring->p_free;
+   }
+   pthread_mutex_unlock(&free_lock);
+   if (p_ring == NULL)
+   {
+      p_ring = (trc_ring_t*)calloc(1, sizeof(trc_ring_t) + TRC_RING_SZ);
+      if (p_ring == NULL)
+      {
+         return NULL;
+      }
+      p_ring->p_data = (char*)(p_ring + 1);
+      p_ring->size = TRC_RING_SZ;
+      p_ring->p_next = __atomic_load_n(&p_rings, __ATOMIC_RELAXED);
+      while (!__atomic_compare_exchange_n(&p_rings, &p_ring->p_next, p_ring,
+         TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      {
+      }
+   }
+   pthread_setspecific(ring_key, p_ring);
+   p_ring_own = p_ring;
+   return p_ring;
+}
+
+/*-----------------------------------------------------------------------------
+Create the key whose destructor runs on the exit of a tracing thread.
+-----------------------------------------------------------------------------*/
+STATIC void trc_ring_key(void)
+{
+   pthread_key_create(&ring_key, trc_ring_free);
+}
+
+/*-----------------------------------------------------------------------------
+Key destructor, the thread exits: its ring goes to the free list. The thread
+wrote its last record, the lock orders its head before the next writer.
+-----------------------------------------------------------------------------*/
+STATIC void trc_ring_free(void* p_arg)
+{
+   trc_ring_t* p_ring = (trc_ring_t*)p_arg;
+
+   p_ring_own = NULL;
+   pthread_mutex_lock(&free_lock);
+   p_ring->p_free = p_rings_free;
+   p_rings_free = p_ring;
+   pthread_mutex_unlock(&free_lock);
+}
+
+/*-----------------------------------------------------------------------------
+Copy a record to the head of the ring. A record does not wrap, the rest of the
+ring is padded if it does not fit.
+\return FALSE if the ring is full
+-----------------------------------------------------------------------------*/
+STATIC bool_t trc_ring_put(trc_ring_t* p_ring, trc_rec_t const* p_rec)
+{
+   uint32_t head = p_ring->head;
+   uint32_t used = head - __atomic_load_n(&p_ring->tail, __ATOMIC_ACQUIRE);
+   uint32_t pos = head & (p_ring->size - 1);
+   uint32_t pad = p_ring->size - pos;
+
+   pad = (pad < p_rec->sz) ? pad : 0;
+   if (used + pad + p_rec->sz > p_ring->size)
+   {
+      __atomic_store_n(&p_ring->lost, p_ring->lost + 1, __ATOMIC_RELAXED);
+      return FALSE;
+   }
+   if (pad > 0)
+   {
+      uint32_t pad_rec[2];
+      pad_rec[0] = pad;
+      pad_rec[1] = 0;
+      memcpy(&p_ring->p_data[pos], pad_rec, sizeof(pad_rec));
+      pos = 0;
+   }
+   memcpy(&p_ring->p_data[pos], p_rec, p_rec->sz);
+   __atomic_store_n(&p_ring->head, head + pad + p_rec->sz, __ATOMIC_RELEASE);
+   return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+Copy the header of the oldest record, padding is skipped.
+\return FALSE if the ring is empty
+-----------------------------------------------------------------------------*/
+STATIC bool_t trc_ring_peek(trc_ring_t* p_ring, trc_rec_t* p_rec)
+{
+   uint32_t head = __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE);
+
+   while (p_ring->tail != head)
+   {
+      uint32_t pos = p_ring->tail & (p_ring->size - 1);
+      uint32_t pad_rec[2];
+
+      memcpy(pad_rec, &p_ring->p_data[pos], sizeof(pad_rec));
+      if (pad_rec[1] != 0)
+      {
+         memcpy(p_rec, &p_ring->p_data[pos], sizeof(trc_rec_t));
+         return TRUE;
+      }
+      __atomic_store_n(&p_ring->tail, p_ring->tail + pad_rec[0],
+         __ATOMIC_RELEASE);
+   }
+   return FALSE;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC uint64_t trc_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+STATIC void* trc_drain(void* p_arg)
+{
+   TOUCH(p_arg);
+   for (;;)
+   {
+      usleep(TRC_DRAIN_MS * 1000);
+      trc_view_buf();
+   }
+   return NULL;
+}
+
 /* END OF FILE ***************************************************************/
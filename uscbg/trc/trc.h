@@ -52,7 +52,7 @@ typedef struct
 
 typedef enum
 {
-   TRC_MODE_BUF,            /*!< Trace will be buffered */
+   TRC_MODE_BUF,            /*!< Trace will be buffered (trc_view_buf) */
    TRC_MODE_PRINT,          /*!< Trace will sent using trc_print */
    TRC_MODE_LAST
 } trc_mode_t;
@@ -161,8 +161,8 @@ this ID if the trc commands are enabled. */
    trc_mode_set(mode)
 #define TRC_MODE_GET()\
    trc_mode_get()
-#define TRC_VIEW_BUF(id, p_nm, part, dst)\
-   trc_view_buf(id, p_nm, part, dst)
+#define TRC_VIEW_BUF()\
+   trc_view_buf()
 #define TRC_GET_BUF_SZ(p_sz_queued, p_sz_free)\
    trc_get_buf_sz(p_sz_queued, p_sz_free)
 #define TRC_CLEAR_BUF()\
@@ -187,7 +187,7 @@ this ID if the trc commands are enabled. */
 #define TRC_DEREG(comp)
 #define TRC_MODE_SET(mode)
 #define TRC_MODE_GET()
-#define TRC_VIEW_BUF(id, p_nm, part, dst)
+#define TRC_VIEW_BUF()
 #define TRC_GET_BUF_SZ(p_sz_queued, p_sz_free)
 #define TRC_CLEAR_BUF()
 #define TRC_PRINT_ATTACH(fn)
@@ -202,7 +202,8 @@ this ID if the trc commands are enabled. */
 This function initialises the trc component. It must be called only once.
 The trc component must be initialized before it is called within another
 context. Attempts to violate this rule are catched with ASSERT in debug
-builds. Define a trace buffer used by trc */
+builds. Define a trace buffer used by trc, it is the TRC_MODE_BUF ring of the
+calling thread. Other threads get a ring of their own on their first trace. */
 /*---------------------------------------------------------------------------*/
 void trc_init(
    char* p_buf,          /*!< Trace buffer pointer */
@@ -296,20 +297,24 @@ trc_mode_t trc_mode_get(
    void
    );
 /*---------------------------------------------------------------------------*/
-/*! \brief View trace buffer */
+/*! \brief View trace buffer
+
+Formats and outputs (trc_print) the traces buffered by all threads in
+TRC_MODE_BUF, oldest first, and the number of traces lost on full buffers.
+A buffered trace keeps the format pointer, the format must be a literal. */
 /*---------------------------------------------------------------------------*/
 void trc_view_buf(
    void
    );
 /*---------------------------------------------------------------------------*/
-/*! \brief Get buffer size */
+/*! \brief Get buffer size (all threads) */
 /*---------------------------------------------------------------------------*/
 void trc_get_buf_sz(
    uint32_t* p_no_used,      /*!< Numner of bytes used */
    uint32_t* p_no_free       /*!< Number of bytes free */
    );
 /*---------------------------------------------------------------------------*/
-/*! \brief Clear buffer */
+/*! \brief Clear buffer (all threads) */
 /*---------------------------------------------------------------------------*/
 void trc_clear_buf(
    void